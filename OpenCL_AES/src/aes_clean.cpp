@@ -9,6 +9,7 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <iomanip>
@@ -16,6 +17,9 @@
 #include <iterator>
 #include <vector>
 #include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
 #include <assert.h>
 
 // #define VERIFY // Enable result comparison with mbedTLS
@@ -27,6 +31,7 @@
 
 #define AES_BLK_BYTES 16 // AES block size
 #define GF_128_FDBK 0x87 // Modulus of the Galois Field
+#define XTS_UNIT_BYTES 4096 // XTS data unit (sector) size for the CPU engine
 
 using namespace std;
 using namespace aocl_utils;
@@ -87,6 +92,146 @@ void mbedXtsReference(const vector<unsigned char> &ptx_h,
   mbedtls_aes_free( &tweak_ctx  );
 }
 
+// Double-ended queue of data unit indexes: the owner takes units from the
+// front, thieves take them from the back
+class UnitDeque {
+ public:
+  void push(size_t unit) {
+    lock_guard<mutex> lock(mtx);
+    units.push_back(unit);
+  }
+
+  bool pop(size_t &unit) {
+    lock_guard<mutex> lock(mtx);
+    if (units.empty())
+      return false;
+    unit = units.front();
+    units.pop_front();
+    return true;
+  }
+
+  bool steal(size_t &unit) {
+    lock_guard<mutex> lock(mtx);
+    if (units.empty())
+      return false;
+    unit = units.back();
+    units.pop_back();
+    return true;
+  }
+
+ private:
+  mutex mtx;
+  deque<size_t> units;
+};
+
+// Per-thread state: expanded keys are computed once per thread and reused
+// for every data unit it processes. Over-aligned elements in a vector need
+// the C++17 aligned operator new.
+struct alignas(64) XtsWorker {
+  mbedtls_aes_context crypt_ctx;
+  mbedtls_aes_context tweak_ctx;
+  UnitDeque queue;
+  size_t units_done;
+  int ret; // First mbedTLS error seen by this worker
+};
+
+static void xtsWorkerLoop(vector<XtsWorker> &workers,
+                          unsigned int id,
+                          const vector<unsigned char> &key_h,
+                          const vector<unsigned char> &ptx_h,
+                          vector<unsigned char> &ctx_h,
+                          uint64_t first_unit) {
+  XtsWorker &self = workers[id];
+  int key_len = key_h.size();
+  size_t unit;
+
+  int ret;
+
+  mbedtls_aes_init( &self.crypt_ctx );
+  mbedtls_aes_init( &self.tweak_ctx );
+  if ((ret = mbedtls_aes_setkey_enc( &self.crypt_ctx, key_h.data(), (key_len*8)/2)) != 0 ||
+      (ret = mbedtls_aes_setkey_enc( &self.tweak_ctx, key_h.data()+(key_len/2), (key_len*8)/2)) != 0) {
+    // Leave the units to the other workers
+    self.ret = ret;
+    mbedtls_aes_free( &self.crypt_ctx );
+    mbedtls_aes_free( &self.tweak_ctx );
+    return;
+  }
+
+  for (;;) {
+    bool found = self.queue.pop(unit);
+    // Own queue is empty: steal from the other workers, nearest first
+    for (unsigned int i = 1; !found && i < workers.size(); i++)
+      found = workers[(id + i) % workers.size()].queue.steal(unit);
+    // No unit is ever added once the workers started, so we are done
+    if (!found)
+      break;
+
+    size_t offset = unit * XTS_UNIT_BYTES;
+    size_t len = min<size_t>(XTS_UNIT_BYTES, ptx_h.size() - offset);
+    ret = mbedtls_aes_crypt_xts_sectors( &self.crypt_ctx, &self.tweak_ctx,
+        MBEDTLS_AES_ENCRYPT, XTS_UNIT_BYTES, first_unit + unit, len,
+        ptx_h.data() + offset, ctx_h.data() + offset, NULL );
+    if (ret != 0) {
+      if (self.ret == 0)
+        self.ret = ret;
+      continue;
+    }
+    self.units_done++;
+  }
+
+  mbedtls_aes_free( &self.crypt_ctx );
+  mbedtls_aes_free( &self.tweak_ctx );
+}
+
+// Multi-threaded CPU XTS: the buffer is split in XTS_UNIT_BYTES data units,
+// numbered from first_unit, and spread over nthreads work-stealing workers.
+// Returns the number of units processed by each worker; exits if any unit
+// could not be encrypted.
+vector<size_t> mbedXtsParallel(const vector<unsigned char> &ptx_h,
+                               const vector<unsigned char> &key_h,
+                               uint64_t first_unit,
+                               vector<unsigned char> &ctx_h,
+                               unsigned int nthreads) {
+  size_t nunits = (ptx_h.size() + XTS_UNIT_BYTES - 1) / XTS_UNIT_BYTES;
+  vector<XtsWorker> workers(nthreads);
+  vector<thread> threads;
+  vector<size_t> units_done;
+
+  // The last data unit needs at least one full block
+  if (ptx_h.size() % XTS_UNIT_BYTES != 0 && ptx_h.size() % XTS_UNIT_BYTES < 16) {
+    cerr << "Error: last data unit is too short, cannot perform ciphertext stealing!"
+         << endl;
+    exit(-1);
+  }
+
+  // Contiguous initial split, stealing evens out the imbalance
+  for (size_t unit = 0; unit < nunits; unit++)
+    workers[unit * nthreads / nunits].queue.push(unit);
+
+  for (unsigned int id = 1; id < nthreads; id++)
+    threads.emplace_back(xtsWorkerLoop, ref(workers), id, cref(key_h),
+                         cref(ptx_h), ref(ctx_h), first_unit);
+  xtsWorkerLoop(workers, 0, key_h, ptx_h, ctx_h, first_unit);
+  for (thread &t : threads)
+    t.join();
+
+  size_t total_done = 0;
+  for (const XtsWorker &w : workers) {
+    if (w.ret != 0)
+      cerr << "Error: XTS worker " << (&w - workers.data())
+           << " got mbedTLS error -0x" << hex << -w.ret << dec << endl;
+    units_done.push_back(w.units_done);
+    total_done += w.units_done;
+  }
+  if (total_done != nunits) {
+    cerr << "Error: " << nunits - total_done << " of " << nunits
+         << " XTS data units were not encrypted!" << endl;
+    exit(-1);
+  }
+  return units_done;
+}
+
 cl::Context initOpenclPlatform() {
   // Opencl Device introspection
   cl_int err;
@@ -237,6 +382,181 @@ void opencl_aes_crypt_ecb(vector<unsigned char> &ptx_h,
   checkErr(err, "CommandQueue::enqueueReadBuffer()");
 }
 
+// AES S-box, computed from the multiplicative inverses in GF(2^8) as in
+// mbedTLS aes_gen_tables()
+static vector<unsigned char> aesSbox() {
+  unsigned char pow[256], log[256];
+  vector<unsigned char> sbox(256);
+  unsigned int x = 1;
+
+  for (int i = 0; i < 256; i++) {
+    pow[i] = x;
+    log[x] = i;
+    x = (x ^ (x << 1) ^ ((x & 0x80) ? 0x1B : 0x00)) & 0xFF;
+  }
+
+  sbox[0] = 0x63;
+  for (int i = 1; i < 256; i++) {
+    unsigned char y, v = pow[255 - log[i]];
+    unsigned char s = v;
+    for (int r = 0; r < 4; r++) {
+      y = (v << 1) | (v >> 7);
+      v = y;
+      s ^= y;
+    }
+    sbox[i] = s ^ 0x63;
+  }
+  return sbox;
+}
+
+// FIPS-197 key expansion, done once per job for aesEcbEncryptBatch: writes
+// the 16 * (rounds + 1) bytes of round keys in the order the kernel uses
+static void aesExpandKey(const unsigned char *key, unsigned int keybits,
+                         unsigned char *rk) {
+  static const vector<unsigned char> sbox = aesSbox();
+  unsigned int nk = keybits / 32, words = 4 * (nk + 7);
+  unsigned char rcon = 0x01;
+
+  memcpy(rk, key, 4 * nk);
+  for (unsigned int i = nk; i < words; i++) {
+    unsigned char t[4];
+    memcpy(t, rk + 4 * (i - 1), 4);
+    if (i % nk == 0) {
+      unsigned char t0 = t[0];
+      t[0] = sbox[t[1]] ^ rcon;
+      t[1] = sbox[t[2]];
+      t[2] = sbox[t[3]];
+      t[3] = sbox[t0];
+      rcon = (rcon << 1) ^ ((rcon & 0x80) ? 0x1B : 0x00);
+    } else if (nk > 6 && i % nk == 4) {
+      for (int j = 0; j < 4; j++)
+        t[j] = sbox[t[j]];
+    }
+    for (int j = 0; j < 4; j++)
+      rk[4 * i + j] = rk[4 * (i - nk) + j] ^ t[j];
+  }
+}
+
+// mbedTLS AES offload engine: the counter blocks of every job are encrypted
+// by aesEcbEncryptBatch, one launch per key size, and XORed with the data
+// on the host. The device objects are created once and reused by every call.
+struct OpenClCtrEngine {
+  cl::Context context;
+  vector<cl::Device> devices;
+  cl::Kernel kernel;
+  cl::CommandQueue queue;
+  mutex mtx; // Calls are serialized unless mbedTLS batches them already
+};
+
+void openclCtrEngineInit(OpenClCtrEngine &engine) {
+  cl_int err;
+
+  engine.context = initOpenclPlatform();
+  engine.devices = engine.context.getInfo<CL_CONTEXT_DEVICES>();
+  checkErr(engine.devices.size() > 0 ? CL_SUCCESS : -1, "devices.size() > 0");
+  engine.kernel = createOpenClKernel(engine.context,
+      engine.devices,
+      "./aes_ecb_kernel",
+      "aesEcbEncryptBatch");
+  engine.queue = cl::CommandQueue(engine.context, engine.devices[0], 0, &err);
+  checkErr(err, "CommandQueue::CommandQueue()");
+}
+
+static cl_int openclCtrLaunch(OpenClCtrEngine &engine,
+                              mbedtls_aes_offload_job * const *jobs,
+                              const vector<size_t> &members,
+                              unsigned int keybits) {
+  const size_t rk_bytes = 16 * (keybits / 32 + 7);
+  vector<unsigned char> ctr_h, rks_h(members.size() * rk_bytes), stream_h;
+  vector<cl_uint> key_idx_h;
+  cl_int err;
+
+  // One counter block per data block, 128-bit big-endian increment
+  for (size_t k = 0; k < members.size(); k++) {
+    const mbedtls_aes_offload_job *job = jobs[members[k]];
+    unsigned char counter[AES_BLK_BYTES];
+    size_t nblocks = (job->length + AES_BLK_BYTES - 1) / AES_BLK_BYTES;
+
+    aesExpandKey(job->key, keybits, rks_h.data() + k * rk_bytes);
+    memcpy(counter, job->nonce_counter, AES_BLK_BYTES);
+    for (size_t b = 0; b < nblocks; b++) {
+      ctr_h.insert(ctr_h.end(), counter, counter + AES_BLK_BYTES);
+      key_idx_h.push_back(k);
+      for (int i = AES_BLK_BYTES; i > 0; i--)
+        if (++counter[i - 1] != 0)
+          break;
+    }
+  }
+  stream_h.resize(ctr_h.size());
+
+  cl::Buffer ctrBuffer(engine.context, ctr_h.begin(), ctr_h.end(), true, true, &err);
+  if (err != CL_SUCCESS) return err;
+  cl::Buffer rksBuffer(engine.context, rks_h.begin(), rks_h.end(), true, true, &err);
+  if (err != CL_SUCCESS) return err;
+  cl::Buffer idxBuffer(engine.context, key_idx_h.begin(), key_idx_h.end(), true, true, &err);
+  if (err != CL_SUCCESS) return err;
+  cl::Buffer streamBuffer(engine.context, CL_MEM_WRITE_ONLY, stream_h.size(), NULL, &err);
+  if (err != CL_SUCCESS) return err;
+
+  cl_uint ptx_size = ctr_h.size();
+  cl_uint key_size_bits = keybits;
+  if ((err = engine.kernel.setArg(0, ctrBuffer)) != CL_SUCCESS ||
+      (err = engine.kernel.setArg(1, rksBuffer)) != CL_SUCCESS ||
+      (err = engine.kernel.setArg(2, idxBuffer)) != CL_SUCCESS ||
+      (err = engine.kernel.setArg(3, streamBuffer)) != CL_SUCCESS ||
+      (err = engine.kernel.setArg(4, key_size_bits)) != CL_SUCCESS ||
+      (err = engine.kernel.setArg(5, ptx_size)) != CL_SUCCESS)
+    return err;
+
+  err = engine.queue.enqueueNDRangeKernel(engine.kernel,
+      cl::NullRange,
+      cl::NDRange(ctr_h.size()),
+      cl::NDRange(16));
+  if (err != CL_SUCCESS) return err;
+
+  err = engine.queue.enqueueReadBuffer(streamBuffer,
+      CL_TRUE,
+      0,
+      stream_h.size(),
+      stream_h.data());
+  if (err != CL_SUCCESS) return err;
+
+  // Apply the keystream, the last block of a job may be partial
+  size_t offset = 0;
+  for (size_t k = 0; k < members.size(); k++) {
+    const mbedtls_aes_offload_job *job = jobs[members[k]];
+    for (size_t i = 0; i < job->length; i++)
+      job->output[i] = job->input[i] ^ stream_h[offset + i];
+    offset += (job->length + AES_BLK_BYTES - 1) / AES_BLK_BYTES * AES_BLK_BYTES;
+  }
+
+  return CL_SUCCESS;
+}
+
+// mbedtls_aes_offload_ctr_t callback
+int opencl_aes_offload_ctr(void *p_engine,
+                           mbedtls_aes_offload_job * const *jobs,
+                           size_t count) {
+  OpenClCtrEngine &engine = *static_cast<OpenClCtrEngine *>(p_engine);
+  lock_guard<mutex> lock(engine.mtx);
+
+  // The kernel takes a single key size per launch
+  for (unsigned int keybits : {128u, 192u, 256u}) {
+    vector<size_t> members;
+    for (size_t j = 0; j < count; j++)
+      if (jobs[j]->keybits == keybits)
+        members.push_back(j);
+    if (members.empty())
+      continue;
+
+    cl_int err = openclCtrLaunch(engine, jobs, members, keybits);
+    if (err != CL_SUCCESS) {
+      std::cerr << "ERROR: offload (" << getErrorString(err) << ")" << std::endl;
+      return err;
+    }
+  }
+  return 0;
+}
 
 void aes_test() {
 
@@ -457,8 +777,10 @@ void xts_test() {
 }
 
 // Measure execution times for data bytes ranging from 1MB to 10GB
-// growing as 1MB, 2MB, 5MB, 10MB and so on
+// growing as 1MB, 2MB, 5MB, 10MB and so on, next to the multi-threaded CPU
+// XTS baseline on every core for the same amount of data
 void aes_benchmark() {
+  unsigned int nthreads = max(1u, thread::hardware_concurrency());
   ofstream outFile;
   outFile.open ("aes_ecb_benchmark.csv");
   for(uint64_t size=1000000; size < 10*(uint64_t)1000000000; size*=10)
@@ -469,14 +791,158 @@ void aes_benchmark() {
       aes_test();
       auto t2 = Clock::now();
       auto ecb_elapsed_time = chrono::duration_cast<chrono::nanoseconds>(t2-t1).count();
+
+      // The content does not matter for timing, skip /dev/urandom
+      vector<unsigned char> ptx_h(ptx_size_xts), ctx_h(ptx_size_xts);
+      vector<unsigned char> key_h(xts_key_size * 2);
+      for (size_t i = 0; i < ptx_h.size(); i++)
+        ptx_h[i] = (unsigned char) (i * 7);
+      for (size_t i = 0; i < key_h.size(); i++)
+        key_h[i] = (unsigned char) (i * 13 + 1);
+      t1 = Clock::now();
+      mbedXtsParallel(ptx_h, key_h, 0, ctx_h, nthreads);
+      t2 = Clock::now();
+      auto cpu_elapsed_time = chrono::duration_cast<chrono::nanoseconds>(t2-t1).count();
+
       outFile << size*value << ","
-              << ecb_elapsed_time << endl;
+              << ecb_elapsed_time << ","
+              << cpu_elapsed_time << endl;
     }
   outFile.close();
 }
 
+// Measure the multi-threaded CPU XTS baseline on 1 to N cores and report
+// throughput, speedup and parallel efficiency for each thread count
+void xts_cpu_scaling() {
+  const uint64_t size = 64*1000000;
+  unsigned int max_threads = max(1u, thread::hardware_concurrency());
+  vector<unsigned int> thread_counts;
+  vector<unsigned char> ptx_h(size), key_h(xts_key_size * 2);
+  vector<unsigned char> ctx_h(size), ctx_ref(size);
+  double base_rate = 0;
+
+  ifstream urandom("/dev/urandom", ios::in|ios::binary);
+  assert(urandom.good());
+  urandom.read(reinterpret_cast<char*>(ptx_h.data()), size);
+  urandom.read(reinterpret_cast<char*>(key_h.data()), xts_key_size * 2);
+  assert(urandom.good());
+  urandom.close();
+
+  // Reference ciphertext, one data unit at a time: the tweak of each unit
+  // is its number as a 16-byte little-endian value
+  for (size_t offset = 0; offset < size; offset += XTS_UNIT_BYTES) {
+    size_t len = min<size_t>(XTS_UNIT_BYTES, size - offset);
+    uint64_t unit = offset / XTS_UNIT_BYTES;
+    vector<unsigned char> unit_ptx(ptx_h.begin() + offset,
+                                   ptx_h.begin() + offset + len);
+    vector<unsigned char> unit_ctx(len), iv_h(iv_size, 0);
+
+    for (unsigned int i = 0; i < 8; i++)
+      iv_h[i] = (unsigned char) (unit >> (8 * i));
+    mbedXtsReference(unit_ptx, key_h, iv_h, unit_ctx);
+    copy(unit_ctx.begin(), unit_ctx.end(), ctx_ref.begin() + offset);
+  }
+
+  // 1, 2, 4, ... threads, then every core
+  for (unsigned int n = 1; n < max_threads; n *= 2)
+    thread_counts.push_back(n);
+  thread_counts.push_back(max_threads);
+
+  ofstream outFile;
+  outFile.open ("xts_cpu_scaling.csv");
+  for (unsigned int n : thread_counts) {
+    auto t1 = Clock::now();
+    vector<size_t> units_done = mbedXtsParallel(ptx_h, key_h, 0, ctx_h, n);
+    auto t2 = Clock::now();
+    auto elapsed_time = chrono::duration_cast<chrono::nanoseconds>(t2-t1).count();
+    double rate = (double) size / elapsed_time; // GB/s
+    if (n == 1)
+      base_rate = rate;
+
+    cout << n << " threads: " << rate << " GB/s, speedup "
+         << rate / base_rate << ", efficiency "
+         << 100 * rate / (base_rate * n) << "%, units per thread:";
+    for (size_t done : units_done)
+      cout << " " << done;
+    cout << (ctx_h == ctx_ref ? "" : " MISMATCH") << endl;
+
+    outFile << n << "," << size << "," << elapsed_time << endl;
+  }
+  outFile.close();
+}
+
+// Many threads encrypting records of mixed sizes and keys through the
+// OpenCL offload engine: requests under the threshold stay on the CPU,
+// the others are gathered into shared launches when mbedTLS is built with
+// MBEDTLS_THREADING_PTHREAD. Every result is checked against mbedTLS.
+void ctr_offload_test() {
+  const unsigned int nthreads = 16, records = 200;
+  const size_t threshold = 4096;
+  OpenClCtrEngine engine;
+  mbedtls_aes_offload_context offload;
+  vector<thread> threads;
+  vector<int> failures(nthreads, 0);
+
+  openclCtrEngineInit(engine);
+  mbedtls_aes_offload_init(&offload);
+  mbedtls_aes_offload_setup(&offload, opencl_aes_offload_ctr, &engine, threshold);
+
+  auto t1 = Clock::now();
+  for (unsigned int id = 0; id < nthreads; id++)
+    threads.emplace_back([&, id]() {
+      unsigned int keybits = 128 + 64 * (id % 3);
+      vector<unsigned char> key(32), ptx(16384), ctx(16384), ref(16384);
+      unsigned char nonce[AES_BLK_BYTES] = {0}, counter[AES_BLK_BYTES];
+      unsigned char stream[AES_BLK_BYTES];
+      mbedtls_aes_context aes;
+
+      for (size_t i = 0; i < key.size(); i++)
+        key[i] = id * 31 + i;
+      for (size_t i = 0; i < ptx.size(); i++)
+        ptx[i] = id + i * 7;
+      mbedtls_aes_init(&aes);
+      mbedtls_aes_setkey_enc(&aes, key.data(), keybits);
+
+      for (unsigned int r = 0; r < records; r++) {
+        size_t len = (r % 4 == 0) ? 512 + r : 16384 - r; // Small and large records
+        size_t nc_off = 0;
+        nonce[15] = r;
+        memcpy(counter, nonce, AES_BLK_BYTES);
+        if (mbedtls_aes_offload_crypt_ctr(&offload, key.data(), keybits, nonce,
+                                          len, ptx.data(), ctx.data()) != 0)
+          failures[id]++;
+        mbedtls_aes_crypt_ctr(&aes, len, &nc_off, counter, stream,
+                              ptx.data(), ref.data());
+        if (memcmp(ctx.data(), ref.data(), len) != 0)
+          failures[id]++;
+      }
+      mbedtls_aes_free(&aes);
+    });
+  for (thread &t : threads)
+    t.join();
+  auto t2 = Clock::now();
+  auto elapsed_time = chrono::duration_cast<chrono::nanoseconds>(t2-t1).count();
+
+  int total_failures = 0;
+  for (int f : failures)
+    total_failures += f;
+  cout << "CTR offload: " << offload.jobs << " requests offloaded in "
+       << offload.calls << " engine calls, " << elapsed_time << " ns, "
+       << (total_failures == 0 ? "CORRECT" : "WRONG") << endl;
+
+  mbedtls_aes_offload_free(&offload);
+}
+
 int main(int argc, char *argv[]) {
   //aes_test();
   //xts_test();
+  if (argc > 1 && string(argv[1]) == "--xts-cpu") {
+    xts_cpu_scaling();
+    return 0;
+  }
+  if (argc > 1 && string(argv[1]) == "--ctr-offload") {
+    ctr_offload_test();
+    return 0;
+  }
   aes_benchmark();
 }
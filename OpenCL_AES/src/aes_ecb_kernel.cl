@@ -74,37 +74,19 @@ void put_uint32(uint32 n, __local uint8 *b, uint8 i)
 
 /**
  *
- *	Setting encryption key
- *	/param context encryption context
- *	/param bey input key
- *	/param nbits key length
+ *	Key expansion, the first words of the round key being the cipher key
+ *	/param context encryption context, with the round number set
  *
  */
 
-int aes_set_key( __local aes_context *context, __constant const uint8 *key, int nbits )
+int aes_expand_key( __local aes_context *context )
 {
     unsigned int i;
-    __local uint32 *RK, *SK;
-
-    // Setting the number of round according to the key length
-
-    switch( nbits )
-    {
-        case 128: context->nr = 10; break;
-        case 192: context->nr = 12; break;
-        case 256: context->nr = 14; break;
-        default : return( 1 );
-    }
+    __local uint32 *RK;
 
     /** Initializing pointer to round key */
     RK = context->erk;
 
-#pragma unroll 8
-    for( i = 0; i < (nbits >> 5); i++ )	  // Convert data into 32 bits
-    {
-        GET_UINT32( RK[i], key, i << 2 );
-    }
-
     switch( context->nr )
     {
         case 10:
@@ -175,6 +157,176 @@ int aes_set_key( __local aes_context *context, __constant const uint8 *key, int
 
 }
 
+/**
+ *
+ *	Setting encryption key
+ *	/param context encryption context
+ *	/param bey input key
+ *	/param nbits key length
+ *
+ */
+
+int aes_set_key( __local aes_context *context, __constant const uint8 *key, int nbits )
+{
+    unsigned int i;
+
+    // Setting the number of round according to the key length
+
+    switch( nbits )
+    {
+        case 128: context->nr = 10; break;
+        case 192: context->nr = 12; break;
+        case 256: context->nr = 14; break;
+        default : return( 1 );
+    }
+
+#pragma unroll 8
+    for( i = 0; i < (nbits >> 5); i++ )	  // Convert data into 32 bits
+    {
+        GET_UINT32( context->erk[i], key, i << 2 );
+    }
+
+    return( aes_expand_key( context ) );
+}
+
+/**
+ *
+ *	Encrypt one block, one byte per work-item of the work-group
+ *	/param nr round number
+ *	/param RK round keys, as bytes
+ *	/param X Y Z work-group buffers
+ *	/param in input byte of the work-item
+ *	/param id index of the work-item in the work-group
+ *	/return output byte of the work-item
+ *
+ */
+
+uint8 aes_encrypt_rounds( int nr,
+        __local uint8 *RK,
+        __local uint8 *X,
+        __local uint8 *Y,
+        __local uint8 *Z,
+        uint8 in,
+        size_t id )
+{
+    // Note that bytes are inserted columns by rows, so the first 4 bytes
+    // in the arrays corresponds to the first column on the left
+
+    // Copy data and first AddRoundKey operation
+    X[id] = in ^ RK[id];
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // N-1 encryption rounds, according to key length
+#pragma unroll 1  // Can't unroll because of data dependencies
+    for(int round_num=1; round_num < nr; round_num++)
+    {
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        // SubBytes
+        Y[id] = SBox[X[id]];
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        // ShiftRows
+        __private int i = id % 4;
+        __private int j = id / 4;
+        Z[i+4*((j-i+4)%4)] = Y[i+4*j];
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        // MixColumns
+        if(id < 4) { // This has a 4-way parallelism
+            uint8 a[4], b[4];
+            for (int i=0; i < 4; i++) {
+                a[i] = Z[id * 4 + i];
+                b[i] = (a[i] << 1) ^ ((a[i] & 0x80) ? 0x1b : 0x00);
+            }
+
+            // 2*a0 + 3*a1 +   a2 +   a3
+            //   a0 * 2*a1 + 3*a2 +   a3
+            //   a0 +   a1 + 2*a2 + 3*a3
+            // 3*a0 +   a1 +   a2 + 2*a3
+
+            Z[id * 4] = b[0] ^ a[1] ^ b[1] ^ a[2] ^ a[3];
+            Z[id * 4 + 1] = a[0] ^ b[1] ^ a[2] ^ b[2] ^ a[3];
+            Z[id * 4 + 2] = a[0] ^ a[1] ^ b[2] ^ a[3] ^ b[3];
+            Z[id * 4 + 3] = a[0] ^ b[0] ^ a[1] ^ a[2] ^ b[3];
+        }
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        // AddRoundKey
+        Z[id] ^= RK[(round_num*16)+id];
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        // Output becomes input of the next round
+        X[id] = Z[id];
+    }
+
+    // Last round
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // SubBytes
+    Y[id] = SBox[X[id]];
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // ShiftRows
+    __private int i = id % 4;
+    __private int j = id / 4;
+    Z[i+4*((j-i+4)%4)] = Y[i+4*j];
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // AddRoundKey
+    Z[id] ^= RK[(nr*16)+id];
+
+    return( Z[id] );
+}
+
+/**
+ *
+ *	Encrypt one block, one byte per work-item of the work-group
+ *	/param context expanded key
+ *	/param RK X Y Z work-group buffers
+ *	/param in input byte of the work-item
+ *	/param id index of the work-item in the work-group
+ *	/param l_size work-items in a work-group
+ *	/return output byte of the work-item
+ *
+ */
+
+uint8 aes_encrypt_block( __local aes_context *context,
+        __local uint8 *RK,
+        __local uint8 *X,
+        __local uint8 *Y,
+        __local uint8 *Z,
+        uint8 in,
+        size_t id,
+        size_t l_size )
+{
+    // Convert 32bit expanded key array into an 8bit array
+    // Split work across work-items, every work-item will perform a certain
+    // number of rounds and rem other work items will perform a round once more
+    int rounds = (context->nr+1)*4/l_size;
+    int rem = ((context->nr+1)*4)%l_size;
+#pragma unroll 2
+    for(int i = 0; i < rounds; i++)
+        put_uint32(context->erk[i*16+id], RK, 4*(i*16+id));
+    if(id < rem)
+        put_uint32(context->erk[rounds*16+id],
+                   RK,
+                   4*(rounds*16+id));
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    return( aes_encrypt_rounds( context->nr, RK, X, Y, Z, in, id ) );
+}
+
 /**
  *
  *       Kernel entry point
@@ -211,99 +363,55 @@ void aesEcbEncrypt (__constant const uint8* restrict ptx_d,
     // Perform this computation with one work_group per AES block
     // each work group is composed of 16 work_item, one per AES block byte
     if(group_id < (ptx_size / 16)) {
-        // Note that bytes are inserted columns by rows, so the first 4 bytes
-        // in the arrays corresponds to the first column on the left
-
-        // Convert 32bit expanded key array into an 8bit array
-        // Split work across work-items, every work-item will perform a certain
-        // number of rounds and rem other work items will perform a round once more
-        int rounds = (context.nr+1)*4/l_size;
-        int rem = ((context.nr+1)*4)%l_size;
-#pragma unroll 2
-        for(int i = 0; i < rounds; i++)
-            put_uint32(context.erk[i*16+id], RK, 4*(i*16+id));
-        if(id < rem)
-            put_uint32(context.erk[rounds*16+id],
-                       RK,
-                       4*(rounds*16+id));
-
-        barrier(CLK_LOCAL_MEM_FENCE);
-
-        // Copy data and first AddRoundKey operation
-        X[id] = ptx_d[global_id] ^ RK[id];
-
-        barrier(CLK_LOCAL_MEM_FENCE);
-
-        // N-1 encryption rounds, according to key length
-#pragma unroll 1  // Can't unroll because of data dependencies
-        for(int round_num=1; round_num < context.nr; round_num++)
-        {
-
-            barrier(CLK_LOCAL_MEM_FENCE);
-
-            // SubBytes
-            Y[id] = SBox[X[id]];
-
-            barrier(CLK_LOCAL_MEM_FENCE);
-
-            // ShiftRows
-            __private int i = id % 4;
-            __private int j = id / 4;
-            Z[i+4*((j-i+4)%4)] = Y[i+4*j];
-
-            barrier(CLK_LOCAL_MEM_FENCE);
-
-            // MixColumns
-            if(id < 4) { // This has a 4-way parallelism
-                uint8 a[4], b[4];
-                for (int i=0; i < 4; i++) {
-                    a[i] = Z[id * 4 + i];
-                    b[i] = (a[i] << 1) ^ ((a[i] & 0x80) ? 0x1b : 0x00);
-                }
-
-                // 2*a0 + 3*a1 +   a2 +   a3
-                //   a0 * 2*a1 + 3*a2 +   a3
-                //   a0 +   a1 + 2*a2 + 3*a3
-                // 3*a0 +   a1 +   a2 + 2*a3
-
-                Z[id * 4] = b[0] ^ a[1] ^ b[1] ^ a[2] ^ a[3];
-                Z[id * 4 + 1] = a[0] ^ b[1] ^ a[2] ^ b[2] ^ a[3];
-                Z[id * 4 + 2] = a[0] ^ a[1] ^ b[2] ^ a[3] ^ b[3];
-                Z[id * 4 + 3] = a[0] ^ b[0] ^ a[1] ^ a[2] ^ b[3];
-            }
-
-            barrier(CLK_LOCAL_MEM_FENCE);
-
-            // AddRoundKey
-            Z[id] ^= RK[(round_num*16)+id];
-
-            barrier(CLK_LOCAL_MEM_FENCE);
-
-            // Output becomes input of the next round
-            X[id] = Z[id];
-        }
-
-        // Last round
+        // Copy results back into host memory
+        ctx_d[global_id] = aes_encrypt_block(&context, RK, X, Y, Z,
+                                             ptx_d[global_id], id, l_size);
 
-        barrier(CLK_LOCAL_MEM_FENCE);
+        barrier(CLK_GLOBAL_MEM_FENCE);
+    }
+}
 
-        // SubBytes
-        Y[id] = SBox[X[id]];
+/**
+ *
+ *       Kernel entry point, blocks with different keys
+ *	/param ptx_d plaintext
+ *	/param rks_d round keys, expanded on the host, as bytes:
+ *	       16 * (rounds + 1) bytes per key
+ *	/param key_idx_d index in rks_d of the key of each block
+ *	/param ctx_d ciphertext
+ *	/param key_length_d keylength in bit, the same for every key
+ *	/param ptx_size plaintext size in bytes
+ *
+ */
+    __kernel __attribute__((reqd_work_group_size(16, 1, 1)))
+void aesEcbEncryptBatch (__global const uint8* restrict ptx_d,
+        __global const uint8* restrict rks_d,
+        __global const uint* restrict key_idx_d,
+        __global uint8* restrict ctx_d,
+        const uint key_length_d,
+        const uint ptx_size)
+{
+    __local uint8 RK[240];                   // Round key
+    __local uint8 X[16];                    // Input blocks (shared in the wg)
+    __local uint8 Y[16];                    // Working blocks (shared in the wg)
+    __local uint8 Z[16];                    // Output blocks (shared in the wg)
+    __private size_t id = get_local_id(0);        // Index in the work-group
+    __private size_t global_id = get_global_id(0);// Global index
+    __private size_t group_id = get_group_id(0);  // Index of the work-group
+    __private int nr = key_length_d / 32 + 6;     // Round number
 
-        barrier(CLK_LOCAL_MEM_FENCE);
+    // One work_group per AES block, as in aesEcbEncrypt, each work-item
+    // copying its bytes of the round keys of the block
+    if(group_id < (ptx_size / 16)) {
+        __global const uint8 *rk = rks_d + key_idx_d[group_id] * 16 * (nr + 1);
 
-        // ShiftRows
-        __private int i = id % 4;
-        __private int j = id / 4;
-        Z[i+4*((j-i+4)%4)] = Y[i+4*j];
+        for(int i = id; i < 16 * (nr + 1); i += 16)
+            RK[i] = rk[i];
 
         barrier(CLK_LOCAL_MEM_FENCE);
 
-        // AddRoundKey
-        Z[id] ^= RK[(context.nr*16)+id];
-
-        // Copy results back into host memory
-        ctx_d[global_id] = Z[id];
+        ctx_d[global_id] = aes_encrypt_rounds(nr, RK, X, Y, Z,
+                                              ptx_d[global_id], id);
 
         barrier(CLK_GLOBAL_MEM_FENCE);
     }
@@ -39,6 +39,18 @@
 #define MBEDTLS_ERR_AES_INVALID_KEY_LENGTH                -0x0020  /**< Invalid key length. */
 #define MBEDTLS_ERR_AES_INVALID_INPUT_LENGTH              -0x0022  /**< Invalid data input length. */
 
+#if defined(MBEDTLS_CIPHER_MODE_XTS)
+struct mbedtls_threading_pool;  /* see threading.h */
+#endif
+
+#if defined(MBEDTLS_AES_OFFLOAD) && defined(MBEDTLS_THREADING_PTHREAD)
+#include <pthread.h>
+#endif
+
+#if !defined(MBEDTLS_AES_OFFLOAD_MAX_JOBS)
+#define MBEDTLS_AES_OFFLOAD_MAX_JOBS    32  /**< Maximum number of requests gathered into one offload engine call */
+#endif
+
 #if !defined(MBEDTLS_AES_ALT)
 // Regular implementation
 //
@@ -197,6 +209,43 @@ int mbedtls_aes_crypt_xts( mbedtls_aes_context *crypt_ctx,
                     unsigned char iv[16],
                     const unsigned char *input,
                     unsigned char *output );
+
+/**
+ * \brief           AES-XTS encryption/decryption of consecutive sectors
+ *                  (data units), optionally spread over a thread pool
+ *
+ *                  Sector first_sector + i covers bytes
+ *                  [i * sector_size, (i + 1) * sector_size) and uses its
+ *                  number as a 128-bit little-endian tweak (IEEE P1619).
+ *                  The last sector may be shorter, but no shorter than
+ *                  16 bytes.
+ *
+ * \note            Decryption of sectors that are not a multiple of 16
+ *                  bytes modifies the input buffer, like
+ *                  mbedtls_aes_crypt_xts().
+ *
+ * \param crypt_ctx AES context for encrypting data
+ * \param tweak_ctx AES context for xor-ing with data
+ * \param mode      MBEDTLS_AES_ENCRYPT or MBEDTLS_AES_DECRYPT
+ * \param sector_size size of a sector in bytes (at least 16)
+ * \param first_sector number of the first sector
+ * \param length    length of the input data in bytes
+ * \param input     buffer holding the input data
+ * \param output    buffer holding the output data
+ * \param pool      mbedtls_threading_pool to run the sectors on, or NULL
+ *                  (requires MBEDTLS_THREADING_PTHREAD)
+ *
+ * \return         0 if successful, or MBEDTLS_ERR_AES_INVALID_INPUT_LENGTH
+ */
+int mbedtls_aes_crypt_xts_sectors( mbedtls_aes_context *crypt_ctx,
+                    mbedtls_aes_context *tweak_ctx,
+                    int mode,
+                    size_t sector_size,
+                    uint64_t first_sector,
+                    size_t length,
+                    const unsigned char *input,
+                    unsigned char *output,
+                    struct mbedtls_threading_pool *pool );
 #endif /* MBEDTLS_CIPHER_MODE_XTS */
 
 #if defined(MBEDTLS_CIPHER_MODE_CFB)
@@ -335,6 +384,121 @@ void mbedtls_aes_decrypt( mbedtls_aes_context *ctx,
 extern "C" {
 #endif
 
+#if defined(MBEDTLS_AES_OFFLOAD)
+/**
+ * \brief          AES-CTR request handed to an offload engine
+ */
+typedef struct
+{
+    const unsigned char *key;       /*!< AES key                            */
+    unsigned int keybits;           /*!< key size: 128, 192 or 256 bits     */
+    unsigned char nonce_counter[16];/*!< first counter block                */
+    const unsigned char *input;     /*!< data to encrypt or decrypt         */
+    unsigned char *output;          /*!< result, may be equal to input      */
+    size_t length;                  /*!< length of the data                 */
+}
+mbedtls_aes_offload_job;
+
+/**
+ * \brief          Callback type: offload engine
+ *
+ *                 Encrypts or decrypts the data of every job in CTR mode,
+ *                 like mbedtls_aes_crypt_ctr() does: the counter block is
+ *                 incremented as a 128-bit big-endian integer after each
+ *                 block, and the last block may be partial. The jobs may
+ *                 use different keys.
+ *
+ * \param p_engine Engine context
+ * \param jobs     Jobs to process in this call
+ * \param count    Number of jobs, between 1 and MBEDTLS_AES_OFFLOAD_MAX_JOBS
+ *
+ * \return         0 if every job was processed, or an error code which is
+ *                 then returned to the callers of all the jobs
+ */
+typedef int mbedtls_aes_offload_ctr_t( void *p_engine,
+                                       mbedtls_aes_offload_job * const *jobs,
+                                       size_t count );
+
+/**
+ * \brief          AES offload context
+ *
+ *                 Requests smaller than the threshold are processed on the
+ *                 CPU (with AES-NI when available), larger ones by the
+ *                 engine. With MBEDTLS_THREADING_PTHREAD, the requests made
+ *                 while the engine is busy are queued, and handed to it in a
+ *                 single call once the current one returns.
+ */
+typedef struct
+{
+    mbedtls_aes_offload_ctr_t *f_ctr;   /*!< engine callback            */
+    void *p_engine;                     /*!< engine context             */
+    size_t threshold;                   /*!< minimum offloaded length   */
+    unsigned long calls;                /*!< engine calls so far        */
+    unsigned long jobs;                 /*!< offloaded requests so far  */
+#if defined(MBEDTLS_THREADING_PTHREAD)
+    pthread_mutex_t mutex;              /*!< protects the fields below  */
+    pthread_cond_t cond;                /*!< an engine call ended       */
+    void *queue[MBEDTLS_AES_OFFLOAD_MAX_JOBS]; /*!< waiting requests    */
+    size_t queued;                      /*!< number of waiting requests */
+    int busy;                           /*!< engine call in progress    */
+#endif
+}
+mbedtls_aes_offload_context;
+
+/**
+ * \brief          Initialize an offload context
+ *
+ * \param ctx      Offload context
+ */
+void mbedtls_aes_offload_init( mbedtls_aes_offload_context *ctx );
+
+/**
+ * \brief          Set the engine of an offload context
+ *
+ * \param ctx      Offload context
+ * \param f_ctr    Engine callback
+ * \param p_engine Engine context
+ * \param threshold Length in bytes from which requests are offloaded.
+ *                 Below it, the latency of the engine usually outweighs
+ *                 its throughput.
+ */
+void mbedtls_aes_offload_setup( mbedtls_aes_offload_context *ctx,
+                                mbedtls_aes_offload_ctr_t *f_ctr,
+                                void *p_engine,
+                                size_t threshold );
+
+/**
+ * \brief          AES-CTR encryption/decryption through an offload context
+ *
+ *                 May be called concurrently by several threads.
+ *
+ * \param ctx      Offload context
+ * \param key      AES key
+ * \param keybits  Key size: 128, 192 or 256 bits
+ * \param nonce_counter The first counter block (left unchanged)
+ * \param length   Length of the data
+ * \param input    Input data
+ * \param output   Output data, may be equal to input
+ *
+ * \return         0 if successful, MBEDTLS_ERR_AES_INVALID_KEY_LENGTH, or
+ *                 an error from the engine
+ */
+int mbedtls_aes_offload_crypt_ctr( mbedtls_aes_offload_context *ctx,
+                                   const unsigned char *key,
+                                   unsigned int keybits,
+                                   const unsigned char nonce_counter[16],
+                                   size_t length,
+                                   const unsigned char *input,
+                                   unsigned char *output );
+
+/**
+ * \brief          Free an offload context. No request may be in progress.
+ *
+ * \param ctx      Offload context
+ */
+void mbedtls_aes_offload_free( mbedtls_aes_offload_context *ctx );
+#endif /* MBEDTLS_AES_OFFLOAD */
+
 /**
  * \brief          Checkup routine
  *
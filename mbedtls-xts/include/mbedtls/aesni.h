@@ -65,6 +65,21 @@ int mbedtls_aesni_crypt_ecb( mbedtls_aes_context *ctx,
                      const unsigned char input[16],
                      unsigned char output[16] );
 
+/**
+ * \brief          AES-NI AES-ECB en(de)cryption of four blocks at once
+ *
+ * \param ctx      AES context
+ * \param mode     MBEDTLS_AES_ENCRYPT or MBEDTLS_AES_DECRYPT
+ * \param input    four consecutive 16-byte input blocks
+ * \param output   four consecutive 16-byte output blocks
+ *
+ * \return         0 on success (cannot fail)
+ */
+int mbedtls_aesni_crypt_ecb4( mbedtls_aes_context *ctx,
+                      int mode,
+                      const unsigned char input[64],
+                      unsigned char output[64] );
+
 /**
  * \brief          GCM multiplication: c = a * b in GF(2^128)
  *
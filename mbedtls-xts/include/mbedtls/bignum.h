@@ -55,7 +55,8 @@
 #if !defined(MBEDTLS_MPI_WINDOW_SIZE)
 /*
  * Maximum window size used for modular exponentiation. Default: 6
- * Minimum value: 1. Maximum value: 6.
+ * Minimum value: 1. Maximum value: 7 (only used for exponents of more
+ * than 1791 bits).
  *
  * Result is an array of ( 2 << MBEDTLS_MPI_WINDOW_SIZE ) MPIs used
  * for the sliding window calculation. (So 64 by default)
@@ -65,6 +66,25 @@
 #define MBEDTLS_MPI_WINDOW_SIZE                           6        /**< Maximum windows size used. */
 #endif /* !MBEDTLS_MPI_WINDOW_SIZE */
 
+#if !defined(MBEDTLS_MPI_KARATSUBA_THRESHOLD)
+/*
+ * Minimum size in limbs of both operands for which multiplications and
+ * squarings use Karatsuba's method instead of the schoolbook one.
+ * Default: 80 (5120 bits with 64-bit limbs). Minimum value: 4.
+ */
+#define MBEDTLS_MPI_KARATSUBA_THRESHOLD                   80       /**< Operand size in limbs above which Karatsuba multiplication is used. */
+#endif /* !MBEDTLS_MPI_KARATSUBA_THRESHOLD */
+
+#if !defined(MBEDTLS_MPI_COMB_WIDTH)
+/*
+ * Number of teeth of the fixed-base combs of mbedtls_mpi_comb_setup().
+ * The table holds ( 1 << MBEDTLS_MPI_COMB_WIDTH ) values of the size of
+ * the modulus, all of which are read at every step of an exponentiation.
+ * Default: 5. Minimum value: 2. Maximum value: 8.
+ */
+#define MBEDTLS_MPI_COMB_WIDTH                            5        /**< Teeth of fixed-base exponentiation combs. */
+#endif /* !MBEDTLS_MPI_COMB_WIDTH */
+
 #if !defined(MBEDTLS_MPI_MAX_SIZE)
 /*
  * Maximum size of MPIs allowed in bits and bytes for user-MPIs.
@@ -78,6 +98,16 @@
 
 #define MBEDTLS_MPI_MAX_BITS                              ( 8 * MBEDTLS_MPI_MAX_SIZE )    /**< Maximum number of bits for usable MPIs. */
 
+#if !defined(MBEDTLS_MPI_ARENA_SIZE)
+/*
+ * Size in bytes of the scratch arena that RSA operations put on the stack
+ * for their MPI temporaries when MBEDTLS_MPI_ARENA is enabled. Allocations
+ * that do not fit go to the heap. Default: 6144 bytes, enough for RSA-2048
+ * private key operations with 64-bit limbs.
+ */
+#define MBEDTLS_MPI_ARENA_SIZE                            6144     /**< Size of the per-operation scratch arena. */
+#endif /* !MBEDTLS_MPI_ARENA_SIZE */
+
 /*
  * When reading from files with mbedtls_mpi_read_file() and writing to files with
  * mbedtls_mpi_write_file() the buffer should have space
@@ -138,6 +168,25 @@
 extern "C" {
 #endif
 
+#if defined(MBEDTLS_MPI_ARENA)
+/**
+ * \brief          Fixed-capacity scratch storage for MPI limbs
+ *
+ *                 Limbs are handed out from the top, each block followed
+ *                 by one bookkeeping limb. A freed block is given back as
+ *                 soon as every block above it has been freed too; the
+ *                 topmost block grows and shrinks in place.
+ */
+typedef struct mbedtls_mpi_arena
+{
+    mbedtls_mpi_uint *buf;      /*!<  storage                       */
+    size_t size;                /*!<  capacity in limbs             */
+    size_t used;                /*!<  limbs handed out              */
+    size_t peak;                /*!<  highest value of used         */
+}
+mbedtls_mpi_arena;
+#endif /* MBEDTLS_MPI_ARENA */
+
 /**
  * \brief          MPI structure
  */
@@ -146,9 +195,45 @@ typedef struct
     int s;              /*!<  integer sign      */
     size_t n;           /*!<  total # of limbs  */
     mbedtls_mpi_uint *p;          /*!<  pointer to limbs  */
+#if defined(MBEDTLS_MPI_ARENA)
+    mbedtls_mpi_arena *arena;     /*!<  scratch arena, or NULL */
+#endif
 }
 mbedtls_mpi;
 
+/**
+ * \brief          Montgomery context: the constants modular exponentiation
+ *                 derives from an odd modulus N, computed once with
+ *                 mbedtls_mpi_mont_setup(). With R the limb base raised to
+ *                 the number of limbs of N, values multiplied by R mod N
+ *                 are said to be in Montgomery form.
+ */
+typedef struct
+{
+    mbedtls_mpi_uint mm;        /*!<  -N^-1 mod limb base  */
+    mbedtls_mpi RR;             /*!<  R^2 mod N            */
+}
+mbedtls_mpi_mont_ctx;
+
+/**
+ * \brief          Fixed-base comb: precomputed powers of a base G modulo N
+ *                 for exponentiations X = G^E mod N with a varying E of at
+ *                 most w * d bits, set up with mbedtls_mpi_comb_setup().
+ *
+ *                 Entry i of the table is the product of G^(2^(j*d)) for
+ *                 every bit j set in i, in Montgomery form.
+ */
+typedef struct
+{
+    size_t w;                   /*!<  teeth, the table has 2^w entries  */
+    size_t d;                   /*!<  bits between two teeth            */
+    mbedtls_mpi N;              /*!<  modulus                           */
+    mbedtls_mpi G;              /*!<  base, reduced mod N               */
+    mbedtls_mpi_mont_ctx mont;  /*!<  Montgomery constants of N         */
+    mbedtls_mpi *T;             /*!<  table                             */
+}
+mbedtls_mpi_comb;
+
 /**
  * \brief           Initialize one MPI (make internal references valid)
  *                  This just makes it ready to be set or freed,
@@ -158,6 +243,33 @@ mbedtls_mpi;
  */
 void mbedtls_mpi_init( mbedtls_mpi *X );
 
+#if defined(MBEDTLS_MPI_ARENA)
+/**
+ * \brief          Initialize a scratch arena
+ *
+ * \param arena    Arena to initialize
+ * \param buf      Storage for the limbs, suitably aligned for
+ *                 mbedtls_mpi_uint
+ * \param size     Size of buf in bytes
+ */
+void mbedtls_mpi_arena_init( mbedtls_mpi_arena *arena, void *buf, size_t size );
+
+/**
+ * \brief          Initialize one MPI whose limbs come from a scratch arena
+ *                 while it has room, and from the heap otherwise.
+ *                 Temporaries of the bignum functions that have X as
+ *                 destination use the same arena.
+ *
+ * \note           X must be freed before the storage of the arena is
+ *                 released or reused, and must not be handed over to
+ *                 longer-lived structures.
+ *
+ * \param X        One MPI to initialize.
+ * \param arena    Arena to draw limbs from
+ */
+void mbedtls_mpi_init_arena( mbedtls_mpi *X, mbedtls_mpi_arena *arena );
+#endif /* MBEDTLS_MPI_ARENA */
+
 /**
  * \brief          Unallocate one MPI
  *
@@ -629,6 +741,134 @@ int mbedtls_mpi_mod_int( mbedtls_mpi_uint *r, const mbedtls_mpi *A, mbedtls_mpi_
  */
 int mbedtls_mpi_exp_mod( mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi *E, const mbedtls_mpi *N, mbedtls_mpi *_RR );
 
+/**
+ * \brief          Initialize a Montgomery context
+ *
+ * \param ctx      Context to initialize
+ */
+void mbedtls_mpi_mont_init( mbedtls_mpi_mont_ctx *ctx );
+
+/**
+ * \brief          Unallocate a Montgomery context
+ *
+ * \param ctx      Context to free
+ */
+void mbedtls_mpi_mont_free( mbedtls_mpi_mont_ctx *ctx );
+
+/**
+ * \brief          Compute the Montgomery constants of a modulus
+ *
+ * \param ctx      Initialized Montgomery context
+ * \param N        Modulus, odd and positive. It must not change, nor
+ *                 grow to more limbs, while ctx is in use.
+ *
+ * \return         0 if successful,
+ *                 MBEDTLS_ERR_MPI_ALLOC_FAILED if memory allocation failed,
+ *                 MBEDTLS_ERR_MPI_BAD_INPUT_DATA if N is not positive or even
+ */
+int mbedtls_mpi_mont_setup( mbedtls_mpi_mont_ctx *ctx, const mbedtls_mpi *N );
+
+/**
+ * \brief          Montgomery multiplication: X = A * B * R^-1 mod N
+ *
+ * \note           With A or B in Montgomery form, this is the plain
+ *                 product A * B mod N without any division; with both,
+ *                 the result is the product in Montgomery form. Multiply
+ *                 by ctx->RR to convert into Montgomery form, and by 1
+ *                 to convert back.
+ *
+ * \param X        Destination MPI
+ * \param A        Left-hand MPI, 0 <= A < N
+ * \param B        Right-hand MPI, 0 <= B < N
+ * \param N        Modulus
+ * \param ctx      Montgomery context set up for N, only read
+ *
+ * \return         0 if successful,
+ *                 MBEDTLS_ERR_MPI_ALLOC_FAILED if memory allocation failed,
+ *                 MBEDTLS_ERR_MPI_BAD_INPUT_DATA if ctx is not set up or
+ *                 A or B is out of range
+ */
+int mbedtls_mpi_mont_mul( mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi *B,
+                          const mbedtls_mpi *N, const mbedtls_mpi_mont_ctx *ctx );
+
+/**
+ * \brief          Sliding-window exponentiation: X = A^E mod N, with the
+ *                 Montgomery constants of N precomputed
+ *
+ * \note           Same as mbedtls_mpi_exp_mod(), but ctx is only read, so
+ *                 that several threads can share it.
+ *
+ * \param X        Destination MPI
+ * \param A        Left-hand MPI
+ * \param E        Exponent MPI
+ * \param N        Modular MPI
+ * \param ctx      Montgomery context set up for N
+ *
+ * \return         0 if successful,
+ *                 MBEDTLS_ERR_MPI_ALLOC_FAILED if memory allocation failed,
+ *                 MBEDTLS_ERR_MPI_BAD_INPUT_DATA if ctx is not set up, N is
+ *                 negative or even or if E is negative
+ */
+int mbedtls_mpi_mont_exp( mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi *E,
+                          const mbedtls_mpi *N, const mbedtls_mpi_mont_ctx *ctx );
+
+/**
+ * \brief          Initialize a fixed-base comb
+ *
+ * \param comb     Comb to be initialized
+ */
+void mbedtls_mpi_comb_init( mbedtls_mpi_comb *comb );
+
+/**
+ * \brief          Unallocate a fixed-base comb
+ *
+ * \param comb     Comb to be unallocated
+ */
+void mbedtls_mpi_comb_free( mbedtls_mpi_comb *comb );
+
+/**
+ * \brief          Precompute the comb of a base G modulo N for exponents
+ *                 of up to ebits bits
+ *
+ * \note           Costs about as much as one exponentiation with
+ *                 mbedtls_mpi_exp_mod(), after which mbedtls_mpi_comb_exp()
+ *                 needs ebits / MBEDTLS_MPI_COMB_WIDTH squarings and as
+ *                 many multiplications instead of about ebits squarings.
+ *
+ * \param comb     Comb, replaced if already set up
+ * \param G        Base
+ * \param N        Modulus, positive and odd
+ * \param ebits    Maximum size of the exponents in bits
+ *
+ * \return         0 if successful,
+ *                 MBEDTLS_ERR_MPI_ALLOC_FAILED if memory allocation failed,
+ *                 MBEDTLS_ERR_MPI_BAD_INPUT_DATA if N is not positive and
+ *                 odd or ebits is 0
+ */
+int mbedtls_mpi_comb_setup( mbedtls_mpi_comb *comb, const mbedtls_mpi *G,
+                            const mbedtls_mpi *N, size_t ebits );
+
+/**
+ * \brief          Fixed-base exponentiation: X = G^E mod N, with G and N
+ *                 those of the comb
+ *
+ * \note           The sequence of operations and memory accesses does not
+ *                 depend on the value of E, only on the size of the comb.
+ *                 The comb is only read, so that several threads can share
+ *                 it.
+ *
+ * \param X        Destination MPI
+ * \param E        Exponent MPI, 0 <= E < 2^(w * d)
+ * \param comb     Comb set up with mbedtls_mpi_comb_setup()
+ *
+ * \return         0 if successful,
+ *                 MBEDTLS_ERR_MPI_ALLOC_FAILED if memory allocation failed,
+ *                 MBEDTLS_ERR_MPI_BAD_INPUT_DATA if the comb is not set up
+ *                 or E is out of range
+ */
+int mbedtls_mpi_comb_exp( mbedtls_mpi *X, const mbedtls_mpi *E,
+                          const mbedtls_mpi_comb *comb );
+
 /**
  * \brief          Fill an MPI X with size bytes of random
  *
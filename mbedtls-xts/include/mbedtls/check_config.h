@@ -73,6 +73,14 @@
 #error "MBEDTLS_CTR_DRBG_C defined, but not all prerequisites"
 #endif
 
+#if defined(MBEDTLS_CTR_DRBG_BUFFER_SIZE) &&                              \
+    ( ( defined(MBEDTLS_CTR_DRBG_MAX_REQUEST) &&                           \
+        MBEDTLS_CTR_DRBG_BUFFER_SIZE > MBEDTLS_CTR_DRBG_MAX_REQUEST ) ||   \
+      ( !defined(MBEDTLS_CTR_DRBG_MAX_REQUEST) &&                          \
+        MBEDTLS_CTR_DRBG_BUFFER_SIZE > 1024 ) )
+#error "MBEDTLS_CTR_DRBG_BUFFER_SIZE larger than MBEDTLS_CTR_DRBG_MAX_REQUEST"
+#endif
+
 #if defined(MBEDTLS_DHM_C) && !defined(MBEDTLS_BIGNUM_C)
 #error "MBEDTLS_DHM_C defined, but not all prerequisites"
 #endif
@@ -112,6 +120,50 @@
 #error "MBEDTLS_ECP_C defined, but not all prerequisites"
 #endif
 
+#if defined(MBEDTLS_ECP_COMB_CACHE) && !defined(MBEDTLS_ECP_C)
+#error "MBEDTLS_ECP_COMB_CACHE defined, but not all prerequisites"
+#endif
+
+#if defined(MBEDTLS_DHM_COMB_CACHE) && !defined(MBEDTLS_DHM_C)
+#error "MBEDTLS_DHM_COMB_CACHE defined, but not all prerequisites"
+#endif
+
+#if defined(MBEDTLS_SSL_LAZY_BUFFERS) && !defined(MBEDTLS_SSL_TLS_C)
+#error "MBEDTLS_SSL_LAZY_BUFFERS defined, but not all prerequisites"
+#endif
+
+#if defined(MBEDTLS_AES_OFFLOAD) &&                                    \
+    ( !defined(MBEDTLS_AES_C) || !defined(MBEDTLS_CIPHER_MODE_CTR) )
+#error "MBEDTLS_AES_OFFLOAD defined, but not all prerequisites"
+#endif
+
+#if defined(MBEDTLS_AES_OFFLOAD_MAX_JOBS) && MBEDTLS_AES_OFFLOAD_MAX_JOBS < 1
+#error "MBEDTLS_AES_OFFLOAD_MAX_JOBS must be at least 1"
+#endif
+
+#if defined(MBEDTLS_NET_POLLER) &&                                     \
+    ( !defined(MBEDTLS_NET_C) || !defined(__linux__) )
+#error "MBEDTLS_NET_POLLER defined, but not all prerequisites"
+#endif
+
+#if defined(MBEDTLS_SSL_BATCH_WRITES) && !defined(MBEDTLS_SSL_TLS_C)
+#error "MBEDTLS_SSL_BATCH_WRITES defined, but not all prerequisites"
+#endif
+
+#if defined(MBEDTLS_SSL_ASYNC_PRIVATE) && !defined(MBEDTLS_SSL_SRV_C)
+#error "MBEDTLS_SSL_ASYNC_PRIVATE defined, but not all prerequisites"
+#endif
+
+#if defined(MBEDTLS_SSL_CACHE_SHARDS) &&                              \
+    ( MBEDTLS_SSL_CACHE_SHARDS < 1 ||                                 \
+      ( MBEDTLS_SSL_CACHE_SHARDS & ( MBEDTLS_SSL_CACHE_SHARDS - 1 ) ) != 0 )
+#error "MBEDTLS_SSL_CACHE_SHARDS must be a power of two"
+#endif
+
+#if defined(MBEDTLS_SSL_BATCH_RECORDS) && MBEDTLS_SSL_BATCH_RECORDS < 2
+#error "MBEDTLS_SSL_BATCH_RECORDS must be at least 2"
+#endif
+
 #if defined(MBEDTLS_ENTROPY_C) && (!defined(MBEDTLS_SHA512_C) &&      \
                                     !defined(MBEDTLS_SHA256_C))
 #error "MBEDTLS_ENTROPY_C defined, but not all prerequisites"
@@ -130,6 +182,12 @@
 #error "MBEDTLS_ENTROPY_FORCE_SHA256 defined, but not all prerequisites"
 #endif
 
+#if defined(MBEDTLS_ENTROPY_BACKGROUND) &&                                   \
+    ( !defined(MBEDTLS_ENTROPY_C) || !defined(MBEDTLS_THREADING_C) ||        \
+      !defined(MBEDTLS_THREADING_PTHREAD) )
+#error "MBEDTLS_ENTROPY_BACKGROUND defined, but not all prerequisites"
+#endif
+
 #if defined(MBEDTLS_GCM_C) && (                                        \
         !defined(MBEDTLS_AES_C) && !defined(MBEDTLS_CAMELLIA_C) )
 #error "MBEDTLS_GCM_C defined, but not all prerequisites"
@@ -203,6 +261,30 @@
 #error "MBEDTLS_MEMORY_BUFFER_ALLOC_C defined, but not all prerequisites"
 #endif
 
+#if defined(MBEDTLS_MPI_ARENA) && !defined(MBEDTLS_BIGNUM_C)
+#error "MBEDTLS_MPI_ARENA defined, but not all prerequisites"
+#endif
+
+#if defined(MBEDTLS_MPI_MULX) && \
+    ( !defined(MBEDTLS_HAVE_ASM) || !defined(MBEDTLS_BIGNUM_C) )
+#error "MBEDTLS_MPI_MULX defined, but not all prerequisites"
+#endif
+
+#if defined(MBEDTLS_MPI_KARATSUBA_THRESHOLD) && \
+    MBEDTLS_MPI_KARATSUBA_THRESHOLD < 4
+#error "MBEDTLS_MPI_KARATSUBA_THRESHOLD must be at least 4"
+#endif
+
+#if defined(MBEDTLS_MPI_WINDOW_SIZE) && \
+    ( MBEDTLS_MPI_WINDOW_SIZE < 1 || MBEDTLS_MPI_WINDOW_SIZE > 7 )
+#error "MBEDTLS_MPI_WINDOW_SIZE must be between 1 and 7"
+#endif
+
+#if defined(MBEDTLS_MPI_COMB_WIDTH) && \
+    ( MBEDTLS_MPI_COMB_WIDTH < 2 || MBEDTLS_MPI_COMB_WIDTH > 8 )
+#error "MBEDTLS_MPI_COMB_WIDTH must be between 2 and 8"
+#endif
+
 #if defined(MBEDTLS_PADLOCK_C) && !defined(MBEDTLS_HAVE_ASM)
 #error "MBEDTLS_PADLOCK_C defined, but not all prerequisites"
 #endif
@@ -346,6 +346,25 @@
  */
 #define MBEDTLS_CIPHER_MODE_CTR
 
+/**
+ * \def MBEDTLS_AES_OFFLOAD
+ *
+ * Enable AES-CTR offloading through mbedtls_aes_offload_context: requests
+ * of at least a given size are handed to an external engine (GPU, FPGA,
+ * OpenCL device...) while smaller ones stay on the CPU. With
+ * MBEDTLS_THREADING_PTHREAD, requests made concurrently by several threads
+ * are gathered into a single call to the engine.
+ *
+ * AES-GCM contexts can use it with mbedtls_gcm_set_offload(), and SSL
+ * configurations with mbedtls_ssl_conf_aes_offload() for the records of
+ * AES-GCM ciphersuites.
+ *
+ * Requires: MBEDTLS_AES_C, MBEDTLS_CIPHER_MODE_CTR
+ *
+ * Comment this macro to disable AES offloading.
+ */
+#define MBEDTLS_AES_OFFLOAD
+
 /**
  * \def MBEDTLS_CIPHER_NULL_CIPHER
  *
@@ -455,6 +474,79 @@
  */
 #define MBEDTLS_ECP_NIST_OPTIM
 
+/**
+ * \def MBEDTLS_ECP_P256_OPTIM
+ *
+ * Enable a dedicated implementation of point multiplication on secp256r1,
+ * using fixed-size 4x64-bit Montgomery field arithmetic without heap
+ * allocation and complete projective formulas with constant-time table
+ * lookups. Several times faster than the generic code for ECDH and ECDSA
+ * on P-256.
+ *
+ * Only effective with compilers providing unsigned __int128 (GCC and Clang
+ * on 64-bit targets); silently ignored otherwise.
+ *
+ * Requires: MBEDTLS_ECP_DP_SECP256R1_ENABLED
+ *
+ * Comment this macro to always use the generic code for secp256r1.
+ */
+#define MBEDTLS_ECP_P256_OPTIM
+
+/**
+ * \def MBEDTLS_ECP_X25519_OPTIM
+ *
+ * Enable a dedicated implementation of point multiplication on Curve25519
+ * (X25519), using 5x51-bit limbs with 128-bit products and a constant-time
+ * Montgomery ladder, instead of the generic bignum code. Used transparently
+ * by the ECDH module.
+ *
+ * Only effective with compilers providing unsigned __int128 (GCC and Clang
+ * on 64-bit targets); silently ignored otherwise.
+ *
+ * Requires: MBEDTLS_ECP_DP_CURVE25519_ENABLED
+ *
+ * Comment this macro to always use the generic code for Curve25519.
+ */
+#define MBEDTLS_ECP_X25519_OPTIM
+
+/**
+ * \def MBEDTLS_ECP_COMB_CACHE
+ *
+ * Keep a process-wide cache of the comb tables precomputed for the
+ * generator of each curve, shared read-only by every group loaded with
+ * mbedtls_ecp_group_load(), so that key generation and signing on a fresh
+ * group (e.g. each TLS handshake) skip the precomputation.
+ *
+ * The tables stay allocated until mbedtls_ecp_comb_cache_free() is called.
+ * With MBEDTLS_THREADING_C, the cache is protected by
+ * mbedtls_threading_ecp_mutex.
+ *
+ * Requires: MBEDTLS_ECP_C
+ *
+ * Uncomment this macro to enable the comb table cache.
+ */
+//#define MBEDTLS_ECP_COMB_CACHE
+
+/**
+ * \def MBEDTLS_DHM_COMB_CACHE
+ *
+ * Keep a process-wide cache of fixed-base comb tables (see
+ * mbedtls_mpi_comb_setup()) for the first few (G, P) pairs used by
+ * mbedtls_dhm_make_params() and mbedtls_dhm_make_public(), so that computing
+ * G^X for a new DHM context (e.g. each TLS handshake with a DHE suite) takes
+ * about a third of a sliding-window exponentiation. Each context keeps a
+ * pointer to the table of its parameters.
+ *
+ * The tables stay allocated until mbedtls_dhm_comb_cache_free() is called.
+ * With MBEDTLS_THREADING_C, the cache is protected by
+ * mbedtls_threading_dhm_mutex.
+ *
+ * Requires: MBEDTLS_DHM_C
+ *
+ * Uncomment this macro to enable the comb table cache.
+ */
+//#define MBEDTLS_DHM_COMB_CACHE
+
 /**
  * \def MBEDTLS_ECDSA_DETERMINISTIC
  *
@@ -768,6 +860,35 @@
  */
 #define MBEDTLS_GENPRIME
 
+/**
+ * \def MBEDTLS_MPI_ARENA
+ *
+ * Let MPIs draw their limbs from a fixed-capacity scratch arena, see
+ * mbedtls_mpi_init_arena(), with the temporaries of bignum operations
+ * following their destination. RSA public and private key operations keep
+ * their temporaries in an arena of MBEDTLS_MPI_ARENA_SIZE bytes on the
+ * stack, so that they make no heap allocations when it is large enough.
+ *
+ * Comment this macro to disable the scratch arenas.
+ *
+ * Requires: MBEDTLS_BIGNUM_C
+ */
+#define MBEDTLS_MPI_ARENA
+
+/**
+ * \def MBEDTLS_MPI_MULX
+ *
+ * Use the MULX, ADCX and ADOX instructions (BMI2 and ADX extensions) in the
+ * inner multiplication loop of the bignum module on x86-64 processors that
+ * support them, which is detected at runtime. Other processors keep using
+ * the code of bn_mul.h.
+ *
+ * Requires: MBEDTLS_HAVE_ASM, MBEDTLS_BIGNUM_C
+ *
+ * Comment this macro to disable the MULX/ADX multiplication loop.
+ */
+#define MBEDTLS_MPI_MULX
+
 /**
  * \def MBEDTLS_FS_IO
  *
@@ -843,6 +964,23 @@
  */
 //#define MBEDTLS_ENTROPY_NV_SEED
 
+/**
+ * \def MBEDTLS_ENTROPY_BACKGROUND
+ *
+ * Enable the background entropy collector,
+ * mbedtls_entropy_background_start() and mbedtls_entropy_background_stop().
+ *
+ * While running, a dedicated thread polls the entropy sources ahead of time
+ * and keeps up to MBEDTLS_ENTROPY_BACKGROUND_SLOTS outputs of
+ * mbedtls_entropy_func() ready, so that DRBG (re)seeding does not wait on
+ * the sources. Each pre-gathered output is handed out once and wiped.
+ *
+ * Requires: MBEDTLS_ENTROPY_C, MBEDTLS_THREADING_C, MBEDTLS_THREADING_PTHREAD
+ *
+ * Uncomment this macro to enable the background entropy collector.
+ */
+//#define MBEDTLS_ENTROPY_BACKGROUND
+
 /**
  * \def MBEDTLS_MEMORY_DEBUG
  *
@@ -1084,6 +1222,65 @@
  */
 //#define MBEDTLS_SSL_SRV_RESPECT_CLIENT_PREFERENCE
 
+/**
+ * \def MBEDTLS_SSL_LAZY_BUFFERS
+ *
+ * Only keep the input and output record buffers of SSL contexts while
+ * they are needed, instead of for the whole life of the context: they are
+ * released as soon as they hold no pending data once the handshake is over
+ * (and by mbedtls_ssl_session_reset()), and allocated again by the next
+ * handshake, read or write. Idle connections then only use the memory of
+ * the context itself.
+ *
+ * When renegotiation is disabled, buffers allocated after the handshake
+ * are sized for the negotiated max_fragment_length instead of
+ * MBEDTLS_SSL_MAX_CONTENT_LEN.
+ *
+ * This trades memory for one allocation of each buffer per read or write
+ * that drains them, so it is mostly useful for servers with many mostly
+ * idle connections.
+ *
+ * Requires: MBEDTLS_SSL_TLS_C
+ *
+ * Uncomment this macro to allocate record buffers on demand.
+ */
+//#define MBEDTLS_SSL_LAZY_BUFFERS
+
+/**
+ * \def MBEDTLS_SSL_BATCH_WRITES
+ *
+ * Let mbedtls_ssl_write() encrypt up to MBEDTLS_SSL_BATCH_RECORDS records
+ * of a large write at once and send them with a single call to a vectored
+ * send callback, set with mbedtls_ssl_set_send_vec() (for example
+ * mbedtls_net_send_vec(), which uses writev()). This saves system calls
+ * and per-call overhead on bulk transfers over TLS (not DTLS).
+ *
+ * Contexts that use a vectored send callback allocate room for the extra
+ * records of a batch on their first large write.
+ *
+ * Requires: MBEDTLS_SSL_TLS_C
+ *
+ * Comment this macro to disable batched writes.
+ */
+#define MBEDTLS_SSL_BATCH_WRITES
+
+/**
+ * \def MBEDTLS_SSL_ASYNC_PRIVATE
+ *
+ * Allow an SSL server to perform its private key operations (the signature
+ * in ServerKeyExchange and the RSA decryption of ClientKeyExchange)
+ * asynchronously, through callbacks set with
+ * mbedtls_ssl_conf_async_private_cb(). While such an operation is pending,
+ * mbedtls_ssl_handshake() returns MBEDTLS_ERR_SSL_WANT_ASYNC, so that the
+ * calling thread can serve other connections in the meantime, for example
+ * while a worker thread or a hardware module computes the signature.
+ *
+ * Requires: MBEDTLS_SSL_SRV_C
+ *
+ * Comment this macro to disable asynchronous private key operations.
+ */
+#define MBEDTLS_SSL_ASYNC_PRIVATE
+
 /**
  * \def MBEDTLS_SSL_MAX_FRAGMENT_LENGTH
  *
@@ -1291,6 +1488,19 @@
  */
 //#define MBEDTLS_THREADING_PTHREAD
 
+/**
+ * \def MBEDTLS_NET_POLLER
+ *
+ * Enable mbedtls_net_poller, edge-triggered readiness notification for
+ * many non-blocking sockets, and the ssl_epoll_server sample program.
+ * Uses epoll, only available on Linux.
+ *
+ * Requires: MBEDTLS_NET_C
+ *
+ * Uncomment this to enable the socket poller.
+ */
+//#define MBEDTLS_NET_POLLER
+
 /**
  * \def MBEDTLS_VERSION_FEATURES
  *
@@ -2218,7 +2428,8 @@
 /**
  * \def MBEDTLS_SSL_CACHE_C
  *
- * Enable simple SSL cache implementation.
+ * Enable simple SSL cache implementation: a hash table of session IDs
+ * split into MBEDTLS_SSL_CACHE_SHARDS independently locked parts.
  *
  * Module:  library/ssl_cache.c
  * Caller:
@@ -2479,6 +2690,12 @@
 /* MPI / BIGNUM options */
 //#define MBEDTLS_MPI_WINDOW_SIZE            6 /**< Maximum windows size used. */
 //#define MBEDTLS_MPI_MAX_SIZE            1024 /**< Maximum number of bytes for usable MPIs. */
+//#define MBEDTLS_MPI_KARATSUBA_THRESHOLD   80 /**< Operand size in limbs above which Karatsuba multiplication is used. */
+//#define MBEDTLS_MPI_COMB_WIDTH             5 /**< Teeth of fixed-base exponentiation combs. */
+//#define MBEDTLS_MPI_ARENA_SIZE          6144 /**< Size of the per-operation scratch arena of RSA operations. */
+
+/* AES options */
+//#define MBEDTLS_AES_OFFLOAD_MAX_JOBS       32 /**< Maximum number of requests gathered into one offload engine call */
 
 /* CTR_DRBG options */
 //#define MBEDTLS_CTR_DRBG_ENTROPY_LEN               48 /**< Amount of entropy used per seed by default (48 with SHA-512, 32 with SHA-256) */
@@ -2486,6 +2703,7 @@
 //#define MBEDTLS_CTR_DRBG_MAX_INPUT                256 /**< Maximum number of additional input bytes */
 //#define MBEDTLS_CTR_DRBG_MAX_REQUEST             1024 /**< Maximum number of requested bytes per call */
 //#define MBEDTLS_CTR_DRBG_MAX_SEED_INPUT           384 /**< Maximum size of (re)seed buffer */
+//#define MBEDTLS_CTR_DRBG_BUFFER_SIZE              512 /**< Size of the pre-generated output buffer (0 to disable) */
 
 /* HMAC_DRBG options */
 //#define MBEDTLS_HMAC_DRBG_RESEED_INTERVAL   10000 /**< Interval before reseed is performed by default */
@@ -2501,6 +2719,7 @@
 /* Entropy options */
 //#define MBEDTLS_ENTROPY_MAX_SOURCES                20 /**< Maximum number of sources supported */
 //#define MBEDTLS_ENTROPY_MAX_GATHER                128 /**< Maximum amount requested from entropy sources */
+//#define MBEDTLS_ENTROPY_BACKGROUND_SLOTS            8 /**< Number of outputs kept ready by the background collector */
 
 /* Memory buffer allocator options */
 //#define MBEDTLS_MEMORY_ALIGN_MULTIPLE      4 /**< Align on multiples of this value */
@@ -2538,10 +2757,12 @@
 /* SSL Cache options */
 //#define MBEDTLS_SSL_CACHE_DEFAULT_TIMEOUT       86400 /**< 1 day  */
 //#define MBEDTLS_SSL_CACHE_DEFAULT_MAX_ENTRIES      50 /**< Maximum entries in cache */
+//#define MBEDTLS_SSL_CACHE_SHARDS                    8 /**< Independently locked parts of the cache, power of two */
 
 /* SSL options */
 //#define MBEDTLS_SSL_MAX_CONTENT_LEN             16384 /**< Maxium fragment length in bytes, determines the size of each of the two internal I/O buffers */
 //#define MBEDTLS_SSL_DEFAULT_TICKET_LIFETIME     86400 /**< Lifetime of session tickets (if enabled) */
+//#define MBEDTLS_SSL_BATCH_RECORDS                   4 /**< Maximum number of records encrypted and sent at once by batched writes */
 //#define MBEDTLS_PSK_MAX_LEN               32 /**< Max size of TLS pre-shared keys, in bytes (default 256 bits) */
 //#define MBEDTLS_SSL_COOKIE_TIMEOUT        60 /**< Default expiration delay of DTLS cookies, in seconds if HAVE_TIME, or in number of cookies issued */
 
@@ -33,6 +33,8 @@
 #define MBEDTLS_ERR_CTR_DRBG_REQUEST_TOO_BIG              -0x0036  /**< Too many random requested in single call. */
 #define MBEDTLS_ERR_CTR_DRBG_INPUT_TOO_BIG                -0x0038  /**< Input too large (Entropy + additional). */
 #define MBEDTLS_ERR_CTR_DRBG_FILE_IO_ERROR                -0x003A  /**< Read/write error in file. */
+#define MBEDTLS_ERR_CTR_DRBG_ALLOC_FAILED                 -0x0011  /**< Failed to allocate memory for the instances. */
+#define MBEDTLS_ERR_CTR_DRBG_BAD_INPUT_DATA               -0x0015  /**< Bad input parameters to function. */
 
 #define MBEDTLS_CTR_DRBG_BLOCKSIZE          16      /**< Block size used by the cipher                  */
 #define MBEDTLS_CTR_DRBG_KEYSIZE            32      /**< Key size used by the cipher                    */
@@ -72,6 +74,10 @@
 #define MBEDTLS_CTR_DRBG_MAX_SEED_INPUT     384     /**< Maximum size of (re)seed buffer */
 #endif
 
+#if !defined(MBEDTLS_CTR_DRBG_BUFFER_SIZE)
+#define MBEDTLS_CTR_DRBG_BUFFER_SIZE        512     /**< Size of the pre-generated output buffer (0 to disable) */
+#endif
+
 /* \} name SECTION: Module settings */
 
 #define MBEDTLS_CTR_DRBG_PR_OFF             0       /**< No prediction resistance       */
@@ -103,6 +109,13 @@ typedef struct
 
     void *p_entropy;            /*!<  context for the entropy function */
 
+    void *p_pool;               /*!<  owning mbedtls_ctr_drbg_pool, if any */
+
+#if MBEDTLS_CTR_DRBG_BUFFER_SIZE > 0
+    unsigned char buf[MBEDTLS_CTR_DRBG_BUFFER_SIZE]; /*!<  pre-generated output */
+    size_t buf_left;            /*!<  unread bytes at the start of buf  */
+#endif
+
 #if defined(MBEDTLS_THREADING_C)
     mbedtls_threading_mutex_t mutex;
 #endif
@@ -243,6 +256,137 @@ int mbedtls_ctr_drbg_random_with_add( void *p_rng,
 int mbedtls_ctr_drbg_random( void *p_rng,
                      unsigned char *output, size_t output_len );
 
+/**
+ * \brief               CTR_DRBG generate random through the output buffer
+ *
+ * Small requests are served from a buffer of MBEDTLS_CTR_DRBG_BUFFER_SIZE
+ * bytes that is filled by a single generate call, so the per-call cost of
+ * the state update is paid once per buffer rather than once per request.
+ * Every refill counts as one request against the reseed interval. Bytes are
+ * wiped from the buffer as soon as they are handed out.
+ *
+ * Note: Requests larger than the buffer, and all requests while prediction
+ *       resistance is enabled, bypass the buffer.
+ *
+ * \param p_rng         CTR_DRBG context
+ * \param output        Buffer to fill
+ * \param output_len    Length of the buffer
+ *
+ * \return              0 if successful, or
+ *                      MBEDTLS_ERR_CTR_DRBG_ENTROPY_SOURCE_FAILED, or
+ *                      MBEDTLS_ERR_CTR_DRBG_REQUEST_TOO_BIG
+ */
+int mbedtls_ctr_drbg_random_buffered( void *p_rng,
+                              unsigned char *output, size_t output_len );
+
+/**
+ * \brief               Top up the output buffer
+ *
+ * Can be called from an idle loop or a background thread so that later
+ * calls to mbedtls_ctr_drbg_random_buffered() find the buffer full.
+ *
+ * \param ctx           CTR_DRBG context
+ *
+ * \return              0 if successful, or
+ *                      MBEDTLS_ERR_CTR_DRBG_ENTROPY_SOURCE_FAILED
+ */
+int mbedtls_ctr_drbg_buffer_refill( mbedtls_ctr_drbg_context *ctx );
+
+/**
+ * \brief          Sharded CTR_DRBG front-end
+ *
+ *                 Holds several independently seeded CTR_DRBG instances.
+ *                 With MBEDTLS_THREADING_PTHREAD each calling thread is bound
+ *                 to one instance on first use and then generates without
+ *                 taking any lock. Threads that find no free instance share
+ *                 the locked fallback instance shards[0].
+ */
+typedef struct mbedtls_ctr_drbg_pool
+{
+    mbedtls_ctr_drbg_context *shards;   /*!<  fallback + per-thread DRBGs   */
+    unsigned char *in_use;              /*!<  claim flag for each shard     */
+    size_t shard_count;                 /*!<  number of entries in shards   */
+
+#if defined(MBEDTLS_THREADING_PTHREAD)
+    pthread_key_t key;                  /*!<  thread to shard binding       */
+    int key_valid;                      /*!<  key has been created          */
+#endif
+#if defined(MBEDTLS_THREADING_C)
+    mbedtls_threading_mutex_t mutex;    /*!<  protects in_use               */
+#endif
+}
+mbedtls_ctr_drbg_pool;
+
+/**
+ * \brief               CTR_DRBG pool initialization
+ *                      Makes the pool ready for mbedtls_ctr_drbg_pool_seed()
+ *                      or mbedtls_ctr_drbg_pool_free().
+ *
+ * \param pool          CTR_DRBG pool to be initialized
+ */
+void mbedtls_ctr_drbg_pool_init( mbedtls_ctr_drbg_pool *pool );
+
+/**
+ * \brief               Allocate and seed the instances of a CTR_DRBG pool
+ *
+ *                      Every instance is seeded separately from f_entropy,
+ *                      with the shard index appended to the personalization
+ *                      data so that no two instances share a state.
+ *                      A pool can only be seeded once; free and initialize
+ *                      it again to seed it anew.
+ *
+ * \param pool          CTR_DRBG pool to be seeded
+ * \param threads       Number of threads that get a private instance
+ *                      (one more instance is created as shared fallback)
+ * \param f_entropy     Entropy callback (p_entropy, buffer to fill, buffer
+ *                      length)
+ * \param p_entropy     Entropy context
+ * \param custom        Personalization data (Device specific identifiers)
+ *                      (Can be NULL)
+ * \param len           Length of personalization data
+ *
+ * \return              0 if successful, or
+ *                      MBEDTLS_ERR_CTR_DRBG_BAD_INPUT_DATA if the pool is
+ *                      already seeded,
+ *                      MBEDTLS_ERR_CTR_DRBG_ALLOC_FAILED,
+ *                      MBEDTLS_ERR_CTR_DRBG_INPUT_TOO_BIG,
+ *                      MBEDTLS_ERR_CTR_DRBG_ENTROPY_SOURCE_FAILED
+ */
+int mbedtls_ctr_drbg_pool_seed( mbedtls_ctr_drbg_pool *pool,
+                        size_t threads,
+                        int (*f_entropy)(void *, unsigned char *, size_t),
+                        void *p_entropy,
+                        const unsigned char *custom,
+                        size_t len );
+
+/**
+ * \brief               Generate random data from the instance bound to the
+ *                      calling thread (f_rng compatible)
+ *
+ * Requests go through the instance's output buffer, as with
+ * mbedtls_ctr_drbg_random_buffered().
+ *
+ * \param p_rng         CTR_DRBG pool
+ * \param output        Buffer to fill
+ * \param output_len    Length of the buffer
+ *
+ * \return              0 if successful, or
+ *                      MBEDTLS_ERR_CTR_DRBG_ENTROPY_SOURCE_FAILED, or
+ *                      MBEDTLS_ERR_CTR_DRBG_REQUEST_TOO_BIG
+ */
+int mbedtls_ctr_drbg_pool_random( void *p_rng,
+                          unsigned char *output, size_t output_len );
+
+/**
+ * \brief               Free the instances of a CTR_DRBG pool
+ *
+ * \note                Must only be called once no thread uses the pool any
+ *                      more.
+ *
+ * \param pool          CTR_DRBG pool to clear
+ */
+void mbedtls_ctr_drbg_pool_free( mbedtls_ctr_drbg_pool *pool );
+
 #if defined(MBEDTLS_FS_IO)
 /**
  * \brief               Write a seed file
@@ -159,6 +159,9 @@ typedef struct
     mbedtls_mpi Vi;     /*!<  blinding value    */
     mbedtls_mpi Vf;     /*!<  un-blinding value */
     mbedtls_mpi pX;     /*!<  previous X        */
+#if defined(MBEDTLS_DHM_COMB_CACHE)
+    const mbedtls_mpi_comb *comb; /*!<  cached comb table of G mod P, or NULL */
+#endif
 }
 mbedtls_dhm_context;
 
@@ -262,6 +265,18 @@ int mbedtls_dhm_calc_secret( mbedtls_dhm_context *ctx,
  */
 void mbedtls_dhm_free( mbedtls_dhm_context *ctx );
 
+#if defined(MBEDTLS_DHM_COMB_CACHE)
+/**
+ * \brief          Free the process-wide cache of fixed-base comb tables
+ *
+ * \note           Contexts that used a cached table keep pointing to it,
+ *                 so this must only be called once every context that
+ *                 generated a key has been freed, typically at program
+ *                 exit.
+ */
+void mbedtls_dhm_comb_cache_free( void );
+#endif /* MBEDTLS_DHM_COMB_CACHE */
+
 #if defined(MBEDTLS_ASN1_PARSE_C)
 /** \ingroup x509_module */
 /**
@@ -51,6 +51,23 @@
  */
 typedef mbedtls_ecp_keypair mbedtls_ecdsa_context;
 
+struct mbedtls_threading_pool;  /* see threading.h */
+
+/**
+ * \brief           One signature of a batch verification,
+ *                  see mbedtls_ecdsa_read_signature_batch()
+ */
+typedef struct
+{
+    const mbedtls_ecp_point *Q;     /*!< public key                     */
+    const unsigned char *hash;      /*!< message hash                   */
+    size_t hlen;                    /*!< size of hash                   */
+    const unsigned char *sig;       /*!< ASN.1 signature                */
+    size_t slen;                    /*!< size of sig                    */
+    int ret;                        /*!< result, written by the batch   */
+}
+mbedtls_ecdsa_verify_item;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -203,6 +220,31 @@ int mbedtls_ecdsa_read_signature( mbedtls_ecdsa_context *ctx,
                           const unsigned char *hash, size_t hlen,
                           const unsigned char *sig, size_t slen );
 
+/**
+ * \brief           Read and verify a batch of ECDSA signatures made with
+ *                  keys on the same curve
+ *
+ *                  Each item gets the result mbedtls_ecdsa_read_signature()
+ *                  would have returned for it. The modular inversions of
+ *                  all signatures are merged into a single one, and the
+ *                  point multiplications may be spread over a thread pool.
+ *
+ * \note            If a pool is given, grp is shared by its threads: it
+ *                  must not be used elsewhere during the call.
+ *
+ * \param grp       ECP group of all public keys
+ * \param items     Signatures to verify, with their public keys
+ * \param count     Number of items
+ * \param pool      mbedtls_threading_pool to run the verifications on, or
+ *                  NULL (requires MBEDTLS_THREADING_PTHREAD)
+ *
+ * \return          0 if all signatures are valid,
+ *                  otherwise the result of the first item that is not
+ */
+int mbedtls_ecdsa_read_signature_batch( mbedtls_ecp_group *grp,
+                          mbedtls_ecdsa_verify_item *items, size_t count,
+                          struct mbedtls_threading_pool *pool );
+
 /**
  * \brief           Generate an ECDSA keypair on the given curve
  *
@@ -143,6 +143,7 @@ typedef struct
     void *t_data;                       /*!< unused                         */
     mbedtls_ecp_point *T;       /*!<  pre-computed points for ecp_mul_comb()        */
     size_t T_size;      /*!<  number for pre-computed points                */
+    unsigned int T_shared;  /*!<  internal: 1 if T belongs to the comb cache */
 }
 mbedtls_ecp_group;
 
@@ -305,6 +306,18 @@ void mbedtls_ecp_group_free( mbedtls_ecp_group *grp );
  */
 void mbedtls_ecp_keypair_free( mbedtls_ecp_keypair *key );
 
+#if defined(MBEDTLS_ECP_COMB_CACHE)
+/**
+ * \brief           Free the process-wide cache of generator comb tables
+ *
+ * \note            Groups that used a cached table keep pointing to it,
+ *                  so this must only be called once every group that did
+ *                  a multiplication by its generator has been freed,
+ *                  typically at program exit.
+ */
+void mbedtls_ecp_comb_cache_free( void );
+#endif /* MBEDTLS_ECP_COMB_CACHE */
+
 /**
  * \brief           Copy the contents of point Q into P
  *
@@ -0,0 +1,133 @@
+/**
+ * \file ecp_internal.h
+ *
+ * \brief Curve-specific point multiplication backends used by ecp.c
+ *
+ *  Copyright (C) 2006-2015, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  This file is part of mbed TLS (https://tls.mbed.org)
+ */
+#ifndef MBEDTLS_ECP_INTERNAL_H
+#define MBEDTLS_ECP_INTERNAL_H
+
+#include "ecp.h"
+
+/*
+ * The dedicated P-256 backend needs 64x64->128 bit multiplication,
+ * so it is only available with compilers providing unsigned __int128
+ * and is skipped when 32-bit limbs are forced with MBEDTLS_HAVE_INT32.
+ */
+#if defined(MBEDTLS_ECP_P256_OPTIM) && \
+    defined(MBEDTLS_ECP_DP_SECP256R1_ENABLED) && \
+    defined(__SIZEOF_INT128__) && !defined(MBEDTLS_HAVE_INT32) && \
+    !defined(MBEDTLS_ECP_P256_64BIT)
+#define MBEDTLS_ECP_P256_64BIT
+#endif
+
+/* Same requirements for the radix 2^51 Curve25519 backend */
+#if defined(MBEDTLS_ECP_X25519_OPTIM) && \
+    defined(MBEDTLS_ECP_DP_CURVE25519_ENABLED) && \
+    defined(__SIZEOF_INT128__) && !defined(MBEDTLS_HAVE_INT32) && \
+    !defined(MBEDTLS_ECP_X25519_64BIT)
+#define MBEDTLS_ECP_X25519_64BIT
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(MBEDTLS_ECP_P256_64BIT)
+/**
+ * \brief           Multiplication by an integer on secp256r1: R = m * P
+ *                  using fixed-size 4x64-bit Montgomery field arithmetic
+ *
+ * \note            Called by mbedtls_ecp_mul() once m and P have been
+ *                  validated. The scalar is processed with a fixed window
+ *                  and constant-time table lookups; if f_rng is not NULL,
+ *                  the projective coordinates of P are randomized.
+ *
+ * \param grp       ECP group (must be MBEDTLS_ECP_DP_SECP256R1)
+ * \param R         Destination point
+ * \param m         Integer by which to multiply, 0 < m < N
+ * \param P         Point to multiply, on the curve and normalized
+ * \param f_rng     RNG function (see notes)
+ * \param p_rng     RNG parameter
+ *
+ * \return          0 if successful,
+ *                  or MBEDTLS_ERR_MPI_XXX on failure
+ */
+int mbedtls_ecp_p256_mul( mbedtls_ecp_group *grp, mbedtls_ecp_point *R,
+                          const mbedtls_mpi *m, const mbedtls_ecp_point *P,
+                          int (*f_rng)(void *, unsigned char *, size_t),
+                          void *p_rng );
+
+/**
+ * \brief           Multiplication and addition on secp256r1:
+ *                  R = m * P + n * Q
+ *
+ * \note            Called by mbedtls_ecp_muladd() once m, n, P and Q have
+ *                  been validated. Interleaved width-w NAF, not
+ *                  constant-time: only for public scalars. Points equal
+ *                  to the generator use a built-in precomputed table.
+ *
+ * \param grp       ECP group (must be MBEDTLS_ECP_DP_SECP256R1)
+ * \param R         Destination point
+ * \param m         Integer by which to multiply P, 0 < m < N
+ * \param P         Point to multiply by m, on the curve and normalized
+ * \param n         Integer by which to multiply Q, 0 < n < N
+ * \param Q         Point to be multiplied by n, on the curve and normalized
+ *
+ * \return          0 if successful,
+ *                  or MBEDTLS_ERR_MPI_XXX on failure
+ */
+int mbedtls_ecp_p256_muladd( mbedtls_ecp_group *grp, mbedtls_ecp_point *R,
+                             const mbedtls_mpi *m, const mbedtls_ecp_point *P,
+                             const mbedtls_mpi *n, const mbedtls_ecp_point *Q );
+#endif /* MBEDTLS_ECP_P256_64BIT */
+
+#if defined(MBEDTLS_ECP_X25519_64BIT)
+/**
+ * \brief           Multiplication by an integer on Curve25519: R = m * P
+ *                  (x coordinate only) using 5x51-bit field arithmetic
+ *
+ * \note            Called by mbedtls_ecp_mul() once m and P have been
+ *                  validated. Uses a constant-time Montgomery ladder;
+ *                  if f_rng is not NULL, the projective coordinates of
+ *                  the starting point are randomized.
+ *
+ * \param grp       ECP group (must be MBEDTLS_ECP_DP_CURVE25519)
+ * \param R         Destination point
+ * \param m         Integer by which to multiply
+ * \param P         Point to multiply, with X < 2^255
+ * \param f_rng     RNG function (see notes)
+ * \param p_rng     RNG parameter
+ *
+ * \return          0 if successful,
+ *                  MBEDTLS_ERR_ECP_BAD_INPUT_DATA if P.X has bit 255 set,
+ *                  MBEDTLS_ERR_MPI_NOT_ACCEPTABLE if the result is zero,
+ *                  or another MBEDTLS_ERR_MPI_XXX on failure
+ */
+int mbedtls_ecp_x25519_mul( mbedtls_ecp_group *grp, mbedtls_ecp_point *R,
+                            const mbedtls_mpi *m, const mbedtls_ecp_point *P,
+                            int (*f_rng)(void *, unsigned char *, size_t),
+                            void *p_rng );
+#endif /* MBEDTLS_ECP_X25519_64BIT */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ecp_internal.h */
@@ -71,6 +71,10 @@
 #define MBEDTLS_ENTROPY_MAX_GATHER      128     /**< Maximum amount requested from entropy sources */
 #endif
 
+#if !defined(MBEDTLS_ENTROPY_BACKGROUND_SLOTS)
+#define MBEDTLS_ENTROPY_BACKGROUND_SLOTS 8      /**< Number of outputs kept ready by the background collector */
+#endif
+
 /* \} name SECTION: Module settings */
 
 #if defined(MBEDTLS_ENTROPY_SHA512_ACCUMULATOR)
@@ -137,6 +141,17 @@ typedef struct
 #if defined(MBEDTLS_ENTROPY_NV_SEED)
     int initial_entropy_run;
 #endif
+#if defined(MBEDTLS_ENTROPY_BACKGROUND)
+    unsigned char bg_ring[MBEDTLS_ENTROPY_BACKGROUND_SLOTS][MBEDTLS_ENTROPY_BLOCK_SIZE];
+                                        /*!< pre-gathered outputs   */
+    int bg_count;                       /*!< outputs ready in ring  */
+    int bg_running;                     /*!< collector thread state */
+    int bg_joinable;                    /*!< thread not yet joined  */
+    int bg_stop;                        /*!< stop request           */
+    pthread_t bg_thread;
+    pthread_mutex_t bg_mutex;           /*!< protects the bg_ fields */
+    pthread_cond_t bg_cond;             /*!< signals free slots     */
+#endif
 }
 mbedtls_entropy_context;
 
@@ -211,6 +226,39 @@ int mbedtls_entropy_func( void *data, unsigned char *output, size_t len );
 int mbedtls_entropy_update_manual( mbedtls_entropy_context *ctx,
                            const unsigned char *data, size_t len );
 
+#if defined(MBEDTLS_ENTROPY_BACKGROUND)
+/**
+ * \brief           Start the background entropy collector
+ *
+ *                  A thread keeps up to MBEDTLS_ENTROPY_BACKGROUND_SLOTS
+ *                  outputs of the accumulator ready. mbedtls_entropy_func()
+ *                  then returns one of them without polling the sources, and
+ *                  only falls back to polling when none is left.
+ *
+ * \note            If polling the sources fails the thread exits, and
+ *                  callers poll the sources themselves. Calling this
+ *                  function again restarts it.
+ *
+ * \note            Pre-gathered outputs are duplicated by fork(). Stop the
+ *                  collector before forking and restart it in each process.
+ *
+ * \param ctx       Entropy context (sources must already be added)
+ *
+ * \return          0 if successful (or already running), or
+ *                  MBEDTLS_ERR_THREADING_FEATURE_UNAVAILABLE if the thread
+ *                  could not be created
+ */
+int mbedtls_entropy_background_start( mbedtls_entropy_context *ctx );
+
+/**
+ * \brief           Stop the background entropy collector and wipe the
+ *                  outputs it gathered. Called by mbedtls_entropy_free().
+ *
+ * \param ctx       Entropy context
+ */
+void mbedtls_entropy_background_stop( mbedtls_entropy_context *ctx );
+#endif /* MBEDTLS_ENTROPY_BACKGROUND */
+
 #if defined(MBEDTLS_ENTROPY_NV_SEED)
 /**
  * \brief           Trigger an update of the seed file in NV by using the
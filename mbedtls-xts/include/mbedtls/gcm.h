@@ -25,6 +25,10 @@
 
 #include "cipher.h"
 
+#if defined(MBEDTLS_AES_OFFLOAD)
+#include "aes.h"
+#endif
+
 #include <stdint.h>
 
 #define MBEDTLS_GCM_ENCRYPT     1
@@ -50,6 +54,11 @@ typedef struct {
     unsigned char y[16];        /*!< Y working value */
     unsigned char buf[16];      /*!< buf working value */
     int mode;                   /*!< Encrypt or Decrypt */
+#if defined(MBEDTLS_AES_OFFLOAD)
+    mbedtls_aes_offload_context *offload; /*!< AES offload, or NULL */
+    unsigned char key[32];      /*!< AES key, only set with offload */
+    unsigned int keybits;       /*!< AES key size, 0 without offload */
+#endif
 }
 mbedtls_gcm_context;
 
@@ -77,6 +86,33 @@ int mbedtls_gcm_setkey( mbedtls_gcm_context *ctx,
                         const unsigned char *key,
                         unsigned int keybits );
 
+#if defined(MBEDTLS_AES_OFFLOAD)
+/**
+ * \brief           Hand the counter mode encryption of large messages to
+ *                  an AES offload context. Authentication is still done
+ *                  on the CPU.
+ *
+ * \note            Call after mbedtls_gcm_setkey(), with the same key: the
+ *                  context keeps a copy of it for the offload engine until
+ *                  offloading is stopped, mbedtls_gcm_setkey() is called
+ *                  again (which also stops it) or the context is freed.
+ *                  The offload context must outlive the GCM context.
+ *
+ * \param ctx       GCM context
+ * \param offload   AES offload context, or NULL to stop offloading
+ * \param key       AES key given to mbedtls_gcm_setkey() (unused for NULL)
+ * \param keybits   Size of key in bits
+ *
+ * \return          0 if successful, or MBEDTLS_ERR_GCM_BAD_INPUT if the
+ *                  cipher is not AES with a key of that size or if key is
+ *                  not the key of the context
+ */
+int mbedtls_gcm_set_offload( mbedtls_gcm_context *ctx,
+                             mbedtls_aes_offload_context *offload,
+                             const unsigned char *key,
+                             unsigned int keybits );
+#endif /* MBEDTLS_AES_OFFLOAD */
+
 /**
  * \brief           GCM buffer encryption/decryption using a block cipher
  *
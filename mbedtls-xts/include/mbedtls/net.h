@@ -45,12 +45,18 @@
 #define MBEDTLS_ERR_NET_UNKNOWN_HOST                      -0x0052  /**< Failed to get an IP address for the given hostname. */
 #define MBEDTLS_ERR_NET_BUFFER_TOO_SMALL                  -0x0043  /**< Buffer is too small to hold the data. */
 #define MBEDTLS_ERR_NET_INVALID_CONTEXT                   -0x0045  /**< The context is invalid, eg because it was free()ed. */
+#define MBEDTLS_ERR_NET_POLL_FAILED                       -0x0047  /**< Waiting for socket events failed. */
 
 #define MBEDTLS_NET_LISTEN_BACKLOG         10 /**< The backlog that listen() should use. */
+#define MBEDTLS_NET_IOV_MAX                16 /**< Maximum number of buffers sent by mbedtls_net_send_vec(). */
 
 #define MBEDTLS_NET_PROTO_TCP 0 /**< The TCP transport protocol */
 #define MBEDTLS_NET_PROTO_UDP 1 /**< The UDP transport protocol */
 
+#define MBEDTLS_NET_POLL_READ  1 /**< The socket became readable */
+#define MBEDTLS_NET_POLL_WRITE 2 /**< The socket became writable */
+#define MBEDTLS_NET_POLL_HUP   4 /**< The peer closed or the socket failed */
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -68,6 +74,27 @@ typedef struct
 }
 mbedtls_net_context;
 
+#if defined(MBEDTLS_NET_POLLER)
+/**
+ * Set of sockets watched for readiness (an epoll instance)
+ */
+typedef struct
+{
+    int fd;             /**< The underlying epoll file descriptor           */
+}
+mbedtls_net_poller;
+
+/**
+ * Readiness of one socket, as returned by mbedtls_net_poller_wait()
+ */
+typedef struct
+{
+    void *data;         /**< Data given to mbedtls_net_poller_add()         */
+    int events;         /**< MBEDTLS_NET_POLL_xxx flags                     */
+}
+mbedtls_net_poll_event;
+#endif /* MBEDTLS_NET_POLLER */
+
 /**
  * \brief          Initialize a context
  *                 Just makes the context ready to be used or freed safely.
@@ -112,6 +139,27 @@ int mbedtls_net_connect( mbedtls_net_context *ctx, const char *host, const char
  */
 int mbedtls_net_bind( mbedtls_net_context *ctx, const char *bind_ip, const char *port, int proto );
 
+/**
+ * \brief          Same as mbedtls_net_bind(), but several sockets can be
+ *                 bound to the same address and port (SO_REUSEPORT), for
+ *                 example one per thread, the kernel spreading the incoming
+ *                 connections among them. All of them must use this
+ *                 function.
+ *
+ * \param ctx      Socket to use
+ * \param bind_ip  IP to bind to, can be NULL
+ * \param port     Port number to use
+ * \param proto    Protocol: MBEDTLS_NET_PROTO_TCP or MBEDTLS_NET_PROTO_UDP
+ *
+ * \return         0 if successful, or one of:
+ *                      MBEDTLS_ERR_NET_SOCKET_FAILED (also if the platform
+ *                      lacks SO_REUSEPORT),
+ *                      MBEDTLS_ERR_NET_BIND_FAILED,
+ *                      MBEDTLS_ERR_NET_LISTEN_FAILED
+ */
+int mbedtls_net_bind_reuseport( mbedtls_net_context *ctx, const char *bind_ip,
+                                const char *port, int proto );
+
 /**
  * \brief           Accept a connection from a remote client
  *
@@ -187,6 +235,25 @@ int mbedtls_net_recv( void *ctx, unsigned char *buf, size_t len );
  */
 int mbedtls_net_send( void *ctx, const unsigned char *buf, size_t len );
 
+/**
+ * \brief          Write the concatenation of several buffers with a single
+ *                 system call (writev() where available). If no error
+ *                 occurs, the actual amount written is returned.
+ *
+ * \param ctx      Socket
+ * \param iov      The buffers to read from
+ * \param iovcnt   The number of buffers, at least 1
+ *
+ * \return         the number of bytes sent,
+ *                 or a non-zero error code; with a non-blocking socket,
+ *                 MBEDTLS_ERR_SSL_WANT_WRITE indicates write() would block.
+ *
+ * \note           At most MBEDTLS_NET_IOV_MAX buffers are sent at once.
+ *                 On Windows, only the first buffer is sent.
+ */
+int mbedtls_net_send_vec( void *ctx, const mbedtls_ssl_iovec *iov,
+                          size_t iovcnt );
+
 /**
  * \brief          Read at most 'len' characters, blocking for at most
  *                 'timeout' seconds. If no error occurs, the actual amount
@@ -218,6 +285,81 @@ int mbedtls_net_recv_timeout( void *ctx, unsigned char *buf, size_t len,
  */
 void mbedtls_net_free( mbedtls_net_context *ctx );
 
+#if defined(MBEDTLS_NET_POLLER)
+/**
+ * \brief          Initialize a poller
+ *                 Just makes the context ready to be used or freed safely.
+ *
+ * \param poller   Poller to initialize
+ */
+void mbedtls_net_poller_init( mbedtls_net_poller *poller );
+
+/**
+ * \brief          Create the underlying epoll instance
+ *
+ * \param poller   Poller
+ *
+ * \return         0 if successful, or MBEDTLS_ERR_NET_SOCKET_FAILED
+ */
+int mbedtls_net_poller_setup( mbedtls_net_poller *poller );
+
+/**
+ * \brief          Watch a socket. Events are edge-triggered: after an
+ *                 event, the socket must be used (mbedtls_net_accept(),
+ *                 mbedtls_ssl_read(), mbedtls_ssl_write()...) until it
+ *                 returns MBEDTLS_ERR_SSL_WANT_READ or
+ *                 MBEDTLS_ERR_SSL_WANT_WRITE, or no further event is
+ *                 reported for it.
+ *
+ * \note           The socket should be non-blocking, see
+ *                 mbedtls_net_set_nonblock(). It is watched by the poller
+ *                 until mbedtls_net_poller_del() or mbedtls_net_free().
+ *
+ * \param poller   Poller
+ * \param ctx      Socket to watch
+ * \param data     Data returned with the events of this socket
+ *
+ * \return         0 if successful, or MBEDTLS_ERR_NET_POLL_FAILED
+ */
+int mbedtls_net_poller_add( mbedtls_net_poller *poller,
+                            mbedtls_net_context *ctx, void *data );
+
+/**
+ * \brief          Stop watching a socket
+ *
+ * \param poller   Poller
+ * \param ctx      Socket
+ *
+ * \return         0 if successful, or MBEDTLS_ERR_NET_POLL_FAILED
+ */
+int mbedtls_net_poller_del( mbedtls_net_poller *poller,
+                            mbedtls_net_context *ctx );
+
+/**
+ * \brief          Wait for events on the watched sockets
+ *
+ * \param poller   Poller
+ * \param events   Array receiving the events
+ * \param max_events Size of the array
+ * \param timeout  Maximum number of milliseconds to wait,
+ *                 0 means no timeout (wait forever)
+ *
+ * \return         the number of events, 0 if the timeout expired or the
+ *                 wait was interrupted by a signal, or
+ *                 MBEDTLS_ERR_NET_POLL_FAILED
+ */
+int mbedtls_net_poller_wait( mbedtls_net_poller *poller,
+                             mbedtls_net_poll_event *events,
+                             size_t max_events, uint32_t timeout );
+
+/**
+ * \brief          Free a poller. The sockets are left open.
+ *
+ * \param poller   Poller to free
+ */
+void mbedtls_net_poller_free( mbedtls_net_poller *poller );
+#endif /* MBEDTLS_NET_POLLER */
+
 #ifdef __cplusplus
 }
 #endif
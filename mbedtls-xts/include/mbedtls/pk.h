@@ -129,6 +129,23 @@ typedef struct
     void *                      pk_ctx;  /**< Underlying public key context  */
 } mbedtls_pk_context;
 
+struct mbedtls_threading_pool;  /* see threading.h */
+
+/**
+ * \brief           One signature of a batch verification,
+ *                  see mbedtls_pk_verify_batch()
+ */
+typedef struct
+{
+    mbedtls_pk_context *pk;         /**< PK context to use              */
+    mbedtls_md_type_t md_alg;       /**< Hash algorithm used            */
+    const unsigned char *hash;      /**< Hash of the message            */
+    size_t hash_len;                /**< Hash length or 0               */
+    const unsigned char *sig;       /**< Signature to verify            */
+    size_t sig_len;                 /**< Signature length               */
+    int ret;                        /**< Result, written by the batch   */
+} mbedtls_pk_verify_item;
+
 #if defined(MBEDTLS_RSA_C)
 /**
  * Quick access to an RSA context inside a PK context.
@@ -284,6 +301,31 @@ int mbedtls_pk_verify( mbedtls_pk_context *ctx, mbedtls_md_type_t md_alg,
                const unsigned char *hash, size_t hash_len,
                const unsigned char *sig, size_t sig_len );
 
+/**
+ * \brief           Verify a batch of signatures
+ *
+ *                  Each item gets the result mbedtls_pk_verify() would
+ *                  have returned for it. ECDSA signatures are verified
+ *                  in place with the keys of their contexts and grouped
+ *                  by curve to share a single modular inversion, see
+ *                  mbedtls_ecdsa_read_signature_batch(); RSA signatures
+ *                  go through mbedtls_rsa_pkcs1_verify_batch().
+ *
+ * \note            Contexts may appear in several items. If a pool is
+ *                  given, the contexts are shared by its threads and must
+ *                  not be used elsewhere during the call.
+ *
+ * \param items     Signatures to verify, with their public keys
+ * \param count     Number of items
+ * \param pool      mbedtls_threading_pool to run the verifications on, or
+ *                  NULL (requires MBEDTLS_THREADING_PTHREAD)
+ *
+ * \return          0 if all signatures are valid,
+ *                  otherwise the result of the first item that is not
+ */
+int mbedtls_pk_verify_batch( mbedtls_pk_verify_item *items, size_t count,
+                             struct mbedtls_threading_pool *pool );
+
 /**
  * \brief           Verify signature, with options.
  *                  (Includes verification of the padding depending on type.)
@@ -36,6 +36,8 @@
 #include "threading.h"
 #endif
 
+struct mbedtls_threading_pool;  /* see threading.h */
+
 /*
  * RSA Error codes
  */
@@ -78,7 +80,7 @@ extern "C" {
  */
 typedef struct
 {
-    int ver;                    /*!<  always 0          */
+    int ver;                    /*!<  0, or 1 for three-prime keys */
     size_t len;                 /*!<  size(N) in chars  */
 
     mbedtls_mpi N;                      /*!<  public modulus    */
@@ -91,12 +93,17 @@ typedef struct
     mbedtls_mpi DQ;                     /*!<  D % (Q - 1)       */
     mbedtls_mpi QP;                     /*!<  1 / (Q % P)       */
 
-    mbedtls_mpi RN;                     /*!<  cached R^2 mod N  */
-    mbedtls_mpi RP;                     /*!<  cached R^2 mod P  */
-    mbedtls_mpi RQ;                     /*!<  cached R^2 mod Q  */
+    mbedtls_mpi R;                      /*!<  3rd prime factor, unset for two-prime keys */
+    mbedtls_mpi DR;                     /*!<  D % (R - 1)       */
+    mbedtls_mpi TR;                     /*!<  1 / (P * Q % R)   */
+
+    mbedtls_mpi_mont_ctx RN;            /*!<  cached Montgomery constants of N  */
+    mbedtls_mpi_mont_ctx RP;            /*!<  cached Montgomery constants of P  */
+    mbedtls_mpi_mont_ctx RQ;            /*!<  cached Montgomery constants of Q  */
+    mbedtls_mpi_mont_ctx RR;            /*!<  cached Montgomery constants of R  */
 
-    mbedtls_mpi Vi;                     /*!<  cached blinding value     */
-    mbedtls_mpi Vf;                     /*!<  cached un-blinding value  */
+    mbedtls_mpi Vi;                     /*!<  cached blinding value, in Montgomery form     */
+    mbedtls_mpi Vf;                     /*!<  cached un-blinding value, in Montgomery form  */
 
     int padding;                /*!<  MBEDTLS_RSA_PKCS_V15 for 1.5 padding and
                                       RSA_PKCS_v21 for OAEP/PSS         */
@@ -107,6 +114,9 @@ typedef struct
 #if defined(MBEDTLS_THREADING_C)
     mbedtls_threading_mutex_t mutex;    /*!<  Thread-safety mutex       */
 #endif
+#if defined(MBEDTLS_THREADING_PTHREAD)
+    struct mbedtls_threading_pool *crt_pool; /*!< pool for the CRT exponentiations, or NULL */
+#endif
 }
 mbedtls_rsa_context;
 
@@ -148,6 +158,24 @@ void mbedtls_rsa_init( mbedtls_rsa_context *ctx,
  */
 void mbedtls_rsa_set_padding( mbedtls_rsa_context *ctx, int padding, int hash_id);
 
+#if defined(MBEDTLS_THREADING_PTHREAD)
+/**
+ * \brief          Run the CRT exponentiations of private key operations,
+ *                 one per prime factor, concurrently on a thread pool
+ *
+ * \param ctx      RSA context
+ * \param pool     Thread pool, or NULL to run them in the calling thread
+ *                 (default)
+ *
+ * \note           This lowers the latency of a single operation. Jobs of
+ *                 a pool run one at a time, so when many threads sign
+ *                 concurrently a shared pool rather adds contention.
+ *                 Ignored with MBEDTLS_RSA_NO_CRT.
+ */
+void mbedtls_rsa_set_crt_pool( mbedtls_rsa_context *ctx,
+                               struct mbedtls_threading_pool *pool );
+#endif
+
 /**
  * \brief          Generate an RSA keypair
  *
@@ -167,6 +195,32 @@ int mbedtls_rsa_gen_key( mbedtls_rsa_context *ctx,
                  void *p_rng,
                  unsigned int nbits, int exponent );
 
+/**
+ * \brief          Generate a multi-prime RSA keypair (RFC 3447 section 3)
+ *
+ * \param ctx      RSA context that will hold the key
+ * \param f_rng    RNG function
+ * \param p_rng    RNG parameter
+ * \param nbits    size of the public key in bits
+ * \param exponent public exponent (e.g., 65537)
+ * \param nprimes  number of prime factors of the modulus, 2 or 3
+ *
+ * \note           With three primes of a third of the modulus size each,
+ *                 private key operations are about twice as fast as with
+ *                 two. Use only with sizes where factoring the modulus
+ *                 remains harder than finding a prime factor, that is
+ *                 at least 2048 bits.
+ *
+ * \note           mbedtls_rsa_init() must be called beforehand to setup
+ *                 the RSA context.
+ *
+ * \return         0 if successful, or an MBEDTLS_ERR_RSA_XXX error code
+ */
+int mbedtls_rsa_gen_key_multi( mbedtls_rsa_context *ctx,
+                       int (*f_rng)(void *, unsigned char *, size_t),
+                       void *p_rng,
+                       unsigned int nbits, int exponent, int nprimes );
+
 /**
  * \brief          Check a public RSA key
  *
@@ -522,6 +576,45 @@ int mbedtls_rsa_pkcs1_verify( mbedtls_rsa_context *ctx,
                       const unsigned char *hash,
                       const unsigned char *sig );
 
+/**
+ * \brief          One signature of a batch verification,
+ *                 see mbedtls_rsa_pkcs1_verify_batch()
+ */
+typedef struct
+{
+    mbedtls_rsa_context *ctx;   /*!< public key                             */
+    mbedtls_md_type_t md_alg;   /*!< MBEDTLS_MD_XXX, or MBEDTLS_MD_NONE     */
+    unsigned int hashlen;       /*!< size of hash (for MBEDTLS_MD_NONE only) */
+    const unsigned char *hash;  /*!< message digest                         */
+    const unsigned char *sig;   /*!< signature, as large as ctx->N          */
+    int ret;                    /*!< result, written by the batch           */
+}
+mbedtls_rsa_verify_item;
+
+/**
+ * \brief          Perform a batch of PKCS#1 verifications with public keys,
+ *                 using the mode of each context
+ *
+ *                 Each item gets the result mbedtls_rsa_pkcs1_verify()
+ *                 would have returned for it in MBEDTLS_RSA_PUBLIC mode.
+ *                 Items may share a context: the Montgomery constant of a
+ *                 key is computed once and public key operations only
+ *                 hold the context mutex until it is.
+ *
+ * \param items    Signatures to verify, with their public keys
+ * \param count    Number of items
+ * \param pool     mbedtls_threading_pool to run the verifications on, or
+ *                 NULL (requires MBEDTLS_THREADING_PTHREAD)
+ *
+ * \return         0 if all signatures are valid, an error from
+ *                 mbedtls_threading_pool_run() if the pool failed (items
+ *                 it didn't verify then hold that error too), otherwise
+ *                 the result of the first item that is not valid
+ */
+int mbedtls_rsa_pkcs1_verify_batch( mbedtls_rsa_verify_item *items,
+                                    size_t count,
+                                    struct mbedtls_threading_pool *pool );
+
 /**
  * \brief          Perform a PKCS#1 v1.5 verification (RSASSA-PKCS1-v1_5-VERIFY)
  *
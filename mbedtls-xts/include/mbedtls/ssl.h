@@ -51,6 +51,10 @@
 #include "zlib.h"
 #endif
 
+#if defined(MBEDTLS_AES_OFFLOAD) && defined(MBEDTLS_GCM_C)
+#include "aes.h"
+#endif
+
 #if defined(MBEDTLS_HAVE_TIME)
 #include <time.h>
 #endif
@@ -107,6 +111,7 @@
 #define MBEDTLS_ERR_SSL_TIMEOUT                           -0x6800  /**< The operation timed out. */
 #define MBEDTLS_ERR_SSL_CLIENT_RECONNECT                  -0x6780  /**< The client initiated a reconnect from the same port. */
 #define MBEDTLS_ERR_SSL_UNEXPECTED_RECORD                 -0x6700  /**< Record header looks valid but is not expected. */
+#define MBEDTLS_ERR_SSL_WANT_ASYNC                        -0x6680  /**< An asynchronous private key operation is in progress. */
 
 /*
  * Various constants
@@ -217,6 +222,10 @@
 #define MBEDTLS_SSL_MAX_CONTENT_LEN         16384   /**< Size of the input / output buffer */
 #endif
 
+#if !defined(MBEDTLS_SSL_BATCH_RECORDS)
+#define MBEDTLS_SSL_BATCH_RECORDS               4   /**< Maximum number of records encrypted and sent at once by batched writes */
+#endif
+
 /* \} name SECTION: Module settings */
 
 /*
@@ -520,6 +529,37 @@ typedef void mbedtls_ssl_set_timer_t( void * ctx,
  */
 typedef int mbedtls_ssl_get_timer_t( void * ctx );
 
+/**
+ * \brief          One buffer of application data to write, for
+ *                 \c mbedtls_ssl_writev()
+ */
+typedef struct
+{
+    const unsigned char *buf;   /*!< start of the data              */
+    size_t len;                 /*!< length of the data             */
+}
+mbedtls_ssl_iovec;
+
+/**
+ * \brief          Callback type: send the concatenation of several buffers
+ *                 to the network, typically with writev() or sendmsg()
+ *
+ * \param ctx      Context for the send callback (the same as for the
+ *                 other BIO callbacks)
+ * \param iov      Buffers holding the data to send
+ * \param iovcnt   Number of buffers, at least 1
+ *
+ * \return         The callback must return the number of bytes sent, or a
+ *                 non-zero error code, following the same conventions as
+ *                 \c mbedtls_ssl_send_t.
+ *
+ * \note           The callback is allowed to send fewer bytes than the
+ *                 total length of the buffers.
+ */
+typedef int mbedtls_ssl_send_vec_t( void *ctx,
+                                    const mbedtls_ssl_iovec *iov,
+                                    size_t iovcnt );
+
 
 /* Defined below */
 typedef struct mbedtls_ssl_session mbedtls_ssl_session;
@@ -638,6 +678,26 @@ struct mbedtls_ssl_config
     void *p_ticket;                 /*!< context for the ticket callbacks   */
 #endif /* MBEDTLS_SSL_SESSION_TICKETS && MBEDTLS_SSL_SRV_C */
 
+#if defined(MBEDTLS_SSL_ASYNC_PRIVATE)
+    /** Callback to start an asynchronous signature                         */
+    int (*f_async_sign_start)( void *, mbedtls_ssl_context *,
+            mbedtls_pk_context *, mbedtls_md_type_t,
+            const unsigned char *, size_t );
+    /** Callback to start an asynchronous RSA decryption                    */
+    int (*f_async_decrypt_start)( void *, mbedtls_ssl_context *,
+            mbedtls_pk_context *, const unsigned char *, size_t );
+    /** Callback to collect the result of an asynchronous operation         */
+    int (*f_async_resume)( void *, mbedtls_ssl_context *,
+            unsigned char *, size_t *, size_t );
+    /** Callback to abandon an asynchronous operation                       */
+    void (*f_async_cancel)( void *, mbedtls_ssl_context * );
+    void *p_async;                  /*!< context for asynchronous callbacks */
+#endif
+
+#if defined(MBEDTLS_AES_OFFLOAD) && defined(MBEDTLS_GCM_C)
+    mbedtls_aes_offload_context *aes_offload; /*!< AES-GCM record offload */
+#endif
+
 #if defined(MBEDTLS_SSL_EXPORT_KEYS)
     /** Callback to export key block and master secret                      */
     int (*f_export_keys)( void *, const unsigned char *,
@@ -777,6 +837,10 @@ struct mbedtls_ssl_context
     mbedtls_ssl_recv_timeout_t *f_recv_timeout;
                                 /*!< Callback for network receive with timeout */
 
+#if defined(MBEDTLS_SSL_BATCH_WRITES)
+    mbedtls_ssl_send_vec_t *f_send_vec; /*!< Callback for vectored send */
+#endif
+
     void *p_bio;                /*!< context for I/O operations   */
 
     /*
@@ -810,6 +874,7 @@ struct mbedtls_ssl_context
      * Record layer (incoming data)
      */
     unsigned char *in_buf;      /*!< input buffer                     */
+    size_t in_buf_len;          /*!< size of the input buffer         */
     unsigned char *in_ctr;      /*!< 64-bit incoming message counter
                                      TLS: maintained by us
                                      DTLS: read from peer             */
@@ -841,6 +906,7 @@ struct mbedtls_ssl_context
      * Record layer (outgoing data)
      */
     unsigned char *out_buf;     /*!< output buffer                    */
+    size_t out_buf_len;         /*!< size of the output buffer        */
     unsigned char *out_ctr;     /*!< 64-bit outgoing message counter  */
     unsigned char *out_hdr;     /*!< start of record header           */
     unsigned char *out_len;     /*!< two-bytes message length field   */
@@ -851,6 +917,20 @@ struct mbedtls_ssl_context
     size_t out_msglen;          /*!< record header: message length    */
     size_t out_left;            /*!< amount of data not yet written   */
 
+#if defined(MBEDTLS_SSL_LAZY_BUFFERS)
+    unsigned char in_ctr_saved[8];  /*!< in_ctr while in_buf is released  */
+    unsigned char out_ctr_saved[8]; /*!< out_ctr while out_buf is released */
+#endif
+
+#if defined(MBEDTLS_SSL_BATCH_WRITES)
+    unsigned char *batch_buf;   /*!< room for the records of a batch
+                                     after the one in out_buf         */
+    mbedtls_ssl_iovec out_batch[MBEDTLS_SSL_BATCH_RECORDS];
+                                /*!< records of the batch being sent  */
+    size_t out_batch_cnt;       /*!< number of records in out_batch   */
+    size_t out_batch_len;       /*!< application data in out_batch    */
+#endif
+
 #if defined(MBEDTLS_ZLIB_SUPPORT)
     unsigned char *compress_buf;        /*!<  zlib data buffer        */
 #endif
@@ -1114,6 +1194,29 @@ void mbedtls_ssl_set_bio( mbedtls_ssl_context *ssl,
                           mbedtls_ssl_recv_t *f_recv,
                           mbedtls_ssl_recv_timeout_t *f_recv_timeout );
 
+#if defined(MBEDTLS_SSL_BATCH_WRITES)
+/**
+ * \brief          Set a vectored send callback, used to send several
+ *                 records at once. Large writes are then encrypted in
+ *                 batches of up to MBEDTLS_SSL_BATCH_RECORDS records, sent
+ *                 with a single call of this callback.
+ *                 (Default: NULL, records are sent one by one.)
+ *
+ * \param ssl      SSL context
+ * \param f_send_vec vectored write callback, or NULL. It gets the p_bio
+ *                 parameter set with \c mbedtls_ssl_set_bio().
+ *
+ * \note           Only used with TLS, not DTLS, and not when CBC record
+ *                 splitting applies.
+ *
+ * \note           On some platforms, net.c provides
+ *                 \c mbedtls_net_send_vec() that is suitable to be used here
+ *                 together with \c mbedtls_net_send().
+ */
+void mbedtls_ssl_set_send_vec( mbedtls_ssl_context *ssl,
+                               mbedtls_ssl_send_vec_t *f_send_vec );
+#endif /* MBEDTLS_SSL_BATCH_WRITES */
+
 /**
  * \brief          Set the timeout period for mbedtls_ssl_read()
  *                 (Default: no timeout.)
@@ -1277,6 +1380,170 @@ void mbedtls_ssl_conf_export_keys_cb( mbedtls_ssl_config *conf,
         void *p_export_keys );
 #endif /* MBEDTLS_SSL_EXPORT_KEYS */
 
+#if defined(MBEDTLS_SSL_ASYNC_PRIVATE)
+/**
+ * \brief           Callback type: start an asynchronous signature
+ *
+ * \param p_async   Context for the asynchronous callbacks
+ * \param ssl       SSL context performing the handshake
+ * \param pk        Own private key, as selected for this handshake
+ * \param md_alg    Hash algorithm, with the same meaning as for
+ *                  \c mbedtls_pk_sign() (MBEDTLS_MD_NONE means an
+ *                  MD5 + SHA-1 hash, for versions prior to TLS 1.2)
+ * \param hash      Hash to sign
+ * \param hash_len  Length of the hash
+ *
+ * \return          0 if the operation was started, in which case its
+ *                  result is collected with the resume callback,
+ *                  MBEDTLS_ERR_SSL_HW_ACCEL_FALLTHROUGH to let the
+ *                  library sign synchronously with \c mbedtls_pk_sign(),
+ *                  or another error code to abort the handshake.
+ *
+ * \note            The hash is not guaranteed to remain available after
+ *                  the callback returns: copy it if needed.
+ */
+typedef int mbedtls_ssl_async_sign_t( void *p_async,
+                                      mbedtls_ssl_context *ssl,
+                                      mbedtls_pk_context *pk,
+                                      mbedtls_md_type_t md_alg,
+                                      const unsigned char *hash,
+                                      size_t hash_len );
+
+/**
+ * \brief           Callback type: start an asynchronous RSA decryption
+ *                  (of the premaster secret sent by the client)
+ *
+ * \param p_async   Context for the asynchronous callbacks
+ * \param ssl       SSL context performing the handshake
+ * \param pk        Own private key, as selected for this handshake
+ * \param input     Encrypted premaster secret
+ * \param input_len Length of the encrypted premaster secret
+ *
+ * \return          Same as \c mbedtls_ssl_async_sign_t.
+ *
+ * \note            The input is not guaranteed to remain available after
+ *                  the callback returns: copy it if needed.
+ */
+typedef int mbedtls_ssl_async_decrypt_t( void *p_async,
+                                         mbedtls_ssl_context *ssl,
+                                         mbedtls_pk_context *pk,
+                                         const unsigned char *input,
+                                         size_t input_len );
+
+/**
+ * \brief           Callback type: collect the result of an asynchronous
+ *                  private key operation
+ *
+ *                  This is called right after the operation was started,
+ *                  then on each call to \c mbedtls_ssl_handshake() until
+ *                  it returns something else than MBEDTLS_ERR_SSL_WANT_ASYNC.
+ *
+ * \param p_async   Context for the asynchronous callbacks
+ * \param ssl       SSL context performing the handshake
+ * \param output    Buffer for the signature or decrypted data
+ * \param output_len Where to store the length of the result
+ * \param output_size Size of the output buffer
+ *
+ * \return          0 if the operation completed successfully,
+ *                  MBEDTLS_ERR_SSL_WANT_ASYNC if it is still in progress,
+ *                  or another error code if it failed.
+ *
+ * \note            A failed decryption is handled like a padding error of
+ *                  \c mbedtls_pk_decrypt(): the handshake goes on, and
+ *                  fails later without telling the peer why.
+ */
+typedef int mbedtls_ssl_async_resume_t( void *p_async,
+                                        mbedtls_ssl_context *ssl,
+                                        unsigned char *output,
+                                        size_t *output_len,
+                                        size_t output_size );
+
+/**
+ * \brief           Callback type: abandon an asynchronous private key
+ *                  operation, because its context is reset or freed
+ *                  before the handshake resumed it to completion
+ *
+ * \param p_async   Context for the asynchronous callbacks
+ * \param ssl       SSL context performing the handshake
+ */
+typedef void mbedtls_ssl_async_cancel_t( void *p_async,
+                                         mbedtls_ssl_context *ssl );
+
+/**
+ * \brief           Configure asynchronous private key operations for
+ *                  servers. (Default: none.)
+ *
+ *                  When a start callback returns 0, the handshake calls
+ *                  the resume callback at once and, if the result is not
+ *                  ready yet, \c mbedtls_ssl_handshake() returns
+ *                  MBEDTLS_ERR_SSL_WANT_ASYNC. The application must then
+ *                  call it again (typically once the operation is known to
+ *                  have completed) to carry on with the handshake.
+ *
+ * \note            At most one operation is in progress per context. Use
+ *                  \c mbedtls_ssl_set_async_operation_data() to attach
+ *                  per-operation state to the context.
+ *
+ * \param conf      SSL configuration context
+ * \param f_sign_start    Callback to start a signature, or NULL to always
+ *                        sign synchronously
+ * \param f_decrypt_start Callback to start an RSA decryption, or NULL to
+ *                        always decrypt synchronously
+ * \param f_resume  Callback to collect the result of an operation
+ * \param f_cancel  Callback to abandon an operation, or NULL
+ * \param p_async   Context shared by the callbacks
+ */
+void mbedtls_ssl_conf_async_private_cb( mbedtls_ssl_config *conf,
+        mbedtls_ssl_async_sign_t *f_sign_start,
+        mbedtls_ssl_async_decrypt_t *f_decrypt_start,
+        mbedtls_ssl_async_resume_t *f_resume,
+        mbedtls_ssl_async_cancel_t *f_cancel,
+        void *p_async );
+
+/**
+ * \brief           Get the data attached to the asynchronous private key
+ *                  operation of a context
+ *
+ * \param ssl       SSL context
+ *
+ * \return          The data set with
+ *                  \c mbedtls_ssl_set_async_operation_data(), or NULL if
+ *                  there is none or no handshake is in progress.
+ */
+void *mbedtls_ssl_get_async_operation_data( const mbedtls_ssl_context *ssl );
+
+/**
+ * \brief           Attach data to the asynchronous private key operation
+ *                  of a context, for use by the asynchronous callbacks.
+ *                  It is forgotten (not freed) when the handshake ends.
+ *
+ * \param ssl       SSL context
+ * \param ctx       Data to attach
+ */
+void mbedtls_ssl_set_async_operation_data( mbedtls_ssl_context *ssl,
+                                           void *ctx );
+#endif /* MBEDTLS_SSL_ASYNC_PRIVATE */
+
+#if defined(MBEDTLS_AES_OFFLOAD) && defined(MBEDTLS_GCM_C)
+/**
+ * \brief           Encrypt and decrypt the records of AES-GCM ciphersuites
+ *                  through an AES offload context (see
+ *                  \c mbedtls_gcm_set_offload()). Only records at least as
+ *                  large as the threshold of the context are offloaded, and
+ *                  the records of every connection sharing the
+ *                  configuration are gathered into the same engine calls.
+ *
+ * \note            Applies to the keys derived after this call. The offload
+ *                  context must outlive every SSL context using this
+ *                  configuration.
+ *
+ * \param conf      SSL configuration
+ * \param offload   AES offload context, or NULL to keep records on the CPU
+ */
+void mbedtls_ssl_conf_aes_offload( mbedtls_ssl_config *conf,
+                                   mbedtls_aes_offload_context *offload );
+#endif /* MBEDTLS_AES_OFFLOAD && MBEDTLS_GCM_C */
+
 /**
  * \brief          Callback type: generate a cookie
  *
@@ -2314,15 +2581,21 @@ int mbedtls_ssl_get_session( const mbedtls_ssl_context *ssl, mbedtls_ssl_session
  *
  * \return         0 if successful, or
  *                 MBEDTLS_ERR_SSL_WANT_READ or MBEDTLS_ERR_SSL_WANT_WRITE, or
+ *                 MBEDTLS_ERR_SSL_WANT_ASYNC (see below), or
  *                 MBEDTLS_ERR_SSL_HELLO_VERIFY_REQUIRED (see below), or
  *                 a specific SSL error code.
  *
  * \note           If this function returns something other than 0 or
- *                 MBEDTLS_ERR_SSL_WANT_READ/WRITE, then the ssl context
+ *                 MBEDTLS_ERR_SSL_WANT_READ/WRITE/ASYNC, then the ssl context
  *                 becomes unusable, and you should either free it or call
  *                 \c mbedtls_ssl_session_reset() on it before re-using it for
  *                 a new connection; the current connection must be closed.
  *
+ * \note           MBEDTLS_ERR_SSL_WANT_ASYNC is only returned by servers
+ *                 using \c mbedtls_ssl_conf_async_private_cb(), while a
+ *                 private key operation is in progress: call this function
+ *                 again to resume the handshake.
+ *
  * \note           If DTLS is in use, then you may choose to handle
  *                 MBEDTLS_ERR_SSL_HELLO_VERIFY_REQUIRED specially for logging
  *                 purposes, as it is an expected return value rather than an
@@ -2407,6 +2680,40 @@ int mbedtls_ssl_renegotiate( mbedtls_ssl_context *ssl );
  */
 int mbedtls_ssl_read( mbedtls_ssl_context *ssl, unsigned char *buf, size_t len );
 
+/**
+ * \brief          Access received application data in place, without
+ *                 copying it out of the input buffer
+ *
+ * \param ssl      SSL context
+ * \param buf      set to the start of the decrypted data
+ *
+ * \return         the number of bytes available at *buf, or
+ *                 0 for EOF, or
+ *                 the same error codes as \c mbedtls_ssl_read().
+ *
+ * \note           The data stays valid until it is marked as consumed with
+ *                 \c mbedtls_ssl_read_consume(), which must be done before
+ *                 any other call on the SSL context. Calling this function
+ *                 again before that returns the same data.
+ *
+ * \note           At most one record is returned at a time, so the return
+ *                 value never exceeds MBEDTLS_SSL_MAX_CONTENT_LEN.
+ */
+int mbedtls_ssl_read_buf( mbedtls_ssl_context *ssl, const unsigned char **buf );
+
+/**
+ * \brief          Mark application data returned by
+ *                 \c mbedtls_ssl_read_buf() as consumed
+ *
+ * \param ssl      SSL context
+ * \param len      number of bytes consumed, at most the value returned by
+ *                 the last call to \c mbedtls_ssl_read_buf()
+ *
+ * \return         0 if successful, or MBEDTLS_ERR_SSL_BAD_INPUT_DATA if no
+ *                 data is pending or len is too large.
+ */
+int mbedtls_ssl_read_consume( mbedtls_ssl_context *ssl, size_t len );
+
 /**
  * \brief          Try to write exactly 'len' application data bytes
  *
@@ -2441,9 +2748,80 @@ int mbedtls_ssl_read( mbedtls_ssl_context *ssl, unsigned char *buf, size_t len )
  *                 - with DTLS, MBEDTLS_ERR_SSL_BAD_INPUT_DATA is returned.
  *                 \c mbedtls_ssl_get_max_frag_len() may be used to query the
  *                 active maximum fragment length.
+ *
+ * \note           With TLS and a vectored send callback set with
+ *                 \c mbedtls_ssl_set_send_vec(), up to
+ *                 MBEDTLS_SSL_BATCH_RECORDS records are written at once.
  */
 int mbedtls_ssl_write( mbedtls_ssl_context *ssl, const unsigned char *buf, size_t len );
 
+/**
+ * \brief          Try to write the concatenation of several buffers of
+ *                 application data, gathering them directly into the
+ *                 output record
+ *
+ * \param ssl      SSL context
+ * \param iov      array of buffers holding the data
+ * \param iovcnt   number of elements of iov
+ *
+ * \return         the number of bytes actually written (may be less than
+ *                 the total length of the buffers), or
+ *                 the same error codes as \c mbedtls_ssl_write().
+ *
+ * \note           This behaves as \c mbedtls_ssl_write() called on the
+ *                 concatenation of the buffers: partial writes happen in
+ *                 the same cases, and after MBEDTLS_ERR_SSL_WANT_READ/WRITE
+ *                 it must be called again with the *same* arguments.
+ *
+ * \note           When CBC record splitting applies (see
+ *                 \c mbedtls_ssl_conf_cbc_record_splitting()), only data from
+ *                 the first non-empty buffer is written by each call.
+ */
+int mbedtls_ssl_writev( mbedtls_ssl_context *ssl,
+                        const mbedtls_ssl_iovec *iov, size_t iovcnt );
+
+/**
+ * \brief          Get room in the output buffer to write application data
+ *                 in place, to be sent with \c mbedtls_ssl_write_commit()
+ *
+ * \param ssl      SSL context
+ * \param buf      set to the start of the room for the data
+ *
+ * \return         the number of bytes that can be written at *buf (the
+ *                 active maximum fragment length), or
+ *                 MBEDTLS_ERR_SSL_FEATURE_UNAVAILABLE if CBC record splitting
+ *                 applies to the connection, or
+ *                 the same error codes as \c mbedtls_ssl_write().
+ *
+ * \note           This completes the handshake and flushes pending output
+ *                 first, if needed. \c mbedtls_ssl_write_commit() must then
+ *                 be called before any other call on the SSL context,
+ *                 otherwise the data is lost.
+ *
+ * \note           When CBC record splitting applies, use
+ *                 \c mbedtls_ssl_write() or \c mbedtls_ssl_writev() instead.
+ */
+int mbedtls_ssl_write_buf( mbedtls_ssl_context *ssl, unsigned char **buf );
+
+/**
+ * \brief          Encrypt and send application data written in place after
+ *                 a call to \c mbedtls_ssl_write_buf()
+ *
+ * \param ssl      SSL context
+ * \param len      number of bytes written, at most the value returned by
+ *                 \c mbedtls_ssl_write_buf()
+ *
+ * \return         len if successful, or
+ *                 MBEDTLS_ERR_SSL_BAD_INPUT_DATA if len is too large, or
+ *                 the same error codes as \c mbedtls_ssl_write().
+ *
+ * \note           The data is encrypted in place as soon as this function
+ *                 is called. When it returns MBEDTLS_ERR_SSL_WANT_WRITE/READ,
+ *                 it must be called again with the same len until it
+ *                 returns len, without writing the data again.
+ */
+int mbedtls_ssl_write_commit( mbedtls_ssl_context *ssl, size_t len );
+
 /**
  * \brief           Send an alert message
  *
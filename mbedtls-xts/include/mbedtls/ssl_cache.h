@@ -45,6 +45,10 @@
 #define MBEDTLS_SSL_CACHE_DEFAULT_MAX_ENTRIES      50   /*!< Maximum entries in cache */
 #endif
 
+#if !defined(MBEDTLS_SSL_CACHE_SHARDS)
+#define MBEDTLS_SSL_CACHE_SHARDS                    8   /*!< Independently locked parts of the cache, power of two */
+#endif
+
 /* \} name SECTION: Module settings */
 
 #ifdef __cplusplus
@@ -53,6 +57,7 @@ extern "C" {
 
 typedef struct mbedtls_ssl_cache_context mbedtls_ssl_cache_context;
 typedef struct mbedtls_ssl_cache_entry mbedtls_ssl_cache_entry;
+typedef struct mbedtls_ssl_cache_shard mbedtls_ssl_cache_shard;
 
 /**
  * \brief   This structure is used for storing cache entries
@@ -66,7 +71,30 @@ struct mbedtls_ssl_cache_entry
 #if defined(MBEDTLS_X509_CRT_PARSE_C)
     mbedtls_x509_buf peer_cert;         /*!< entry peer_cert    */
 #endif
-    mbedtls_ssl_cache_entry *next;      /*!< chain pointer      */
+    int referenced;                     /*!< retrieved since last
+                                             pass of the clock hand */
+};
+
+/**
+ * \brief   Part of the cache holding the session IDs with a given hash
+ *
+ *          Entries come from a pool of \c size entries, the share of
+ *          max_entries of the shard, allocated once; \c index is an
+ *          open-addressing (linear probing) table of twice that size
+ *          mapping session IDs to entries. When the shard is full, the
+ *          entry to drop is chosen with the clock algorithm, preferring
+ *          expired entries.
+ */
+struct mbedtls_ssl_cache_shard
+{
+    mbedtls_ssl_cache_entry *entries;   /*!< entry pool                 */
+    size_t *index;              /*!< entry number + 1, or 0 if free     */
+    size_t size;                /*!< number of entries in the pool      */
+    size_t used;                /*!< number of entries in use           */
+    size_t hand;                /*!< clock hand (entry number)          */
+#if defined(MBEDTLS_THREADING_C)
+    mbedtls_threading_mutex_t mutex;    /*!< mutex                  */
+#endif
 };
 
 /**
@@ -74,12 +102,11 @@ struct mbedtls_ssl_cache_entry
  */
 struct mbedtls_ssl_cache_context
 {
-    mbedtls_ssl_cache_entry *chain;     /*!< start of the chain     */
+    mbedtls_ssl_cache_shard shards[MBEDTLS_SSL_CACHE_SHARDS]; /*!< shards */
     int timeout;                /*!< cache entry timeout    */
     int max_entries;            /*!< maximum entries        */
-#if defined(MBEDTLS_THREADING_C)
-    mbedtls_threading_mutex_t mutex;    /*!< mutex                  */
-#endif
+    volatile size_t nshards;    /*!< shards in use, a power of two:
+                                     changed with all shards locked */
 };
 
 /**
@@ -124,6 +151,13 @@ void mbedtls_ssl_cache_set_timeout( mbedtls_ssl_cache_context *cache, int timeou
  * \brief          Set the maximum number of cache entries
  *                 (Default: MBEDTLS_SSL_CACHE_DEFAULT_MAX_ENTRIES (50))
  *
+ * \note           The maximum applies to the cache as a whole: each of the
+ *                 shards in use (MBEDTLS_SSL_CACHE_SHARDS at most, and at
+ *                 most max of them) gets its share of it, allocated here,
+ *                 and drops an entry when that share is full. Sessions
+ *                 already cached are kept, except those that no longer
+ *                 fit a lower maximum.
+ *
  * \param cache    SSL cache context
  * \param max      cache entry maximum
  */
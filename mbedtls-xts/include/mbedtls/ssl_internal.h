@@ -236,6 +236,9 @@ struct mbedtls_ssl_handshake_params
     mbedtls_sha512_context fin_sha512;
 #endif
 #endif /* MBEDTLS_SSL_PROTO_TLS1_2 */
+    unsigned char *transcript;          /*!<  messages not hashed yet, until
+                                              the checksum is optimized    */
+    size_t transcript_len;              /*!<  length of transcript         */
 
     void (*update_checksum)(mbedtls_ssl_context *, const unsigned char *, size_t);
     void (*calc_verify)(mbedtls_ssl_context *, unsigned char *);
@@ -261,6 +264,11 @@ struct mbedtls_ssl_handshake_params
 #if defined(MBEDTLS_SSL_EXTENDED_MASTER_SECRET)
     int extended_ms;                    /*!< use Extended Master Secret? */
 #endif
+#if defined(MBEDTLS_SSL_ASYNC_PRIVATE)
+    int async_in_progress;              /*!< private key op. pending? */
+    size_t async_offset;                /*!< where the signature goes */
+    void *user_async_ctx;               /*!< data for async callbacks */
+#endif
 };
 
 /*
@@ -27,6 +27,13 @@
  * This implementation of the session ticket callbacks includes key
  * management, rotating the keys periodically in order to preserve forward
  * secrecy, when MBEDTLS_HAVE_TIME is defined.
+ *
+ * With MBEDTLS_THREADING_PTHREAD, each thread protects tickets with its own
+ * copy of the keys, refreshed only when the keys change, so that issuing
+ * and parsing tickets does not take any lock. Each copy also builds the IVs
+ * of the tickets it issues from a 64-bit random identifier, drawn again
+ * after fork() and every 2^32 tickets, and a 32-bit counter, rather than
+ * calling the shared RNG for each ticket.
  */
 
 #include "ssl.h"
@@ -48,9 +55,31 @@ typedef struct
     unsigned char name[4];          /*!< random key identifier              */
     uint32_t generation_time;       /*!< key generation timestamp (seconds) */
     mbedtls_cipher_context_t ctx;   /*!< context for auth enc/decryption    */
+#if defined(MBEDTLS_THREADING_PTHREAD)
+    unsigned char key[32];          /*!< key material for thread copies     */
+#endif
 }
 mbedtls_ssl_ticket_key;
 
+#if defined(MBEDTLS_THREADING_PTHREAD)
+/**
+ * \brief   Private copy of the ticket keys used by one thread
+ */
+typedef struct mbedtls_ssl_ticket_thread
+{
+    mbedtls_ssl_ticket_key keys[2]; /*!< keys, with their own contexts      */
+    unsigned char active;           /*!< index of the currently active key  */
+    uint32_t generation;            /*!< generation of the copied keys      */
+    uint64_t id;                    /*!< random identifier, part of IVs     */
+    uint64_t invocations;           /*!< tickets issued, rest of IVs        */
+    uint32_t forks;                 /*!< fork count when id was drawn       */
+    int in_use;                     /*!< claimed by a running thread        */
+    void *owner;                    /*!< mbedtls_ssl_ticket_context         */
+    struct mbedtls_ssl_ticket_thread *next; /*!< next copy                  */
+}
+mbedtls_ssl_ticket_thread;
+#endif
+
 /**
  * \brief   Context for session ticket handling functions
  */
@@ -68,6 +97,12 @@ typedef struct
 #if defined(MBEDTLS_THREADING_C)
     mbedtls_threading_mutex_t mutex;
 #endif
+#if defined(MBEDTLS_THREADING_PTHREAD)
+    volatile uint32_t generation;   /*!< incremented when the keys change   */
+    mbedtls_ssl_ticket_thread *threads; /*!< copies of the keys per thread  */
+    pthread_key_t thread_key;       /*!< thread to copy binding             */
+    int thread_key_valid;           /*!< thread_key has been created        */
+#endif
 }
 mbedtls_ssl_ticket_context;
 
@@ -99,6 +134,14 @@ void mbedtls_ssl_ticket_init( mbedtls_ssl_ticket_context *ctx );
  *                  It is recommended to pick a reasonnable lifetime so as not
  *                  to negate the benefits of forward secrecy.
  *
+ * \note            With MBEDTLS_THREADING_PTHREAD, a context may be shared
+ *                  with child processes after fork(): each process draws
+ *                  new IV identifiers from f_rng on first use, noticed
+ *                  through a pthread_atfork() handler. The RNG must
+ *                  then be reseeded in each child, as ssl_fork_server does,
+ *                  or the children draw the same identifiers and repeat
+ *                  the IVs of each other under the same key.
+ *
  * \return          0 if successful,
  *                  or a specific MBEDTLS_ERR_XXX error code
  */
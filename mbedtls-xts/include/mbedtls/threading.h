@@ -38,6 +38,7 @@ extern "C" {
 #define MBEDTLS_ERR_THREADING_FEATURE_UNAVAILABLE         -0x001A  /**< The selected feature is not available. */
 #define MBEDTLS_ERR_THREADING_BAD_INPUT_DATA              -0x001C  /**< Bad input parameters to function. */
 #define MBEDTLS_ERR_THREADING_MUTEX_ERROR                 -0x001E  /**< Locking / unlocking / free failed with error code. */
+#define MBEDTLS_ERR_THREADING_ALLOC_FAILED                -0x0013  /**< Failed to allocate memory for the thread pool. */
 
 #if defined(MBEDTLS_THREADING_PTHREAD)
 #include <pthread.h>
@@ -81,6 +82,94 @@ void mbedtls_threading_set_alt( void (*mutex_init)( mbedtls_threading_mutex_t *
 void mbedtls_threading_free_alt( void );
 #endif /* MBEDTLS_THREADING_ALT */
 
+#if defined(MBEDTLS_THREADING_PTHREAD)
+/**
+ * \brief           Job callback for mbedtls_threading_pool_run()
+ *
+ * \param p_job     Job context
+ * \param index     Work item to process, in [0, count)
+ *
+ * \return          0 on success, or an error code that stops the job
+ */
+typedef int (*mbedtls_threading_job_f)( void *p_job, size_t index );
+
+/**
+ * \brief           Work-queue thread pool
+ *
+ *                  The work items of a job are claimed one at a time by the
+ *                  worker threads and by the thread that submitted the job.
+ */
+typedef struct mbedtls_threading_pool
+{
+    pthread_t *threads;                 /*!< worker threads             */
+    size_t thread_count;                /*!< number of worker threads   */
+    pthread_mutex_t mutex;              /*!< protects the fields below  */
+    pthread_cond_t work_cond;           /*!< a job or stop is pending   */
+    pthread_cond_t done_cond;           /*!< a job or work item ended   */
+    mbedtls_threading_job_f f_job;      /*!< current job, or NULL       */
+    void *p_job;                        /*!< current job context        */
+    const void *caller;                 /*!< pools the submitter works for */
+    size_t next;                        /*!< next unclaimed work item   */
+    size_t count;                       /*!< number of work items       */
+    size_t active;                      /*!< work items in progress     */
+    int ret;                            /*!< first error of the job     */
+    int stop;                           /*!< workers must exit          */
+}
+mbedtls_threading_pool;
+
+/**
+ * \brief           Initialize a thread pool (no threads are started)
+ *
+ * \param pool      Thread pool
+ */
+void mbedtls_threading_pool_init( mbedtls_threading_pool *pool );
+
+/**
+ * \brief           Start the worker threads
+ *
+ * \param pool      Thread pool
+ * \param threads   Number of worker threads. The submitting thread also
+ *                  takes part in every job, so use one less than the number
+ *                  of cores. 0 runs every job in the submitting thread.
+ *
+ * \return          0 if successful, MBEDTLS_ERR_THREADING_ALLOC_FAILED, or
+ *                  MBEDTLS_ERR_THREADING_FEATURE_UNAVAILABLE if a thread
+ *                  could not be created
+ */
+int mbedtls_threading_pool_setup( mbedtls_threading_pool *pool, size_t threads );
+
+/**
+ * \brief           Run f_job( p_job, i ) for every i in [0, count) and wait
+ *                  for all of them to finish
+ *
+ *                  Several threads may submit jobs to the same pool; jobs
+ *                  run one after the other.
+ *
+ *                  A job submitted from a work item of a job of the same
+ *                  pool, directly or through jobs of other pools, runs in
+ *                  the calling thread instead, as waiting for the pool to
+ *                  be free would deadlock.
+ *
+ * \param pool      Thread pool, or NULL to run in the calling thread
+ * \param f_job     Job callback
+ * \param p_job     Job context
+ * \param count     Number of work items
+ *
+ * \return          0 if every work item succeeded, otherwise the first
+ *                  error returned by f_job (remaining items are skipped)
+ */
+int mbedtls_threading_pool_run( mbedtls_threading_pool *pool,
+                                mbedtls_threading_job_f f_job, void *p_job,
+                                size_t count );
+
+/**
+ * \brief           Stop the worker threads and free the pool
+ *
+ * \param pool      Thread pool
+ */
+void mbedtls_threading_pool_free( mbedtls_threading_pool *pool );
+#endif /* MBEDTLS_THREADING_PTHREAD */
+
 #if defined(MBEDTLS_THREADING_C)
 /*
  * The function pointers for mutex_init, mutex_free, mutex_ and mutex_unlock
@@ -97,6 +186,8 @@ extern int (*mbedtls_mutex_unlock)( mbedtls_threading_mutex_t *mutex );
  */
 extern mbedtls_threading_mutex_t mbedtls_threading_readdir_mutex;
 extern mbedtls_threading_mutex_t mbedtls_threading_gmtime_mutex;
+extern mbedtls_threading_mutex_t mbedtls_threading_ecp_mutex;
+extern mbedtls_threading_mutex_t mbedtls_threading_dhm_mutex;
 #endif /* MBEDTLS_THREADING_C */
 
 #ifdef __cplusplus
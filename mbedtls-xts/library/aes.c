@@ -46,6 +46,9 @@
 #if defined(MBEDTLS_CIPHER_MODE_XEX) || defined(MBEDTLS_CIPHER_MODE_XTS)
 #include "mbedtls/gf128mul.h"
 #endif
+#if defined(MBEDTLS_CIPHER_MODE_XTS) && defined(MBEDTLS_THREADING_PTHREAD)
+#include "mbedtls/threading.h"
+#endif
 
 #if defined(MBEDTLS_SELF_TEST)
 #if defined(MBEDTLS_PLATFORM_C)
@@ -56,12 +59,14 @@
 #endif /* MBEDTLS_PLATFORM_C */
 #endif /* MBEDTLS_SELF_TEST */
 
-#if !defined(MBEDTLS_AES_ALT)
-
+#if !defined(MBEDTLS_AES_ALT) || defined(MBEDTLS_AES_OFFLOAD)
 /* Implementation that should never be optimized out by the compiler */
 static void mbedtls_zeroize( void *v, size_t n ) {
     volatile unsigned char *p = (unsigned char*)v; while( n-- ) *p++ = 0;
 }
+#endif
+
+#if !defined(MBEDTLS_AES_ALT)
 
 /*
  * 32-bit integer manipulation macros (little endian)
@@ -1118,6 +1123,97 @@ decrypt_only_one_full_block:
 
     return( 0 );
 }
+
+/*
+ * One call of mbedtls_aes_crypt_xts_sectors(), shared by all work items
+ */
+typedef struct
+{
+    mbedtls_aes_context *crypt_ctx;
+    mbedtls_aes_context *tweak_ctx;
+    int mode;
+    size_t sector_size;
+    uint64_t first_sector;
+    size_t length;
+    const unsigned char *input;
+    unsigned char *output;
+}
+xts_sectors_job;
+
+/*
+ * Process sector number first_sector + index
+ */
+static int xts_sector_crypt( void *p_job, size_t index )
+{
+    xts_sectors_job *job = (xts_sectors_job *) p_job;
+    unsigned char iv[16];
+    uint64_t sector = job->first_sector + index;
+    size_t offset = index * job->sector_size;
+    size_t len = job->length - offset;
+    int i;
+
+    if( len > job->sector_size )
+        len = job->sector_size;
+
+    /* The tweak is the data unit number, little endian */
+    for( i = 0; i < 8; i++ )
+        iv[i] = (unsigned char)( sector >> ( 8 * i ) );
+    memset( iv + 8, 0, 8 );
+
+    return( mbedtls_aes_crypt_xts( job->crypt_ctx, job->tweak_ctx, job->mode,
+                                   len * 8, iv, job->input + offset,
+                                   job->output + offset ) );
+}
+
+/*
+ * AES-XTS encryption/decryption of consecutive sectors
+ */
+int mbedtls_aes_crypt_xts_sectors( mbedtls_aes_context *crypt_ctx,
+                    mbedtls_aes_context *tweak_ctx,
+                    int mode,
+                    size_t sector_size,
+                    uint64_t first_sector,
+                    size_t length,
+                    const unsigned char *input,
+                    unsigned char *output,
+                    struct mbedtls_threading_pool *pool )
+{
+    xts_sectors_job job;
+    size_t count;
+
+    /* A short last sector still needs one full block */
+    if( sector_size < 16 ||
+        ( length % sector_size != 0 && length % sector_size < 16 ) )
+        return( MBEDTLS_ERR_AES_INVALID_INPUT_LENGTH );
+
+    job.crypt_ctx = crypt_ctx;
+    job.tweak_ctx = tweak_ctx;
+    job.mode = mode;
+    job.sector_size = sector_size;
+    job.first_sector = first_sector;
+    job.length = length;
+    job.input = input;
+    job.output = output;
+
+    count = ( length + sector_size - 1 ) / sector_size;
+
+#if defined(MBEDTLS_THREADING_PTHREAD)
+    return( mbedtls_threading_pool_run( pool, xts_sector_crypt, &job, count ) );
+#else
+    {
+        int ret;
+        size_t i;
+
+        ((void) pool);
+
+        for( i = 0; i < count; i++ )
+            if( ( ret = xts_sector_crypt( &job, i ) ) != 0 )
+                return( ret );
+
+        return( 0 );
+    }
+#endif
+}
 #endif /* MBEDTLS_CIPHER_MODE_XTS */
 
 #if defined(MBEDTLS_CIPHER_MODE_CFB)
@@ -1238,6 +1334,183 @@ int mbedtls_aes_crypt_ctr( mbedtls_aes_context *ctx,
 
 #endif /* !MBEDTLS_AES_ALT */
 
+#if defined(MBEDTLS_AES_OFFLOAD)
+/*
+ * One mbedtls_aes_offload_crypt_ctr() call waiting for the engine
+ */
+typedef struct
+{
+    mbedtls_aes_offload_job job;
+    int done;
+    int ret;
+}
+aes_offload_request;
+
+void mbedtls_aes_offload_init( mbedtls_aes_offload_context *ctx )
+{
+    memset( ctx, 0, sizeof( mbedtls_aes_offload_context ) );
+
+#if defined(MBEDTLS_THREADING_PTHREAD)
+    pthread_mutex_init( &ctx->mutex, NULL );
+    pthread_cond_init( &ctx->cond, NULL );
+#endif
+}
+
+void mbedtls_aes_offload_setup( mbedtls_aes_offload_context *ctx,
+                                mbedtls_aes_offload_ctr_t *f_ctr,
+                                void *p_engine,
+                                size_t threshold )
+{
+    ctx->f_ctr = f_ctr;
+    ctx->p_engine = p_engine;
+    ctx->threshold = threshold;
+}
+
+/*
+ * Process a request on the CPU
+ */
+static int aes_offload_cpu( const mbedtls_aes_offload_job *job )
+{
+    int ret;
+    mbedtls_aes_context aes;
+    unsigned char nonce_counter[16];
+    unsigned char stream_block[16];
+    size_t nc_off = 0;
+
+    mbedtls_aes_init( &aes );
+    memcpy( nonce_counter, job->nonce_counter, 16 );
+
+    if( ( ret = mbedtls_aes_setkey_enc( &aes, job->key, job->keybits ) ) == 0 )
+        ret = mbedtls_aes_crypt_ctr( &aes, job->length, &nc_off, nonce_counter,
+                                     stream_block, job->input, job->output );
+
+    mbedtls_aes_free( &aes );
+    mbedtls_zeroize( stream_block, sizeof( stream_block ) );
+
+    return( ret );
+}
+
+#if defined(MBEDTLS_THREADING_PTHREAD)
+/*
+ * Queue a request and wait for it to be processed. The first thread to find
+ * the engine idle calls it for every queued request, including the ones
+ * queued while it was busy, until the queue is empty.
+ */
+static int aes_offload_submit( mbedtls_aes_offload_context *ctx,
+                               aes_offload_request *req )
+{
+    mbedtls_aes_offload_job *jobs[MBEDTLS_AES_OFFLOAD_MAX_JOBS];
+    aes_offload_request *batch[MBEDTLS_AES_OFFLOAD_MAX_JOBS];
+    size_t i, count;
+    int ret;
+
+    pthread_mutex_lock( &ctx->mutex );
+
+    /* No room left: don't wait for the engine */
+    if( ctx->queued == MBEDTLS_AES_OFFLOAD_MAX_JOBS )
+    {
+        pthread_mutex_unlock( &ctx->mutex );
+        return( aes_offload_cpu( &req->job ) );
+    }
+
+    ctx->queue[ctx->queued++] = req;
+
+    while( ctx->busy && ! req->done )
+        pthread_cond_wait( &ctx->cond, &ctx->mutex );
+
+    while( ! req->done )
+    {
+        ctx->busy = 1;
+
+        count = ctx->queued;
+        for( i = 0; i < count; i++ )
+        {
+            batch[i] = (aes_offload_request *) ctx->queue[i];
+            jobs[i] = &batch[i]->job;
+        }
+        ctx->queued = 0;
+        ctx->calls++;
+        ctx->jobs += count;
+
+        pthread_mutex_unlock( &ctx->mutex );
+        ret = ctx->f_ctr( ctx->p_engine, jobs, count );
+        pthread_mutex_lock( &ctx->mutex );
+
+        for( i = 0; i < count; i++ )
+        {
+            batch[i]->ret = ret;
+            batch[i]->done = 1;
+        }
+
+        ctx->busy = 0;
+        pthread_cond_broadcast( &ctx->cond );
+    }
+
+    pthread_mutex_unlock( &ctx->mutex );
+
+    return( req->ret );
+}
+#else
+static int aes_offload_submit( mbedtls_aes_offload_context *ctx,
+                               aes_offload_request *req )
+{
+    mbedtls_aes_offload_job *job = &req->job;
+
+    ctx->calls++;
+    ctx->jobs++;
+
+    return( ctx->f_ctr( ctx->p_engine, &job, 1 ) );
+}
+#endif /* MBEDTLS_THREADING_PTHREAD */
+
+/*
+ * AES-CTR encryption/decryption, offloaded when large enough
+ */
+int mbedtls_aes_offload_crypt_ctr( mbedtls_aes_offload_context *ctx,
+                                   const unsigned char *key,
+                                   unsigned int keybits,
+                                   const unsigned char nonce_counter[16],
+                                   size_t length,
+                                   const unsigned char *input,
+                                   unsigned char *output )
+{
+    aes_offload_request req;
+
+    if( keybits != 128 && keybits != 192 && keybits != 256 )
+        return( MBEDTLS_ERR_AES_INVALID_KEY_LENGTH );
+
+    req.job.key = key;
+    req.job.keybits = keybits;
+    memcpy( req.job.nonce_counter, nonce_counter, 16 );
+    req.job.input = input;
+    req.job.output = output;
+    req.job.length = length;
+    req.done = 0;
+    req.ret = 0;
+
+    if( length == 0 )
+        return( 0 );
+
+    if( ctx->f_ctr == NULL || length < ctx->threshold )
+        return( aes_offload_cpu( &req.job ) );
+
+    return( aes_offload_submit( ctx, &req ) );
+}
+
+void mbedtls_aes_offload_free( mbedtls_aes_offload_context *ctx )
+{
+    if( ctx == NULL )
+        return;
+
+#if defined(MBEDTLS_THREADING_PTHREAD)
+    pthread_cond_destroy( &ctx->cond );
+    pthread_mutex_destroy( &ctx->mutex );
+#endif
+
+    memset( ctx, 0, sizeof( mbedtls_aes_offload_context ) );
+}
+#endif /* MBEDTLS_AES_OFFLOAD */
+
 #if defined(MBEDTLS_SELF_TEST)
 /*
  * AES test vectors from:
@@ -88,6 +88,8 @@ int mbedtls_aesni_has_support( unsigned int what )
 #define xmm0_xmm4   "0xE0"
 #define xmm1_xmm0   "0xC1"
 #define xmm1_xmm2   "0xD1"
+#define xmm1_xmm3   "0xD9"
+#define xmm1_xmm4   "0xE1"
 
 /*
  * AES-NI AES-ECB block en(de)cryption
@@ -134,6 +136,74 @@ int mbedtls_aesni_crypt_ecb( mbedtls_aes_context *ctx,
     return( 0 );
 }
 
+/*
+ * AES-NI AES-ECB en(de)cryption of four independent blocks
+ *
+ * The four blocks go through each round back to back, which hides the
+ * latency of AESENC/AESDEC behind the three other blocks.
+ */
+int mbedtls_aesni_crypt_ecb4( mbedtls_aes_context *ctx,
+                      int mode,
+                      const unsigned char input[64],
+                      unsigned char output[64] )
+{
+    asm( "movdqu    (%3), %%xmm0    \n\t" // load input
+         "movdqu  16(%3), %%xmm2    \n\t"
+         "movdqu  32(%3), %%xmm3    \n\t"
+         "movdqu  48(%3), %%xmm4    \n\t"
+         "movdqu    (%1), %%xmm1    \n\t" // load round key 0
+         "pxor      %%xmm1, %%xmm0  \n\t" // round 0
+         "pxor      %%xmm1, %%xmm2  \n\t"
+         "pxor      %%xmm1, %%xmm3  \n\t"
+         "pxor      %%xmm1, %%xmm4  \n\t"
+         "add       $16, %1         \n\t" // point to next round key
+         "subl      $1, %0          \n\t" // normal rounds = nr - 1
+         "test      %2, %2          \n\t" // mode?
+         "jz        2f              \n\t" // 0 = decrypt
+
+         "1:                        \n\t" // encryption loop
+         "movdqu    (%1), %%xmm1    \n\t" // load round key
+         AESENC     xmm1_xmm0      "\n\t" // do round
+         AESENC     xmm1_xmm2      "\n\t"
+         AESENC     xmm1_xmm3      "\n\t"
+         AESENC     xmm1_xmm4      "\n\t"
+         "add       $16, %1         \n\t" // point to next round key
+         "subl      $1, %0          \n\t" // loop
+         "jnz       1b              \n\t"
+         "movdqu    (%1), %%xmm1    \n\t" // load round key
+         AESENCLAST xmm1_xmm0      "\n\t" // last round
+         AESENCLAST xmm1_xmm2      "\n\t"
+         AESENCLAST xmm1_xmm3      "\n\t"
+         AESENCLAST xmm1_xmm4      "\n\t"
+         "jmp       3f              \n\t"
+
+         "2:                        \n\t" // decryption loop
+         "movdqu    (%1), %%xmm1    \n\t"
+         AESDEC     xmm1_xmm0      "\n\t" // do round
+         AESDEC     xmm1_xmm2      "\n\t"
+         AESDEC     xmm1_xmm3      "\n\t"
+         AESDEC     xmm1_xmm4      "\n\t"
+         "add       $16, %1         \n\t"
+         "subl      $1, %0          \n\t"
+         "jnz       2b              \n\t"
+         "movdqu    (%1), %%xmm1    \n\t" // load round key
+         AESDECLAST xmm1_xmm0      "\n\t" // last round
+         AESDECLAST xmm1_xmm2      "\n\t"
+         AESDECLAST xmm1_xmm3      "\n\t"
+         AESDECLAST xmm1_xmm4      "\n\t"
+
+         "3:                        \n\t"
+         "movdqu    %%xmm0,   (%4)  \n\t" // export output
+         "movdqu    %%xmm2, 16(%4)  \n\t"
+         "movdqu    %%xmm3, 32(%4)  \n\t"
+         "movdqu    %%xmm4, 48(%4)  \n\t"
+         :
+         : "r" (ctx->nr), "r" (ctx->rk), "r" (mode), "r" (input), "r" (output)
+         : "memory", "cc", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4" );
+
+    return( 0 );
+}
+
 /*
  * GCM multiplication: c = a times b in GF(2^128)
  * Based on [CLMUL-WP] algorithms 1 (with equation 27) and 5.
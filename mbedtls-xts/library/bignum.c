@@ -33,6 +33,10 @@
  *  [3] GNU Multi-Precision Arithmetic Library
  *      https://gmplib.org/manual/index.html
  *
+ *  [4] New Instructions Supporting Large Integer Arithmetic on Intel
+ *      Architecture Processors - 2012
+ *      Ozturk, Guilford, Gopal and Feghali
+ *
  */
 
 #if !defined(MBEDTLS_CONFIG_FILE)
@@ -87,6 +91,143 @@ void mbedtls_mpi_init( mbedtls_mpi *X )
     X->s = 1;
     X->n = 0;
     X->p = NULL;
+#if defined(MBEDTLS_MPI_ARENA)
+    X->arena = NULL;
+#endif
+}
+
+#if defined(MBEDTLS_MPI_ARENA)
+/*
+ * Initialize a scratch arena
+ */
+void mbedtls_mpi_arena_init( mbedtls_mpi_arena *arena, void *buf, size_t size )
+{
+    arena->buf = (mbedtls_mpi_uint *) buf;
+    arena->size = size / ciL;
+    arena->used = 0;
+    arena->peak = 0;
+}
+
+/*
+ * Initialize one MPI drawing its limbs from an arena
+ */
+void mbedtls_mpi_init_arena( mbedtls_mpi *X, mbedtls_mpi_arena *arena )
+{
+    mbedtls_mpi_init( X );
+
+    if( X != NULL )
+        X->arena = arena;
+}
+
+/*
+ * Each block of an arena is followed by a footer limb with its size and
+ * whether it was freed, so that blocks freed out of order are given back
+ * along with the block above them
+ */
+#define MPI_ARENA_FOOTER( n, freed )  \
+    ( ( (mbedtls_mpi_uint) (n) << 1 ) | (freed) )
+
+/*
+ * Whether the limbs of X come from its arena
+ */
+static int mpi_in_arena( const mbedtls_mpi *X )
+{
+    return( X->arena != NULL && X->p != NULL &&
+            X->p >= X->arena->buf && X->p < X->arena->buf + X->arena->size );
+}
+
+/*
+ * Whether the limbs of X are the topmost block of its arena, which can
+ * grow or shrink in place
+ */
+static int mpi_arena_top( const mbedtls_mpi *X )
+{
+    return( mpi_in_arena( X ) &&
+            X->p + X->n + 1 == X->arena->buf + X->arena->used );
+}
+
+/*
+ * Hand out limbs at the top of an arena
+ */
+static void mpi_arena_take( mbedtls_mpi_arena *arena, size_t nblimbs )
+{
+    arena->used += nblimbs;
+    if( arena->used > arena->peak )
+        arena->peak = arena->used;
+}
+
+/*
+ * Give back the freed blocks at the top of an arena
+ */
+static void mpi_arena_release( mbedtls_mpi_arena *arena )
+{
+    mbedtls_mpi_uint footer;
+
+    while( arena->used > 0 &&
+           ( ( footer = arena->buf[arena->used - 1] ) & 1 ) != 0 )
+    {
+        arena->used -= (size_t)( footer >> 1 ) + 1;
+    }
+}
+#endif /* MBEDTLS_MPI_ARENA */
+
+/*
+ * Initialize a temporary of an operation with destination X (possibly
+ * NULL): its limbs come from the same arena as those of X
+ */
+static void mpi_init_tmp( mbedtls_mpi *T, const mbedtls_mpi *X )
+{
+    mbedtls_mpi_init( T );
+#if defined(MBEDTLS_MPI_ARENA)
+    if( X != NULL )
+        T->arena = X->arena;
+#else
+    ((void) X);
+#endif
+}
+
+/*
+ * Allocate nblimbs zeroed limbs for X, from its arena if there is room
+ */
+static mbedtls_mpi_uint *mpi_alloc_limbs( mbedtls_mpi *X, size_t nblimbs )
+{
+#if defined(MBEDTLS_MPI_ARENA)
+    mbedtls_mpi_arena *arena = X->arena;
+    mbedtls_mpi_uint *p;
+
+    if( arena != NULL && arena->size - arena->used > nblimbs )
+    {
+        p = arena->buf + arena->used;
+        mpi_arena_take( arena, nblimbs + 1 );
+        memset( p, 0, nblimbs * ciL );
+        p[nblimbs] = MPI_ARENA_FOOTER( nblimbs, 0 );
+
+        return( p );
+    }
+#else
+    ((void) X);
+#endif
+
+    return( (mbedtls_mpi_uint*)mbedtls_calloc( nblimbs, ciL ) );
+}
+
+/*
+ * Wipe and release the limbs of X
+ */
+static void mpi_free_limbs( mbedtls_mpi *X )
+{
+    mbedtls_mpi_zeroize( X->p, X->n );
+
+#if defined(MBEDTLS_MPI_ARENA)
+    if( mpi_in_arena( X ) )
+    {
+        X->p[X->n] = MPI_ARENA_FOOTER( X->n, 1 );
+        mpi_arena_release( X->arena );
+        return;
+    }
+#endif
+
+    mbedtls_free( X->p );
 }
 
 /*
@@ -98,10 +239,7 @@ void mbedtls_mpi_free( mbedtls_mpi *X )
         return;
 
     if( X->p != NULL )
-    {
-        mbedtls_mpi_zeroize( X->p, X->n );
-        mbedtls_free( X->p );
-    }
+        mpi_free_limbs( X );
 
     X->s = 1;
     X->n = 0;
@@ -120,14 +258,26 @@ int mbedtls_mpi_grow( mbedtls_mpi *X, size_t nblimbs )
 
     if( X->n < nblimbs )
     {
-        if( ( p = (mbedtls_mpi_uint*)mbedtls_calloc( nblimbs, ciL ) ) == NULL )
+#if defined(MBEDTLS_MPI_ARENA)
+        if( mpi_arena_top( X ) &&
+            X->arena->size - X->arena->used >= nblimbs - X->n )
+        {
+            memset( X->p + X->n, 0, ( nblimbs - X->n ) * ciL );
+            X->p[nblimbs] = MPI_ARENA_FOOTER( nblimbs, 0 );
+            mpi_arena_take( X->arena, nblimbs - X->n );
+            X->n = nblimbs;
+
+            return( 0 );
+        }
+#endif
+
+        if( ( p = mpi_alloc_limbs( X, nblimbs ) ) == NULL )
             return( MBEDTLS_ERR_MPI_ALLOC_FAILED );
 
         if( X->p != NULL )
         {
             memcpy( p, X->p, X->n * ciL );
-            mbedtls_mpi_zeroize( X->p, X->n );
-            mbedtls_free( X->p );
+            mpi_free_limbs( X );
         }
 
         X->n = nblimbs;
@@ -158,14 +308,25 @@ int mbedtls_mpi_shrink( mbedtls_mpi *X, size_t nblimbs )
     if( i < nblimbs )
         i = nblimbs;
 
-    if( ( p = (mbedtls_mpi_uint*)mbedtls_calloc( i, ciL ) ) == NULL )
+#if defined(MBEDTLS_MPI_ARENA)
+    if( mpi_arena_top( X ) )
+    {
+        mbedtls_mpi_zeroize( X->p + i, X->n - i + 1 );
+        X->p[i] = MPI_ARENA_FOOTER( i, 0 );
+        X->arena->used -= X->n - i;
+        X->n = i;
+
+        return( 0 );
+    }
+#endif
+
+    if( ( p = mpi_alloc_limbs( X, i ) ) == NULL )
         return( MBEDTLS_ERR_MPI_ALLOC_FAILED );
 
     if( X->p != NULL )
     {
         memcpy( p, X->p, i * ciL );
-        mbedtls_mpi_zeroize( X->p, X->n );
-        mbedtls_free( X->p );
+        mpi_free_limbs( X );
     }
 
     X->n = i;
@@ -872,6 +1033,7 @@ int mbedtls_mpi_cmp_int( const mbedtls_mpi *X, mbedtls_mpi_sint z )
     Y.s = ( z < 0 ) ? -1 : 1;
     Y.n = 1;
     Y.p = p;
+    Y.arena = NULL;
 
     return( mbedtls_mpi_cmp_mpi( X, &Y ) );
 }
@@ -965,7 +1127,7 @@ int mbedtls_mpi_sub_abs( mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi
     if( mbedtls_mpi_cmp_abs( A, B ) < 0 )
         return( MBEDTLS_ERR_MPI_NEGATIVE_VALUE );
 
-    mbedtls_mpi_init( &TB );
+    mpi_init_tmp( &TB, X );
 
     if( X == B )
     {
@@ -1070,6 +1232,7 @@ int mbedtls_mpi_add_int( mbedtls_mpi *X, const mbedtls_mpi *A, mbedtls_mpi_sint
     _B.s = ( b < 0 ) ? -1 : 1;
     _B.n = 1;
     _B.p = p;
+    _B.arena = NULL;
 
     return( mbedtls_mpi_add_mpi( X, A, &_B ) );
 }
@@ -1086,10 +1249,113 @@ int mbedtls_mpi_sub_int( mbedtls_mpi *X, const mbedtls_mpi *A, mbedtls_mpi_sint
     _B.s = ( b < 0 ) ? -1 : 1;
     _B.n = 1;
     _B.p = p;
+    _B.arena = NULL;
 
     return( mbedtls_mpi_sub_mpi( X, A, &_B ) );
 }
 
+#if defined(MBEDTLS_MPI_MULX) && defined(MBEDTLS_HAVE_ASM) && \
+    defined(__GNUC__) && ( defined(__amd64__) || defined(__x86_64__) ) && \
+    !defined(MBEDTLS_HAVE_INT32)
+#define MPI_HAVE_MULX
+
+/*
+ * Whether the CPU has MULX (BMI2) and ADCX/ADOX (ADX):
+ * CPUID leaf 7, EBX bits 8 and 19
+ */
+static int mpi_mulx_supported( void )
+{
+    static int done = 0;
+    static int supported = 0;
+    unsigned int max, b = 0;
+
+    if( ! done )
+    {
+        asm( "movl  $0, %%eax   \n\t"
+             "cpuid             \n\t"
+             : "=a" (max)
+             :
+             : "ebx", "ecx", "edx" );
+
+        if( max >= 7 )
+        {
+            asm( "movl  $7, %%eax       \n\t"
+                 "xorl  %%ecx, %%ecx    \n\t"
+                 "cpuid                 \n\t"
+                 : "=b" (b)
+                 :
+                 : "eax", "ecx", "edx" );
+        }
+
+        supported = ( b & ( 1u << 8 ) ) != 0 && ( b & ( 1u << 19 ) ) != 0;
+        done = 1;
+    }
+
+    return( supported );
+}
+
+/*
+ * d[0..i-1] += s[0..i-1] * b, returning the carry out of d[i-1]  (see [4])
+ *
+ * MULX leaves the flags alone, so the high half of the previous product
+ * is added with ADCX (carry flag) while the destination limb is added with
+ * ADOX (overflow flag): two independent carry chains. Loop control only
+ * uses LEA and JRCXZ, which preserve both flags.
+ */
+static mbedtls_mpi_uint mpi_mulx_hlp( size_t i, mbedtls_mpi_uint *s,
+                                      mbedtls_mpi_uint *d, mbedtls_mpi_uint b )
+{
+    mbedtls_mpi_uint c;
+    size_t n4 = i / 4, n1 = i % 4;
+
+    asm( "xorl   %k[c], %k[c]               \n\t"
+         "1:                                \n\t"
+         "jrcxz  2f                         \n\t"
+         "mulx   (%%rsi), %%rax, %%r9       \n\t"
+         "adcx   %[c], %%rax                \n\t"
+         "adox   (%%rdi), %%rax             \n\t"
+         "movq   %%rax, (%%rdi)             \n\t"
+         "mulx   8(%%rsi), %%rax, %[c]      \n\t"
+         "adcx   %%r9, %%rax                \n\t"
+         "adox   8(%%rdi), %%rax            \n\t"
+         "movq   %%rax, 8(%%rdi)            \n\t"
+         "mulx   16(%%rsi), %%rax, %%r9     \n\t"
+         "adcx   %[c], %%rax                \n\t"
+         "adox   16(%%rdi), %%rax           \n\t"
+         "movq   %%rax, 16(%%rdi)           \n\t"
+         "mulx   24(%%rsi), %%rax, %[c]     \n\t"
+         "adcx   %%r9, %%rax                \n\t"
+         "adox   24(%%rdi), %%rax           \n\t"
+         "movq   %%rax, 24(%%rdi)           \n\t"
+         "leaq   32(%%rsi), %%rsi           \n\t"
+         "leaq   32(%%rdi), %%rdi           \n\t"
+         "leaq   -1(%%rcx), %%rcx           \n\t"
+         "jmp    1b                         \n\t"
+         "2:                                \n\t"
+         "movq   %[n1], %%rcx               \n\t"
+         "3:                                \n\t"
+         "jrcxz  4f                         \n\t"
+         "mulx   (%%rsi), %%rax, %%r9       \n\t"
+         "adcx   %[c], %%rax                \n\t"
+         "adox   (%%rdi), %%rax             \n\t"
+         "movq   %%rax, (%%rdi)             \n\t"
+         "movq   %%r9, %[c]                 \n\t"
+         "leaq   8(%%rsi), %%rsi            \n\t"
+         "leaq   8(%%rdi), %%rdi            \n\t"
+         "leaq   -1(%%rcx), %%rcx           \n\t"
+         "jmp    3b                         \n\t"
+         "4:                                \n\t"
+         "movl   $0, %%eax                  \n\t"
+         "adcx   %%rax, %[c]                \n\t"
+         "adox   %%rax, %[c]                \n\t"
+         : [c] "=&r" (c), "+S" (s), "+D" (d), "+c" (n4)
+         : [n1] "r" (n1), "d" (b)
+         : "rax", "r9", "cc", "memory" );
+
+    return( c );
+}
+#endif /* MBEDTLS_MPI_MULX && MBEDTLS_HAVE_ASM && __GNUC__ && x86-64 */
+
 /*
  * Helper for mbedtls_mpi multiplication
  */
@@ -1105,6 +1371,15 @@ void mpi_mul_hlp( size_t i, mbedtls_mpi_uint *s, mbedtls_mpi_uint *d, mbedtls_mp
 {
     mbedtls_mpi_uint c = 0, t = 0;
 
+#if defined(MPI_HAVE_MULX)
+    if( mpi_mulx_supported() )
+    {
+        c = mpi_mulx_hlp( i, s, d, b );
+        d += i;
+        i = 0;
+    }
+#endif
+
 #if defined(MULADDC_HUIT)
     for( ; i >= 8; i -= 8 )
     {
@@ -1162,19 +1437,210 @@ void mpi_mul_hlp( size_t i, mbedtls_mpi_uint *s, mbedtls_mpi_uint *d, mbedtls_mp
     while( c != 0 );
 }
 
+/*
+ * Addition of limbs: d += s, with s of n limbs (carry propagated into d)
+ */
+static void mpi_add_hlp( size_t n, mbedtls_mpi_uint *s, mbedtls_mpi_uint *d )
+{
+    size_t i;
+    mbedtls_mpi_uint c, t;
+
+    for( i = c = 0; i < n; i++, s++, d++ )
+    {
+        t = *s + c; c  = ( t < c );
+        *d += t;    c += ( *d < t );
+    }
+
+    while( c != 0 )
+    {
+        *d += c; c = ( *d < c ); d++;
+    }
+}
+
+/*
+ * Schoolbook multiplication of limbs: d = a * b  (HAC 14.12)
+ * d has an + bn limbs and does not overlap a or b
+ */
+static void mpi_mul_school( mbedtls_mpi_uint *d, mbedtls_mpi_uint *a, size_t an,
+                            mbedtls_mpi_uint *b, size_t bn )
+{
+    if( an + bn == 0 )
+        return;
+
+    memset( d, 0, ( an + bn ) * ciL );
+
+    if( an == 0 )
+        return;
+
+    for( ; bn > 0; bn-- )
+        mpi_mul_hlp( an, a, d + bn - 1, b[bn - 1] );
+}
+
+/*
+ * Schoolbook squaring of limbs: d = a * a  (HAC 14.16)
+ * d has 2 * n limbs and does not overlap a
+ */
+static void mpi_sqr_school( mbedtls_mpi_uint *d, mbedtls_mpi_uint *a, size_t n )
+{
+    size_t i;
+    mbedtls_mpi_uint c, t;
+#if defined(MBEDTLS_HAVE_UDBL)
+    mbedtls_mpi_uint d0, d1;
+    mbedtls_t_udbl r;
+#endif
+
+    if( n == 0 )
+        return;
+
+    memset( d, 0, 2 * n * ciL );
+
+    /* Products of distinct limbs, once */
+    for( i = 0; i + 1 < n; i++ )
+        mpi_mul_hlp( n - i - 1, a + i + 1, d + 2 * i + 1, a[i] );
+
+#if defined(MBEDTLS_HAVE_UDBL)
+    /* Twice, plus the squares of the limbs */
+    for( i = c = t = 0; i < n; i++ )
+    {
+        d0 = ( d[2 * i] << 1 ) | t;
+        t = d[2 * i] >> ( biL - 1 );
+        d1 = ( d[2 * i + 1] << 1 ) | t;
+        t = d[2 * i + 1] >> ( biL - 1 );
+
+        r = (mbedtls_t_udbl) a[i] * a[i] + d0 + c;
+        d[2 * i] = (mbedtls_mpi_uint) r;
+        r = ( r >> biL ) + d1;
+        d[2 * i + 1] = (mbedtls_mpi_uint) r;
+        c = (mbedtls_mpi_uint)( r >> biL );
+    }
+#else
+    /* Twice */
+    for( i = c = 0; i < 2 * n; i++ )
+    {
+        t = d[i] >> ( biL - 1 );
+        d[i] = ( d[i] << 1 ) | c;
+        c = t;
+    }
+
+    /* Plus the squares of the limbs */
+    for( i = 0; i < n; i++ )
+        mpi_mul_hlp( 1, a + i, d + 2 * i, a[i] );
+#endif /* MBEDTLS_HAVE_UDBL */
+}
+
+/*
+ * Limbs of scratch space used by mpi_mul_kara() and mpi_sqr_kara()
+ * on n-limb operands
+ */
+static size_t mpi_kara_scratch( size_t n )
+{
+    size_t w = 0;
+
+    while( n >= MBEDTLS_MPI_KARATSUBA_THRESHOLD )
+    {
+        n = n - n / 2 + 1;
+        w += 4 * n;
+    }
+
+    return( w );
+}
+
+/*
+ * Karatsuba multiplication of limbs: d = a * b, with a and b of n limbs
+ * and d of 2 * n limbs not overlapping them. Splitting a = a1 2^(h biL) + a0
+ * and likewise b, the middle term a0 b1 + a1 b0 is computed as
+ * (a0 + a1) (b0 + b1) - a0 b0 - a1 b1. Below the threshold, or on each
+ * half, falls back to schoolbook multiplication.
+ */
+static void mpi_mul_kara( mbedtls_mpi_uint *d, mbedtls_mpi_uint *a,
+                          mbedtls_mpi_uint *b, size_t n, mbedtls_mpi_uint *w )
+{
+    size_t h, m;
+    mbedtls_mpi_uint *sa, *sb, *z1;
+
+    if( n < MBEDTLS_MPI_KARATSUBA_THRESHOLD )
+    {
+        mpi_mul_school( d, a, n, b, n );
+        return;
+    }
+
+    h = n / 2;
+    m = n - h;
+    sa = w;
+    sb = sa + m + 1;
+    z1 = sb + m + 1;
+    w  = z1 + 2 * ( m + 1 );
+
+    /* d = a1 b1 2^(2 h biL) + a0 b0 */
+    mpi_mul_kara( d, a, b, h, w );
+    mpi_mul_kara( d + 2 * h, a + h, b + h, m, w );
+
+    /* z1 = (a0 + a1) (b0 + b1) - a0 b0 - a1 b1 */
+    memcpy( sa, a + h, m * ciL ); sa[m] = 0;
+    memcpy( sb, b + h, m * ciL ); sb[m] = 0;
+    mpi_add_hlp( h, a, sa );
+    mpi_add_hlp( h, b, sb );
+
+    mpi_mul_kara( z1, sa, sb, m + 1, w );
+    mpi_sub_hlp( 2 * h, d, z1 );
+    mpi_sub_hlp( 2 * m, d + 2 * h, z1 );
+
+    /* z1 < 2^((n + 1) biL) */
+    mpi_add_hlp( n + 1, z1, d + h );
+}
+
+/*
+ * Karatsuba squaring of limbs: d = a * a, same layout as mpi_mul_kara()
+ */
+static void mpi_sqr_kara( mbedtls_mpi_uint *d, mbedtls_mpi_uint *a,
+                          size_t n, mbedtls_mpi_uint *w )
+{
+    size_t h, m;
+    mbedtls_mpi_uint *sa, *z1;
+
+    if( n < MBEDTLS_MPI_KARATSUBA_THRESHOLD )
+    {
+        mpi_sqr_school( d, a, n );
+        return;
+    }
+
+    h = n / 2;
+    m = n - h;
+    sa = w;
+    z1 = sa + 2 * ( m + 1 );
+    w  = z1 + 2 * ( m + 1 );
+
+    mpi_sqr_kara( d, a, h, w );
+    mpi_sqr_kara( d + 2 * h, a + h, m, w );
+
+    memcpy( sa, a + h, m * ciL ); sa[m] = 0;
+    mpi_add_hlp( h, a, sa );
+
+    mpi_sqr_kara( z1, sa, m + 1, w );
+    mpi_sub_hlp( 2 * h, d, z1 );
+    mpi_sub_hlp( 2 * m, d + 2 * h, z1 );
+
+    mpi_add_hlp( n + 1, z1, d + h );
+}
+
 /*
  * Baseline multiplication: X = A * B  (HAC 14.12)
+ *
+ * Squares use mpi_sqr_school(), and operands of at least
+ * MBEDTLS_MPI_KARATSUBA_THRESHOLD limbs Karatsuba multiplication.
  */
 int mbedtls_mpi_mul_mpi( mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi *B )
 {
     int ret;
-    size_t i, j;
-    mbedtls_mpi TA, TB;
+    size_t i, j, n;
+    mbedtls_mpi TA, TB, W;
+    int sqr = ( A == B );
 
-    mbedtls_mpi_init( &TA ); mbedtls_mpi_init( &TB );
+    mpi_init_tmp( &TA, X ); mpi_init_tmp( &TB, X ); mpi_init_tmp( &W, X );
 
     if( X == A ) { MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &TA, A ) ); A = &TA; }
     if( X == B ) { MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &TB, B ) ); B = &TB; }
+    if( sqr ) B = A;
 
     for( i = A->n; i > 0; i-- )
         if( A->p[i - 1] != 0 )
@@ -1184,17 +1650,52 @@ int mbedtls_mpi_mul_mpi( mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi
         if( B->p[j - 1] != 0 )
             break;
 
-    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( X, i + j ) );
-    MBEDTLS_MPI_CHK( mbedtls_mpi_lset( X, 0 ) );
+    if( i >= MBEDTLS_MPI_KARATSUBA_THRESHOLD &&
+        j >= MBEDTLS_MPI_KARATSUBA_THRESHOLD )
+    {
+        /* Zero-extend the shorter operand to n limbs */
+        n = ( i > j ) ? i : j;
+
+        if( A->n < n )
+        {
+            MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &TA, A ) );
+            MBEDTLS_MPI_CHK( mbedtls_mpi_grow( &TA, n ) );
+            A = &TA;
+        }
+
+        if( B->n < n )
+        {
+            MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &TB, B ) );
+            MBEDTLS_MPI_CHK( mbedtls_mpi_grow( &TB, n ) );
+            B = &TB;
+        }
 
-    for( i++; j > 0; j-- )
-        mpi_mul_hlp( i - 1, A->p, X->p + j - 1, B->p[j - 1] );
+        MBEDTLS_MPI_CHK( mbedtls_mpi_grow( &W, mpi_kara_scratch( n ) ) );
+        MBEDTLS_MPI_CHK( mbedtls_mpi_grow( X, 2 * n ) );
+        memset( X->p + 2 * n, 0, ( X->n - 2 * n ) * ciL );
+
+        if( sqr )
+            mpi_sqr_kara( X->p, A->p, n, W.p );
+        else
+            mpi_mul_kara( X->p, A->p, B->p, n, W.p );
+    }
+    else
+    {
+        MBEDTLS_MPI_CHK( mbedtls_mpi_grow( X, i + j ) );
+        if( X->n > i + j )
+            memset( X->p + i + j, 0, ( X->n - i - j ) * ciL );
+
+        if( sqr )
+            mpi_sqr_school( X->p, A->p, i );
+        else
+            mpi_mul_school( X->p, A->p, i, B->p, j );
+    }
 
     X->s = A->s * B->s;
 
 cleanup:
 
-    mbedtls_mpi_free( &TB ); mbedtls_mpi_free( &TA );
+    mbedtls_mpi_free( &W ); mbedtls_mpi_free( &TB ); mbedtls_mpi_free( &TA );
 
     return( ret );
 }
@@ -1210,6 +1711,7 @@ int mbedtls_mpi_mul_int( mbedtls_mpi *X, const mbedtls_mpi *A, mbedtls_mpi_uint
     _B.s = 1;
     _B.n = 1;
     _B.p = p;
+    _B.arena = NULL;
     p[0] = b;
 
     return( mbedtls_mpi_mul_mpi( X, A, &_B ) );
@@ -1319,12 +1821,13 @@ int mbedtls_mpi_div_mpi( mbedtls_mpi *Q, mbedtls_mpi *R, const mbedtls_mpi *A, c
     int ret;
     size_t i, n, t, k;
     mbedtls_mpi X, Y, Z, T1, T2;
+    const mbedtls_mpi *D = ( R != NULL ) ? R : Q;
 
     if( mbedtls_mpi_cmp_int( B, 0 ) == 0 )
         return( MBEDTLS_ERR_MPI_DIVISION_BY_ZERO );
 
-    mbedtls_mpi_init( &X ); mbedtls_mpi_init( &Y ); mbedtls_mpi_init( &Z );
-    mbedtls_mpi_init( &T1 ); mbedtls_mpi_init( &T2 );
+    mpi_init_tmp( &X, D ); mpi_init_tmp( &Y, D ); mpi_init_tmp( &Z, D );
+    mpi_init_tmp( &T1, D ); mpi_init_tmp( &T2, D );
 
     if( mbedtls_mpi_cmp_abs( A, B ) < 0 )
     {
@@ -1438,6 +1941,7 @@ int mbedtls_mpi_div_int( mbedtls_mpi *Q, mbedtls_mpi *R, const mbedtls_mpi *A, m
     _B.s = ( b < 0 ) ? -1 : 1;
     _B.n = 1;
     _B.p = p;
+    _B.arena = NULL;
 
     return( mbedtls_mpi_div_mpi( Q, R, A, &_B ) );
 }
@@ -1582,6 +2086,47 @@ static int mpi_montmul( mbedtls_mpi *A, const mbedtls_mpi *B, const mbedtls_mpi
     return( 0 );
 }
 
+/*
+ * Montgomery squaring: A = A * A * R^-1 mod N, computing the square first
+ * and reducing it afterwards (HAC 14.32). T must have room for the 2n + 1
+ * limbs of the square followed by the scratch space of mpi_sqr_kara().
+ */
+static int mpi_montsqr( mbedtls_mpi *A, const mbedtls_mpi *N, mbedtls_mpi_uint mm,
+                        const mbedtls_mpi *T )
+{
+    size_t i, n;
+    mbedtls_mpi_uint *d;
+
+    n = N->n;
+
+    if( A->n < n + 1 || T->p == NULL ||
+        T->n < 2 * n + 1 + mpi_kara_scratch( n ) )
+        return( MBEDTLS_ERR_MPI_BAD_INPUT_DATA );
+
+    d = T->p;
+
+    mpi_sqr_kara( d, A->p, n, d + 2 * n + 1 );
+    d[2 * n] = 0;
+
+    for( i = 0; i < n; i++ )
+    {
+        /*
+         * T = T + u * N * 2^(i biL), clearing limb i
+         */
+        mpi_mul_hlp( n, N->p, d + i, d[i] * mm );
+    }
+
+    memcpy( A->p, d + n, ( n + 1 ) * ciL );
+
+    if( mbedtls_mpi_cmp_abs( A, N ) >= 0 )
+        mpi_sub_hlp( n, N->p, A->p );
+    else
+        /* prevent timing attacks */
+        mpi_sub_hlp( n, A->p, T->p );
+
+    return( 0 );
+}
+
 /*
  * Montgomery reduction: A = A * R^-1 mod N
  */
@@ -1592,41 +2137,54 @@ static int mpi_montred( mbedtls_mpi *A, const mbedtls_mpi *N, mbedtls_mpi_uint m
 
     U.n = U.s = (int) z;
     U.p = &z;
+    U.arena = NULL;
 
     return( mpi_montmul( A, &U, N, mm, T ) );
 }
 
+/*
+ * R^2 mod N, with R = 2^(biL * N->n)
+ */
+static int mpi_mont_rr( mbedtls_mpi *RR, const mbedtls_mpi *N )
+{
+    int ret;
+
+    MBEDTLS_MPI_CHK( mbedtls_mpi_lset( RR, 1 ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_shift_l( RR, N->n * 2 * biL ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi( RR, RR, N ) );
+
+cleanup:
+
+    return( ret );
+}
+
 /*
  * Sliding-window exponentiation: X = A^E mod N  (HAC 14.85)
+ * given mm = -N^-1 mod 2^biL and RR = R^2 mod N
  */
-int mbedtls_mpi_exp_mod( mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi *E, const mbedtls_mpi *N, mbedtls_mpi *_RR )
+static int mpi_exp_mod( mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi *E,
+                        const mbedtls_mpi *N, mbedtls_mpi_uint mm,
+                        const mbedtls_mpi *RR )
 {
     int ret;
     size_t wbits, wsize, one = 1;
     size_t i, j, nblimbs;
     size_t bufsize, nbits;
-    mbedtls_mpi_uint ei, mm, state;
-    mbedtls_mpi RR, T, W[ 2 << MBEDTLS_MPI_WINDOW_SIZE ], Apos;
+    mbedtls_mpi_uint ei, state;
+    mbedtls_mpi T, W[ 2 << MBEDTLS_MPI_WINDOW_SIZE ], Apos;
     int neg;
 
-    if( mbedtls_mpi_cmp_int( N, 0 ) < 0 || ( N->p[0] & 1 ) == 0 )
-        return( MBEDTLS_ERR_MPI_BAD_INPUT_DATA );
-
-    if( mbedtls_mpi_cmp_int( E, 0 ) < 0 )
-        return( MBEDTLS_ERR_MPI_BAD_INPUT_DATA );
-
     /*
      * Init temps and window size
      */
-    mpi_montg_init( &mm, N );
-    mbedtls_mpi_init( &RR ); mbedtls_mpi_init( &T );
-    mbedtls_mpi_init( &Apos );
-    memset( W, 0, sizeof( W ) );
+    mpi_init_tmp( &T, X ); mpi_init_tmp( &Apos, X );
+    for( i = 0; i < sizeof( W ) / sizeof( W[0] ); i++ )
+        mpi_init_tmp( &W[i], X );
 
     i = mbedtls_mpi_bitlen( E );
 
-    wsize = ( i > 671 ) ? 6 : ( i > 239 ) ? 5 :
-            ( i >  79 ) ? 4 : ( i >  23 ) ? 3 : 1;
+    wsize = ( i > 1791 ) ? 7 : ( i > 671 ) ? 6 : ( i > 239 ) ? 5 :
+            ( i >   79 ) ? 4 : ( i >  23 ) ? 3 : 1;
 
     if( wsize > MBEDTLS_MPI_WINDOW_SIZE )
         wsize = MBEDTLS_MPI_WINDOW_SIZE;
@@ -1634,7 +2192,7 @@ int mbedtls_mpi_exp_mod( mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi
     j = N->n + 1;
     MBEDTLS_MPI_CHK( mbedtls_mpi_grow( X, j ) );
     MBEDTLS_MPI_CHK( mbedtls_mpi_grow( &W[1],  j ) );
-    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( &T, j * 2 ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( &T, j * 2 + mpi_kara_scratch( N->n ) ) );
 
     /*
      * Compensate for negative A (and correct at the end)
@@ -1647,21 +2205,6 @@ int mbedtls_mpi_exp_mod( mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi
         A = &Apos;
     }
 
-    /*
-     * If 1st call, pre-compute R^2 mod N
-     */
-    if( _RR == NULL || _RR->p == NULL )
-    {
-        MBEDTLS_MPI_CHK( mbedtls_mpi_lset( &RR, 1 ) );
-        MBEDTLS_MPI_CHK( mbedtls_mpi_shift_l( &RR, N->n * 2 * biL ) );
-        MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi( &RR, &RR, N ) );
-
-        if( _RR != NULL )
-            memcpy( _RR, &RR, sizeof( mbedtls_mpi ) );
-    }
-    else
-        memcpy( &RR, _RR, sizeof( mbedtls_mpi ) );
-
     /*
      * W[1] = A * R^2 * R^-1 mod N = A * R mod N
      */
@@ -1670,12 +2213,12 @@ int mbedtls_mpi_exp_mod( mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi
     else
         MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &W[1], A ) );
 
-    MBEDTLS_MPI_CHK( mpi_montmul( &W[1], &RR, N, mm, &T ) );
+    MBEDTLS_MPI_CHK( mpi_montmul( &W[1], RR, N, mm, &T ) );
 
     /*
      * X = R^2 * R^-1 mod N = R mod N
      */
-    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( X, &RR ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( X, RR ) );
     MBEDTLS_MPI_CHK( mpi_montred( X, N, mm, &T ) );
 
     if( wsize > 1 )
@@ -1689,7 +2232,7 @@ int mbedtls_mpi_exp_mod( mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi
         MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &W[j], &W[1]    ) );
 
         for( i = 0; i < wsize - 1; i++ )
-            MBEDTLS_MPI_CHK( mpi_montmul( &W[j], &W[j], N, mm, &T ) );
+            MBEDTLS_MPI_CHK( mpi_montsqr( &W[j], N, mm, &T ) );
 
         /*
          * W[i] = W[i - 1] * W[1]
@@ -1736,7 +2279,7 @@ int mbedtls_mpi_exp_mod( mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi
             /*
              * out of window, square X
              */
-            MBEDTLS_MPI_CHK( mpi_montmul( X, X, N, mm, &T ) );
+            MBEDTLS_MPI_CHK( mpi_montsqr( X, N, mm, &T ) );
             continue;
         }
 
@@ -1754,7 +2297,7 @@ int mbedtls_mpi_exp_mod( mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi
              * X = X^wsize R^-1 mod N
              */
             for( i = 0; i < wsize; i++ )
-                MBEDTLS_MPI_CHK( mpi_montmul( X, X, N, mm, &T ) );
+                MBEDTLS_MPI_CHK( mpi_montsqr( X, N, mm, &T ) );
 
             /*
              * X = X * W[wbits] R^-1 mod N
@@ -1772,7 +2315,7 @@ int mbedtls_mpi_exp_mod( mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi
      */
     for( i = 0; i < nbits; i++ )
     {
-        MBEDTLS_MPI_CHK( mpi_montmul( X, X, N, mm, &T ) );
+        MBEDTLS_MPI_CHK( mpi_montsqr( X, N, mm, &T ) );
 
         wbits <<= 1;
 
@@ -1798,12 +2341,355 @@ cleanup:
 
     mbedtls_mpi_free( &W[1] ); mbedtls_mpi_free( &T ); mbedtls_mpi_free( &Apos );
 
+    return( ret );
+}
+
+/*
+ * Sliding-window exponentiation: X = A^E mod N  (HAC 14.85)
+ */
+int mbedtls_mpi_exp_mod( mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi *E, const mbedtls_mpi *N, mbedtls_mpi *_RR )
+{
+    int ret;
+    mbedtls_mpi_uint mm;
+    mbedtls_mpi RR;
+
+    if( mbedtls_mpi_cmp_int( N, 0 ) < 0 || ( N->p[0] & 1 ) == 0 )
+        return( MBEDTLS_ERR_MPI_BAD_INPUT_DATA );
+
+    if( mbedtls_mpi_cmp_int( E, 0 ) < 0 )
+        return( MBEDTLS_ERR_MPI_BAD_INPUT_DATA );
+
+    mpi_montg_init( &mm, N );
+
+    /* RR is handed over to _RR for later calls: keep it out of arenas */
+    if( _RR == NULL )
+        mpi_init_tmp( &RR, X );
+    else
+        mbedtls_mpi_init( &RR );
+
+    /*
+     * If 1st call, pre-compute R^2 mod N
+     */
+    if( _RR == NULL || _RR->p == NULL )
+    {
+        MBEDTLS_MPI_CHK( mpi_mont_rr( &RR, N ) );
+
+        if( _RR != NULL )
+            memcpy( _RR, &RR, sizeof( mbedtls_mpi ) );
+    }
+    else
+        memcpy( &RR, _RR, sizeof( mbedtls_mpi ) );
+
+    MBEDTLS_MPI_CHK( mpi_exp_mod( X, A, E, N, mm, &RR ) );
+
+cleanup:
+
     if( _RR == NULL || _RR->p == NULL )
         mbedtls_mpi_free( &RR );
 
     return( ret );
 }
 
+/*
+ * Initialize a Montgomery context
+ */
+void mbedtls_mpi_mont_init( mbedtls_mpi_mont_ctx *ctx )
+{
+    if( ctx == NULL )
+        return;
+
+    ctx->mm = 0;
+    mbedtls_mpi_init( &ctx->RR );
+}
+
+/*
+ * Unallocate a Montgomery context
+ */
+void mbedtls_mpi_mont_free( mbedtls_mpi_mont_ctx *ctx )
+{
+    if( ctx == NULL )
+        return;
+
+    ctx->mm = 0;
+    mbedtls_mpi_free( &ctx->RR );
+}
+
+/*
+ * Compute the Montgomery constants of N
+ */
+int mbedtls_mpi_mont_setup( mbedtls_mpi_mont_ctx *ctx, const mbedtls_mpi *N )
+{
+    int ret;
+
+    if( mbedtls_mpi_cmp_int( N, 0 ) <= 0 || ( N->p[0] & 1 ) == 0 )
+        return( MBEDTLS_ERR_MPI_BAD_INPUT_DATA );
+
+    MBEDTLS_MPI_CHK( mpi_mont_rr( &ctx->RR, N ) );
+    mpi_montg_init( &ctx->mm, N );
+
+cleanup:
+
+    return( ret );
+}
+
+/*
+ * Montgomery multiplication: X = A * B * R^-1 mod N
+ */
+int mbedtls_mpi_mont_mul( mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi *B,
+                          const mbedtls_mpi *N, const mbedtls_mpi_mont_ctx *ctx )
+{
+    int ret;
+    const mbedtls_mpi *C;
+    mbedtls_mpi T;
+
+    if( ctx->RR.p == NULL ||
+        mbedtls_mpi_cmp_int( A, 0 ) < 0 || mbedtls_mpi_cmp_mpi( A, N ) >= 0 ||
+        mbedtls_mpi_cmp_int( B, 0 ) < 0 || mbedtls_mpi_cmp_mpi( B, N ) >= 0 )
+        return( MBEDTLS_ERR_MPI_BAD_INPUT_DATA );
+
+    /* X takes the place of A, which must not be B */
+    if( X == B )
+    {
+        C = A; A = B; B = C;
+    }
+
+    mpi_init_tmp( &T, X );
+
+    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( &T, ( N->n + 1 ) * 2 +
+                                           mpi_kara_scratch( N->n ) ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( X, A ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( X, N->n + 1 ) );
+
+    if( A == B )
+        MBEDTLS_MPI_CHK( mpi_montsqr( X, N, ctx->mm, &T ) );
+    else
+        MBEDTLS_MPI_CHK( mpi_montmul( X, B, N, ctx->mm, &T ) );
+
+cleanup:
+
+    mbedtls_mpi_free( &T );
+
+    return( ret );
+}
+
+/*
+ * Sliding-window exponentiation with precomputed constants: X = A^E mod N
+ */
+int mbedtls_mpi_mont_exp( mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi *E,
+                          const mbedtls_mpi *N, const mbedtls_mpi_mont_ctx *ctx )
+{
+    if( ctx->RR.p == NULL ||
+        mbedtls_mpi_cmp_int( N, 0 ) < 0 || ( N->p[0] & 1 ) == 0 )
+        return( MBEDTLS_ERR_MPI_BAD_INPUT_DATA );
+
+    if( mbedtls_mpi_cmp_int( E, 0 ) < 0 )
+        return( MBEDTLS_ERR_MPI_BAD_INPUT_DATA );
+
+    return( mpi_exp_mod( X, A, E, N, ctx->mm, &ctx->RR ) );
+}
+
+/*
+ * Initialize a fixed-base comb
+ */
+void mbedtls_mpi_comb_init( mbedtls_mpi_comb *comb )
+{
+    if( comb == NULL )
+        return;
+
+    comb->w = 0;
+    comb->d = 0;
+    mbedtls_mpi_init( &comb->N );
+    mbedtls_mpi_init( &comb->G );
+    mbedtls_mpi_mont_init( &comb->mont );
+    comb->T = NULL;
+}
+
+/*
+ * Unallocate a fixed-base comb
+ */
+void mbedtls_mpi_comb_free( mbedtls_mpi_comb *comb )
+{
+    size_t i;
+
+    if( comb == NULL )
+        return;
+
+    if( comb->T != NULL )
+    {
+        for( i = 0; i < ( (size_t) 1 << comb->w ); i++ )
+            mbedtls_mpi_free( &comb->T[i] );
+
+        mbedtls_free( comb->T );
+    }
+
+    mbedtls_mpi_mont_free( &comb->mont );
+    mbedtls_mpi_free( &comb->G );
+    mbedtls_mpi_free( &comb->N );
+
+    mbedtls_mpi_comb_init( comb );
+}
+
+/*
+ * Precompute the comb table of G mod N (Lim-Lee, HAC 14.117 with h = 2):
+ * T[2^j] = G^(2^(j*d)) * R mod N, and every other entry T[i] is the
+ * product of the T[2^j] for the bits j set in i, T[0] = R mod N
+ */
+int mbedtls_mpi_comb_setup( mbedtls_mpi_comb *comb, const mbedtls_mpi *G,
+                            const mbedtls_mpi *N, size_t ebits )
+{
+    int ret;
+    size_t i, j, top, n, count;
+    mbedtls_mpi T;
+
+    if( mbedtls_mpi_cmp_int( N, 0 ) <= 0 || ( N->p[0] & 1 ) == 0 ||
+        ebits == 0 )
+        return( MBEDTLS_ERR_MPI_BAD_INPUT_DATA );
+
+    mbedtls_mpi_comb_free( comb );
+    mbedtls_mpi_init( &T );
+
+    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &comb->N, N ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi( &comb->G, G, N ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_mont_setup( &comb->mont, &comb->N ) );
+
+    n = comb->N.n;
+    count = (size_t) 1 << MBEDTLS_MPI_COMB_WIDTH;
+
+    comb->T = (mbedtls_mpi *) mbedtls_calloc( count, sizeof( mbedtls_mpi ) );
+    if( comb->T == NULL )
+    {
+        ret = MBEDTLS_ERR_MPI_ALLOC_FAILED;
+        goto cleanup;
+    }
+
+    comb->w = MBEDTLS_MPI_COMB_WIDTH;
+    comb->d = ( ebits + comb->w - 1 ) / comb->w;
+
+    for( i = 0; i < count; i++ )
+    {
+        mbedtls_mpi_init( &comb->T[i] );
+        MBEDTLS_MPI_CHK( mbedtls_mpi_grow( &comb->T[i], n + 1 ) );
+    }
+
+    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( &T, ( n + 1 ) * 2 + mpi_kara_scratch( n ) ) );
+
+    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &comb->T[0], &comb->mont.RR ) );
+    MBEDTLS_MPI_CHK( mpi_montred( &comb->T[0], &comb->N, comb->mont.mm, &T ) );
+
+    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &comb->T[1], &comb->G ) );
+    MBEDTLS_MPI_CHK( mpi_montmul( &comb->T[1], &comb->mont.RR, &comb->N,
+                                  comb->mont.mm, &T ) );
+
+    for( j = 1; j < comb->w; j++ )
+    {
+        MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &comb->T[(size_t) 1 << j],
+                                           &comb->T[(size_t) 1 << ( j - 1 )] ) );
+
+        for( i = 0; i < comb->d; i++ )
+            MBEDTLS_MPI_CHK( mpi_montsqr( &comb->T[(size_t) 1 << j], &comb->N,
+                                          comb->mont.mm, &T ) );
+    }
+
+    for( i = 3, top = 2; i < count; i++ )
+    {
+        if( ( i & ( i - 1 ) ) == 0 )
+        {
+            top = i;
+            continue;
+        }
+
+        MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &comb->T[i], &comb->T[i - top] ) );
+        MBEDTLS_MPI_CHK( mpi_montmul( &comb->T[i], &comb->T[top], &comb->N,
+                                      comb->mont.mm, &T ) );
+    }
+
+cleanup:
+
+    mbedtls_mpi_free( &T );
+
+    if( ret != 0 )
+        mbedtls_mpi_comb_free( comb );
+
+    return( ret );
+}
+
+/*
+ * Constant-time table lookup: S = T[idx], reading all entries
+ */
+static void mpi_comb_select( mbedtls_mpi *S, const mbedtls_mpi *T,
+                             size_t count, size_t idx, size_t n )
+{
+    size_t i, k, diff;
+    mbedtls_mpi_uint mask;
+
+    memset( S->p, 0, S->n * ciL );
+
+    for( i = 0; i < count; i++ )
+    {
+        /* all ones if i == idx, zero otherwise */
+        diff = i ^ idx;
+        mask = (mbedtls_mpi_uint) ( ( diff | ( 0 - diff ) ) >>
+                                    ( sizeof( size_t ) * 8 - 1 ) ) - 1;
+
+        for( k = 0; k < n; k++ )
+            S->p[k] |= T[i].p[k] & mask;
+    }
+}
+
+/*
+ * Fixed-base comb exponentiation: X = G^E mod N  (HAC 14.117 with h = 2)
+ */
+int mbedtls_mpi_comb_exp( mbedtls_mpi *X, const mbedtls_mpi *E,
+                          const mbedtls_mpi_comb *comb )
+{
+    int ret;
+    size_t i, j, n, idx;
+    mbedtls_mpi S, T, Ec;
+
+    if( comb->T == NULL || mbedtls_mpi_cmp_int( E, 0 ) < 0 ||
+        mbedtls_mpi_bitlen( E ) > comb->w * comb->d )
+        return( MBEDTLS_ERR_MPI_BAD_INPUT_DATA );
+
+    n = comb->N.n;
+
+    mpi_init_tmp( &S, X ); mpi_init_tmp( &T, X ); mpi_init_tmp( &Ec, X );
+
+    /* X is written before E has been read entirely */
+    if( X == E )
+    {
+        MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &Ec, E ) );
+        E = &Ec;
+    }
+
+    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( &S, n + 1 ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( &T, ( n + 1 ) * 2 + mpi_kara_scratch( n ) ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( X, &comb->T[0] ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( X, n + 1 ) );
+
+    /*
+     * Column i of the comb holds bits i, d + i, ..., (w - 1) * d + i of E
+     */
+    for( i = comb->d; i > 0; i-- )
+    {
+        MBEDTLS_MPI_CHK( mpi_montsqr( X, &comb->N, comb->mont.mm, &T ) );
+
+        idx = 0;
+        for( j = 0; j < comb->w; j++ )
+            idx |= (size_t) mbedtls_mpi_get_bit( E, j * comb->d + i - 1 ) << j;
+
+        mpi_comb_select( &S, comb->T, (size_t) 1 << comb->w, idx, n + 1 );
+        MBEDTLS_MPI_CHK( mpi_montmul( X, &S, &comb->N, comb->mont.mm, &T ) );
+    }
+
+    MBEDTLS_MPI_CHK( mpi_montred( X, &comb->N, comb->mont.mm, &T ) );
+
+cleanup:
+
+    mbedtls_mpi_free( &Ec ); mbedtls_mpi_free( &T ); mbedtls_mpi_free( &S );
+
+    return( ret );
+}
+
 /*
  * Greatest common divisor: G = gcd(A, B)  (HAC 14.54)
  */
@@ -1813,7 +2699,7 @@ int mbedtls_mpi_gcd( mbedtls_mpi *G, const mbedtls_mpi *A, const mbedtls_mpi *B
     size_t lz, lzt;
     mbedtls_mpi TG, TA, TB;
 
-    mbedtls_mpi_init( &TG ); mbedtls_mpi_init( &TA ); mbedtls_mpi_init( &TB );
+    mpi_init_tmp( &TG, G ); mpi_init_tmp( &TA, G ); mpi_init_tmp( &TB, G );
 
     MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &TA, A ) );
     MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &TB, B ) );
@@ -1891,9 +2777,9 @@ int mbedtls_mpi_inv_mod( mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi
     if( mbedtls_mpi_cmp_int( N, 0 ) <= 0 )
         return( MBEDTLS_ERR_MPI_BAD_INPUT_DATA );
 
-    mbedtls_mpi_init( &TA ); mbedtls_mpi_init( &TU ); mbedtls_mpi_init( &U1 ); mbedtls_mpi_init( &U2 );
-    mbedtls_mpi_init( &G ); mbedtls_mpi_init( &TB ); mbedtls_mpi_init( &TV );
-    mbedtls_mpi_init( &V1 ); mbedtls_mpi_init( &V2 );
+    mpi_init_tmp( &TA, X ); mpi_init_tmp( &TU, X ); mpi_init_tmp( &U1, X ); mpi_init_tmp( &U2, X );
+    mpi_init_tmp( &G, X ); mpi_init_tmp( &TB, X ); mpi_init_tmp( &TV, X );
+    mpi_init_tmp( &V1, X ); mpi_init_tmp( &V2, X );
 
     MBEDTLS_MPI_CHK( mbedtls_mpi_gcd( &G, A, N ) );
 
@@ -2152,6 +3038,7 @@ int mbedtls_mpi_is_prime( const mbedtls_mpi *X,
     XX.s = 1;
     XX.n = X->n;
     XX.p = X->p;
+    XX.arena = NULL;
 
     if( mbedtls_mpi_cmp_int( &XX, 0 ) == 0 ||
         mbedtls_mpi_cmp_int( &XX, 1 ) == 0 )
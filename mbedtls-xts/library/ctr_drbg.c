@@ -36,10 +36,22 @@
 
 #include <string.h>
 
+#if defined(MBEDTLS_AESNI_C)
+#include "mbedtls/aesni.h"
+#endif
+
 #if defined(MBEDTLS_FS_IO)
 #include <stdio.h>
 #endif
 
+#if defined(MBEDTLS_PLATFORM_C)
+#include "mbedtls/platform.h"
+#else
+#include <stdlib.h>
+#define mbedtls_calloc    calloc
+#define mbedtls_free       free
+#endif
+
 #if defined(MBEDTLS_SELF_TEST)
 #if defined(MBEDTLS_PLATFORM_C)
 #include "mbedtls/platform.h"
@@ -124,9 +136,35 @@ void mbedtls_ctr_drbg_free( mbedtls_ctr_drbg_context *ctx )
     mbedtls_zeroize( ctx, sizeof( mbedtls_ctr_drbg_context ) );
 }
 
+/*
+ * Drop whatever is left in the output buffer
+ */
+static void ctr_drbg_buffer_discard( mbedtls_ctr_drbg_context *ctx )
+{
+#if MBEDTLS_CTR_DRBG_BUFFER_SIZE > 0
+    mbedtls_zeroize( ctx->buf, ctx->buf_left );
+    ctx->buf_left = 0;
+#else
+    ((void) ctx);
+#endif
+}
+
 void mbedtls_ctr_drbg_set_prediction_resistance( mbedtls_ctr_drbg_context *ctx, int resistance )
 {
+#if defined(MBEDTLS_THREADING_C)
+    if( mbedtls_mutex_lock( &ctx->mutex ) != 0 )
+        return;
+#endif
+
+    /* Buffered bytes predate any future reseed */
+    if( resistance != MBEDTLS_CTR_DRBG_PR_OFF )
+        ctr_drbg_buffer_discard( ctx );
+
     ctx->prediction_resistance = resistance;
+
+#if defined(MBEDTLS_THREADING_C)
+    (void) mbedtls_mutex_unlock( &ctx->mutex );
+#endif
 }
 
 void mbedtls_ctr_drbg_set_entropy_len( mbedtls_ctr_drbg_context *ctx, size_t len )
@@ -229,6 +267,43 @@ static int block_cipher_df( unsigned char *output,
     return( 0 );
 }
 
+/*
+ * Increase the counter and encrypt it, nblocks times (at most 4)
+ */
+static void ctr_drbg_gen_blocks( mbedtls_ctr_drbg_context *ctx,
+                                 unsigned char *output, size_t nblocks )
+{
+    unsigned char ctr[4 * MBEDTLS_CTR_DRBG_BLOCKSIZE];
+    size_t k;
+    int i;
+
+    for( k = 0; k < nblocks; k++ )
+    {
+        for( i = MBEDTLS_CTR_DRBG_BLOCKSIZE; i > 0; i-- )
+            if( ++ctx->counter[i - 1] != 0 )
+                break;
+
+        memcpy( ctr + k * MBEDTLS_CTR_DRBG_BLOCKSIZE, ctx->counter,
+                MBEDTLS_CTR_DRBG_BLOCKSIZE );
+    }
+
+#if defined(MBEDTLS_AESNI_C) && defined(MBEDTLS_HAVE_X86_64) && \
+    !defined(MBEDTLS_AES_ALT)
+    if( nblocks == 4 && mbedtls_aesni_has_support( MBEDTLS_AESNI_AES ) )
+    {
+        mbedtls_aesni_crypt_ecb4( &ctx->aes_ctx, MBEDTLS_AES_ENCRYPT, ctr, output );
+        return;
+    }
+#endif
+
+    for( k = 0; k < nblocks; k++ )
+    {
+        mbedtls_aes_crypt_ecb( &ctx->aes_ctx, MBEDTLS_AES_ENCRYPT,
+                               ctr + k * MBEDTLS_CTR_DRBG_BLOCKSIZE,
+                               output + k * MBEDTLS_CTR_DRBG_BLOCKSIZE );
+    }
+}
+
 static int ctr_drbg_update_internal( mbedtls_ctr_drbg_context *ctx,
                               const unsigned char data[MBEDTLS_CTR_DRBG_SEEDLEN] )
 {
@@ -284,8 +359,8 @@ void mbedtls_ctr_drbg_update( mbedtls_ctr_drbg_context *ctx,
     }
 }
 
-int mbedtls_ctr_drbg_reseed( mbedtls_ctr_drbg_context *ctx,
-                     const unsigned char *additional, size_t len )
+static int ctr_drbg_reseed_internal( mbedtls_ctr_drbg_context *ctx,
+                                    const unsigned char *additional, size_t len )
 {
     unsigned char seed[MBEDTLS_CTR_DRBG_MAX_SEED_INPUT];
     size_t seedlen = 0;
@@ -329,6 +404,32 @@ int mbedtls_ctr_drbg_reseed( mbedtls_ctr_drbg_context *ctx,
     return( 0 );
 }
 
+int mbedtls_ctr_drbg_reseed( mbedtls_ctr_drbg_context *ctx,
+                     const unsigned char *additional, size_t len )
+{
+    int ret;
+
+#if defined(MBEDTLS_THREADING_C)
+    if( ( ret = mbedtls_mutex_lock( &ctx->mutex ) ) != 0 )
+        return( ret );
+#endif
+
+    /*
+     * An explicit reseed (e.g. after fork()) must not be followed by output
+     * generated from the previous state
+     */
+    ctr_drbg_buffer_discard( ctx );
+
+    ret = ctr_drbg_reseed_internal( ctx, additional, len );
+
+#if defined(MBEDTLS_THREADING_C)
+    if( mbedtls_mutex_unlock( &ctx->mutex ) != 0 )
+        return( MBEDTLS_ERR_THREADING_MUTEX_ERROR );
+#endif
+
+    return( ret );
+}
+
 int mbedtls_ctr_drbg_random_with_add( void *p_rng,
                               unsigned char *output, size_t output_len,
                               const unsigned char *additional, size_t add_len )
@@ -337,9 +438,8 @@ int mbedtls_ctr_drbg_random_with_add( void *p_rng,
     mbedtls_ctr_drbg_context *ctx = (mbedtls_ctr_drbg_context *) p_rng;
     unsigned char add_input[MBEDTLS_CTR_DRBG_SEEDLEN];
     unsigned char *p = output;
-    unsigned char tmp[MBEDTLS_CTR_DRBG_BLOCKSIZE];
-    int i;
-    size_t use_len;
+    unsigned char tmp[4 * MBEDTLS_CTR_DRBG_BLOCKSIZE];
+    size_t nblocks, use_len;
 
     if( output_len > MBEDTLS_CTR_DRBG_MAX_REQUEST )
         return( MBEDTLS_ERR_CTR_DRBG_REQUEST_TOO_BIG );
@@ -352,7 +452,7 @@ int mbedtls_ctr_drbg_random_with_add( void *p_rng,
     if( ctx->reseed_counter > ctx->reseed_interval ||
         ctx->prediction_resistance )
     {
-        if( ( ret = mbedtls_ctr_drbg_reseed( ctx, additional, add_len ) ) != 0 )
+        if( ( ret = ctr_drbg_reseed_internal( ctx, additional, add_len ) ) != 0 )
             return( ret );
 
         add_len = 0;
@@ -367,27 +467,26 @@ int mbedtls_ctr_drbg_random_with_add( void *p_rng,
     while( output_len > 0 )
     {
         /*
-         * Increase counter
+         * Crypt up to four counter blocks at once
          */
-        for( i = MBEDTLS_CTR_DRBG_BLOCKSIZE; i > 0; i-- )
-            if( ++ctx->counter[i - 1] != 0 )
-                break;
+        nblocks = ( output_len + MBEDTLS_CTR_DRBG_BLOCKSIZE - 1 ) /
+                  MBEDTLS_CTR_DRBG_BLOCKSIZE;
+        if( nblocks > 4 )
+            nblocks = 4;
 
-        /*
-         * Crypt counter block
-         */
-        mbedtls_aes_crypt_ecb( &ctx->aes_ctx, MBEDTLS_AES_ENCRYPT, ctx->counter, tmp );
+        ctr_drbg_gen_blocks( ctx, tmp, nblocks );
 
-        use_len = ( output_len > MBEDTLS_CTR_DRBG_BLOCKSIZE ) ? MBEDTLS_CTR_DRBG_BLOCKSIZE :
-                                                       output_len;
+        use_len = ( output_len > sizeof( tmp ) ) ? sizeof( tmp ) : output_len;
         /*
-         * Copy random block to destination
+         * Copy random blocks to destination
          */
         memcpy( p, tmp, use_len );
         p += use_len;
         output_len -= use_len;
     }
 
+    mbedtls_zeroize( tmp, sizeof( tmp ) );
+
     ctr_drbg_update_internal( ctx, add_input );
 
     ctx->reseed_counter++;
@@ -415,6 +514,321 @@ int mbedtls_ctr_drbg_random( void *p_rng, unsigned char *output, size_t output_l
     return( ret );
 }
 
+#if MBEDTLS_CTR_DRBG_BUFFER_SIZE > 0
+/*
+ * Fill the consumed part of the output buffer with one generate call.
+ * Unread bytes live at the start of the buffer and are consumed from their
+ * end, so the free space is always contiguous.
+ */
+static int ctr_drbg_buffer_fill( mbedtls_ctr_drbg_context *ctx )
+{
+    int ret;
+
+    if( ctx->buf_left == MBEDTLS_CTR_DRBG_BUFFER_SIZE )
+        return( 0 );
+
+    ret = mbedtls_ctr_drbg_random_with_add( ctx, ctx->buf + ctx->buf_left,
+                            MBEDTLS_CTR_DRBG_BUFFER_SIZE - ctx->buf_left, NULL, 0 );
+    if( ret != 0 )
+        return( ret );
+
+    ctx->buf_left = MBEDTLS_CTR_DRBG_BUFFER_SIZE;
+
+    return( 0 );
+}
+
+/*
+ * Serve a request from the output buffer; the caller holds ctx->mutex or
+ * owns the context
+ */
+static int ctr_drbg_buffer_read( mbedtls_ctr_drbg_context *ctx,
+                                 unsigned char *output, size_t output_len )
+{
+    int ret;
+    size_t use_len;
+
+    if( ctx->prediction_resistance || output_len > MBEDTLS_CTR_DRBG_BUFFER_SIZE )
+        return( mbedtls_ctr_drbg_random_with_add( ctx, output, output_len,
+                                                  NULL, 0 ) );
+
+    while( output_len > 0 )
+    {
+        if( ctx->buf_left == 0 &&
+            ( ret = ctr_drbg_buffer_fill( ctx ) ) != 0 )
+            return( ret );
+
+        use_len = ( output_len > ctx->buf_left ) ? ctx->buf_left : output_len;
+        ctx->buf_left -= use_len;
+
+        memcpy( output, ctx->buf + ctx->buf_left, use_len );
+        mbedtls_zeroize( ctx->buf + ctx->buf_left, use_len );
+
+        output += use_len;
+        output_len -= use_len;
+    }
+
+    return( 0 );
+}
+#endif /* MBEDTLS_CTR_DRBG_BUFFER_SIZE > 0 */
+
+int mbedtls_ctr_drbg_random_buffered( void *p_rng, unsigned char *output, size_t output_len )
+{
+#if MBEDTLS_CTR_DRBG_BUFFER_SIZE > 0
+    int ret = 0;
+    mbedtls_ctr_drbg_context *ctx = (mbedtls_ctr_drbg_context *) p_rng;
+
+    if( output_len > MBEDTLS_CTR_DRBG_MAX_REQUEST )
+        return( MBEDTLS_ERR_CTR_DRBG_REQUEST_TOO_BIG );
+
+#if defined(MBEDTLS_THREADING_C)
+    if( ( ret = mbedtls_mutex_lock( &ctx->mutex ) ) != 0 )
+        return( ret );
+#endif
+
+    ret = ctr_drbg_buffer_read( ctx, output, output_len );
+
+#if defined(MBEDTLS_THREADING_C)
+    if( mbedtls_mutex_unlock( &ctx->mutex ) != 0 )
+        return( MBEDTLS_ERR_THREADING_MUTEX_ERROR );
+#endif
+
+    return( ret );
+#else
+    return( mbedtls_ctr_drbg_random( p_rng, output, output_len ) );
+#endif /* MBEDTLS_CTR_DRBG_BUFFER_SIZE > 0 */
+}
+
+int mbedtls_ctr_drbg_buffer_refill( mbedtls_ctr_drbg_context *ctx )
+{
+#if MBEDTLS_CTR_DRBG_BUFFER_SIZE > 0
+    int ret = 0;
+
+#if defined(MBEDTLS_THREADING_C)
+    if( ( ret = mbedtls_mutex_lock( &ctx->mutex ) ) != 0 )
+        return( ret );
+#endif
+
+    if( !ctx->prediction_resistance )
+        ret = ctr_drbg_buffer_fill( ctx );
+
+#if defined(MBEDTLS_THREADING_C)
+    if( mbedtls_mutex_unlock( &ctx->mutex ) != 0 )
+        return( MBEDTLS_ERR_THREADING_MUTEX_ERROR );
+#endif
+
+    return( ret );
+#else
+    ((void) ctx);
+    return( 0 );
+#endif /* MBEDTLS_CTR_DRBG_BUFFER_SIZE > 0 */
+}
+
+/*
+ * CTR_DRBG pool initialization
+ */
+void mbedtls_ctr_drbg_pool_init( mbedtls_ctr_drbg_pool *pool )
+{
+    memset( pool, 0, sizeof( mbedtls_ctr_drbg_pool ) );
+
+#if defined(MBEDTLS_THREADING_C)
+    mbedtls_mutex_init( &pool->mutex );
+#endif
+}
+
+#if defined(MBEDTLS_THREADING_PTHREAD)
+/*
+ * Thread exit handler: give the shard back so that short-lived threads (one
+ * per connection) do not exhaust the pool.
+ */
+static void ctr_drbg_pool_release( void *data )
+{
+    mbedtls_ctr_drbg_context *ctx = (mbedtls_ctr_drbg_context *) data;
+    mbedtls_ctr_drbg_pool *pool = (mbedtls_ctr_drbg_pool *) ctx->p_pool;
+
+    if( mbedtls_mutex_lock( &pool->mutex ) != 0 )
+        return;
+
+    pool->in_use[ctx - pool->shards] = 0;
+
+    mbedtls_mutex_unlock( &pool->mutex );
+}
+
+/*
+ * Bind the calling thread to a free shard, or to the shared fallback
+ */
+static int ctr_drbg_pool_claim( mbedtls_ctr_drbg_pool *pool,
+                                mbedtls_ctr_drbg_context **ctx )
+{
+    int ret;
+    size_t i;
+
+    if( ( ret = mbedtls_mutex_lock( &pool->mutex ) ) != 0 )
+        return( ret );
+
+    *ctx = &pool->shards[0];
+
+    for( i = 1; i < pool->shard_count; i++ )
+    {
+        if( pool->in_use[i] == 0 )
+        {
+            pool->in_use[i] = 1;
+            *ctx = &pool->shards[i];
+            break;
+        }
+    }
+
+    if( mbedtls_mutex_unlock( &pool->mutex ) != 0 )
+        return( MBEDTLS_ERR_THREADING_MUTEX_ERROR );
+
+    if( *ctx != &pool->shards[0] &&
+        pthread_setspecific( pool->key, *ctx ) != 0 )
+    {
+        ctr_drbg_pool_release( *ctx );
+        *ctx = &pool->shards[0];
+    }
+
+    return( 0 );
+}
+#endif /* MBEDTLS_THREADING_PTHREAD */
+
+int mbedtls_ctr_drbg_pool_seed( mbedtls_ctr_drbg_pool *pool,
+                        size_t threads,
+                        int (*f_entropy)(void *, unsigned char *, size_t),
+                        void *p_entropy,
+                        const unsigned char *custom,
+                        size_t len )
+{
+    int ret;
+    size_t i;
+    unsigned char pers[MBEDTLS_CTR_DRBG_MAX_SEED_INPUT];
+
+    /* Threads may hold pointers to the current instances */
+    if( pool->shards != NULL )
+        return( MBEDTLS_ERR_CTR_DRBG_BAD_INPUT_DATA );
+
+    if( len + 4 > MBEDTLS_CTR_DRBG_MAX_SEED_INPUT - MBEDTLS_CTR_DRBG_ENTROPY_LEN )
+        return( MBEDTLS_ERR_CTR_DRBG_INPUT_TOO_BIG );
+
+    pool->shard_count = threads + 1;
+
+    pool->shards = mbedtls_calloc( pool->shard_count,
+                                   sizeof( mbedtls_ctr_drbg_context ) );
+    pool->in_use = mbedtls_calloc( pool->shard_count, 1 );
+
+    if( pool->shards == NULL || pool->in_use == NULL )
+    {
+        mbedtls_free( pool->shards );
+        mbedtls_free( pool->in_use );
+        pool->shards = NULL;
+        pool->in_use = NULL;
+        pool->shard_count = 0;
+        return( MBEDTLS_ERR_CTR_DRBG_ALLOC_FAILED );
+    }
+
+    if( custom != NULL && len > 0 )
+        memcpy( pers, custom, len );
+
+    for( i = 0; i < pool->shard_count; i++ )
+        mbedtls_ctr_drbg_init( &pool->shards[i] );
+
+    /*
+     * Personalization = custom || 32-bit shard index
+     */
+    for( i = 0; i < pool->shard_count; i++ )
+    {
+        pers[len    ] = (unsigned char)( i >> 24 );
+        pers[len + 1] = (unsigned char)( i >> 16 );
+        pers[len + 2] = (unsigned char)( i >>  8 );
+        pers[len + 3] = (unsigned char)( i       );
+
+        if( ( ret = mbedtls_ctr_drbg_seed( &pool->shards[i], f_entropy, p_entropy,
+                                           pers, len + 4 ) ) != 0 )
+        {
+            goto cleanup;
+        }
+
+        pool->shards[i].p_pool = pool;
+    }
+
+#if defined(MBEDTLS_THREADING_PTHREAD)
+    if( pthread_key_create( &pool->key, ctr_drbg_pool_release ) != 0 )
+    {
+        ret = MBEDTLS_ERR_THREADING_MUTEX_ERROR;
+        goto cleanup;
+    }
+    pool->key_valid = 1;
+#endif
+
+    ret = 0;
+
+cleanup:
+    mbedtls_zeroize( pers, sizeof( pers ) );
+
+    return( ret );
+}
+
+int mbedtls_ctr_drbg_pool_random( void *p_rng,
+                          unsigned char *output, size_t output_len )
+{
+    mbedtls_ctr_drbg_pool *pool = (mbedtls_ctr_drbg_pool *) p_rng;
+#if defined(MBEDTLS_THREADING_PTHREAD)
+    int ret;
+    mbedtls_ctr_drbg_context *ctx;
+
+    ctx = (mbedtls_ctr_drbg_context *) pthread_getspecific( pool->key );
+
+    if( ctx == NULL &&
+        ( ret = ctr_drbg_pool_claim( pool, &ctx ) ) != 0 )
+    {
+        return( ret );
+    }
+
+    /* This shard belongs to the calling thread alone: no lock needed */
+    if( ctx != &pool->shards[0] )
+    {
+        if( output_len > MBEDTLS_CTR_DRBG_MAX_REQUEST )
+            return( MBEDTLS_ERR_CTR_DRBG_REQUEST_TOO_BIG );
+
+#if MBEDTLS_CTR_DRBG_BUFFER_SIZE > 0
+        return( ctr_drbg_buffer_read( ctx, output, output_len ) );
+#else
+        return( mbedtls_ctr_drbg_random_with_add( ctx, output, output_len,
+                                                  NULL, 0 ) );
+#endif
+    }
+#endif /* MBEDTLS_THREADING_PTHREAD */
+
+    return( mbedtls_ctr_drbg_random_buffered( &pool->shards[0], output,
+                                              output_len ) );
+}
+
+void mbedtls_ctr_drbg_pool_free( mbedtls_ctr_drbg_pool *pool )
+{
+    size_t i;
+
+    if( pool == NULL )
+        return;
+
+#if defined(MBEDTLS_THREADING_PTHREAD)
+    if( pool->key_valid )
+        (void) pthread_key_delete( pool->key );
+#endif
+#if defined(MBEDTLS_THREADING_C)
+    mbedtls_mutex_free( &pool->mutex );
+#endif
+
+    if( pool->shards != NULL )
+    {
+        for( i = 0; i < pool->shard_count; i++ )
+            mbedtls_ctr_drbg_free( &pool->shards[i] );
+
+        mbedtls_free( pool->shards );
+    }
+
+    mbedtls_free( pool->in_use );
+    mbedtls_zeroize( pool, sizeof( mbedtls_ctr_drbg_pool ) );
+}
+
 #if defined(MBEDTLS_FS_IO)
 int mbedtls_ctr_drbg_write_seed_file( mbedtls_ctr_drbg_context *ctx, const char *path )
 {
@@ -25,6 +25,9 @@
  *  [1] Handbook of Applied Cryptography - 1997, Chapter 12
  *      Menezes, van Oorschot and Vanstone
  *
+ *  [2] Handbook of Applied Cryptography - 1997, Chapter 14.6.3
+ *      Fixed-base comb method for exponentiation (G^X)
+ *
  */
 
 #if !defined(MBEDTLS_CONFIG_FILE)
@@ -47,6 +50,10 @@
 #include "mbedtls/asn1.h"
 #endif
 
+#if defined(MBEDTLS_DHM_COMB_CACHE) && defined(MBEDTLS_THREADING_C)
+#include "mbedtls/threading.h"
+#endif
+
 #if defined(MBEDTLS_PLATFORM_C)
 #include "mbedtls/platform.h"
 #else
@@ -145,6 +152,113 @@ int mbedtls_dhm_read_params( mbedtls_dhm_context *ctx,
     return( 0 );
 }
 
+#if defined(MBEDTLS_DHM_COMB_CACHE)
+/*
+ * Process-wide comb tables for the first (G, P) pairs seen. Entries are
+ * built once, then only read until mbedtls_dhm_comb_cache_free().
+ */
+#define DHM_COMB_CACHE_SIZE     4
+
+static mbedtls_mpi_comb dhm_comb_cache[DHM_COMB_CACHE_SIZE];
+static size_t dhm_comb_cache_len;
+
+/*
+ * Make ctx->comb point to the cached comb table for G mod P, computing it
+ * on first use. Leaves ctx->comb NULL if G is out of range or the cache is
+ * full of other parameters.
+ */
+static int dhm_comb_cache_get( mbedtls_dhm_context *ctx )
+{
+    int ret = 0;
+    size_t i;
+
+    if( ctx->comb != NULL &&
+        mbedtls_mpi_cmp_mpi( &ctx->comb->N, &ctx->P ) == 0 &&
+        mbedtls_mpi_cmp_mpi( &ctx->comb->G, &ctx->G ) == 0 )
+        return( 0 );
+
+    ctx->comb = NULL;
+
+    if( dhm_check_range( &ctx->G, &ctx->P ) != 0 )
+        return( 0 );
+
+#if defined(MBEDTLS_THREADING_C)
+    if( ( ret = mbedtls_mutex_lock( &mbedtls_threading_dhm_mutex ) ) != 0 )
+        return( ret );
+#endif
+
+    for( i = 0; i < dhm_comb_cache_len; i++ )
+    {
+        if( mbedtls_mpi_cmp_mpi( &dhm_comb_cache[i].N, &ctx->P ) == 0 &&
+            mbedtls_mpi_cmp_mpi( &dhm_comb_cache[i].G, &ctx->G ) == 0 )
+        {
+            ctx->comb = &dhm_comb_cache[i];
+            goto cleanup;
+        }
+    }
+
+    if( dhm_comb_cache_len < DHM_COMB_CACHE_SIZE )
+    {
+        mbedtls_mpi_comb_init( &dhm_comb_cache[i] );
+        if( ( ret = mbedtls_mpi_comb_setup( &dhm_comb_cache[i], &ctx->G, &ctx->P,
+                                            mbedtls_mpi_bitlen( &ctx->P ) ) ) != 0 )
+            goto cleanup;
+
+        ctx->comb = &dhm_comb_cache[i];
+        dhm_comb_cache_len++;
+    }
+
+cleanup:
+#if defined(MBEDTLS_THREADING_C)
+    if( mbedtls_mutex_unlock( &mbedtls_threading_dhm_mutex ) != 0 )
+        return( MBEDTLS_ERR_THREADING_MUTEX_ERROR );
+#endif
+
+    return( ret );
+}
+
+/*
+ * Free the cached comb tables
+ */
+void mbedtls_dhm_comb_cache_free( void )
+{
+    size_t i;
+
+#if defined(MBEDTLS_THREADING_C)
+    if( mbedtls_mutex_lock( &mbedtls_threading_dhm_mutex ) != 0 )
+        return;
+#endif
+
+    for( i = 0; i < dhm_comb_cache_len; i++ )
+        mbedtls_mpi_comb_free( &dhm_comb_cache[i] );
+
+    dhm_comb_cache_len = 0;
+
+#if defined(MBEDTLS_THREADING_C)
+    mbedtls_mutex_unlock( &mbedtls_threading_dhm_mutex );
+#endif
+}
+#endif /* MBEDTLS_DHM_COMB_CACHE */
+
+/*
+ * GX = G^X mod P, with the cached comb table of G when available [2]
+ */
+static int dhm_make_gx( mbedtls_dhm_context *ctx )
+{
+#if defined(MBEDTLS_DHM_COMB_CACHE)
+    int ret;
+
+    if( ( ret = dhm_comb_cache_get( ctx ) ) != 0 )
+        return( ret );
+
+    if( ctx->comb != NULL )
+        return( mbedtls_mpi_comb_exp( &ctx->GX, &ctx->X, ctx->comb ) );
+#endif
+
+    return( mbedtls_mpi_exp_mod( &ctx->GX, &ctx->G, &ctx->X,
+                                 &ctx->P , &ctx->RP ) );
+}
+
 /*
  * Setup and write the ServerKeyExchange parameters
  */
@@ -178,8 +292,7 @@ int mbedtls_dhm_make_params( mbedtls_dhm_context *ctx, int x_size,
     /*
      * Calculate GX = G^X mod P
      */
-    MBEDTLS_MPI_CHK( mbedtls_mpi_exp_mod( &ctx->GX, &ctx->G, &ctx->X,
-                          &ctx->P , &ctx->RP ) );
+    MBEDTLS_MPI_CHK( dhm_make_gx( ctx ) );
 
     if( ( ret = dhm_check_range( &ctx->GX, &ctx->P ) ) != 0 )
         return( ret );
@@ -261,8 +374,7 @@ int mbedtls_dhm_make_public( mbedtls_dhm_context *ctx, int x_size,
     }
     while( dhm_check_range( &ctx->X, &ctx->P ) != 0 );
 
-    MBEDTLS_MPI_CHK( mbedtls_mpi_exp_mod( &ctx->GX, &ctx->G, &ctx->X,
-                          &ctx->P , &ctx->RP ) );
+    MBEDTLS_MPI_CHK( dhm_make_gx( ctx ) );
 
     if( ( ret = dhm_check_range( &ctx->GX, &ctx->P ) ) != 0 )
         return( ret );
@@ -42,6 +42,18 @@
 #include "mbedtls/hmac_drbg.h"
 #endif
 
+#if defined(MBEDTLS_THREADING_PTHREAD)
+#include "mbedtls/threading.h"
+#endif
+
+#if defined(MBEDTLS_PLATFORM_C)
+#include "mbedtls/platform.h"
+#else
+#include <stdlib.h>
+#define mbedtls_calloc    calloc
+#define mbedtls_free       free
+#endif
+
 /*
  * Derive a suitable integer for group grp from a buffer of length len
  * SEC1 4.1.3 step 5 aka SEC1 4.1.4 step 3
@@ -352,54 +364,307 @@ int mbedtls_ecdsa_write_signature_det( mbedtls_ecdsa_context *ctx,
 #endif
 
 /*
- * Read and check signature
+ * Parse a signature from ASN.1, reporting in trailing whether sig has
+ * bytes left after it
  */
-int mbedtls_ecdsa_read_signature( mbedtls_ecdsa_context *ctx,
-                          const unsigned char *hash, size_t hlen,
-                          const unsigned char *sig, size_t slen )
+static int ecdsa_signature_from_asn1( const unsigned char *sig, size_t slen,
+                                      mbedtls_mpi *r, mbedtls_mpi *s,
+                                      int *trailing )
 {
     int ret;
     unsigned char *p = (unsigned char *) sig;
     const unsigned char *end = sig + slen;
     size_t len;
+
+    if( ( ret = mbedtls_asn1_get_tag( &p, end, &len,
+                    MBEDTLS_ASN1_CONSTRUCTED | MBEDTLS_ASN1_SEQUENCE ) ) != 0 )
+        return( ret + MBEDTLS_ERR_ECP_BAD_INPUT_DATA );
+
+    if( p + len != end )
+        return( MBEDTLS_ERR_ECP_BAD_INPUT_DATA +
+                MBEDTLS_ERR_ASN1_LENGTH_MISMATCH );
+
+    if( ( ret = mbedtls_asn1_get_mpi( &p, end, r ) ) != 0 ||
+        ( ret = mbedtls_asn1_get_mpi( &p, end, s ) ) != 0 )
+        return( ret + MBEDTLS_ERR_ECP_BAD_INPUT_DATA );
+
+    *trailing = ( p != end );
+
+    return( 0 );
+}
+
+/*
+ * Read and check signature
+ */
+int mbedtls_ecdsa_read_signature( mbedtls_ecdsa_context *ctx,
+                          const unsigned char *hash, size_t hlen,
+                          const unsigned char *sig, size_t slen )
+{
+    int ret, trailing;
     mbedtls_mpi r, s;
 
     mbedtls_mpi_init( &r );
     mbedtls_mpi_init( &s );
 
-    if( ( ret = mbedtls_asn1_get_tag( &p, end, &len,
-                    MBEDTLS_ASN1_CONSTRUCTED | MBEDTLS_ASN1_SEQUENCE ) ) != 0 )
-    {
-        ret += MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
+    if( ( ret = ecdsa_signature_from_asn1( sig, slen, &r, &s,
+                                           &trailing ) ) != 0 )
         goto cleanup;
+
+    if( ( ret = mbedtls_ecdsa_verify( &ctx->grp, hash, hlen,
+                              &ctx->Q, &r, &s ) ) != 0 )
+        goto cleanup;
+
+    if( trailing )
+        ret = MBEDTLS_ERR_ECP_SIG_LEN_MISMATCH;
+
+cleanup:
+    mbedtls_mpi_free( &r );
+    mbedtls_mpi_free( &s );
+
+    return( ret );
+}
+
+/*
+ * Batch items still to be verified: parsed and in range, possibly with
+ * trailing bytes (reported if the signature turns out to be valid)
+ */
+#define ECDSA_BATCH_PENDING( ret )                                  \
+    ( (ret) == 0 || (ret) == MBEDTLS_ERR_ECP_SIG_LEN_MISMATCH )
+
+/*
+ * One call of mbedtls_ecdsa_read_signature_batch(), shared by all work
+ * items: r[i] and s[i] hold the signature of item i, and s[i] is replaced
+ * by its inverse mod N before the verifications start
+ */
+typedef struct
+{
+    mbedtls_ecp_group *grp;
+    mbedtls_ecdsa_verify_item *items;
+    mbedtls_mpi *r;
+    mbedtls_mpi *s;
+}
+ecdsa_batch_job;
+
+/*
+ * Replace s[i] by its inverse mod N for all pending items with a single
+ * inversion (Montgomery's trick): with c[i] the product of the previous
+ * s[j], 1 / s[i] = c[i] / ( c[i] * s[i] ), and the inverse of the full
+ * product yields each inverse of a partial one in turn, going backwards.
+ */
+static int ecdsa_batch_inv( const mbedtls_ecp_group *grp,
+                            const mbedtls_ecdsa_verify_item *items,
+                            mbedtls_mpi *s, mbedtls_mpi *c, size_t count )
+{
+    int ret;
+    size_t i;
+    mbedtls_mpi acc, t;
+
+    mbedtls_mpi_init( &acc ); mbedtls_mpi_init( &t );
+
+    MBEDTLS_MPI_CHK( mbedtls_mpi_lset( &acc, 1 ) );
+
+    for( i = 0; i < count; i++ )
+    {
+        if( ! ECDSA_BATCH_PENDING( items[i].ret ) )
+            continue;
+
+        MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &c[i], &acc ) );
+        MBEDTLS_MPI_CHK( mbedtls_mpi_mul_mpi( &acc, &acc, &s[i] ) );
+        MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi( &acc, &acc, &grp->N ) );
     }
 
-    if( p + len != end )
+    /* Nonzero since N is prime and all s[i] are in range 1..n-1 */
+    MBEDTLS_MPI_CHK( mbedtls_mpi_inv_mod( &acc, &acc, &grp->N ) );
+
+    for( i = count; i-- > 0; )
+    {
+        if( ! ECDSA_BATCH_PENDING( items[i].ret ) )
+            continue;
+
+        /* acc = 1 / ( c[i] * s[i] ) on entry, 1 / c[i] on exit */
+        MBEDTLS_MPI_CHK( mbedtls_mpi_mul_mpi( &t, &acc, &s[i] ) );
+        MBEDTLS_MPI_CHK( mbedtls_mpi_mul_mpi( &s[i], &acc, &c[i] ) );
+        MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi( &s[i], &s[i], &grp->N ) );
+        MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi( &acc, &t, &grp->N ) );
+    }
+
+cleanup:
+    mbedtls_mpi_free( &acc ); mbedtls_mpi_free( &t );
+
+    return( ret );
+}
+
+/*
+ * Steps 3 to 8 of mbedtls_ecdsa_verify() for one item, given 1 / s
+ */
+static int ecdsa_batch_verify( void *p_job, size_t index )
+{
+    int ret;
+    ecdsa_batch_job *job = (ecdsa_batch_job *) p_job;
+    mbedtls_ecdsa_verify_item *item = &job->items[index];
+    mbedtls_ecp_group *grp = job->grp;
+    const mbedtls_mpi *r = &job->r[index], *s_inv = &job->s[index];
+    mbedtls_mpi e, u1, u2;
+    mbedtls_ecp_point R;
+
+    if( ! ECDSA_BATCH_PENDING( item->ret ) )
+        return( 0 );
+
+    mbedtls_ecp_point_init( &R );
+    mbedtls_mpi_init( &e ); mbedtls_mpi_init( &u1 ); mbedtls_mpi_init( &u2 );
+
+    /*
+     * Make sure Q is valid: mbedtls_ecp_muladd() doesn't when u2 is 1,
+     * which r == s gives
+     */
+    MBEDTLS_MPI_CHK( mbedtls_ecp_check_pubkey( grp, item->Q ) );
+
+    MBEDTLS_MPI_CHK( derive_mpi( grp, &e, item->hash, item->hlen ) );
+
+    MBEDTLS_MPI_CHK( mbedtls_mpi_mul_mpi( &u1, &e, s_inv ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi( &u1, &u1, &grp->N ) );
+
+    MBEDTLS_MPI_CHK( mbedtls_mpi_mul_mpi( &u2, r, s_inv ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi( &u2, &u2, &grp->N ) );
+
+    MBEDTLS_MPI_CHK( mbedtls_ecp_muladd( grp, &R, &u1, &grp->G, &u2, item->Q ) );
+
+    if( mbedtls_ecp_is_zero( &R ) )
     {
-        ret = MBEDTLS_ERR_ECP_BAD_INPUT_DATA +
-              MBEDTLS_ERR_ASN1_LENGTH_MISMATCH;
+        ret = MBEDTLS_ERR_ECP_VERIFY_FAILED;
         goto cleanup;
     }
 
-    if( ( ret = mbedtls_asn1_get_mpi( &p, end, &r ) ) != 0 ||
-        ( ret = mbedtls_asn1_get_mpi( &p, end, &s ) ) != 0 )
+    MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi( &R.X, &R.X, &grp->N ) );
+
+    if( mbedtls_mpi_cmp_mpi( &R.X, r ) != 0 )
+        ret = MBEDTLS_ERR_ECP_VERIFY_FAILED;
+
+cleanup:
+    /* Keep a pending MBEDTLS_ERR_ECP_SIG_LEN_MISMATCH if valid */
+    if( ret != 0 )
+        item->ret = ret;
+
+    mbedtls_ecp_point_free( &R );
+    mbedtls_mpi_free( &e ); mbedtls_mpi_free( &u1 ); mbedtls_mpi_free( &u2 );
+
+    return( 0 );
+}
+
+/*
+ * Read and check a batch of signatures
+ */
+int mbedtls_ecdsa_read_signature_batch( mbedtls_ecp_group *grp,
+                          mbedtls_ecdsa_verify_item *items, size_t count,
+                          struct mbedtls_threading_pool *pool )
+{
+    int ret = 0, trailing;
+    size_t i;
+    ecdsa_batch_job job;
+    mbedtls_mpi *mpi = NULL, *c;
+
+    if( count == 0 )
+        return( 0 );
+
+    /* Fail cleanly on curves such as Curve25519 that can't be used for ECDSA */
+    if( grp->N.p == NULL )
     {
-        ret += MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
+        ret = MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
         goto cleanup;
     }
 
-    if( ( ret = mbedtls_ecdsa_verify( &ctx->grp, hash, hlen,
-                              &ctx->Q, &r, &s ) ) != 0 )
+    /* r, s and the partial products of the batch inversion */
+    if( ( mpi = mbedtls_calloc( 3 * count, sizeof( mbedtls_mpi ) ) ) == NULL )
+    {
+        ret = MBEDTLS_ERR_ECP_ALLOC_FAILED;
         goto cleanup;
+    }
 
-    if( p != end )
-        ret = MBEDTLS_ERR_ECP_SIG_LEN_MISMATCH;
+    for( i = 0; i < 3 * count; i++ )
+        mbedtls_mpi_init( &mpi[i] );
+
+    job.grp = grp;
+    job.items = items;
+    job.r = mpi;
+    job.s = mpi + count;
+    c = mpi + 2 * count;
+
+    /*
+     * Parse all signatures and make sure r and s are in range 1..n-1
+     */
+    for( i = 0; i < count; i++ )
+    {
+        items[i].ret = ecdsa_signature_from_asn1( items[i].sig, items[i].slen,
+                                                  &job.r[i], &job.s[i],
+                                                  &trailing );
+        if( items[i].ret != 0 )
+            continue;
+
+        if( mbedtls_mpi_cmp_int( &job.r[i], 1 ) < 0 ||
+            mbedtls_mpi_cmp_mpi( &job.r[i], &grp->N ) >= 0 ||
+            mbedtls_mpi_cmp_int( &job.s[i], 1 ) < 0 ||
+            mbedtls_mpi_cmp_mpi( &job.s[i], &grp->N ) >= 0 )
+        {
+            items[i].ret = MBEDTLS_ERR_ECP_VERIFY_FAILED;
+        }
+        else if( trailing )
+            items[i].ret = MBEDTLS_ERR_ECP_SIG_LEN_MISMATCH;
+    }
+
+    MBEDTLS_MPI_CHK( ecdsa_batch_inv( grp, items, job.s, c, count ) );
+
+#if defined(MBEDTLS_THREADING_PTHREAD)
+    /*
+     * mbedtls_ecp_muladd() only reads grp, except when a multiplier is 1
+     * and the other term goes through mbedtls_ecp_mul(), which may store
+     * the generator comb table in grp: build it before sharing grp.
+     */
+    if( pool != NULL && grp->T == NULL )
+    {
+        mbedtls_ecp_point R;
+        mbedtls_mpi one;
+
+        mbedtls_ecp_point_init( &R );
+        mbedtls_mpi_init( &one );
+        ret = mbedtls_mpi_lset( &one, 1 );
+        if( ret == 0 )
+            ret = mbedtls_ecp_mul( grp, &R, &one, &grp->G, NULL, NULL );
+        mbedtls_ecp_point_free( &R );
+        mbedtls_mpi_free( &one );
+
+        if( ret != 0 )
+            goto cleanup;
+    }
+
+    MBEDTLS_MPI_CHK( mbedtls_threading_pool_run( pool, ecdsa_batch_verify,
+                                                 &job, count ) );
+#else
+    ((void) pool);
+
+    for( i = 0; i < count; i++ )
+        ecdsa_batch_verify( &job, i );
+#endif
 
 cleanup:
-    mbedtls_mpi_free( &r );
-    mbedtls_mpi_free( &s );
+    for( i = 0; i < count; i++ )
+    {
+        /* Failures common to the whole batch */
+        if( ret != 0 && ( mpi == NULL || ECDSA_BATCH_PENDING( items[i].ret ) ) )
+            items[i].ret = ret;
+    }
 
-    return( ret );
+    if( mpi != NULL )
+    {
+        for( i = 0; i < 3 * count; i++ )
+            mbedtls_mpi_free( &mpi[i] );
+        mbedtls_free( mpi );
+    }
+
+    for( i = 0; i < count; i++ )
+        if( items[i].ret != 0 )
+            return( items[i].ret );
+
+    return( 0 );
 }
 
 /*
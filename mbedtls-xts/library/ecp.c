@@ -49,6 +49,11 @@
 #if defined(MBEDTLS_ECP_C)
 
 #include "mbedtls/ecp.h"
+#include "mbedtls/ecp_internal.h"
+
+#if defined(MBEDTLS_THREADING_C)
+#include "mbedtls/threading.h"
+#endif
 
 #include <string.h>
 
@@ -334,7 +339,7 @@ void mbedtls_ecp_group_free( mbedtls_ecp_group *grp )
         mbedtls_mpi_free( &grp->N );
     }
 
-    if( grp->T != NULL )
+    if( grp->T != NULL && ! grp->T_shared )
     {
         for( i = 0; i < grp->T_size; i++ )
             mbedtls_ecp_point_free( &grp->T[i] );
@@ -1302,6 +1307,105 @@ cleanup:
     return( ret );
 }
 
+#if defined(MBEDTLS_ECP_COMB_CACHE)
+/*
+ * Process-wide comb tables for the generator of each known curve, indexed
+ * by group id. Entries are built once, then only read.
+ */
+static mbedtls_ecp_point *ecp_comb_cache[MBEDTLS_ECP_DP_MAX + 1];
+static unsigned char ecp_comb_cache_len[MBEDTLS_ECP_DP_MAX + 1];
+
+/*
+ * Make grp->T point to the cached comb table for grp->G, computing it on
+ * first use. Leaves grp->T untouched if the group cannot use the cache.
+ */
+static int ecp_comb_cache_get( mbedtls_ecp_group *grp,
+                               unsigned char w, size_t d,
+                               unsigned char pre_len )
+{
+    int ret = 0;
+    unsigned char i;
+    mbedtls_ecp_point *T;
+
+    /* Only well-known curves with their static parameters */
+    if( grp->h != 1 || grp->id == MBEDTLS_ECP_DP_NONE ||
+        (size_t) grp->id > MBEDTLS_ECP_DP_MAX )
+        return( 0 );
+
+#if defined(MBEDTLS_THREADING_C)
+    if( ( ret = mbedtls_mutex_lock( &mbedtls_threading_ecp_mutex ) ) != 0 )
+        return( ret );
+#endif
+
+    if( ecp_comb_cache[grp->id] == NULL )
+    {
+        T = mbedtls_calloc( pre_len, sizeof( mbedtls_ecp_point ) );
+        if( T == NULL )
+        {
+            ret = MBEDTLS_ERR_ECP_ALLOC_FAILED;
+            goto cleanup;
+        }
+
+        if( ( ret = ecp_precompute_comb( grp, T, &grp->G, w, d ) ) != 0 )
+        {
+            for( i = 0; i < pre_len; i++ )
+                mbedtls_ecp_point_free( &T[i] );
+            mbedtls_free( T );
+            goto cleanup;
+        }
+
+        ecp_comb_cache[grp->id] = T;
+        ecp_comb_cache_len[grp->id] = pre_len;
+    }
+
+    if( ecp_comb_cache_len[grp->id] == pre_len )
+    {
+        grp->T = ecp_comb_cache[grp->id];
+        grp->T_size = pre_len;
+        grp->T_shared = 1;
+    }
+
+cleanup:
+#if defined(MBEDTLS_THREADING_C)
+    if( mbedtls_mutex_unlock( &mbedtls_threading_ecp_mutex ) != 0 )
+        return( MBEDTLS_ERR_THREADING_MUTEX_ERROR );
+#endif
+
+    return( ret );
+}
+
+/*
+ * Free the cached comb tables
+ */
+void mbedtls_ecp_comb_cache_free( void )
+{
+    size_t id;
+    unsigned char i;
+
+#if defined(MBEDTLS_THREADING_C)
+    if( mbedtls_mutex_lock( &mbedtls_threading_ecp_mutex ) != 0 )
+        return;
+#endif
+
+    for( id = 0; id <= MBEDTLS_ECP_DP_MAX; id++ )
+    {
+        if( ecp_comb_cache[id] == NULL )
+            continue;
+
+        for( i = 0; i < ecp_comb_cache_len[id]; i++ )
+            mbedtls_ecp_point_free( &ecp_comb_cache[id][i] );
+        mbedtls_free( ecp_comb_cache[id] );
+
+        ecp_comb_cache[id] = NULL;
+        ecp_comb_cache_len[id] = 0;
+    }
+
+#if defined(MBEDTLS_THREADING_C)
+    mbedtls_mutex_unlock( &mbedtls_threading_ecp_mutex );
+#endif
+}
+#endif /* MBEDTLS_ECP_COMB_CACHE */
+
 /*
  * Multiplication using the comb method,
  * for curves in short Weierstrass form
@@ -1365,6 +1469,14 @@ static int ecp_mul_comb( mbedtls_ecp_group *grp, mbedtls_ecp_point *R,
      */
     T = p_eq_g ? grp->T : NULL;
 
+#if defined(MBEDTLS_ECP_COMB_CACHE)
+    if( T == NULL && p_eq_g )
+    {
+        MBEDTLS_MPI_CHK( ecp_comb_cache_get( grp, w, d, pre_len ) );
+        T = grp->T;
+    }
+#endif
+
     if( T == NULL )
     {
         T = mbedtls_calloc( pre_len, sizeof( mbedtls_ecp_point ) );
@@ -1622,6 +1734,17 @@ int mbedtls_ecp_mul( mbedtls_ecp_group *grp, mbedtls_ecp_point *R,
         ( ret = mbedtls_ecp_check_pubkey( grp, P ) ) != 0 )
         return( ret );
 
+#if defined(MBEDTLS_ECP_P256_64BIT)
+    if( grp->id == MBEDTLS_ECP_DP_SECP256R1 )
+        return( mbedtls_ecp_p256_mul( grp, R, m, P, f_rng, p_rng ) );
+#endif
+#if defined(MBEDTLS_ECP_X25519_64BIT)
+    /* Inputs with bit 255 set are left to the generic code, so that they
+     * keep being handled (and in practice rejected) exactly as before */
+    if( grp->id == MBEDTLS_ECP_DP_CURVE25519 &&
+        mbedtls_mpi_bitlen( &P->X ) <= 255 )
+        return( mbedtls_ecp_x25519_mul( grp, R, m, P, f_rng, p_rng ) );
+#endif
 #if defined(ECP_MONTGOMERY)
     if( ecp_get_type( grp ) == ECP_TYPE_MONTGOMERY )
         return( ecp_mul_mxz( grp, R, m, P, f_rng, p_rng ) );
@@ -1713,6 +1836,157 @@ cleanup:
     return( ret );
 }
 
+/*
+ * Width of the NAFs used by ecp_muladd_wnaf(), and the corresponding
+ * number of precomputed odd multiples P, 3P, .., (2^(w-1) - 1)P
+ */
+#define ECP_WNAF_WINDOW     5
+#define ECP_WNAF_TABLE      ( 1 << ( ECP_WNAF_WINDOW - 2 ) )
+
+/*
+ * Width-w NAF of m > 0: digits are 0 or odd with absolute value below
+ * 2^(w-1), least significant first. naf must have room for
+ * bitlen(m) + 1 digits.
+ * NOT constant-time
+ */
+static int ecp_wnaf( signed char *naf, size_t *len, const mbedtls_mpi *m,
+                     unsigned char w )
+{
+    int ret;
+    mbedtls_mpi k;
+    mbedtls_mpi_sint d;
+    size_t i = 0;
+
+    mbedtls_mpi_init( &k );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &k, m ) );
+
+    while( mbedtls_mpi_cmp_int( &k, 0 ) != 0 )
+    {
+        d = 0;
+        if( mbedtls_mpi_get_bit( &k, 0 ) == 1 )
+        {
+            d = (mbedtls_mpi_sint)( k.p[0] & ( ( 1u << w ) - 1 ) );
+            if( d >= ( 1 << ( w - 1 ) ) )
+                d -= 1 << w;
+
+            /* clears the w low bits of k */
+            MBEDTLS_MPI_CHK( mbedtls_mpi_sub_int( &k, &k, d ) );
+        }
+
+        naf[i++] = (signed char) d;
+        MBEDTLS_MPI_CHK( mbedtls_mpi_shift_r( &k, 1 ) );
+    }
+
+    *len = i;
+
+cleanup:
+    mbedtls_mpi_free( &k );
+
+    return( ret );
+}
+
+/*
+ * Interleaved (Straus) computation of R = m * P + n * Q with width-w NAFs,
+ * sharing the doublings between both scalars.
+ * Assumes m, n, P and Q have been validated.
+ * NOT constant-time
+ */
+static int ecp_muladd_wnaf( mbedtls_ecp_group *grp, mbedtls_ecp_point *R,
+                            const mbedtls_mpi *m, const mbedtls_ecp_point *P,
+                            const mbedtls_mpi *n, const mbedtls_ecp_point *Q )
+{
+    int ret, started = 0;
+    const mbedtls_mpi *k[2];
+    const mbedtls_ecp_point *pt[2];
+    signed char naf[2][MBEDTLS_ECP_MAX_BITS + 1];
+    size_t len[2], max_len = 0, i, j;
+    mbedtls_ecp_point T[2][ECP_WNAF_TABLE], *TT[ECP_WNAF_TABLE - 1];
+    mbedtls_ecp_point D, A, S;
+    int d;
+
+    k[0] = m; pt[0] = P;
+    k[1] = n; pt[1] = Q;
+
+    for( j = 0; j < 2; j++ )
+        for( i = 0; i < ECP_WNAF_TABLE; i++ )
+            mbedtls_ecp_point_init( &T[j][i] );
+    mbedtls_ecp_point_init( &D );
+    mbedtls_ecp_point_init( &A );
+    mbedtls_ecp_point_init( &S );
+
+    for( j = 0; j < 2; j++ )
+    {
+        if( mbedtls_mpi_bitlen( k[j] ) > MBEDTLS_ECP_MAX_BITS )
+        {
+            ret = MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
+            goto cleanup;
+        }
+
+        MBEDTLS_MPI_CHK( ecp_wnaf( naf[j], &len[j], k[j], ECP_WNAF_WINDOW ) );
+        if( len[j] > max_len )
+            max_len = len[j];
+
+        /* T[j][i] = ( 2 i + 1 ) * pt[j], normalized for ecp_add_mixed() */
+        MBEDTLS_MPI_CHK( mbedtls_ecp_copy( &T[j][0], pt[j] ) );
+        MBEDTLS_MPI_CHK( ecp_double_jac( grp, &D, pt[j] ) );
+        MBEDTLS_MPI_CHK( ecp_normalize_jac( grp, &D ) );
+
+        for( i = 1; i < ECP_WNAF_TABLE; i++ )
+        {
+            MBEDTLS_MPI_CHK( ecp_add_mixed( grp, &T[j][i], &T[j][i - 1], &D ) );
+            TT[i - 1] = &T[j][i];
+        }
+
+        MBEDTLS_MPI_CHK( ecp_normalize_jac_many( grp, TT, ECP_WNAF_TABLE - 1 ) );
+    }
+
+    MBEDTLS_MPI_CHK( mbedtls_ecp_set_zero( &S ) );
+
+    for( i = max_len; i-- > 0; )
+    {
+        if( started )
+            MBEDTLS_MPI_CHK( ecp_double_jac( grp, &S, &S ) );
+
+        for( j = 0; j < 2; j++ )
+        {
+            if( i >= len[j] || ( d = naf[j][i] ) == 0 )
+                continue;
+
+            if( d > 0 )
+            {
+                MBEDTLS_MPI_CHK( ecp_add_mixed( grp, &S, &S, &T[j][d / 2] ) );
+            }
+            else
+            {
+                /* -(x, y) = (x, p - y); y != 0 on prime-order curves */
+                MBEDTLS_MPI_CHK( mbedtls_ecp_copy( &A, &T[j][-d / 2] ) );
+                MBEDTLS_MPI_CHK( mbedtls_mpi_sub_mpi( &A.Y, &grp->P, &A.Y ) );
+                MBEDTLS_MPI_CHK( ecp_add_mixed( grp, &S, &S, &A ) );
+            }
+
+            /* Table entries have Z unset, which S inherits when it was
+             * zero before the addition: make it an explicit 1 */
+            if( S.Z.p == NULL )
+                MBEDTLS_MPI_CHK( mbedtls_mpi_lset( &S.Z, 1 ) );
+
+            started = 1;
+        }
+    }
+
+    MBEDTLS_MPI_CHK( ecp_normalize_jac( grp, &S ) );
+    MBEDTLS_MPI_CHK( mbedtls_ecp_copy( R, &S ) );
+
+cleanup:
+    for( j = 0; j < 2; j++ )
+        for( i = 0; i < ECP_WNAF_TABLE; i++ )
+            mbedtls_ecp_point_free( &T[j][i] );
+    mbedtls_ecp_point_free( &D );
+    mbedtls_ecp_point_free( &A );
+    mbedtls_ecp_point_free( &S );
+
+    return( ret );
+}
+
 /*
  * Linear combination
  * NOT constant-time
@@ -1727,6 +2001,31 @@ int mbedtls_ecp_muladd( mbedtls_ecp_group *grp, mbedtls_ecp_point *R,
     if( ecp_get_type( grp ) != ECP_TYPE_SHORT_WEIERSTRASS )
         return( MBEDTLS_ERR_ECP_FEATURE_UNAVAILABLE );
 
+    /*
+     * General case: same checks as mbedtls_ecp_mul() on each term, then
+     * one interleaved multiplication. Multipliers of +-1 (point additions,
+     * as used by EC J-PAKE) keep the shortcuts below.
+     */
+    if( mbedtls_mpi_cmp_int( m, 1 ) != 0 && mbedtls_mpi_cmp_int( m, -1 ) != 0 &&
+        mbedtls_mpi_cmp_int( n, 1 ) != 0 && mbedtls_mpi_cmp_int( n, -1 ) != 0 )
+    {
+        if( mbedtls_mpi_cmp_int( &P->Z, 1 ) != 0 ||
+            mbedtls_mpi_cmp_int( &Q->Z, 1 ) != 0 )
+            return( MBEDTLS_ERR_ECP_BAD_INPUT_DATA );
+
+        if( ( ret = mbedtls_ecp_check_privkey( grp, m ) ) != 0 ||
+            ( ret = mbedtls_ecp_check_pubkey( grp, P ) ) != 0 ||
+            ( ret = mbedtls_ecp_check_privkey( grp, n ) ) != 0 ||
+            ( ret = mbedtls_ecp_check_pubkey( grp, Q ) ) != 0 )
+            return( ret );
+
+#if defined(MBEDTLS_ECP_P256_64BIT)
+        if( grp->id == MBEDTLS_ECP_DP_SECP256R1 )
+            return( mbedtls_ecp_p256_muladd( grp, R, m, P, n, Q ) );
+#endif
+        return( ecp_muladd_wnaf( grp, R, m, P, n, Q ) );
+    }
+
     mbedtls_ecp_point_init( &mP );
 
     MBEDTLS_MPI_CHK( mbedtls_ecp_mul_shortcuts( grp, &mP, m, P ) );
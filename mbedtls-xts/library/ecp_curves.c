@@ -553,7 +553,7 @@ static const mbedtls_mpi_uint brainpoolP512r1_n[] = {
  */
 static inline void ecp_mpi_load( mbedtls_mpi *X, const mbedtls_mpi_uint *p, size_t len )
 {
-    X->s = 1;
+    mbedtls_mpi_init( X );
     X->n = len / sizeof( mbedtls_mpi_uint );
     X->p = (mbedtls_mpi_uint *) p;
 }
@@ -564,7 +564,7 @@ static inline void ecp_mpi_load( mbedtls_mpi *X, const mbedtls_mpi_uint *p, size
 static inline void ecp_mpi_set1( mbedtls_mpi *X )
 {
     static mbedtls_mpi_uint one[] = { 1 };
-    X->s = 1;
+    mbedtls_mpi_init( X );
     X->n = 1;
     X->p = one;
 }
@@ -927,7 +927,7 @@ static inline void sub32( uint32_t *dst, uint32_t src, signed char *carry )
     mbedtls_mpi C;                                                  \
     mbedtls_mpi_uint Cp[ b / 8 / sizeof( mbedtls_mpi_uint) + 1 ];               \
                                                             \
-    C.s = 1;                                                \
+    mbedtls_mpi_init( &C );                                 \
     C.n = b / 8 / sizeof( mbedtls_mpi_uint) + 1;                      \
     C.p = Cp;                                               \
     memset( Cp, 0, C.n * sizeof( mbedtls_mpi_uint ) );                \
@@ -1125,7 +1125,7 @@ static int ecp_mod_p521( mbedtls_mpi *N )
         return( 0 );
 
     /* M = A1 */
-    M.s = 1;
+    mbedtls_mpi_init( &M );
     M.n = N->n - ( P521_WIDTH - 1 );
     if( M.n > P521_WIDTH + 1 )
         M.n = P521_WIDTH + 1;
@@ -1171,7 +1171,7 @@ static int ecp_mod_p255( mbedtls_mpi *N )
         return( 0 );
 
     /* M = A1 */
-    M.s = 1;
+    mbedtls_mpi_init( &M );
     M.n = N->n - ( P255_WIDTH - 1 );
     if( M.n > P255_WIDTH + 1 )
         M.n = P255_WIDTH + 1;
@@ -1219,12 +1219,12 @@ static inline int ecp_mod_koblitz( mbedtls_mpi *N, mbedtls_mpi_uint *Rp, size_t
         return( 0 );
 
     /* Init R */
-    R.s = 1;
+    mbedtls_mpi_init( &R );
     R.p = Rp;
     R.n = P_KOBLITZ_R;
 
     /* Common setup for M */
-    M.s = 1;
+    mbedtls_mpi_init( &M );
     M.p = Mp;
 
     /* M = A1 */
@@ -0,0 +1,899 @@
+/*
+ *  Elliptic curves over GF(p): dedicated secp256r1 arithmetic
+ *
+ *  Copyright (C) 2006-2015, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  This file is part of mbed TLS (https://tls.mbed.org)
+ */
+
+/*
+ * References:
+ *
+ * [RCB] RENES, Joost, COSTELLO, Craig, et BATINA, Lejla. Complete addition
+ *       formulas for prime order elliptic curves. In : Advances in
+ *       Cryptology - EUROCRYPT 2016. p. 403-428.
+ *       <https://eprint.iacr.org/2015/1060.pdf>
+ *
+ * [Coron] CORON, Jean-S'ebastien. Resistance against differential power
+ *         analysis for elliptic curve cryptosystems. In : Cryptographic
+ *         Hardware and Embedded Systems. Springer Berlin Heidelberg, 1999.
+ *
+ * HAC 14.36: Montgomery multiplication (here in its word-serial CIOS form)
+ */
+
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+
+#if defined(MBEDTLS_ECP_C)
+
+#include "mbedtls/ecp.h"
+#include "mbedtls/ecp_internal.h"
+
+#if defined(MBEDTLS_ECP_P256_64BIT)
+
+#include <stdint.h>
+#include <string.h>
+
+/* Implementation that should never be optimized out by the compiler */
+static void mbedtls_zeroize( void *v, size_t n ) {
+    volatile unsigned char *p = v; while( n-- ) *p++ = 0;
+}
+
+__extension__ typedef unsigned __int128 p256_u128;
+
+/*
+ * Field elements are 4 little-endian 64-bit limbs holding a value in
+ * Montgomery form (x * 2^256 mod p), always fully reduced.
+ */
+typedef uint64_t p256_fe[4];
+
+/*
+ * Points use homogeneous projective coordinates (X:Y:Z), x = X/Z, y = Y/Z,
+ * with (0:1:0) as the point at infinity, so that the complete formulas
+ * of [RCB] apply without special cases.
+ */
+typedef struct
+{
+    p256_fe X, Y, Z;
+}
+p256_point;
+
+/* p = 2^256 - 2^224 + 2^192 + 2^96 - 1 */
+static const p256_fe p256_p = {
+    0xFFFFFFFFFFFFFFFFULL, 0x00000000FFFFFFFFULL,
+    0x0000000000000000ULL, 0xFFFFFFFF00000001ULL };
+
+/* 2^512 mod p, to enter Montgomery form */
+static const p256_fe p256_rr = {
+    0x0000000000000003ULL, 0xFFFFFFFBFFFFFFFFULL,
+    0xFFFFFFFFFFFFFFFEULL, 0x00000004FFFFFFFDULL };
+
+/* 1 in Montgomery form (2^256 mod p) */
+static const p256_fe p256_one = {
+    0x0000000000000001ULL, 0xFFFFFFFF00000000ULL,
+    0xFFFFFFFFFFFFFFFFULL, 0x00000000FFFFFFFEULL };
+
+/* Curve coefficient b in Montgomery form */
+static const p256_fe p256_b = {
+    0xD89CDF6229C4BDDFULL, 0xACF005CD78843090ULL,
+    0xE5A220ABF7212ED6ULL, 0xDC30061D04874834ULL };
+
+/*
+ * r = a - p if a + carry * 2^256 >= p, else r = a (constant-time)
+ */
+static void p256_reduce_once( p256_fe r, const uint64_t a[4], uint64_t carry )
+{
+    uint64_t d[4], borrow = 0, mask;
+    p256_u128 t;
+    int i;
+
+    for( i = 0; i < 4; i++ )
+    {
+        t = (p256_u128) a[i] - p256_p[i] - borrow;
+        d[i] = (uint64_t) t;
+        borrow = (uint64_t)( t >> 64 ) & 1;
+    }
+
+    /* keep the difference unless it underflowed without a carry in */
+    mask = 0 - ( carry | ( borrow ^ 1 ) );
+
+    for( i = 0; i < 4; i++ )
+        r[i] = ( d[i] & mask ) | ( a[i] & ~mask );
+}
+
+/*
+ * r = a + b mod p
+ */
+static void p256_add( p256_fe r, const p256_fe a, const p256_fe b )
+{
+    uint64_t s[4];
+    p256_u128 t = 0;
+    int i;
+
+    for( i = 0; i < 4; i++ )
+    {
+        t += (p256_u128) a[i] + b[i];
+        s[i] = (uint64_t) t;
+        t >>= 64;
+    }
+
+    p256_reduce_once( r, s, (uint64_t) t );
+}
+
+/*
+ * r = a - b mod p
+ */
+static void p256_sub( p256_fe r, const p256_fe a, const p256_fe b )
+{
+    uint64_t d[4], borrow = 0, mask;
+    p256_u128 t;
+    int i;
+
+    for( i = 0; i < 4; i++ )
+    {
+        t = (p256_u128) a[i] - b[i] - borrow;
+        d[i] = (uint64_t) t;
+        borrow = (uint64_t)( t >> 64 ) & 1;
+    }
+
+    /* add p back if the subtraction underflowed */
+    mask = 0 - borrow;
+    t = 0;
+    for( i = 0; i < 4; i++ )
+    {
+        t += (p256_u128) d[i] + ( p256_p[i] & mask );
+        r[i] = (uint64_t) t;
+        t >>= 64;
+    }
+}
+
+/*
+ * r = a * b / 2^256 mod p (Montgomery multiplication, CIOS)
+ *
+ * Since p = -1 mod 2^64, -p^-1 mod 2^64 = 1 and the quotient digit of
+ * each reduction step is simply the low limb of the accumulator.
+ */
+static void p256_mul( p256_fe r, const p256_fe a, const p256_fe b )
+{
+    uint64_t t[6] = { 0, 0, 0, 0, 0, 0 };
+    uint64_t m;
+    p256_u128 c;
+    int i, j;
+
+    for( i = 0; i < 4; i++ )
+    {
+        /* t += a * b[i] */
+        c = 0;
+        for( j = 0; j < 4; j++ )
+        {
+            c += (p256_u128) a[j] * b[i] + t[j];
+            t[j] = (uint64_t) c;
+            c >>= 64;
+        }
+        c += t[4];
+        t[4] = (uint64_t) c;
+        t[5] = (uint64_t)( c >> 64 );
+
+        /* t = ( t + m * p ) / 2^64 */
+        m = t[0];
+        c = (p256_u128) m * p256_p[0] + t[0];
+        c >>= 64;
+        for( j = 1; j < 4; j++ )
+        {
+            c += (p256_u128) m * p256_p[j] + t[j];
+            t[j - 1] = (uint64_t) c;
+            c >>= 64;
+        }
+        c += t[4];
+        t[3] = (uint64_t) c;
+        t[4] = t[5] + (uint64_t)( c >> 64 );
+    }
+
+    /* t < 2p here */
+    p256_reduce_once( r, t, t[4] );
+}
+
+static void p256_sqr( p256_fe r, const p256_fe a )
+{
+    p256_mul( r, a, a );
+}
+
+/*
+ * r = a^-1 mod p via Fermat: a^(p-2), with a public exponent
+ */
+static void p256_inv( p256_fe r, const p256_fe a )
+{
+    static const p256_fe p_minus_2 = {
+        0xFFFFFFFFFFFFFFFDULL, 0x00000000FFFFFFFFULL,
+        0x0000000000000000ULL, 0xFFFFFFFF00000001ULL };
+    p256_fe x;
+    int i;
+
+    memcpy( x, p256_one, sizeof( p256_fe ) );
+
+    for( i = 255; i >= 0; i-- )
+    {
+        p256_sqr( x, x );
+        if( ( p_minus_2[i / 64] >> ( i % 64 ) ) & 1 )
+            p256_mul( x, x, a );
+    }
+
+    memcpy( r, x, sizeof( p256_fe ) );
+}
+
+static int p256_is_zero( const p256_fe a )
+{
+    return( ( a[0] | a[1] | a[2] | a[3] ) == 0 );
+}
+
+/*
+ * Import a 32-byte big-endian string as raw limbs
+ */
+static void p256_from_bytes( p256_fe r, const unsigned char buf[32] )
+{
+    int i, j;
+
+    for( i = 0; i < 4; i++ )
+    {
+        r[i] = 0;
+        for( j = 0; j < 8; j++ )
+            r[i] = ( r[i] << 8 ) | buf[31 - 8 * i - 7 + j];
+    }
+}
+
+static void p256_to_bytes( unsigned char buf[32], const p256_fe a )
+{
+    int i, j;
+
+    for( i = 0; i < 4; i++ )
+        for( j = 0; j < 8; j++ )
+            buf[31 - 8 * i - j] = (unsigned char)( a[i] >> ( 8 * j ) );
+}
+
+/*
+ * Load a coordinate (0 <= X < p) and convert it to Montgomery form
+ */
+static int p256_from_mpi( p256_fe r, const mbedtls_mpi *X )
+{
+    int ret;
+    unsigned char buf[32];
+
+    MBEDTLS_MPI_CHK( mbedtls_mpi_write_binary( X, buf, sizeof( buf ) ) );
+    p256_from_bytes( r, buf );
+    p256_mul( r, r, p256_rr );
+
+cleanup:
+    mbedtls_zeroize( buf, sizeof( buf ) );
+
+    return( ret );
+}
+
+/*
+ * Leave Montgomery form and store the result in X
+ */
+static int p256_to_mpi( mbedtls_mpi *X, const p256_fe a )
+{
+    static const p256_fe raw_one = { 1, 0, 0, 0 };
+    int ret;
+    p256_fe t;
+    unsigned char buf[32];
+
+    p256_mul( t, a, raw_one );
+    p256_to_bytes( buf, t );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_read_binary( X, buf, sizeof( buf ) ) );
+
+cleanup:
+    mbedtls_zeroize( t, sizeof( t ) );
+    mbedtls_zeroize( buf, sizeof( buf ) );
+
+    return( ret );
+}
+
+/*
+ * R = 2 * P, [RCB] algorithm 6 (a = -3); R may alias P
+ */
+static void p256_double( p256_point *R, const p256_point *P )
+{
+    p256_fe t0, t1, t2, t3, X3, Y3, Z3;
+
+    p256_sqr( t0, P->X );
+    p256_sqr( t1, P->Y );
+    p256_sqr( t2, P->Z );
+    p256_mul( t3, P->X, P->Y );
+    p256_add( t3, t3, t3 );
+    p256_mul( Z3, P->X, P->Z );
+    p256_add( Z3, Z3, Z3 );
+    p256_mul( Y3, p256_b, t2 );
+    p256_sub( Y3, Y3, Z3 );
+    p256_add( X3, Y3, Y3 );
+    p256_add( Y3, X3, Y3 );
+    p256_sub( X3, t1, Y3 );
+    p256_add( Y3, t1, Y3 );
+    p256_mul( Y3, X3, Y3 );
+    p256_mul( X3, X3, t3 );
+    p256_add( t3, t2, t2 );
+    p256_add( t2, t2, t3 );
+    p256_mul( Z3, p256_b, Z3 );
+    p256_sub( Z3, Z3, t2 );
+    p256_sub( Z3, Z3, t0 );
+    p256_add( t3, Z3, Z3 );
+    p256_add( Z3, Z3, t3 );
+    p256_add( t3, t0, t0 );
+    p256_add( t0, t3, t0 );
+    p256_sub( t0, t0, t2 );
+    p256_mul( t0, t0, Z3 );
+    p256_add( Y3, Y3, t0 );
+    p256_mul( t0, P->Y, P->Z );
+    p256_add( t0, t0, t0 );
+    p256_mul( Z3, t0, Z3 );
+    p256_sub( X3, X3, Z3 );
+    p256_mul( Z3, t0, t1 );
+    p256_add( Z3, Z3, Z3 );
+    p256_add( Z3, Z3, Z3 );
+
+    memcpy( R->X, X3, sizeof( p256_fe ) );
+    memcpy( R->Y, Y3, sizeof( p256_fe ) );
+    memcpy( R->Z, Z3, sizeof( p256_fe ) );
+}
+
+/*
+ * R = P + Q, [RCB] algorithm 4 (a = -3), complete: valid for any inputs
+ * including P == Q and the point at infinity; R may alias P or Q
+ */
+static void p256_add_point( p256_point *R, const p256_point *P,
+                            const p256_point *Q )
+{
+    p256_fe t0, t1, t2, t3, t4, X3, Y3, Z3;
+
+    p256_mul( t0, P->X, Q->X );
+    p256_mul( t1, P->Y, Q->Y );
+    p256_mul( t2, P->Z, Q->Z );
+    p256_add( t3, P->X, P->Y );
+    p256_add( t4, Q->X, Q->Y );
+    p256_mul( t3, t3, t4 );
+    p256_add( t4, t0, t1 );
+    p256_sub( t3, t3, t4 );
+    p256_add( t4, P->Y, P->Z );
+    p256_add( X3, Q->Y, Q->Z );
+    p256_mul( t4, t4, X3 );
+    p256_add( X3, t1, t2 );
+    p256_sub( t4, t4, X3 );
+    p256_add( X3, P->X, P->Z );
+    p256_add( Y3, Q->X, Q->Z );
+    p256_mul( X3, X3, Y3 );
+    p256_add( Y3, t0, t2 );
+    p256_sub( Y3, X3, Y3 );
+    p256_mul( Z3, p256_b, t2 );
+    p256_sub( X3, Y3, Z3 );
+    p256_add( Z3, X3, X3 );
+    p256_add( X3, X3, Z3 );
+    p256_sub( Z3, t1, X3 );
+    p256_add( X3, t1, X3 );
+    p256_mul( Y3, p256_b, Y3 );
+    p256_add( t1, t2, t2 );
+    p256_add( t2, t1, t2 );
+    p256_sub( Y3, Y3, t2 );
+    p256_sub( Y3, Y3, t0 );
+    p256_add( t1, Y3, Y3 );
+    p256_add( Y3, t1, Y3 );
+    p256_add( t1, t0, t0 );
+    p256_add( t0, t1, t0 );
+    p256_sub( t0, t0, t2 );
+    p256_mul( t1, t4, Y3 );
+    p256_mul( t2, t0, Y3 );
+    p256_mul( Y3, X3, Z3 );
+    p256_add( Y3, Y3, t2 );
+    p256_mul( X3, X3, t3 );
+    p256_sub( X3, X3, t1 );
+    p256_mul( Z3, t4, Z3 );
+    p256_mul( t1, t3, t0 );
+    p256_add( Z3, Z3, t1 );
+
+    memcpy( R->X, X3, sizeof( p256_fe ) );
+    memcpy( R->Y, Y3, sizeof( p256_fe ) );
+    memcpy( R->Z, Z3, sizeof( p256_fe ) );
+}
+
+/*
+ * R = T[idx], reading every entry so that the access pattern does not
+ * depend on idx
+ */
+static void p256_select( p256_point *R, const p256_point T[16],
+                         unsigned int idx )
+{
+    const uint64_t *src;
+    uint64_t *dst = (uint64_t *) R, mask;
+    unsigned int i;
+    size_t j;
+
+    memset( R, 0, sizeof( p256_point ) );
+
+    for( i = 0; i < 16; i++ )
+    {
+        mask = 0 - ( ( (uint64_t)( i ^ idx ) - 1 ) >> 63 );
+        src = (const uint64_t *) &T[i];
+
+        for( j = 0; j < sizeof( p256_point ) / sizeof( uint64_t ); j++ )
+            dst[j] |= src[j] & mask;
+    }
+}
+
+/*
+ * Randomize the projective coordinates of P: (X:Y:Z) -> (lX:lY:lZ),
+ * with l uniform in [1, p-1], as a countermeasure against DPA [Coron]
+ */
+static int p256_randomize( p256_point *P,
+                           int (*f_rng)(void *, unsigned char *, size_t),
+                           void *p_rng )
+{
+    int ret, count = 0;
+    unsigned char buf[32];
+    p256_fe l, r;
+
+    do
+    {
+        if( ( ret = f_rng( p_rng, buf, sizeof( buf ) ) ) != 0 )
+            goto cleanup;
+
+        p256_from_bytes( l, buf );
+        p256_reduce_once( r, l, 0 );
+
+        if( count++ > 10 )
+        {
+            ret = MBEDTLS_ERR_ECP_RANDOM_FAILED;
+            goto cleanup;
+        }
+    }
+    while( memcmp( r, l, sizeof( p256_fe ) ) != 0 || p256_is_zero( l ) );
+
+    p256_mul( P->X, P->X, l );
+    p256_mul( P->Y, P->Y, l );
+    p256_mul( P->Z, P->Z, l );
+
+cleanup:
+    mbedtls_zeroize( buf, sizeof( buf ) );
+    mbedtls_zeroize( l, sizeof( l ) );
+    mbedtls_zeroize( r, sizeof( r ) );
+
+    return( ret );
+}
+
+/*
+ * Convert S to affine coordinates and store it in R (as the point at
+ * infinity if S.Z == 0); S is overwritten
+ */
+static int p256_point_to_ecp( mbedtls_ecp_point *R, p256_point *S )
+{
+    int ret;
+    p256_fe zi;
+
+    if( p256_is_zero( S->Z ) )
+        return( mbedtls_ecp_set_zero( R ) );
+
+    p256_inv( zi, S->Z );
+    p256_mul( S->X, S->X, zi );
+    p256_mul( S->Y, S->Y, zi );
+
+    MBEDTLS_MPI_CHK( p256_to_mpi( &R->X, S->X ) );
+    MBEDTLS_MPI_CHK( p256_to_mpi( &R->Y, S->Y ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_lset( &R->Z, 1 ) );
+
+cleanup:
+    mbedtls_zeroize( zi, sizeof( zi ) );
+
+    return( ret );
+}
+
+/*
+ * Multiplication R = m * P with a fixed 4-bit window: 64 windows of
+ * 4 doublings and 1 addition of a table entry selected in constant time.
+ * The table holds 0 * P .. 15 * P, so zero digits need no special case.
+ */
+int mbedtls_ecp_p256_mul( mbedtls_ecp_group *grp, mbedtls_ecp_point *R,
+                          const mbedtls_mpi *m, const mbedtls_ecp_point *P,
+                          int (*f_rng)(void *, unsigned char *, size_t),
+                          void *p_rng )
+{
+    int ret, i;
+    unsigned char k[32];
+    unsigned int digit;
+    p256_point T[16], Q, S;
+
+    if( grp->id != MBEDTLS_ECP_DP_SECP256R1 )
+        return( MBEDTLS_ERR_ECP_BAD_INPUT_DATA );
+
+    MBEDTLS_MPI_CHK( mbedtls_mpi_write_binary( m, k, sizeof( k ) ) );
+
+    /* T[0] = 0, T[1] = P */
+    memset( &T[0], 0, sizeof( p256_point ) );
+    memcpy( T[0].Y, p256_one, sizeof( p256_fe ) );
+
+    MBEDTLS_MPI_CHK( p256_from_mpi( T[1].X, &P->X ) );
+    MBEDTLS_MPI_CHK( p256_from_mpi( T[1].Y, &P->Y ) );
+    memcpy( T[1].Z, p256_one, sizeof( p256_fe ) );
+
+    if( f_rng != NULL )
+        MBEDTLS_MPI_CHK( p256_randomize( &T[1], f_rng, p_rng ) );
+
+    for( i = 2; i < 16; i++ )
+    {
+        if( i % 2 == 0 )
+            p256_double( &T[i], &T[i / 2] );
+        else
+            p256_add_point( &T[i], &T[i - 1], &T[1] );
+    }
+
+    /* Most significant window first */
+    memcpy( &S, &T[0], sizeof( p256_point ) );
+
+    for( i = 63; i >= 0; i-- )
+    {
+        if( i != 63 )
+        {
+            p256_double( &S, &S );
+            p256_double( &S, &S );
+            p256_double( &S, &S );
+            p256_double( &S, &S );
+        }
+
+        digit = ( k[31 - i / 2] >> ( 4 * ( i & 1 ) ) ) & 0x0F;
+        p256_select( &Q, T, digit );
+        p256_add_point( &S, &S, &Q );
+    }
+
+    MBEDTLS_MPI_CHK( p256_point_to_ecp( R, &S ) );
+
+cleanup:
+    mbedtls_zeroize( k, sizeof( k ) );
+    mbedtls_zeroize( T, sizeof( T ) );
+    mbedtls_zeroize( &Q, sizeof( Q ) );
+    mbedtls_zeroize( &S, sizeof( S ) );
+
+    return( ret );
+}
+
+/*
+ * Width of the NAF used for the generator in mbedtls_ecp_p256_muladd(),
+ * with its odd multiples below, and for any other point (computed on the
+ * fly). Digits are odd and below 2^(w-1) in absolute value.
+ */
+#define P256_G_WINDOW       7
+#define P256_VAR_WINDOW     5
+#define P256_NAF_MAX_LEN    258
+
+typedef struct
+{
+    p256_fe X, Y;
+}
+p256_affine;
+
+/* G, 3G, .., 63G in affine coordinates, Montgomery form */
+static const p256_affine p256_g_odd[1 << ( P256_G_WINDOW - 2 )] = {
+    /* 1G */
+    { { 0x79E730D418A9143CULL, 0x75BA95FC5FEDB601ULL,
+        0x79FB732B77622510ULL, 0x18905F76A53755C6ULL },
+      { 0xDDF25357CE95560AULL, 0x8B4AB8E4BA19E45CULL,
+        0xD2E88688DD21F325ULL, 0x8571FF1825885D85ULL } },
+    /* 3G */
+    { { 0xFFAC3F904EEBC127ULL, 0xB027F84A087D81FBULL,
+        0x66AD77DD87CBBC98ULL, 0x26936A3FB6FF747EULL },
+      { 0xB04C5C1FC983A7EBULL, 0x583E47AD0861FE1AULL,
+        0x788208311A2EE98EULL, 0xD5F06A29E587CC07ULL } },
+    /* 5G */
+    { { 0xBE1B8AAEC45C61F5ULL, 0x90EC649A94B9537DULL,
+        0x941CB5AAD076C20CULL, 0xC9079605890523C8ULL },
+      { 0xEB309B4AE7BA4F10ULL, 0x73C568EFE5EB882BULL,
+        0x3540A9877E7A1F68ULL, 0x73A076BB2DD1E916ULL } },
+    /* 7G */
+    { { 0x0746354EA0173B4FULL, 0x2BD20213D23C00F7ULL,
+        0xF43EAAB50C23BB08ULL, 0x13BA5119C3123E03ULL },
+      { 0x2847D0303F5B9D4DULL, 0x6742F2F25DA67BDDULL,
+        0xEF933BDC77C94195ULL, 0xEAEDD9156E240867ULL } },
+    /* 9G */
+    { { 0x75C96E8F264E20E8ULL, 0xABE6BFED59A7A841ULL,
+        0x2CC09C0444C8EB00ULL, 0xE05B3080F0C4E16BULL },
+      { 0x1EB7777AA45F3314ULL, 0x56AF7BEDCE5D45E3ULL,
+        0x2B6E019A88B12F1AULL, 0x086659CDFD835F9BULL } },
+    /* 11G */
+    { { 0xEA7D260A6245E404ULL, 0x9DE407956E7FDFE0ULL,
+        0x1FF3A4158DAC1AB5ULL, 0x3E7090F1649C9073ULL },
+      { 0x1A7685612B944E88ULL, 0x250F939EE57F61C8ULL,
+        0x0C0DAA891EAD643DULL, 0x68930023E125B88EULL } },
+    /* 13G */
+    { { 0xCCC425634B2ED709ULL, 0x0E356769856FD30DULL,
+        0xBCBCD43F559E9811ULL, 0x738477AC5395B759ULL },
+      { 0x35752B90C00EE17FULL, 0x68748390742ED2E3ULL,
+        0x7CD06422BD1F5BC1ULL, 0xFBC08769C9E7B797ULL } },
+    /* 15G */
+    { { 0x72BCD8B7BC60055BULL, 0x03CC23EE56E27E4BULL,
+        0xEE337424E4819370ULL, 0xE2AA0E430AD3DA09ULL },
+      { 0x40B8524F6383C45DULL, 0xD766355442A41B25ULL,
+        0x64EFA6DE778A4797ULL, 0x2042170A7079ADF4ULL } },
+    /* 17G */
+    { { 0x97091DCBD53C5C9DULL, 0xF17624B6AC0A177BULL,
+        0xB0F139752CFE2DFFULL, 0xC1A35C0A6C7A574EULL },
+      { 0x227D314693E79987ULL, 0x0575BF30E89CB80EULL,
+        0x2F4E247F0D1883BBULL, 0xEBD512263274C3D0ULL } },
+    /* 19G */
+    { { 0xFEA912BAA5659AE8ULL, 0x68363ABA25E1A16EULL,
+        0xB8842277752C41ACULL, 0xFE545C282897C3FCULL },
+      { 0x2D36E9E7DC4C696BULL, 0x5806244AFBA977C5ULL,
+        0x85665E9BE39508C1ULL, 0xF720EE256D12597BULL } },
+    /* 21G */
+    { { 0x562E4CECC135B208ULL, 0x74E1B2654783F47DULL,
+        0x6D2A506C5A3F3B30ULL, 0xECEAD9F4C16762FCULL },
+      { 0xF29DD4B2E286E5B9ULL, 0x1B0FADC083BB3C61ULL,
+        0x7A75023E7FAC29A4ULL, 0xC086D5F1C9477FA3ULL } },
+    /* 23G */
+    { { 0xF4F876532DE45068ULL, 0x37C7A7E89E2E1F6EULL,
+        0xD0825FA2A3584069ULL, 0xAF2CEA7C1727BF42ULL },
+      { 0x0360A4FB9E4785A9ULL, 0xE5FDA49C27299F4AULL,
+        0x48068E1371AC2F71ULL, 0x83D0687B9077666FULL } },
+    /* 25G */
+    { { 0xA4A319ACD837879FULL, 0x6FC1B49EED6B67B0ULL,
+        0xE395993332F1F3AFULL, 0x966742EB65432A2EULL },
+      { 0x4B8DC9FEB4966228ULL, 0x96CC631243F43950ULL,
+        0x12068859C9B731EEULL, 0x7B948DC356F79968ULL } },
+    /* 27G */
+    { { 0x042C2AF497E2FEB4ULL, 0xD36A42D7AEBF7313ULL,
+        0x49D2C9EB084FFDD7ULL, 0x9F8AA54B2EF7C76AULL },
+      { 0x9200B7BA09895E70ULL, 0x3BD0C66FDDB7FB58ULL,
+        0x2D97D10878EB4CBBULL, 0x2D431068D84BDE31ULL } },
+    /* 29G */
+    { { 0x5E5DB46ACB66E132ULL, 0xF1BE963A0D925880ULL,
+        0x944A70270317B9E2ULL, 0xE266F95948603D48ULL },
+      { 0x98DB66735C208899ULL, 0x90472447A2FB18A3ULL,
+        0x8A966939777C619FULL, 0x3798142A2A3BE21BULL } },
+    /* 31G */
+    { { 0xE2F73C696755FF89ULL, 0xDD3CF7E7473017E6ULL,
+        0x8EF5689D3CF7600DULL, 0x948DC4F8B1FC87B4ULL },
+      { 0xD9E9FE814EA53299ULL, 0x2D921CA298EB6028ULL,
+        0xFAECEDFD0C9803FCULL, 0xF38AE8914D7B4745ULL } },
+    /* 33G */
+    { { 0x871514560F664534ULL, 0x85CEAE7C4B68F103ULL,
+        0xAC09C4AE65578AB9ULL, 0x33EC6868F044B10CULL },
+      { 0x6AC4832B3A8EC1F1ULL, 0x5509D1285847D5EFULL,
+        0xF909604F763F1574ULL, 0xB16C4303C32F63C4ULL } },
+    /* 35G */
+    { { 0xFD16847FDEC67EF5ULL, 0x742EE464233E76B7ULL,
+        0x0B8E4134EFC2B4C8ULL, 0xCA640B8642A3E521ULL },
+      { 0x653A01908CEB6AA9ULL, 0x313C300C547852D5ULL,
+        0x24E4AB126B237AF7ULL, 0x2BA901628BB47AF8ULL } },
+    /* 37G */
+    { { 0x00467BC58CCE08B5ULL, 0xB636458C7F178D55ULL,
+        0xC5748BAEA677D806ULL, 0x2763A387DFA394EBULL },
+      { 0xA12B448A7D3CEBB6ULL, 0xE7ADDA3E6F20D850ULL,
+        0xF63EBCE51558462CULL, 0x58B36143620088A8ULL } },
+    /* 39G */
+    { { 0xA9D89488A059C142ULL, 0x6F5AE714FF0B9346ULL,
+        0x068F237D16FB3664ULL, 0x5853E4C4363186ACULL },
+      { 0xE2D87D2363C52F98ULL, 0x2EC4A76681828876ULL,
+        0x47B864FAE14E7B1CULL, 0x0C0BC0E569192408ULL } },
+    /* 41G */
+    { { 0x624D60492ED22E91ULL, 0x6FDFE0B56F072822ULL,
+        0xEECA111539CE2271ULL, 0x98100A4FDB01614FULL },
+      { 0xB6B0DAA2A35C628FULL, 0xB6F94D2EC87E9A47ULL,
+        0xC67732591D57D9CEULL, 0xF70BFEEC03884A7BULL } },
+    /* 43G */
+    { { 0x4FF23FFD248A7D06ULL, 0x80C5BFB4878873FAULL,
+        0xB7D9AD9005745981ULL, 0x179C85DB3DB01994ULL },
+      { 0xBA41B06261A6966CULL, 0x4D82D052EADCE5A8ULL,
+        0x9E91CD3BA5E6A318ULL, 0x47795F4F95B2DDA0ULL } },
+    /* 45G */
+    { { 0x1EE426CCD5CD79BFULL, 0x0032940B946C6E18ULL,
+        0x1B1E8AE057477F58ULL, 0xE94F7D346D823278ULL },
+      { 0xC747CB96782BA21AULL, 0xC5254469F72B33A5ULL,
+        0x772EF6DEC7F80C81ULL, 0xD73ACBFE2CD9E6B5ULL } },
+    /* 47G */
+    { { 0x283C7513CAA76097ULL, 0x0A624FA936C83906ULL,
+        0x6B20AFEC715AF2C7ULL, 0x4B969974EBA78BFDULL },
+      { 0x220755CCD921D60EULL, 0x9B944E107BAECA13ULL,
+        0x04819D515DED93D4ULL, 0x9BBFF86E6DDDFD27ULL } },
+    /* 49G */
+    { { 0x21950B421FF6ACD3ULL, 0xFFE7048453DC6909ULL,
+        0xFF4CD0B228766127ULL, 0xABDBE6084FB7DB2BULL },
+      { 0x837C92285E1109E8ULL, 0x26147D27F4645B5AULL,
+        0x4D78F592F7818ED8ULL, 0xD394077EF247FA36ULL } },
+    /* 51G */
+    { { 0x508CEC1C3B3F64C9ULL, 0xE20BC0BA1E5EDF3FULL,
+        0xDA1DEB852F4318D4ULL, 0xD20EBE0D5C3FA443ULL },
+      { 0x370B4EA773241EA3ULL, 0x61F1511C5E1A5F65ULL,
+        0x99A5E23D82681C62ULL, 0xD731E383A2F54C2DULL } },
+    /* 53G */
+    { { 0x97359638546C4D8DULL, 0x5F9C3FC492F24679ULL,
+        0x912E8BEDA8C8ACD9ULL, 0xEC3A318D306634B0ULL },
+      { 0x80167F41C31CB264ULL, 0x3DB82F6F522113F2ULL,
+        0xB155BCD2DCAFE197ULL, 0xFBA1DA5943465283ULL } },
+    /* 55G */
+    { { 0x258BBBF9E7305683ULL, 0x31EEA5BF07EF5BE6ULL,
+        0x0DEB0E4A46C814C1ULL, 0x5CEE8449A7B730DDULL },
+      { 0xEAB495C5A0182BDEULL, 0xEE759F879E27A6B4ULL,
+        0xC2CF6A6880E518CAULL, 0x25E8013FF14CF3F4ULL } },
+    /* 57G */
+    { { 0x3EC832E77ACACA28ULL, 0x1BFEEA57C7385B29ULL,
+        0x068212E3FD1EAF38ULL, 0xC13298306ACF8CCCULL },
+      { 0xB909F2DB2AAC9E59ULL, 0x5748060DB661782AULL,
+        0xC5AB2632C79B7A01ULL, 0xDA44C6C600017626ULL } },
+    /* 59G */
+    { { 0x69D44ED65C46AA8EULL, 0x2100D5D3A8D063D1ULL,
+        0xCB9727EAA2D17C36ULL, 0x4C2BAB1B8ADD53B7ULL },
+      { 0xA084E90C15426704ULL, 0x778AFCD3A837EBEAULL,
+        0x6651F7017CE477F8ULL, 0xA062499846FB7A8BULL } },
+    /* 61G */
+    { { 0x3667EB1A7F4C04CCULL, 0x59556621A9404F84ULL,
+        0x71CDF6537ECEB50AULL, 0x994A44A69B8335FAULL },
+      { 0xD7FAF819DBEB9B69ULL, 0x473C5680EED4350DULL,
+        0xB6658466DA44BBA2ULL, 0x0D1BC780872BDBF3ULL } },
+    /* 63G */
+    { { 0xB8D3D9319FF91FE5ULL, 0x039C4800F0518EEDULL,
+        0x95C376329182CB26ULL, 0x0763A43482FC568DULL },
+      { 0x707C04D5383E76BAULL, 0xAC98B930824E8197ULL,
+        0x92BF7C8F91230DE0ULL, 0x90876A0140959B70ULL } }
+};
+
+/*
+ * Width-w NAF of k < 2^256 (32 big-endian bytes), least significant digit
+ * first. Returns the number of digits. Not constant-time.
+ */
+static size_t p256_wnaf( signed char naf[P256_NAF_MAX_LEN],
+                         const unsigned char buf[32], int w )
+{
+    uint64_t k[5], mask = ( (uint64_t) 1 << w ) - 1, borrow, carry;
+    p256_u128 t;
+    int64_t d;
+    size_t len = 0;
+    int i;
+
+    p256_from_bytes( k, buf );
+    k[4] = 0;
+    memset( naf, 0, P256_NAF_MAX_LEN );
+
+    while( ( k[0] | k[1] | k[2] | k[3] | k[4] ) != 0 )
+    {
+        if( k[0] & 1 )
+        {
+            d = (int64_t)( k[0] & mask );
+            if( d >= ( (int64_t) 1 << ( w - 1 ) ) )
+                d -= (int64_t) 1 << w;
+            naf[len] = (signed char) d;
+
+            /* k -= d, which clears the w low bits of k */
+            if( d > 0 )
+            {
+                borrow = (uint64_t) d;
+                for( i = 0; i < 5; i++ )
+                {
+                    t = (p256_u128) k[i] - borrow;
+                    k[i] = (uint64_t) t;
+                    borrow = (uint64_t)( t >> 64 ) & 1;
+                }
+            }
+            else
+            {
+                carry = (uint64_t) -d;
+                for( i = 0; i < 5; i++ )
+                {
+                    t = (p256_u128) k[i] + carry;
+                    k[i] = (uint64_t) t;
+                    carry = (uint64_t)( t >> 64 );
+                }
+            }
+        }
+
+        len++;
+
+        for( i = 0; i < 4; i++ )
+            k[i] = ( k[i] >> 1 ) | ( k[i + 1] << 63 );
+        k[4] >>= 1;
+    }
+
+    return( len );
+}
+
+/*
+ * Interleaved (Straus) double multiplication R = m * P + n * Q with
+ * width-w NAFs: the doublings are shared by both scalars. Points equal to
+ * the generator use the constant table above; the odd multiples of the
+ * other points are computed first.
+ */
+int mbedtls_ecp_p256_muladd( mbedtls_ecp_group *grp, mbedtls_ecp_point *R,
+                             const mbedtls_mpi *m, const mbedtls_ecp_point *P,
+                             const mbedtls_mpi *n, const mbedtls_ecp_point *Q )
+{
+    int ret, started = 0;
+    const mbedtls_mpi *k[2];
+    const mbedtls_ecp_point *pt[2];
+    signed char naf[2][P256_NAF_MAX_LEN];
+    size_t len[2], i, j, max_len = 0;
+    int is_g[2], d, idx;
+    unsigned char buf[32];
+    p256_point T[2][1 << ( P256_VAR_WINDOW - 2 )], D, A, S;
+    static const p256_fe zero = { 0, 0, 0, 0 };
+
+    if( grp->id != MBEDTLS_ECP_DP_SECP256R1 )
+        return( MBEDTLS_ERR_ECP_BAD_INPUT_DATA );
+
+    k[0] = m; pt[0] = P;
+    k[1] = n; pt[1] = Q;
+
+    for( j = 0; j < 2; j++ )
+    {
+        is_g[j] = ( mbedtls_mpi_cmp_mpi( &pt[j]->X, &grp->G.X ) == 0 &&
+                    mbedtls_mpi_cmp_mpi( &pt[j]->Y, &grp->G.Y ) == 0 );
+
+        MBEDTLS_MPI_CHK( mbedtls_mpi_write_binary( k[j], buf, sizeof( buf ) ) );
+        len[j] = p256_wnaf( naf[j], buf,
+                            is_g[j] ? P256_G_WINDOW : P256_VAR_WINDOW );
+        if( len[j] > max_len )
+            max_len = len[j];
+
+        if( is_g[j] )
+            continue;
+
+        /* T[j][i] = ( 2 i + 1 ) * pt[j] */
+        MBEDTLS_MPI_CHK( p256_from_mpi( T[j][0].X, &pt[j]->X ) );
+        MBEDTLS_MPI_CHK( p256_from_mpi( T[j][0].Y, &pt[j]->Y ) );
+        memcpy( T[j][0].Z, p256_one, sizeof( p256_fe ) );
+
+        p256_double( &D, &T[j][0] );
+        for( i = 1; i < ( 1 << ( P256_VAR_WINDOW - 2 ) ); i++ )
+            p256_add_point( &T[j][i], &T[j][i - 1], &D );
+    }
+
+    memset( &S, 0, sizeof( p256_point ) );
+    memcpy( S.Y, p256_one, sizeof( p256_fe ) );
+
+    for( i = max_len; i-- > 0; )
+    {
+        if( started )
+            p256_double( &S, &S );
+
+        for( j = 0; j < 2; j++ )
+        {
+            d = naf[j][i];
+            if( d == 0 )
+                continue;
+
+            idx = ( d < 0 ? -d : d ) / 2;
+            if( is_g[j] )
+            {
+                memcpy( A.X, p256_g_odd[idx].X, sizeof( p256_fe ) );
+                memcpy( A.Y, p256_g_odd[idx].Y, sizeof( p256_fe ) );
+                memcpy( A.Z, p256_one, sizeof( p256_fe ) );
+            }
+            else
+                memcpy( &A, &T[j][idx], sizeof( p256_point ) );
+
+            if( d < 0 )
+                p256_sub( A.Y, zero, A.Y );
+
+            p256_add_point( &S, &S, &A );
+            started = 1;
+        }
+    }
+
+    MBEDTLS_MPI_CHK( p256_point_to_ecp( R, &S ) );
+
+cleanup:
+    return( ret );
+}
+
+#endif /* MBEDTLS_ECP_P256_64BIT */
+
+#endif /* MBEDTLS_ECP_C */
@@ -0,0 +1,479 @@
+/*
+ *  Elliptic curves over GF(p): dedicated Curve25519 arithmetic
+ *
+ *  Copyright (C) 2006-2015, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  This file is part of mbed TLS (https://tls.mbed.org)
+ */
+
+/*
+ * References:
+ *
+ * [Curve25519] http://cr.yp.to/ecdh/curve25519-20060209.pdf
+ * RFC 7748 for the Montgomery ladder and the X25519 function
+ */
+
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+
+#if defined(MBEDTLS_ECP_C)
+
+#include "mbedtls/ecp.h"
+#include "mbedtls/ecp_internal.h"
+
+#if defined(MBEDTLS_ECP_X25519_64BIT)
+
+#include "mbedtls/bignum.h"
+
+#include <stdint.h>
+#include <string.h>
+
+/* Implementation that should never be optimized out by the compiler */
+static void mbedtls_zeroize( void *v, size_t n ) {
+    volatile unsigned char *p = v; while( n-- ) *p++ = 0;
+}
+
+__extension__ typedef unsigned __int128 x25519_u128;
+
+/*
+ * Field elements mod p = 2^255 - 19 are 5 limbs in radix 2^51:
+ * x = f[0] + f[1] 2^51 + f[2] 2^102 + f[3] 2^153 + f[4] 2^204.
+ * Limbs are kept below 2^52 between operations, but the value is only
+ * fully reduced by x25519_fe_tobytes().
+ */
+typedef uint64_t x25519_fe[5];
+
+#define X25519_MASK51   ( ( (uint64_t) 1 << 51 ) - 1 )
+
+/* (A - 2) / 4 for Curve25519 */
+#define X25519_A24      121665
+
+/*
+ * Propagate carries so that every limb is below 2^51 (limb 0 may exceed
+ * it slightly after the final wrap-around)
+ */
+static void x25519_fe_carry( x25519_fe h )
+{
+    uint64_t c;
+
+    c = h[0] >> 51; h[0] &= X25519_MASK51; h[1] += c;
+    c = h[1] >> 51; h[1] &= X25519_MASK51; h[2] += c;
+    c = h[2] >> 51; h[2] &= X25519_MASK51; h[3] += c;
+    c = h[3] >> 51; h[3] &= X25519_MASK51; h[4] += c;
+    c = h[4] >> 51; h[4] &= X25519_MASK51; h[0] += 19 * c;
+}
+
+static void x25519_fe_add( x25519_fe h, const x25519_fe f, const x25519_fe g )
+{
+    int i;
+
+    for( i = 0; i < 5; i++ )
+        h[i] = f[i] + g[i];
+
+    x25519_fe_carry( h );
+}
+
+/*
+ * h = f - g, computed as f + 4p - g so that limbs never underflow
+ */
+static void x25519_fe_sub( x25519_fe h, const x25519_fe f, const x25519_fe g )
+{
+    h[0] = ( f[0] + 0x1FFFFFFFFFFFB4ULL ) - g[0];
+    h[1] = ( f[1] + 0x1FFFFFFFFFFFFCULL ) - g[1];
+    h[2] = ( f[2] + 0x1FFFFFFFFFFFFCULL ) - g[2];
+    h[3] = ( f[3] + 0x1FFFFFFFFFFFFCULL ) - g[3];
+    h[4] = ( f[4] + 0x1FFFFFFFFFFFFCULL ) - g[4];
+
+    x25519_fe_carry( h );
+}
+
+/*
+ * Reduce 128-bit column sums to limbs below 2^51 (plus a small excess
+ * in limb 1)
+ */
+static void x25519_fe_reduce( x25519_fe h, x25519_u128 r[5] )
+{
+    x25519_u128 t;
+
+    r[1] += (uint64_t)( r[0] >> 51 ); h[0] = (uint64_t) r[0] & X25519_MASK51;
+    r[2] += (uint64_t)( r[1] >> 51 ); h[1] = (uint64_t) r[1] & X25519_MASK51;
+    r[3] += (uint64_t)( r[2] >> 51 ); h[2] = (uint64_t) r[2] & X25519_MASK51;
+    r[4] += (uint64_t)( r[3] >> 51 ); h[3] = (uint64_t) r[3] & X25519_MASK51;
+    h[4] = (uint64_t) r[4] & X25519_MASK51;
+
+    /* 2^255 = 19 mod p */
+    t = (x25519_u128) h[0] + (x25519_u128)( r[4] >> 51 ) * 19;
+    h[0] = (uint64_t) t & X25519_MASK51;
+    h[1] += (uint64_t)( t >> 51 );
+}
+
+static void x25519_fe_mul( x25519_fe h, const x25519_fe f, const x25519_fe g )
+{
+    x25519_u128 r[5];
+    uint64_t g1_19 = 19 * g[1], g2_19 = 19 * g[2];
+    uint64_t g3_19 = 19 * g[3], g4_19 = 19 * g[4];
+
+    r[0] = (x25519_u128) f[0] * g[0] + (x25519_u128) f[1] * g4_19 +
+           (x25519_u128) f[2] * g3_19 + (x25519_u128) f[3] * g2_19 +
+           (x25519_u128) f[4] * g1_19;
+    r[1] = (x25519_u128) f[0] * g[1] + (x25519_u128) f[1] * g[0] +
+           (x25519_u128) f[2] * g4_19 + (x25519_u128) f[3] * g3_19 +
+           (x25519_u128) f[4] * g2_19;
+    r[2] = (x25519_u128) f[0] * g[2] + (x25519_u128) f[1] * g[1] +
+           (x25519_u128) f[2] * g[0] + (x25519_u128) f[3] * g4_19 +
+           (x25519_u128) f[4] * g3_19;
+    r[3] = (x25519_u128) f[0] * g[3] + (x25519_u128) f[1] * g[2] +
+           (x25519_u128) f[2] * g[1] + (x25519_u128) f[3] * g[0] +
+           (x25519_u128) f[4] * g4_19;
+    r[4] = (x25519_u128) f[0] * g[4] + (x25519_u128) f[1] * g[3] +
+           (x25519_u128) f[2] * g[2] + (x25519_u128) f[3] * g[1] +
+           (x25519_u128) f[4] * g[0];
+
+    x25519_fe_reduce( h, r );
+}
+
+static void x25519_fe_sqr( x25519_fe h, const x25519_fe f )
+{
+    x25519_u128 r[5];
+    uint64_t f0_2 = 2 * f[0], f1_2 = 2 * f[1], f2_2 = 2 * f[2];
+    uint64_t f3_2 = 2 * f[3];
+    uint64_t f3_19 = 19 * f[3], f4_19 = 19 * f[4];
+
+    r[0] = (x25519_u128) f[0] * f[0] + (x25519_u128) f1_2 * f4_19 +
+           (x25519_u128) f2_2 * f3_19;
+    r[1] = (x25519_u128) f0_2 * f[1] + (x25519_u128) f2_2 * f4_19 +
+           (x25519_u128) f[3] * f3_19;
+    r[2] = (x25519_u128) f0_2 * f[2] + (x25519_u128) f[1] * f[1] +
+           (x25519_u128) f3_2 * f4_19;
+    r[3] = (x25519_u128) f0_2 * f[3] + (x25519_u128) f1_2 * f[2] +
+           (x25519_u128) f[4] * f4_19;
+    r[4] = (x25519_u128) f0_2 * f[4] + (x25519_u128) f1_2 * f[3] +
+           (x25519_u128) f[2] * f[2];
+
+    x25519_fe_reduce( h, r );
+}
+
+/* h = f^(2^n) */
+static void x25519_fe_sqr_n( x25519_fe h, const x25519_fe f, int n )
+{
+    x25519_fe_sqr( h, f );
+    while( --n > 0 )
+        x25519_fe_sqr( h, h );
+}
+
+static void x25519_fe_mul_a24( x25519_fe h, const x25519_fe f )
+{
+    x25519_u128 r[5];
+    int i;
+
+    for( i = 0; i < 5; i++ )
+        r[i] = (x25519_u128) f[i] * X25519_A24;
+
+    x25519_fe_reduce( h, r );
+}
+
+/*
+ * h = f^-1 = f^(p - 2) = f^(2^255 - 21), with the usual addition chain
+ * (11 multiplications and 254 squarings)
+ */
+static void x25519_fe_inv( x25519_fe h, const x25519_fe f )
+{
+    x25519_fe z2, z9, z11, z2_5_0, z2_10_0, z2_20_0, z2_50_0, z2_100_0, t;
+
+    x25519_fe_sqr( z2, f );                     /* 2 */
+    x25519_fe_sqr_n( t, z2, 2 );                /* 8 */
+    x25519_fe_mul( z9, t, f );                  /* 9 */
+    x25519_fe_mul( z11, z9, z2 );               /* 11 */
+    x25519_fe_sqr( t, z11 );                    /* 22 */
+    x25519_fe_mul( z2_5_0, t, z9 );             /* 2^5 - 1 */
+
+    x25519_fe_sqr_n( t, z2_5_0, 5 );
+    x25519_fe_mul( z2_10_0, t, z2_5_0 );        /* 2^10 - 1 */
+    x25519_fe_sqr_n( t, z2_10_0, 10 );
+    x25519_fe_mul( z2_20_0, t, z2_10_0 );       /* 2^20 - 1 */
+    x25519_fe_sqr_n( t, z2_20_0, 20 );
+    x25519_fe_mul( t, t, z2_20_0 );             /* 2^40 - 1 */
+    x25519_fe_sqr_n( t, t, 10 );
+    x25519_fe_mul( z2_50_0, t, z2_10_0 );       /* 2^50 - 1 */
+    x25519_fe_sqr_n( t, z2_50_0, 50 );
+    x25519_fe_mul( z2_100_0, t, z2_50_0 );      /* 2^100 - 1 */
+    x25519_fe_sqr_n( t, z2_100_0, 100 );
+    x25519_fe_mul( t, t, z2_100_0 );            /* 2^200 - 1 */
+    x25519_fe_sqr_n( t, t, 50 );
+    x25519_fe_mul( t, t, z2_50_0 );             /* 2^250 - 1 */
+    x25519_fe_sqr_n( t, t, 5 );                 /* 2^255 - 32 */
+    x25519_fe_mul( h, t, z11 );                 /* 2^255 - 21 */
+}
+
+/*
+ * Swap f and g if swap == 1, in constant time
+ */
+static void x25519_fe_cswap( x25519_fe f, x25519_fe g, uint64_t swap )
+{
+    uint64_t mask = 0 - swap, x;
+    int i;
+
+    for( i = 0; i < 5; i++ )
+    {
+        x = mask & ( f[i] ^ g[i] );
+        f[i] ^= x;
+        g[i] ^= x;
+    }
+}
+
+/*
+ * Load a 255-bit little-endian string (the top bit is ignored)
+ */
+static void x25519_fe_frombytes( x25519_fe h, const unsigned char s[32] )
+{
+    uint64_t w[4];
+    int i, j;
+
+    for( i = 0; i < 4; i++ )
+    {
+        w[i] = 0;
+        for( j = 7; j >= 0; j-- )
+            w[i] = ( w[i] << 8 ) | s[8 * i + j];
+    }
+
+    h[0] = w[0] & X25519_MASK51;
+    h[1] = ( ( w[0] >> 51 ) | ( w[1] << 13 ) ) & X25519_MASK51;
+    h[2] = ( ( w[1] >> 38 ) | ( w[2] << 26 ) ) & X25519_MASK51;
+    h[3] = ( ( w[2] >> 25 ) | ( w[3] << 39 ) ) & X25519_MASK51;
+    h[4] = ( w[3] >> 12 ) & X25519_MASK51;
+}
+
+/*
+ * Store the fully reduced value of f as 32 little-endian bytes
+ */
+static void x25519_fe_tobytes( unsigned char s[32], const x25519_fe f )
+{
+    uint64_t t[5], w[4], q;
+    int i, j;
+
+    memcpy( t, f, sizeof( t ) );
+    x25519_fe_carry( t );
+    x25519_fe_carry( t );
+
+    /* Now 0 <= t < 2^255; subtract p once if t >= p */
+    q = ( t[0] + 19 ) >> 51;
+    q = ( t[1] + q ) >> 51;
+    q = ( t[2] + q ) >> 51;
+    q = ( t[3] + q ) >> 51;
+    q = ( t[4] + q ) >> 51;
+
+    t[0] += 19 * q;
+    t[1] += t[0] >> 51; t[0] &= X25519_MASK51;
+    t[2] += t[1] >> 51; t[1] &= X25519_MASK51;
+    t[3] += t[2] >> 51; t[2] &= X25519_MASK51;
+    t[4] += t[3] >> 51; t[3] &= X25519_MASK51;
+    t[4] &= X25519_MASK51;
+
+    w[0] = t[0]           | ( t[1] << 51 );
+    w[1] = ( t[1] >> 13 ) | ( t[2] << 38 );
+    w[2] = ( t[2] >> 26 ) | ( t[3] << 25 );
+    w[3] = ( t[3] >> 39 ) | ( t[4] << 12 );
+
+    for( i = 0; i < 4; i++ )
+        for( j = 0; j < 8; j++ )
+            s[8 * i + j] = (unsigned char)( w[i] >> ( 8 * j ) );
+
+    mbedtls_zeroize( t, sizeof( t ) );
+    mbedtls_zeroize( w, sizeof( w ) );
+}
+
+/*
+ * Conversions between mbedtls_mpi (big-endian binary) and little-endian
+ * field element encodings
+ */
+static int x25519_mpi_to_bytes( unsigned char s[32], const mbedtls_mpi *X )
+{
+    int ret;
+    unsigned char tmp;
+    size_t i;
+
+    MBEDTLS_MPI_CHK( mbedtls_mpi_write_binary( X, s, 32 ) );
+
+    for( i = 0; i < 16; i++ )
+    {
+        tmp = s[i];
+        s[i] = s[31 - i];
+        s[31 - i] = tmp;
+    }
+
+cleanup:
+    return( ret );
+}
+
+static int x25519_bytes_to_mpi( mbedtls_mpi *X, unsigned char s[32] )
+{
+    unsigned char tmp;
+    size_t i;
+
+    for( i = 0; i < 16; i++ )
+    {
+        tmp = s[i];
+        s[i] = s[31 - i];
+        s[31 - i] = tmp;
+    }
+
+    return( mbedtls_mpi_read_binary( X, s, 32 ) );
+}
+
+/*
+ * Randomize the projective representation (x : 1) -> (l x : l) of the
+ * starting point of the ladder, with l a random non-zero field element
+ */
+static int x25519_randomize( x25519_fe x3, x25519_fe z3,
+                             int (*f_rng)(void *, unsigned char *, size_t),
+                             void *p_rng )
+{
+    int ret, count = 0;
+    unsigned char buf[32], chk[32], zero[32];
+    x25519_fe l;
+
+    memset( zero, 0, sizeof( zero ) );
+
+    do
+    {
+        if( ( ret = f_rng( p_rng, buf, sizeof( buf ) ) ) != 0 )
+            goto cleanup;
+
+        x25519_fe_frombytes( l, buf );
+        x25519_fe_tobytes( chk, l );
+
+        if( count++ > 10 )
+        {
+            ret = MBEDTLS_ERR_ECP_RANDOM_FAILED;
+            goto cleanup;
+        }
+    }
+    while( memcmp( chk, zero, sizeof( chk ) ) == 0 );
+
+    x25519_fe_mul( x3, x3, l );
+    memcpy( z3, l, sizeof( x25519_fe ) );
+
+cleanup:
+    mbedtls_zeroize( buf, sizeof( buf ) );
+    mbedtls_zeroize( chk, sizeof( chk ) );
+    mbedtls_zeroize( l, sizeof( l ) );
+
+    return( ret );
+}
+
+/*
+ * Montgomery ladder on the x-coordinate only (RFC 7748 section 5), with
+ * one constant-time conditional swap per scalar bit. Same scalar bit range
+ * as ecp_mul_mxz(), that is from the most significant bit of m down.
+ */
+int mbedtls_ecp_x25519_mul( mbedtls_ecp_group *grp, mbedtls_ecp_point *R,
+                            const mbedtls_mpi *m, const mbedtls_ecp_point *P,
+                            int (*f_rng)(void *, unsigned char *, size_t),
+                            void *p_rng )
+{
+    int ret;
+    size_t i;
+    unsigned char k[32], buf[32], zero[32];
+    uint64_t swap = 0, bit;
+    x25519_fe x1, x2, z2, x3, z3, A, AA, B, BB, E, C, D, DA, CB;
+
+    if( grp->id != MBEDTLS_ECP_DP_CURVE25519 ||
+        mbedtls_mpi_bitlen( &P->X ) > 255 )
+        return( MBEDTLS_ERR_ECP_BAD_INPUT_DATA );
+
+    MBEDTLS_MPI_CHK( x25519_mpi_to_bytes( k, m ) );
+    MBEDTLS_MPI_CHK( x25519_mpi_to_bytes( buf, &P->X ) );
+    x25519_fe_frombytes( x1, buf );
+
+    /* (x2 : z2) = 0, (x3 : z3) = P */
+    memset( x2, 0, sizeof( x25519_fe ) ); x2[0] = 1;
+    memset( z2, 0, sizeof( x25519_fe ) );
+    memcpy( x3, x1, sizeof( x25519_fe ) );
+    memset( z3, 0, sizeof( x25519_fe ) ); z3[0] = 1;
+
+    if( f_rng != NULL )
+        MBEDTLS_MPI_CHK( x25519_randomize( x3, z3, f_rng, p_rng ) );
+
+    i = mbedtls_mpi_bitlen( m );
+    while( i-- > 0 )
+    {
+        bit = ( k[i / 8] >> ( i % 8 ) ) & 1;
+        swap ^= bit;
+        x25519_fe_cswap( x2, x3, swap );
+        x25519_fe_cswap( z2, z3, swap );
+        swap = bit;
+
+        x25519_fe_add( A, x2, z2 );
+        x25519_fe_sqr( AA, A );
+        x25519_fe_sub( B, x2, z2 );
+        x25519_fe_sqr( BB, B );
+        x25519_fe_sub( E, AA, BB );
+        x25519_fe_add( C, x3, z3 );
+        x25519_fe_sub( D, x3, z3 );
+        x25519_fe_mul( DA, D, A );
+        x25519_fe_mul( CB, C, B );
+
+        x25519_fe_add( x3, DA, CB );
+        x25519_fe_sqr( x3, x3 );
+        x25519_fe_sub( z3, DA, CB );
+        x25519_fe_sqr( z3, z3 );
+        x25519_fe_mul( z3, z3, x1 );
+        x25519_fe_mul( x2, AA, BB );
+        x25519_fe_mul_a24( z2, E );
+        x25519_fe_add( z2, z2, AA );
+        x25519_fe_mul( z2, z2, E );
+    }
+
+    x25519_fe_cswap( x2, x3, swap );
+    x25519_fe_cswap( z2, z3, swap );
+
+    /* The point at infinity has no affine x, like in ecp_normalize_mxz() */
+    memset( zero, 0, sizeof( zero ) );
+    x25519_fe_tobytes( buf, z2 );
+    if( memcmp( buf, zero, sizeof( buf ) ) == 0 )
+    {
+        ret = MBEDTLS_ERR_MPI_NOT_ACCEPTABLE;
+        goto cleanup;
+    }
+
+    x25519_fe_inv( z2, z2 );
+    x25519_fe_mul( x2, x2, z2 );
+    x25519_fe_tobytes( buf, x2 );
+
+    MBEDTLS_MPI_CHK( x25519_bytes_to_mpi( &R->X, buf ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_lset( &R->Z, 1 ) );
+    mbedtls_mpi_free( &R->Y );
+
+cleanup:
+    mbedtls_zeroize( k, sizeof( k ) );
+    mbedtls_zeroize( buf, sizeof( buf ) );
+    mbedtls_zeroize( x2, sizeof( x2 ) ); mbedtls_zeroize( z2, sizeof( z2 ) );
+    mbedtls_zeroize( x3, sizeof( x3 ) ); mbedtls_zeroize( z3, sizeof( z3 ) );
+    mbedtls_zeroize( A, sizeof( A ) );   mbedtls_zeroize( AA, sizeof( AA ) );
+    mbedtls_zeroize( B, sizeof( B ) );   mbedtls_zeroize( BB, sizeof( BB ) );
+    mbedtls_zeroize( E, sizeof( E ) );   mbedtls_zeroize( C, sizeof( C ) );
+    mbedtls_zeroize( D, sizeof( D ) );   mbedtls_zeroize( DA, sizeof( DA ) );
+    mbedtls_zeroize( CB, sizeof( CB ) );
+
+    return( ret );
+}
+
+#endif /* MBEDTLS_ECP_X25519_64BIT */
+
+#endif /* MBEDTLS_ECP_C */
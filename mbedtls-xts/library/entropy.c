@@ -72,6 +72,10 @@ void mbedtls_entropy_init( mbedtls_entropy_context *ctx )
 #if defined(MBEDTLS_HAVEGE_C)
     mbedtls_havege_init( &ctx->havege_data );
 #endif
+#if defined(MBEDTLS_ENTROPY_BACKGROUND)
+    pthread_mutex_init( &ctx->bg_mutex, NULL );
+    pthread_cond_init( &ctx->bg_cond, NULL );
+#endif
 
 #if !defined(MBEDTLS_NO_DEFAULT_ENTROPY_SOURCES)
 #if !defined(MBEDTLS_NO_PLATFORM_ENTROPY)
@@ -104,6 +108,11 @@ void mbedtls_entropy_init( mbedtls_entropy_context *ctx )
 
 void mbedtls_entropy_free( mbedtls_entropy_context *ctx )
 {
+#if defined(MBEDTLS_ENTROPY_BACKGROUND)
+    mbedtls_entropy_background_stop( ctx );
+    pthread_cond_destroy( &ctx->bg_cond );
+    pthread_mutex_destroy( &ctx->bg_mutex );
+#endif
 #if defined(MBEDTLS_HAVEGE_C)
     mbedtls_havege_free( &ctx->havege_data );
 #endif
@@ -268,27 +277,15 @@ int mbedtls_entropy_gather( mbedtls_entropy_context *ctx )
     return( ret );
 }
 
-int mbedtls_entropy_func( void *data, unsigned char *output, size_t len )
+/*
+ * Poll the sources until every threshold is met and extract one output
+ */
+static int entropy_func_internal( mbedtls_entropy_context *ctx,
+                                  unsigned char *output, size_t len )
 {
     int ret, count = 0, i, done;
-    mbedtls_entropy_context *ctx = (mbedtls_entropy_context *) data;
     unsigned char buf[MBEDTLS_ENTROPY_BLOCK_SIZE];
 
-    if( len > MBEDTLS_ENTROPY_BLOCK_SIZE )
-        return( MBEDTLS_ERR_ENTROPY_SOURCE_FAILED );
-
-#if defined(MBEDTLS_ENTROPY_NV_SEED)
-    /* Update the NV entropy seed before generating any entropy for outside
-     * use.
-     */
-    if( ctx->initial_entropy_run == 0 )
-    {
-        ctx->initial_entropy_run = 1;
-        if( ( ret = mbedtls_entropy_update_nv_seed( ctx ) ) != 0 )
-            return( ret );
-    }
-#endif
-
 #if defined(MBEDTLS_THREADING_C)
     if( ( ret = mbedtls_mutex_lock( &ctx->mutex ) ) != 0 )
         return( ret );
@@ -363,6 +360,169 @@ exit:
     return( ret );
 }
 
+#if defined(MBEDTLS_ENTROPY_BACKGROUND)
+/*
+ * Collector thread: keep the ring of pre-gathered outputs full
+ */
+static void *entropy_background_thread( void *data )
+{
+    mbedtls_entropy_context *ctx = (mbedtls_entropy_context *) data;
+    unsigned char buf[MBEDTLS_ENTROPY_BLOCK_SIZE];
+    int ret;
+
+    pthread_mutex_lock( &ctx->bg_mutex );
+
+    for( ;; )
+    {
+        while( ! ctx->bg_stop &&
+               ctx->bg_count == MBEDTLS_ENTROPY_BACKGROUND_SLOTS )
+        {
+            pthread_cond_wait( &ctx->bg_cond, &ctx->bg_mutex );
+        }
+
+        if( ctx->bg_stop )
+            break;
+
+        /* Poll without holding bg_mutex so that callers never wait on it */
+        pthread_mutex_unlock( &ctx->bg_mutex );
+        ret = entropy_func_internal( ctx, buf, MBEDTLS_ENTROPY_BLOCK_SIZE );
+        pthread_mutex_lock( &ctx->bg_mutex );
+
+        /* On failure callers poll the sources themselves and see the error */
+        if( ret != 0 )
+            break;
+
+        memcpy( ctx->bg_ring[ctx->bg_count++], buf, MBEDTLS_ENTROPY_BLOCK_SIZE );
+    }
+
+    /* Lets mbedtls_entropy_background_start() run a new thread */
+    ctx->bg_running = 0;
+
+    pthread_mutex_unlock( &ctx->bg_mutex );
+
+    mbedtls_zeroize( buf, sizeof( buf ) );
+
+    return( NULL );
+}
+
+/*
+ * Hand out one pre-gathered output, if any. Returns 1 on success.
+ */
+static int entropy_background_take( mbedtls_entropy_context *ctx,
+                                    unsigned char *output, size_t len )
+{
+    unsigned char *p;
+    int taken = 0;
+
+    if( pthread_mutex_lock( &ctx->bg_mutex ) != 0 )
+        return( 0 );
+
+    if( ctx->bg_count > 0 )
+    {
+        p = ctx->bg_ring[--ctx->bg_count];
+        memcpy( output, p, len );
+        mbedtls_zeroize( p, MBEDTLS_ENTROPY_BLOCK_SIZE );
+
+        pthread_cond_signal( &ctx->bg_cond );
+        taken = 1;
+    }
+
+    pthread_mutex_unlock( &ctx->bg_mutex );
+
+    return( taken );
+}
+
+int mbedtls_entropy_background_start( mbedtls_entropy_context *ctx )
+{
+    int ret = 0;
+
+    if( pthread_mutex_lock( &ctx->bg_mutex ) != 0 )
+        return( MBEDTLS_ERR_THREADING_MUTEX_ERROR );
+
+    if( ! ctx->bg_running )
+    {
+        /* A thread that exited on error released bg_mutex for good */
+        if( ctx->bg_joinable )
+        {
+            pthread_join( ctx->bg_thread, NULL );
+            ctx->bg_joinable = 0;
+        }
+
+        ctx->bg_stop = 0;
+
+        if( pthread_create( &ctx->bg_thread, NULL,
+                            entropy_background_thread, ctx ) != 0 )
+            ret = MBEDTLS_ERR_THREADING_FEATURE_UNAVAILABLE;
+        else
+            ctx->bg_running = ctx->bg_joinable = 1;
+    }
+
+    if( pthread_mutex_unlock( &ctx->bg_mutex ) != 0 )
+        return( MBEDTLS_ERR_THREADING_MUTEX_ERROR );
+
+    return( ret );
+}
+
+void mbedtls_entropy_background_stop( mbedtls_entropy_context *ctx )
+{
+    pthread_t thread;
+    int joinable;
+
+    if( pthread_mutex_lock( &ctx->bg_mutex ) != 0 )
+        return;
+
+    /* Also join a thread that already exited on error */
+    thread = ctx->bg_thread;
+    joinable = ctx->bg_joinable;
+    ctx->bg_joinable = 0;
+    ctx->bg_stop = 1;
+    pthread_cond_broadcast( &ctx->bg_cond );
+
+    pthread_mutex_unlock( &ctx->bg_mutex );
+
+    if( joinable )
+        pthread_join( thread, NULL );
+
+    pthread_mutex_lock( &ctx->bg_mutex );
+
+    ctx->bg_running = 0;
+    ctx->bg_count = 0;
+    mbedtls_zeroize( ctx->bg_ring, sizeof( ctx->bg_ring ) );
+
+    pthread_mutex_unlock( &ctx->bg_mutex );
+}
+#endif /* MBEDTLS_ENTROPY_BACKGROUND */
+
+int mbedtls_entropy_func( void *data, unsigned char *output, size_t len )
+{
+    mbedtls_entropy_context *ctx = (mbedtls_entropy_context *) data;
+#if defined(MBEDTLS_ENTROPY_NV_SEED)
+    int ret;
+#endif
+
+    if( len > MBEDTLS_ENTROPY_BLOCK_SIZE )
+        return( MBEDTLS_ERR_ENTROPY_SOURCE_FAILED );
+
+#if defined(MBEDTLS_ENTROPY_NV_SEED)
+    /* Update the NV entropy seed before generating any entropy for outside
+     * use.
+     */
+    if( ctx->initial_entropy_run == 0 )
+    {
+        ctx->initial_entropy_run = 1;
+        if( ( ret = mbedtls_entropy_update_nv_seed( ctx ) ) != 0 )
+            return( ret );
+    }
+#endif
+
+#if defined(MBEDTLS_ENTROPY_BACKGROUND)
+    if( entropy_background_take( ctx, output, len ) )
+        return( 0 );
+#endif
+
+    return( entropy_func_internal( ctx, output, len ) );
+}
+
 #if defined(MBEDTLS_ENTROPY_NV_SEED)
 int mbedtls_entropy_update_nv_seed( mbedtls_entropy_context *ctx )
 {
@@ -435,6 +435,8 @@ void mbedtls_strerror( int ret, char *buf, size_t buflen )
             mbedtls_snprintf( buf, buflen, "SSL - The client initiated a reconnect from the same port" );
         if( use_ret == -(MBEDTLS_ERR_SSL_UNEXPECTED_RECORD) )
             mbedtls_snprintf( buf, buflen, "SSL - Record header looks valid but is not expected" );
+        if( use_ret == -(MBEDTLS_ERR_SSL_WANT_ASYNC) )
+            mbedtls_snprintf( buf, buflen, "SSL - An asynchronous private key operation is in progress" );
 #endif /* MBEDTLS_SSL_TLS_C */
 
 #if defined(MBEDTLS_X509_USE_C) || defined(MBEDTLS_X509_CREATE_C)
@@ -587,6 +589,10 @@ void mbedtls_strerror( int ret, char *buf, size_t buflen )
         mbedtls_snprintf( buf, buflen, "CTR_DRBG - Input too large (Entropy + additional)" );
     if( use_ret == -(MBEDTLS_ERR_CTR_DRBG_FILE_IO_ERROR) )
         mbedtls_snprintf( buf, buflen, "CTR_DRBG - Read/write error in file" );
+    if( use_ret == -(MBEDTLS_ERR_CTR_DRBG_ALLOC_FAILED) )
+        mbedtls_snprintf( buf, buflen, "CTR_DRBG - Failed to allocate memory for the instances" );
+    if( use_ret == -(MBEDTLS_ERR_CTR_DRBG_BAD_INPUT_DATA) )
+        mbedtls_snprintf( buf, buflen, "CTR_DRBG - Bad input parameters to function" );
 #endif /* MBEDTLS_CTR_DRBG_C */
 
 #if defined(MBEDTLS_DES_C)
@@ -648,6 +654,8 @@ void mbedtls_strerror( int ret, char *buf, size_t buflen )
         mbedtls_snprintf( buf, buflen, "NET - Buffer is too small to hold the data" );
     if( use_ret == -(MBEDTLS_ERR_NET_INVALID_CONTEXT) )
         mbedtls_snprintf( buf, buflen, "NET - The context is invalid, eg because it was free()ed" );
+    if( use_ret == -(MBEDTLS_ERR_NET_POLL_FAILED) )
+        mbedtls_snprintf( buf, buflen, "NET - Waiting for socket events failed" );
 #endif /* MBEDTLS_NET_C */
 
 #if defined(MBEDTLS_OID_C)
@@ -669,6 +677,8 @@ void mbedtls_strerror( int ret, char *buf, size_t buflen )
         mbedtls_snprintf( buf, buflen, "THREADING - Bad input parameters to function" );
     if( use_ret == -(MBEDTLS_ERR_THREADING_MUTEX_ERROR) )
         mbedtls_snprintf( buf, buflen, "THREADING - Locking / unlocking / free failed with error code" );
+    if( use_ret == -(MBEDTLS_ERR_THREADING_ALLOC_FAILED) )
+        mbedtls_snprintf( buf, buflen, "THREADING - Failed to allocate memory for the thread pool" );
 #endif /* MBEDTLS_THREADING_C */
 
 #if defined(MBEDTLS_XTEA_C)
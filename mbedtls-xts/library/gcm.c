@@ -187,9 +187,71 @@ int mbedtls_gcm_setkey( mbedtls_gcm_context *ctx,
     if( ( ret = gcm_gen_table( ctx ) ) != 0 )
         return( ret );
 
+#if defined(MBEDTLS_AES_OFFLOAD)
+    /* The key copy of a previous offload would no longer match */
+    (void) mbedtls_gcm_set_offload( ctx, NULL, NULL, 0 );
+#endif
+
     return( 0 );
 }
 
+#if defined(MBEDTLS_AES_OFFLOAD)
+int mbedtls_gcm_set_offload( mbedtls_gcm_context *ctx,
+                             mbedtls_aes_offload_context *offload,
+                             const unsigned char *key,
+                             unsigned int keybits )
+{
+    int ret;
+    mbedtls_aes_context aes;
+    unsigned char h[16], ref[16], diff;
+    size_t i;
+
+    mbedtls_zeroize( ctx->key, sizeof( ctx->key ) );
+    ctx->keybits = 0;
+    ctx->offload = NULL;
+
+    if( offload == NULL )
+        return( 0 );
+
+    if( ctx->cipher_ctx.cipher_info == NULL ||
+        ctx->cipher_ctx.cipher_info != mbedtls_cipher_info_from_values(
+                        MBEDTLS_CIPHER_ID_AES, keybits, MBEDTLS_MODE_ECB ) )
+    {
+        return( MBEDTLS_ERR_GCM_BAD_INPUT );
+    }
+
+    /* The key must be the one given to mbedtls_gcm_setkey(): check that it
+     * gives the same H = E(K, 0^128) */
+    mbedtls_aes_init( &aes );
+    memset( h, 0, 16 );
+    if( ( ret = mbedtls_aes_setkey_enc( &aes, key, keybits ) ) == 0 )
+        ret = mbedtls_aes_crypt_ecb( &aes, MBEDTLS_AES_ENCRYPT, h, h );
+    mbedtls_aes_free( &aes );
+
+    PUT_UINT32_BE( ctx->HH[8] >> 32, ref,  0 );
+    PUT_UINT32_BE( ctx->HH[8],       ref,  4 );
+    PUT_UINT32_BE( ctx->HL[8] >> 32, ref,  8 );
+    PUT_UINT32_BE( ctx->HL[8],       ref, 12 );
+
+    for( diff = 0, i = 0; i < 16; i++ )
+        diff |= h[i] ^ ref[i];
+
+    mbedtls_zeroize( h, sizeof( h ) );
+    mbedtls_zeroize( ref, sizeof( ref ) );
+
+    if( ret != 0 )
+        return( ret );
+    if( diff != 0 )
+        return( MBEDTLS_ERR_GCM_BAD_INPUT );
+
+    memcpy( ctx->key, key, keybits / 8 );
+    ctx->keybits = keybits;
+    ctx->offload = offload;
+
+    return( 0 );
+}
+#endif /* MBEDTLS_AES_OFFLOAD */
+
 /*
  * Shoup's method for multiplication use this table with
  *      last4[x] = x times P^128
@@ -344,6 +406,71 @@ int mbedtls_gcm_starts( mbedtls_gcm_context *ctx,
     return( 0 );
 }
 
+#if defined(MBEDTLS_AES_OFFLOAD)
+/*
+ * Fold data into the GHASH state, 16 bytes at a time
+ */
+static void gcm_ghash( mbedtls_gcm_context *ctx,
+                       const unsigned char *p, size_t length )
+{
+    size_t i, use_len;
+
+    while( length > 0 )
+    {
+        use_len = ( length < 16 ) ? length : 16;
+
+        for( i = 0; i < use_len; i++ )
+            ctx->buf[i] ^= p[i];
+
+        gcm_mult( ctx, ctx->buf, ctx->buf );
+
+        length -= use_len;
+        p += use_len;
+    }
+}
+
+/*
+ * Same as the loop of mbedtls_gcm_update(), with the counter mode part done
+ * by the offload context in one request. Returns 1 without touching the
+ * context when the request can't be expressed as plain AES-CTR, that is when
+ * the 32-bit GCM counter would wrap.
+ */
+static int gcm_update_offload( mbedtls_gcm_context *ctx,
+                               size_t length,
+                               const unsigned char *input,
+                               unsigned char *output )
+{
+    int ret;
+    uint32_t ctr;
+    uint64_t blocks = ( (uint64_t) length + 15 ) / 16;
+    unsigned char nonce_counter[16];
+
+    GET_UINT32_BE( ctr, ctx->y, 12 );
+    if( (uint64_t) ctr + blocks > 0xFFFFFFFF )
+        return( 1 );
+
+    memcpy( nonce_counter, ctx->y, 12 );
+    PUT_UINT32_BE( ctr + 1, nonce_counter, 12 );
+
+    if( ctx->mode == MBEDTLS_GCM_DECRYPT )
+        gcm_ghash( ctx, input, length );
+
+    if( ( ret = mbedtls_aes_offload_crypt_ctr( ctx->offload, ctx->key,
+                                               ctx->keybits, nonce_counter,
+                                               length, input, output ) ) != 0 )
+    {
+        return( ret );
+    }
+
+    if( ctx->mode == MBEDTLS_GCM_ENCRYPT )
+        gcm_ghash( ctx, output, length );
+
+    PUT_UINT32_BE( ctr + (uint32_t) blocks, ctx->y, 12 );
+
+    return( 0 );
+}
+#endif /* MBEDTLS_AES_OFFLOAD */
+
 int mbedtls_gcm_update( mbedtls_gcm_context *ctx,
                 size_t length,
                 const unsigned char *input,
@@ -369,6 +496,16 @@ int mbedtls_gcm_update( mbedtls_gcm_context *ctx,
 
     ctx->len += length;
 
+#if defined(MBEDTLS_AES_OFFLOAD)
+    if( ctx->offload != NULL && length >= ctx->offload->threshold &&
+        ctx->offload->f_ctr != NULL )
+    {
+        ret = gcm_update_offload( ctx, length, input, output );
+        if( ret != 1 )
+            return( ret );
+    }
+#endif
+
     p = input;
     while( length > 0 )
     {
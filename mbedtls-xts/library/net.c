@@ -77,12 +77,17 @@ static int wsa_init_done = 0;
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <signal.h>
 #include <fcntl.h>
 #include <netdb.h>
 #include <errno.h>
 
+#if defined(MBEDTLS_NET_POLLER)
+#include <sys/epoll.h>
+#endif
+
 #endif /* ( _WIN32 || _WIN32_WCE ) && !EFIX64 && !EFI32 */
 
 /* Some MS functions want int and MSVC warns if we pass size_t,
@@ -179,13 +184,19 @@ int mbedtls_net_connect( mbedtls_net_context *ctx, const char *host, const char
 }
 
 /*
- * Create a listening socket on bind_ip:port
+ * Create a listening socket on bind_ip:port, possibly shared with others
  */
-int mbedtls_net_bind( mbedtls_net_context *ctx, const char *bind_ip, const char *port, int proto )
+static int net_bind( mbedtls_net_context *ctx, const char *bind_ip,
+                     const char *port, int proto, int reuseport )
 {
     int n, ret;
     struct addrinfo hints, *addr_list, *cur;
 
+#if !defined(SO_REUSEPORT)
+    if( reuseport )
+        return( MBEDTLS_ERR_NET_SOCKET_FAILED );
+#endif
+
     if( ( ret = net_prepare() ) != 0 )
         return( ret );
 
@@ -221,6 +232,17 @@ int mbedtls_net_bind( mbedtls_net_context *ctx, const char *bind_ip, const char
             continue;
         }
 
+#if defined(SO_REUSEPORT)
+        if( reuseport &&
+            setsockopt( ctx->fd, SOL_SOCKET, SO_REUSEPORT,
+                        (const char *) &n, sizeof( n ) ) != 0 )
+        {
+            close( ctx->fd );
+            ret = MBEDTLS_ERR_NET_SOCKET_FAILED;
+            continue;
+        }
+#endif
+
         if( bind( ctx->fd, cur->ai_addr, MSVC_INT_CAST cur->ai_addrlen ) != 0 )
         {
             close( ctx->fd );
@@ -250,6 +272,17 @@ int mbedtls_net_bind( mbedtls_net_context *ctx, const char *bind_ip, const char
 
 }
 
+int mbedtls_net_bind( mbedtls_net_context *ctx, const char *bind_ip, const char *port, int proto )
+{
+    return( net_bind( ctx, bind_ip, port, proto, 0 ) );
+}
+
+int mbedtls_net_bind_reuseport( mbedtls_net_context *ctx, const char *bind_ip,
+                                const char *port, int proto )
+{
+    return( net_bind( ctx, bind_ip, port, proto, 1 ) );
+}
+
 #if ( defined(_WIN32) || defined(_WIN32_WCE) ) && !defined(EFIX64) && \
     !defined(EFI32)
 /*
@@ -569,6 +602,54 @@ int mbedtls_net_send( void *ctx, const unsigned char *buf, size_t len )
     return( ret );
 }
 
+/*
+ * Write the concatenation of several buffers at once
+ */
+int mbedtls_net_send_vec( void *ctx, const mbedtls_ssl_iovec *iov,
+                          size_t iovcnt )
+{
+#if ( defined(_WIN32) || defined(_WIN32_WCE) ) && !defined(EFIX64) && \
+    !defined(EFI32)
+    /* Partial writes are allowed: send the first buffer only */
+    return( mbedtls_net_send( ctx, iov[0].buf, iov[0].len ) );
+#else
+    int ret;
+    int fd = ((mbedtls_net_context *) ctx)->fd;
+    struct iovec vec[MBEDTLS_NET_IOV_MAX];
+    size_t i;
+
+    if( fd < 0 )
+        return( MBEDTLS_ERR_NET_INVALID_CONTEXT );
+
+    if( iovcnt > MBEDTLS_NET_IOV_MAX )
+        iovcnt = MBEDTLS_NET_IOV_MAX;
+
+    for( i = 0; i < iovcnt; i++ )
+    {
+        vec[i].iov_base = (void *) iov[i].buf;
+        vec[i].iov_len  = iov[i].len;
+    }
+
+    ret = (int) writev( fd, vec, (int) iovcnt );
+
+    if( ret < 0 )
+    {
+        if( net_would_block( ctx ) != 0 )
+            return( MBEDTLS_ERR_SSL_WANT_WRITE );
+
+        if( errno == EPIPE || errno == ECONNRESET )
+            return( MBEDTLS_ERR_NET_CONN_RESET );
+
+        if( errno == EINTR )
+            return( MBEDTLS_ERR_SSL_WANT_WRITE );
+
+        return( MBEDTLS_ERR_NET_SEND_FAILED );
+    }
+
+    return( ret );
+#endif /* ( _WIN32 || _WIN32_WCE ) && !EFIX64 && !EFI32 */
+}
+
 /*
  * Gracefully close the connection
  */
@@ -583,4 +664,103 @@ void mbedtls_net_free( mbedtls_net_context *ctx )
     ctx->fd = -1;
 }
 
+#if defined(MBEDTLS_NET_POLLER)
+/*
+ * Edge-triggered readiness notification with epoll
+ */
+void mbedtls_net_poller_init( mbedtls_net_poller *poller )
+{
+    poller->fd = -1;
+}
+
+int mbedtls_net_poller_setup( mbedtls_net_poller *poller )
+{
+    int ret;
+
+    if( ( ret = net_prepare() ) != 0 )
+        return( ret );
+
+    if( ( poller->fd = epoll_create1( EPOLL_CLOEXEC ) ) < 0 )
+        return( MBEDTLS_ERR_NET_SOCKET_FAILED );
+
+    return( 0 );
+}
+
+int mbedtls_net_poller_add( mbedtls_net_poller *poller,
+                            mbedtls_net_context *ctx, void *data )
+{
+    struct epoll_event ev;
+
+    memset( &ev, 0, sizeof( ev ) );
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = data;
+
+    if( epoll_ctl( poller->fd, EPOLL_CTL_ADD, ctx->fd, &ev ) != 0 )
+        return( MBEDTLS_ERR_NET_POLL_FAILED );
+
+    return( 0 );
+}
+
+int mbedtls_net_poller_del( mbedtls_net_poller *poller,
+                            mbedtls_net_context *ctx )
+{
+    struct epoll_event ev;
+
+    /* Non-NULL event for kernels before 2.6.9 */
+    memset( &ev, 0, sizeof( ev ) );
+
+    if( epoll_ctl( poller->fd, EPOLL_CTL_DEL, ctx->fd, &ev ) != 0 )
+        return( MBEDTLS_ERR_NET_POLL_FAILED );
+
+    return( 0 );
+}
+
+int mbedtls_net_poller_wait( mbedtls_net_poller *poller,
+                             mbedtls_net_poll_event *events,
+                             size_t max_events, uint32_t timeout )
+{
+    struct epoll_event ev[64];
+    int ret, i;
+
+    if( max_events > sizeof( ev ) / sizeof( ev[0] ) )
+        max_events = sizeof( ev ) / sizeof( ev[0] );
+
+    ret = epoll_wait( poller->fd, ev, (int) max_events,
+                      timeout == 0 ? -1 : (int) timeout );
+
+    if( ret < 0 )
+    {
+        if( errno == EINTR )
+            return( 0 );
+
+        return( MBEDTLS_ERR_NET_POLL_FAILED );
+    }
+
+    for( i = 0; i < ret; i++ )
+    {
+        events[i].data = ev[i].data.ptr;
+        events[i].events = 0;
+
+        if( ev[i].events & EPOLLIN )
+            events[i].events |= MBEDTLS_NET_POLL_READ;
+        if( ev[i].events & EPOLLOUT )
+            events[i].events |= MBEDTLS_NET_POLL_WRITE;
+        if( ev[i].events & ( EPOLLRDHUP | EPOLLHUP | EPOLLERR ) )
+            events[i].events |= MBEDTLS_NET_POLL_HUP;
+    }
+
+    return( ret );
+}
+
+void mbedtls_net_poller_free( mbedtls_net_poller *poller )
+{
+    if( poller->fd == -1 )
+        return;
+
+    close( poller->fd );
+
+    poller->fd = -1;
+}
+#endif /* MBEDTLS_NET_POLLER */
+
 #endif /* MBEDTLS_NET_C */
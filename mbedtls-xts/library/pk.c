@@ -39,6 +39,14 @@
 #include "mbedtls/ecdsa.h"
 #endif
 
+#if defined(MBEDTLS_PLATFORM_C)
+#include "mbedtls/platform.h"
+#else
+#include <stdlib.h>
+#define mbedtls_calloc    calloc
+#define mbedtls_free       free
+#endif
+
 /* Implementation that should never be optimized out by the compiler */
 static void mbedtls_zeroize( void *v, size_t n ) {
     volatile unsigned char *p = v; while( n-- ) *p++ = 0;
@@ -189,6 +197,176 @@ int mbedtls_pk_verify( mbedtls_pk_context *ctx, mbedtls_md_type_t md_alg,
                                        sig, sig_len ) );
 }
 
+/*
+ * Verify a batch of signatures
+ */
+int mbedtls_pk_verify_batch( mbedtls_pk_verify_item *items, size_t count,
+                             struct mbedtls_threading_pool *pool )
+{
+    size_t i, j, n, *idx = NULL;
+#if defined(MBEDTLS_RSA_C)
+    mbedtls_rsa_verify_item *rsa = NULL;
+    mbedtls_rsa_context *rsa_ctx;
+#endif
+#if defined(MBEDTLS_ECDSA_C)
+    mbedtls_ecdsa_verify_item *ecdsa = NULL;
+    mbedtls_ecp_group *grp;
+    size_t n_ec = 0, rest, hash_len, *ec_idx;
+#endif
+
+    if( count == 0 )
+        return( 0 );
+
+    if( ( idx = mbedtls_calloc( 2 * count, sizeof( size_t ) ) ) == NULL )
+        goto fallback;
+
+#if defined(MBEDTLS_RSA_C)
+    if( ( rsa = mbedtls_calloc( count, sizeof( *rsa ) ) ) == NULL )
+        goto fallback;
+#endif
+#if defined(MBEDTLS_ECDSA_C)
+    if( ( ecdsa = mbedtls_calloc( count, sizeof( *ecdsa ) ) ) == NULL )
+        goto fallback;
+    ec_idx = idx + count;
+#endif
+
+    /*
+     * Sort items by key type, verifying directly those with no batch
+     * support (e.g. RSA-alt) or with invalid parameters
+     */
+    n = 0;
+    for( i = 0; i < count; i++ )
+    {
+        mbedtls_pk_context *ctx = items[i].pk;
+        size_t md_len = items[i].hash_len;
+
+        if( ctx == NULL || ctx->pk_info == NULL ||
+            pk_hashlen_helper( items[i].md_alg, &md_len ) != 0 )
+        {
+            items[i].ret = MBEDTLS_ERR_PK_BAD_INPUT_DATA;
+            continue;
+        }
+
+#if defined(MBEDTLS_RSA_C)
+        if( ctx->pk_info->type == MBEDTLS_PK_RSA )
+        {
+            rsa_ctx = mbedtls_pk_rsa( *ctx );
+
+            if( items[i].sig_len < rsa_ctx->len )
+            {
+                items[i].ret = MBEDTLS_ERR_RSA_VERIFY_FAILED;
+                continue;
+            }
+
+            rsa[n].ctx = rsa_ctx;
+            rsa[n].md_alg = items[i].md_alg;
+            rsa[n].hashlen = (unsigned int) md_len;
+            rsa[n].hash = items[i].hash;
+            rsa[n].sig = items[i].sig;
+            idx[n++] = i;
+            continue;
+        }
+#endif
+#if defined(MBEDTLS_ECDSA_C)
+        if( ctx->pk_info->type == MBEDTLS_PK_ECKEY ||
+            ctx->pk_info->type == MBEDTLS_PK_ECDSA )
+        {
+            ec_idx[n_ec++] = i;
+            continue;
+        }
+#endif
+
+        items[i].ret = mbedtls_pk_verify( ctx, items[i].md_alg,
+                                          items[i].hash, items[i].hash_len,
+                                          items[i].sig, items[i].sig_len );
+    }
+
+#if defined(MBEDTLS_RSA_C)
+    if( n > 0 )
+        (void) mbedtls_rsa_pkcs1_verify_batch( rsa, n, pool );
+
+    for( j = 0; j < n; j++ )
+    {
+        i = idx[j];
+        items[i].ret = rsa[j].ret;
+
+        if( items[i].ret == 0 && items[i].sig_len > rsa[j].ctx->len )
+            items[i].ret = MBEDTLS_ERR_PK_SIG_LEN_MISMATCH;
+    }
+#endif
+
+#if defined(MBEDTLS_ECDSA_C)
+    /*
+     * One batch per curve, with the group of its first key
+     */
+    while( n_ec > 0 )
+    {
+        grp = &mbedtls_pk_ec( *items[ec_idx[0]].pk )->grp;
+
+        for( j = n = rest = 0; j < n_ec; j++ )
+        {
+            i = ec_idx[j];
+
+            if( mbedtls_pk_ec( *items[i].pk )->grp.id != grp->id )
+            {
+                ec_idx[rest++] = i;
+                continue;
+            }
+
+            hash_len = items[i].hash_len;
+            (void) pk_hashlen_helper( items[i].md_alg, &hash_len );
+
+            ecdsa[n].Q = &mbedtls_pk_ec( *items[i].pk )->Q;
+            ecdsa[n].hash = items[i].hash;
+            ecdsa[n].hlen = hash_len;
+            ecdsa[n].sig = items[i].sig;
+            ecdsa[n].slen = items[i].sig_len;
+            idx[n++] = i;
+        }
+
+        (void) mbedtls_ecdsa_read_signature_batch( grp, ecdsa, n, pool );
+
+        for( j = 0; j < n; j++ )
+        {
+            i = idx[j];
+            items[i].ret = ecdsa[j].ret;
+
+            if( items[i].ret == MBEDTLS_ERR_ECP_SIG_LEN_MISMATCH )
+                items[i].ret = MBEDTLS_ERR_PK_SIG_LEN_MISMATCH;
+        }
+
+        n_ec = rest;
+    }
+#endif
+
+    goto cleanup;
+
+fallback:
+    /* Out of memory for the batch: one signature at a time */
+    for( i = 0; i < count; i++ )
+        items[i].ret = mbedtls_pk_verify( items[i].pk, items[i].md_alg,
+                                          items[i].hash, items[i].hash_len,
+                                          items[i].sig, items[i].sig_len );
+
+cleanup:
+    mbedtls_free( idx );
+#if defined(MBEDTLS_RSA_C)
+    mbedtls_free( rsa );
+#endif
+#if defined(MBEDTLS_ECDSA_C)
+    mbedtls_free( ecdsa );
+#endif
+#if !defined(MBEDTLS_THREADING_PTHREAD)
+    ((void) pool);
+#endif
+
+    for( i = 0; i < count; i++ )
+        if( items[i].ret != 0 )
+            return( items[i].ret );
+
+    return( 0 );
+}
+
 /*
  * Verify a signature with options
  */
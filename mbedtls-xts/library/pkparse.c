@@ -645,7 +645,7 @@ static int pk_parse_key_pkcs1_der( mbedtls_rsa_context *rsa,
 {
     int ret;
     size_t len;
-    unsigned char *p, *end;
+    unsigned char *p, *end, *end2;
 
     p = (unsigned char *) key;
     end = p + keylen;
@@ -679,7 +679,7 @@ static int pk_parse_key_pkcs1_der( mbedtls_rsa_context *rsa,
         return( MBEDTLS_ERR_PK_KEY_INVALID_FORMAT + ret );
     }
 
-    if( rsa->ver != 0 )
+    if( rsa->ver != 0 && rsa->ver != 1 )
     {
         return( MBEDTLS_ERR_PK_KEY_INVALID_VERSION );
     }
@@ -697,6 +697,54 @@ static int pk_parse_key_pkcs1_der( mbedtls_rsa_context *rsa,
         return( MBEDTLS_ERR_PK_KEY_INVALID_FORMAT + ret );
     }
 
+    /*
+     * Version 1 (multi-prime) keys have
+     *
+     *  OtherPrimeInfos ::= SEQUENCE SIZE(1..MAX) OF OtherPrimeInfo
+     *
+     *  OtherPrimeInfo ::= SEQUENCE {
+     *      prime             INTEGER,  -- ri
+     *      exponent          INTEGER,  -- di
+     *      coefficient       INTEGER   -- ti
+     *  }
+     *
+     * of which only one, for three-prime keys, is supported.
+     */
+    if( rsa->ver == 1 )
+    {
+        if( ( ret = mbedtls_asn1_get_tag( &p, end, &len,
+                MBEDTLS_ASN1_CONSTRUCTED | MBEDTLS_ASN1_SEQUENCE ) ) != 0 ||
+            ( ret = mbedtls_asn1_get_tag( &p, end, &len,
+                MBEDTLS_ASN1_CONSTRUCTED | MBEDTLS_ASN1_SEQUENCE ) ) != 0 )
+        {
+            mbedtls_rsa_free( rsa );
+            return( MBEDTLS_ERR_PK_KEY_INVALID_FORMAT + ret );
+        }
+
+        end2 = p + len;
+
+        if( ( ret = mbedtls_asn1_get_mpi( &p, end2, &rsa->R  ) ) != 0 ||
+            ( ret = mbedtls_asn1_get_mpi( &p, end2, &rsa->DR ) ) != 0 ||
+            ( ret = mbedtls_asn1_get_mpi( &p, end2, &rsa->TR ) ) != 0 )
+        {
+            mbedtls_rsa_free( rsa );
+            return( MBEDTLS_ERR_PK_KEY_INVALID_FORMAT + ret );
+        }
+
+        if( p != end2 )
+        {
+            mbedtls_rsa_free( rsa );
+            return( MBEDTLS_ERR_PK_KEY_INVALID_FORMAT +
+                    MBEDTLS_ERR_ASN1_LENGTH_MISMATCH );
+        }
+
+        if( p != end )
+        {
+            mbedtls_rsa_free( rsa );
+            return( MBEDTLS_ERR_PK_FEATURE_UNAVAILABLE );
+        }
+    }
+
     rsa->len = mbedtls_mpi_size( &rsa->N );
 
     if( p != end )
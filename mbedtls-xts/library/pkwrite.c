@@ -207,6 +207,23 @@ int mbedtls_pk_write_key_der( mbedtls_pk_context *key, unsigned char *buf, size_
     {
         mbedtls_rsa_context *rsa = mbedtls_pk_rsa( *key );
 
+        if( rsa->R.p != NULL )
+        {
+            size_t info_len = 0;
+
+            /* otherPrimeInfos, with the single OtherPrimeInfo of R */
+            MBEDTLS_ASN1_CHK_ADD( info_len, mbedtls_asn1_write_mpi( &c, buf, &rsa->TR ) );
+            MBEDTLS_ASN1_CHK_ADD( info_len, mbedtls_asn1_write_mpi( &c, buf, &rsa->DR ) );
+            MBEDTLS_ASN1_CHK_ADD( info_len, mbedtls_asn1_write_mpi( &c, buf, &rsa->R ) );
+            MBEDTLS_ASN1_CHK_ADD( info_len, mbedtls_asn1_write_len( &c, buf, info_len ) );
+            MBEDTLS_ASN1_CHK_ADD( info_len, mbedtls_asn1_write_tag( &c, buf, MBEDTLS_ASN1_CONSTRUCTED |
+                                                        MBEDTLS_ASN1_SEQUENCE ) );
+            MBEDTLS_ASN1_CHK_ADD( info_len, mbedtls_asn1_write_len( &c, buf, info_len ) );
+            MBEDTLS_ASN1_CHK_ADD( info_len, mbedtls_asn1_write_tag( &c, buf, MBEDTLS_ASN1_CONSTRUCTED |
+                                                        MBEDTLS_ASN1_SEQUENCE ) );
+            len += info_len;
+        }
+
         MBEDTLS_ASN1_CHK_ADD( len, mbedtls_asn1_write_mpi( &c, buf, &rsa->QP ) );
         MBEDTLS_ASN1_CHK_ADD( len, mbedtls_asn1_write_mpi( &c, buf, &rsa->DQ ) );
         MBEDTLS_ASN1_CHK_ADD( len, mbedtls_asn1_write_mpi( &c, buf, &rsa->DP ) );
@@ -215,7 +232,8 @@ int mbedtls_pk_write_key_der( mbedtls_pk_context *key, unsigned char *buf, size_
         MBEDTLS_ASN1_CHK_ADD( len, mbedtls_asn1_write_mpi( &c, buf, &rsa->D ) );
         MBEDTLS_ASN1_CHK_ADD( len, mbedtls_asn1_write_mpi( &c, buf, &rsa->E ) );
         MBEDTLS_ASN1_CHK_ADD( len, mbedtls_asn1_write_mpi( &c, buf, &rsa->N ) );
-        MBEDTLS_ASN1_CHK_ADD( len, mbedtls_asn1_write_int( &c, buf, 0 ) );
+        MBEDTLS_ASN1_CHK_ADD( len, mbedtls_asn1_write_int( &c, buf,
+                                                    rsa->R.p != NULL ? 1 : 0 ) );
 
         MBEDTLS_ASN1_CHK_ADD( len, mbedtls_asn1_write_len( &c, buf, len ) );
         MBEDTLS_ASN1_CHK_ADD( len, mbedtls_asn1_write_tag( &c, buf, MBEDTLS_ASN1_CONSTRUCTED |
@@ -323,13 +341,18 @@ int mbedtls_pk_write_key_der( mbedtls_pk_context *key, unsigned char *buf, size_
  *      exponent1         INTEGER,                  1 + 3 + MPI_MAX / 2 + 1
  *      exponent2         INTEGER,                  1 + 3 + MPI_MAX / 2 + 1
  *      coefficient       INTEGER,                  1 + 3 + MPI_MAX / 2 + 1
- *      otherPrimeInfos   OtherPrimeInfos OPTIONAL  0 (not supported)
+ *      otherPrimeInfos   OtherPrimeInfos OPTIONAL  1 + 3
  *  }
+ *  OtherPrimeInfo ::= SEQUENCE {                   1 + 3
+ *      prime             INTEGER,                  1 + 3 + MPI_MAX / 2 + 1
+ *      exponent          INTEGER,                  1 + 3 + MPI_MAX / 2 + 1
+ *      coefficient       INTEGER                   1 + 3 + MPI_MAX / 2 + 1
+ *  }                                               (one, for three-prime keys)
  */
 #define MPI_MAX_SIZE_2          MBEDTLS_MPI_MAX_SIZE / 2 + \
                                 MBEDTLS_MPI_MAX_SIZE % 2
-#define RSA_PRV_DER_MAX_BYTES   47 + 3 * MBEDTLS_MPI_MAX_SIZE \
-                                   + 5 * MPI_MAX_SIZE_2
+#define RSA_PRV_DER_MAX_BYTES   70 + 3 * MBEDTLS_MPI_MAX_SIZE \
+                                   + 8 * MPI_MAX_SIZE_2
 
 #else /* MBEDTLS_RSA_C */
 
@@ -52,6 +52,10 @@
 #include <stdlib.h>
 #endif
 
+#if defined(MBEDTLS_THREADING_PTHREAD)
+#include "mbedtls/threading.h"
+#endif
+
 #if defined(MBEDTLS_PLATFORM_C)
 #include "mbedtls/platform.h"
 #else
@@ -86,6 +90,17 @@ void mbedtls_rsa_set_padding( mbedtls_rsa_context *ctx, int padding, int hash_id
     ctx->hash_id = hash_id;
 }
 
+#if defined(MBEDTLS_THREADING_PTHREAD)
+/*
+ * Set the thread pool for the CRT exponentiations
+ */
+void mbedtls_rsa_set_crt_pool( mbedtls_rsa_context *ctx,
+                               struct mbedtls_threading_pool *pool )
+{
+    ctx->crt_pool = pool;
+}
+#endif
+
 #if defined(MBEDTLS_GENPRIME)
 
 /*
@@ -95,68 +110,108 @@ int mbedtls_rsa_gen_key( mbedtls_rsa_context *ctx,
                  int (*f_rng)(void *, unsigned char *, size_t),
                  void *p_rng,
                  unsigned int nbits, int exponent )
+{
+    return( mbedtls_rsa_gen_key_multi( ctx, f_rng, p_rng, nbits, exponent, 2 ) );
+}
+
+/*
+ * Generate a two or three-prime RSA keypair
+ */
+int mbedtls_rsa_gen_key_multi( mbedtls_rsa_context *ctx,
+                       int (*f_rng)(void *, unsigned char *, size_t),
+                       void *p_rng,
+                       unsigned int nbits, int exponent, int nprimes )
 {
     int ret;
-    mbedtls_mpi P1, Q1, H, G;
+    unsigned int pbits;
+    mbedtls_mpi P1, Q1, R1, H, G;
 
-    if( f_rng == NULL || nbits < 128 || exponent < 3 )
+    if( f_rng == NULL || nbits < 128 || exponent < 3 ||
+        nprimes < 2 || nprimes > 3 )
         return( MBEDTLS_ERR_RSA_BAD_INPUT_DATA );
 
-    mbedtls_mpi_init( &P1 ); mbedtls_mpi_init( &Q1 ); 
+    mbedtls_mpi_init( &P1 ); mbedtls_mpi_init( &Q1 ); mbedtls_mpi_init( &R1 );
     mbedtls_mpi_init( &H ); mbedtls_mpi_init( &G );
 
     /*
-     * find primes P and Q with Q < P so that:
-     * GCD( E, (P-1)*(Q-1) ) == 1
+     * find distinct primes P, Q (and R) so that:
+     * GCD( E, (P-1)*(Q-1)*(R-1) ) == 1
+     * the last prime takes the bits left over by the others
      */
     MBEDTLS_MPI_CHK( mbedtls_mpi_lset( &ctx->E, exponent ) );
+    pbits = nbits / nprimes;
 
     do
     {
-        MBEDTLS_MPI_CHK( mbedtls_mpi_gen_prime( &ctx->P, nbits >> 1, 0,
+        MBEDTLS_MPI_CHK( mbedtls_mpi_gen_prime( &ctx->P, pbits, 0,
                                 f_rng, p_rng ) );
 
-        if( nbits % 2 )
+        if( nprimes == 2 )
         {
-            MBEDTLS_MPI_CHK( mbedtls_mpi_gen_prime( &ctx->Q, ( nbits >> 1 ) + 1, 0,
+            MBEDTLS_MPI_CHK( mbedtls_mpi_gen_prime( &ctx->Q, nbits - pbits, 0,
                                 f_rng, p_rng ) );
         }
         else
         {
-            MBEDTLS_MPI_CHK( mbedtls_mpi_gen_prime( &ctx->Q, nbits >> 1, 0,
+            MBEDTLS_MPI_CHK( mbedtls_mpi_gen_prime( &ctx->Q, pbits, 0,
+                                f_rng, p_rng ) );
+            MBEDTLS_MPI_CHK( mbedtls_mpi_gen_prime( &ctx->R, nbits - 2 * pbits, 0,
                                 f_rng, p_rng ) );
         }
 
         if( mbedtls_mpi_cmp_mpi( &ctx->P, &ctx->Q ) == 0 )
             continue;
 
+        if( nprimes == 3 &&
+            ( mbedtls_mpi_cmp_mpi( &ctx->R, &ctx->P ) == 0 ||
+              mbedtls_mpi_cmp_mpi( &ctx->R, &ctx->Q ) == 0 ) )
+            continue;
+
         MBEDTLS_MPI_CHK( mbedtls_mpi_mul_mpi( &ctx->N, &ctx->P, &ctx->Q ) );
+        if( nprimes == 3 )
+            MBEDTLS_MPI_CHK( mbedtls_mpi_mul_mpi( &ctx->N, &ctx->N, &ctx->R ) );
         if( mbedtls_mpi_bitlen( &ctx->N ) != nbits )
             continue;
 
         MBEDTLS_MPI_CHK( mbedtls_mpi_sub_int( &P1, &ctx->P, 1 ) );
         MBEDTLS_MPI_CHK( mbedtls_mpi_sub_int( &Q1, &ctx->Q, 1 ) );
         MBEDTLS_MPI_CHK( mbedtls_mpi_mul_mpi( &H, &P1, &Q1 ) );
+        if( nprimes == 3 )
+        {
+            MBEDTLS_MPI_CHK( mbedtls_mpi_sub_int( &R1, &ctx->R, 1 ) );
+            MBEDTLS_MPI_CHK( mbedtls_mpi_mul_mpi( &H, &H, &R1 ) );
+        }
         MBEDTLS_MPI_CHK( mbedtls_mpi_gcd( &G, &ctx->E, &H  ) );
     }
     while( mbedtls_mpi_cmp_int( &G, 1 ) != 0 );
 
     /*
-     * D  = E^-1 mod ((P-1)*(Q-1))
+     * D  = E^-1 mod ((P-1)*(Q-1)*(R-1))
      * DP = D mod (P - 1)
      * DQ = D mod (Q - 1)
      * QP = Q^-1 mod P
+     * DR = D mod (R - 1)
+     * TR = (P*Q)^-1 mod R
      */
     MBEDTLS_MPI_CHK( mbedtls_mpi_inv_mod( &ctx->D , &ctx->E, &H  ) );
     MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi( &ctx->DP, &ctx->D, &P1 ) );
     MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi( &ctx->DQ, &ctx->D, &Q1 ) );
     MBEDTLS_MPI_CHK( mbedtls_mpi_inv_mod( &ctx->QP, &ctx->Q, &ctx->P ) );
 
+    if( nprimes == 3 )
+    {
+        MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi( &ctx->DR, &ctx->D, &R1 ) );
+        MBEDTLS_MPI_CHK( mbedtls_mpi_mul_mpi( &G, &ctx->P, &ctx->Q ) );
+        MBEDTLS_MPI_CHK( mbedtls_mpi_inv_mod( &ctx->TR, &G, &ctx->R ) );
+        ctx->ver = 1;
+    }
+
     ctx->len = ( mbedtls_mpi_bitlen( &ctx->N ) + 7 ) >> 3;
 
 cleanup:
 
-    mbedtls_mpi_free( &P1 ); mbedtls_mpi_free( &Q1 ); mbedtls_mpi_free( &H ); mbedtls_mpi_free( &G );
+    mbedtls_mpi_free( &P1 ); mbedtls_mpi_free( &Q1 ); mbedtls_mpi_free( &R1 );
+    mbedtls_mpi_free( &H ); mbedtls_mpi_free( &G );
 
     if( ret != 0 )
     {
@@ -198,7 +253,7 @@ int mbedtls_rsa_check_pubkey( const mbedtls_rsa_context *ctx )
 int mbedtls_rsa_check_privkey( const mbedtls_rsa_context *ctx )
 {
     int ret;
-    mbedtls_mpi PQ, DE, P1, Q1, H, I, G, G2, L1, L2, DP, DQ, QP;
+    mbedtls_mpi PQ, DE, P1, Q1, H, I, G, G2, L1, L2, DP, DQ, QP, R1, DR, TR;
 
     if( ( ret = mbedtls_rsa_check_pubkey( ctx ) ) != 0 )
         return( ret );
@@ -209,17 +264,35 @@ int mbedtls_rsa_check_privkey( const mbedtls_rsa_context *ctx )
     mbedtls_mpi_init( &PQ ); mbedtls_mpi_init( &DE ); mbedtls_mpi_init( &P1 ); mbedtls_mpi_init( &Q1 );
     mbedtls_mpi_init( &H  ); mbedtls_mpi_init( &I  ); mbedtls_mpi_init( &G  ); mbedtls_mpi_init( &G2 );
     mbedtls_mpi_init( &L1 ); mbedtls_mpi_init( &L2 ); mbedtls_mpi_init( &DP ); mbedtls_mpi_init( &DQ );
-    mbedtls_mpi_init( &QP );
+    mbedtls_mpi_init( &QP ); mbedtls_mpi_init( &R1 ); mbedtls_mpi_init( &DR ); mbedtls_mpi_init( &TR );
 
     MBEDTLS_MPI_CHK( mbedtls_mpi_mul_mpi( &PQ, &ctx->P, &ctx->Q ) );
     MBEDTLS_MPI_CHK( mbedtls_mpi_mul_mpi( &DE, &ctx->D, &ctx->E ) );
     MBEDTLS_MPI_CHK( mbedtls_mpi_sub_int( &P1, &ctx->P, 1 ) );
     MBEDTLS_MPI_CHK( mbedtls_mpi_sub_int( &Q1, &ctx->Q, 1 ) );
     MBEDTLS_MPI_CHK( mbedtls_mpi_mul_mpi( &H, &P1, &Q1 ) );
-    MBEDTLS_MPI_CHK( mbedtls_mpi_gcd( &G, &ctx->E, &H  ) );
 
     MBEDTLS_MPI_CHK( mbedtls_mpi_gcd( &G2, &P1, &Q1 ) );
     MBEDTLS_MPI_CHK( mbedtls_mpi_div_mpi( &L1, &L2, &H, &G2 ) );
+
+    if( ctx->R.p != NULL )
+    {
+        /*
+         * Three-prime key: TR = (P*Q)^-1 mod R, then multiply N and H by
+         * the third factor and make L1 = lcm( P-1, Q-1, R-1 )
+         */
+        MBEDTLS_MPI_CHK( mbedtls_mpi_sub_int( &R1, &ctx->R, 1 ) );
+        MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi( &DR, &ctx->D, &R1 ) );
+        MBEDTLS_MPI_CHK( mbedtls_mpi_inv_mod( &TR, &PQ, &ctx->R ) );
+        MBEDTLS_MPI_CHK( mbedtls_mpi_mul_mpi( &PQ, &PQ, &ctx->R ) );
+        MBEDTLS_MPI_CHK( mbedtls_mpi_mul_mpi( &H, &H, &R1 ) );
+
+        MBEDTLS_MPI_CHK( mbedtls_mpi_gcd( &G2, &L1, &R1 ) );
+        MBEDTLS_MPI_CHK( mbedtls_mpi_mul_mpi( &I, &L1, &R1 ) );
+        MBEDTLS_MPI_CHK( mbedtls_mpi_div_mpi( &L1, &L2, &I, &G2 ) );
+    }
+
+    MBEDTLS_MPI_CHK( mbedtls_mpi_gcd( &G, &ctx->E, &H  ) );
     MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi( &I, &DE, &L1  ) );
 
     MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi( &DP, &ctx->D, &P1 ) );
@@ -234,7 +307,10 @@ int mbedtls_rsa_check_privkey( const mbedtls_rsa_context *ctx )
         mbedtls_mpi_cmp_mpi( &QP, &ctx->QP ) != 0 ||
         mbedtls_mpi_cmp_int( &L2, 0 ) != 0 ||
         mbedtls_mpi_cmp_int( &I, 1 ) != 0 ||
-        mbedtls_mpi_cmp_int( &G, 1 ) != 0 )
+        mbedtls_mpi_cmp_int( &G, 1 ) != 0 ||
+        ( ctx->R.p != NULL &&
+          ( mbedtls_mpi_cmp_mpi( &DR, &ctx->DR ) != 0 ||
+            mbedtls_mpi_cmp_mpi( &TR, &ctx->TR ) != 0 ) ) )
     {
         ret = MBEDTLS_ERR_RSA_KEY_CHECK_FAILED;
     }
@@ -243,7 +319,7 @@ cleanup:
     mbedtls_mpi_free( &PQ ); mbedtls_mpi_free( &DE ); mbedtls_mpi_free( &P1 ); mbedtls_mpi_free( &Q1 );
     mbedtls_mpi_free( &H  ); mbedtls_mpi_free( &I  ); mbedtls_mpi_free( &G  ); mbedtls_mpi_free( &G2 );
     mbedtls_mpi_free( &L1 ); mbedtls_mpi_free( &L2 ); mbedtls_mpi_free( &DP ); mbedtls_mpi_free( &DQ );
-    mbedtls_mpi_free( &QP );
+    mbedtls_mpi_free( &QP ); mbedtls_mpi_free( &R1 ); mbedtls_mpi_free( &DR ); mbedtls_mpi_free( &TR );
 
     if( ret == MBEDTLS_ERR_RSA_KEY_CHECK_FAILED )
         return( ret );
@@ -284,14 +360,38 @@ int mbedtls_rsa_public( mbedtls_rsa_context *ctx,
     int ret;
     size_t olen;
     mbedtls_mpi T;
+#if defined(MBEDTLS_MPI_ARENA)
+    mbedtls_mpi_uint scratch[MBEDTLS_MPI_ARENA_SIZE / sizeof( mbedtls_mpi_uint )];
+    mbedtls_mpi_arena arena;
 
+    /* All temporaries of the operation are released with T */
+    mbedtls_mpi_arena_init( &arena, scratch, sizeof( scratch ) );
+    mbedtls_mpi_init_arena( &T, &arena );
+#else
     mbedtls_mpi_init( &T );
+#endif
 
 #if defined(MBEDTLS_THREADING_C)
     if( ( ret = mbedtls_mutex_lock( &ctx->mutex ) ) != 0 )
         return( ret );
 #endif
 
+    /*
+     * Only the first operation writes to the context, to store RN:
+     * operations with the same key then run concurrently
+     */
+    ret = 0;
+    if( ctx->RN.RR.p == NULL )
+        ret = mbedtls_mpi_mont_setup( &ctx->RN, &ctx->N );
+
+#if defined(MBEDTLS_THREADING_C)
+    if( mbedtls_mutex_unlock( &ctx->mutex ) != 0 )
+        return( MBEDTLS_ERR_THREADING_MUTEX_ERROR );
+#endif
+
+    if( ret != 0 )
+        return( MBEDTLS_ERR_RSA_PUBLIC_FAILED + ret );
+
     MBEDTLS_MPI_CHK( mbedtls_mpi_read_binary( &T, input, ctx->len ) );
 
     if( mbedtls_mpi_cmp_mpi( &T, &ctx->N ) >= 0 )
@@ -301,15 +401,10 @@ int mbedtls_rsa_public( mbedtls_rsa_context *ctx,
     }
 
     olen = ctx->len;
-    MBEDTLS_MPI_CHK( mbedtls_mpi_exp_mod( &T, &T, &ctx->E, &ctx->N, &ctx->RN ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_mont_exp( &T, &T, &ctx->E, &ctx->N, &ctx->RN ) );
     MBEDTLS_MPI_CHK( mbedtls_mpi_write_binary( &T, output, olen ) );
 
 cleanup:
-#if defined(MBEDTLS_THREADING_C)
-    if( mbedtls_mutex_unlock( &ctx->mutex ) != 0 )
-        return( MBEDTLS_ERR_THREADING_MUTEX_ERROR );
-#endif
-
     mbedtls_mpi_free( &T );
 
     if( ret != 0 )
@@ -331,11 +426,14 @@ static int rsa_prepare_blinding( mbedtls_rsa_context *ctx,
 
     if( ctx->Vf.p != NULL )
     {
-        /* We already have blinding values, just update them by squaring */
-        MBEDTLS_MPI_CHK( mbedtls_mpi_mul_mpi( &ctx->Vi, &ctx->Vi, &ctx->Vi ) );
-        MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi( &ctx->Vi, &ctx->Vi, &ctx->N ) );
-        MBEDTLS_MPI_CHK( mbedtls_mpi_mul_mpi( &ctx->Vf, &ctx->Vf, &ctx->Vf ) );
-        MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi( &ctx->Vf, &ctx->Vf, &ctx->N ) );
+        /*
+         * We already have blinding values, just update them by squaring:
+         * in Montgomery form, this needs no division
+         */
+        MBEDTLS_MPI_CHK( mbedtls_mpi_mont_mul( &ctx->Vi, &ctx->Vi, &ctx->Vi,
+                                               &ctx->N, &ctx->RN ) );
+        MBEDTLS_MPI_CHK( mbedtls_mpi_mont_mul( &ctx->Vf, &ctx->Vf, &ctx->Vf,
+                                               &ctx->N, &ctx->RN ) );
 
         goto cleanup;
     }
@@ -343,7 +441,10 @@ static int rsa_prepare_blinding( mbedtls_rsa_context *ctx,
     /* Unblinding value: Vf = random number, invertible mod N */
     do {
         if( count++ > 10 )
-            return( MBEDTLS_ERR_RSA_RNG_FAILED );
+        {
+            ret = MBEDTLS_ERR_RSA_RNG_FAILED;
+            goto cleanup;
+        }
 
         MBEDTLS_MPI_CHK( mbedtls_mpi_fill_random( &ctx->Vf, ctx->len - 1, f_rng, p_rng ) );
         MBEDTLS_MPI_CHK( mbedtls_mpi_gcd( &ctx->Vi, &ctx->Vf, &ctx->N ) );
@@ -351,13 +452,147 @@ static int rsa_prepare_blinding( mbedtls_rsa_context *ctx,
 
     /* Blinding value: Vi =  Vf^(-e) mod N */
     MBEDTLS_MPI_CHK( mbedtls_mpi_inv_mod( &ctx->Vi, &ctx->Vf, &ctx->N ) );
-    MBEDTLS_MPI_CHK( mbedtls_mpi_exp_mod( &ctx->Vi, &ctx->Vi, &ctx->E, &ctx->N, &ctx->RN ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_mont_exp( &ctx->Vi, &ctx->Vi, &ctx->E, &ctx->N, &ctx->RN ) );
 
+    /* Both are kept in Montgomery form */
+    MBEDTLS_MPI_CHK( mbedtls_mpi_mont_mul( &ctx->Vi, &ctx->Vi, &ctx->RN.RR,
+                                           &ctx->N, &ctx->RN ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_mont_mul( &ctx->Vf, &ctx->Vf, &ctx->RN.RR,
+                                           &ctx->N, &ctx->RN ) );
 
 cleanup:
+    if( ret != 0 )
+    {
+        /* Do not leave a partial pair behind */
+        mbedtls_mpi_free( &ctx->Vi );
+        mbedtls_mpi_free( &ctx->Vf );
+    }
+
     return( ret );
 }
 
+/*
+ * Set up the Montgomery constants of the key on first use
+ */
+static int rsa_prepare_mont( mbedtls_rsa_context *ctx )
+{
+    int ret = 0;
+
+    if( ctx->RN.RR.p == NULL )
+        MBEDTLS_MPI_CHK( mbedtls_mpi_mont_setup( &ctx->RN, &ctx->N ) );
+
+#if !defined(MBEDTLS_RSA_NO_CRT)
+    if( ctx->RP.RR.p == NULL )
+        MBEDTLS_MPI_CHK( mbedtls_mpi_mont_setup( &ctx->RP, &ctx->P ) );
+
+    if( ctx->RQ.RR.p == NULL )
+        MBEDTLS_MPI_CHK( mbedtls_mpi_mont_setup( &ctx->RQ, &ctx->Q ) );
+
+    if( ctx->R.p != NULL && ctx->RR.RR.p == NULL )
+        MBEDTLS_MPI_CHK( mbedtls_mpi_mont_setup( &ctx->RR, &ctx->R ) );
+#endif
+
+cleanup:
+    return( ret );
+}
+
+#if !defined(MBEDTLS_RSA_NO_CRT)
+/*
+ * CRT component i of a private key operation: M = T ^ D_i mod P_i,
+ * using only constants that are not written once set up
+ */
+static int rsa_crt_component( const mbedtls_rsa_context *ctx, size_t i,
+                              mbedtls_mpi *M, const mbedtls_mpi *T )
+{
+    if( i == 0 )
+        return( mbedtls_mpi_mont_exp( M, T, &ctx->DP, &ctx->P, &ctx->RP ) );
+
+    if( i == 1 )
+        return( mbedtls_mpi_mont_exp( M, T, &ctx->DQ, &ctx->Q, &ctx->RQ ) );
+
+    return( mbedtls_mpi_mont_exp( M, T, &ctx->DR, &ctx->R, &ctx->RR ) );
+}
+
+#if defined(MBEDTLS_THREADING_PTHREAD)
+typedef struct
+{
+    const mbedtls_rsa_context *ctx;
+    const mbedtls_mpi *T;
+    mbedtls_mpi M[3];
+}
+rsa_crt_job;
+
+static int rsa_crt_run( void *p_job, size_t index )
+{
+    rsa_crt_job *job = (rsa_crt_job *) p_job;
+#if defined(MBEDTLS_MPI_ARENA)
+    /*
+     * Arenas are not shared between threads: compute in one local to the
+     * work item and only copy the result to the heap
+     */
+    int ret;
+    mbedtls_mpi M;
+    mbedtls_mpi_uint scratch[MBEDTLS_MPI_ARENA_SIZE / sizeof( mbedtls_mpi_uint )];
+    mbedtls_mpi_arena arena;
+
+    mbedtls_mpi_arena_init( &arena, scratch, sizeof( scratch ) );
+    mbedtls_mpi_init_arena( &M, &arena );
+
+    MBEDTLS_MPI_CHK( rsa_crt_component( job->ctx, index, &M, job->T ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &job->M[index], &M ) );
+
+cleanup:
+    mbedtls_mpi_free( &M );
+
+    return( ret );
+#else
+    return( rsa_crt_component( job->ctx, index, &job->M[index], job->T ) );
+#endif
+}
+#endif /* MBEDTLS_THREADING_PTHREAD */
+
+/*
+ * Compute the CRT components M[i] = T ^ D_i mod P_i for every prime
+ * factor of the key, on its CRT pool if any
+ */
+static int rsa_crt_exp( const mbedtls_rsa_context *ctx, const mbedtls_mpi *T,
+                        mbedtls_mpi *M )
+{
+    int ret = 0;
+    size_t i, count = ctx->R.p != NULL ? 3 : 2;
+
+#if defined(MBEDTLS_THREADING_PTHREAD)
+    if( ctx->crt_pool != NULL )
+    {
+        rsa_crt_job job;
+
+        job.ctx = ctx;
+        job.T = T;
+        for( i = 0; i < count; i++ )
+            mbedtls_mpi_init( &job.M[i] );
+
+        ret = mbedtls_threading_pool_run( ctx->crt_pool, rsa_crt_run, &job,
+                                          count );
+
+        for( i = 0; i < count; i++ )
+        {
+            if( ret == 0 )
+                ret = mbedtls_mpi_copy( &M[i], &job.M[i] );
+            mbedtls_mpi_free( &job.M[i] );
+        }
+
+        return( ret );
+    }
+#endif
+
+    for( i = 0; i < count; i++ )
+        MBEDTLS_MPI_CHK( rsa_crt_component( ctx, i, &M[i], T ) );
+
+cleanup:
+    return( ret );
+}
+#endif /* !MBEDTLS_RSA_NO_CRT */
+
 /*
  * Do an RSA private key operation
  */
@@ -369,17 +604,36 @@ int mbedtls_rsa_private( mbedtls_rsa_context *ctx,
 {
     int ret;
     size_t olen;
-    mbedtls_mpi T, T1, T2;
+    mbedtls_mpi T, TM[3], Vi, Vf;
+#if defined(MBEDTLS_THREADING_C)
+    int locked = 0;
+#endif
+#if defined(MBEDTLS_MPI_ARENA)
+    mbedtls_mpi_uint scratch[MBEDTLS_MPI_ARENA_SIZE / sizeof( mbedtls_mpi_uint )];
+    mbedtls_mpi_arena arena;
+#endif
 
     /* Make sure we have private key info, prevent possible misuse */
     if( ctx->P.p == NULL || ctx->Q.p == NULL || ctx->D.p == NULL )
         return( MBEDTLS_ERR_RSA_BAD_INPUT_DATA );
 
-    mbedtls_mpi_init( &T ); mbedtls_mpi_init( &T1 ); mbedtls_mpi_init( &T2 );
+#if defined(MBEDTLS_MPI_ARENA)
+    mbedtls_mpi_arena_init( &arena, scratch, sizeof( scratch ) );
+    mbedtls_mpi_init_arena( &T, &arena );
+    mbedtls_mpi_init_arena( &TM[0], &arena );
+    mbedtls_mpi_init_arena( &TM[1], &arena );
+    mbedtls_mpi_init_arena( &TM[2], &arena );
+    mbedtls_mpi_init_arena( &Vi, &arena );
+    mbedtls_mpi_init_arena( &Vf, &arena );
+#else
+    mbedtls_mpi_init( &T ); mbedtls_mpi_init( &TM[0] ); mbedtls_mpi_init( &TM[1] );
+    mbedtls_mpi_init( &TM[2] ); mbedtls_mpi_init( &Vi ); mbedtls_mpi_init( &Vf );
+#endif
 
 #if defined(MBEDTLS_THREADING_C)
     if( ( ret = mbedtls_mutex_lock( &ctx->mutex ) ) != 0 )
         return( ret );
+    locked = 1;
 #endif
 
     MBEDTLS_MPI_CHK( mbedtls_mpi_read_binary( &T, input, ctx->len ) );
@@ -389,51 +643,83 @@ int mbedtls_rsa_private( mbedtls_rsa_context *ctx,
         goto cleanup;
     }
 
+    /*
+     * Only the Montgomery constants, on first use, and the blinding values
+     * are written to the context: the exponentiations run unlocked
+     */
+    MBEDTLS_MPI_CHK( rsa_prepare_mont( ctx ) );
+
+    if( f_rng != NULL )
+    {
+        MBEDTLS_MPI_CHK( rsa_prepare_blinding( ctx, f_rng, p_rng ) );
+        MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &Vi, &ctx->Vi ) );
+        MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &Vf, &ctx->Vf ) );
+    }
+
+#if defined(MBEDTLS_THREADING_C)
+    locked = 0;
+    if( mbedtls_mutex_unlock( &ctx->mutex ) != 0 )
+    {
+        ret = MBEDTLS_ERR_THREADING_MUTEX_ERROR;
+        goto cleanup;
+    }
+#endif
+
     if( f_rng != NULL )
     {
         /*
          * Blinding
-         * T = T * Vi mod N
+         * T = T * Vi mod N, with Vi in Montgomery form
          */
-        MBEDTLS_MPI_CHK( rsa_prepare_blinding( ctx, f_rng, p_rng ) );
-        MBEDTLS_MPI_CHK( mbedtls_mpi_mul_mpi( &T, &T, &ctx->Vi ) );
-        MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi( &T, &T, &ctx->N ) );
+        MBEDTLS_MPI_CHK( mbedtls_mpi_mont_mul( &T, &T, &Vi, &ctx->N, &ctx->RN ) );
     }
 
 #if defined(MBEDTLS_RSA_NO_CRT)
-    MBEDTLS_MPI_CHK( mbedtls_mpi_exp_mod( &T, &T, &ctx->D, &ctx->N, &ctx->RN ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_mont_exp( &T, &T, &ctx->D, &ctx->N, &ctx->RN ) );
 #else
     /*
      * faster decryption using the CRT
      *
-     * T1 = input ^ dP mod P
-     * T2 = input ^ dQ mod Q
+     * TM[0] = input ^ dP mod P
+     * TM[1] = input ^ dQ mod Q
+     * TM[2] = input ^ dR mod R, for three-prime keys
      */
-    MBEDTLS_MPI_CHK( mbedtls_mpi_exp_mod( &T1, &T, &ctx->DP, &ctx->P, &ctx->RP ) );
-    MBEDTLS_MPI_CHK( mbedtls_mpi_exp_mod( &T2, &T, &ctx->DQ, &ctx->Q, &ctx->RQ ) );
+    MBEDTLS_MPI_CHK( rsa_crt_exp( ctx, &T, TM ) );
 
     /*
-     * T = (T1 - T2) * (Q^-1 mod P) mod P
+     * T = (TM[0] - TM[1]) * (Q^-1 mod P) mod P
      */
-    MBEDTLS_MPI_CHK( mbedtls_mpi_sub_mpi( &T, &T1, &T2 ) );
-    MBEDTLS_MPI_CHK( mbedtls_mpi_mul_mpi( &T1, &T, &ctx->QP ) );
-    MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi( &T, &T1, &ctx->P ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_sub_mpi( &T, &TM[0], &TM[1] ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_mul_mpi( &TM[0], &T, &ctx->QP ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi( &T, &TM[0], &ctx->P ) );
 
     /*
-     * T = T2 + T * Q
+     * T = TM[1] + T * Q
      */
-    MBEDTLS_MPI_CHK( mbedtls_mpi_mul_mpi( &T1, &T, &ctx->Q ) );
-    MBEDTLS_MPI_CHK( mbedtls_mpi_add_mpi( &T, &T2, &T1 ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_mul_mpi( &TM[0], &T, &ctx->Q ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_add_mpi( &T, &TM[1], &TM[0] ) );
+
+    if( ctx->R.p != NULL )
+    {
+        /*
+         * T = T + ((TM[2] - T) * ((P*Q)^-1 mod R) mod R) * P * Q
+         */
+        MBEDTLS_MPI_CHK( mbedtls_mpi_sub_mpi( &TM[0], &TM[2], &T ) );
+        MBEDTLS_MPI_CHK( mbedtls_mpi_mul_mpi( &TM[1], &TM[0], &ctx->TR ) );
+        MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi( &TM[0], &TM[1], &ctx->R ) );
+        MBEDTLS_MPI_CHK( mbedtls_mpi_mul_mpi( &TM[1], &TM[0], &ctx->P ) );
+        MBEDTLS_MPI_CHK( mbedtls_mpi_mul_mpi( &TM[0], &TM[1], &ctx->Q ) );
+        MBEDTLS_MPI_CHK( mbedtls_mpi_add_mpi( &T, &T, &TM[0] ) );
+    }
 #endif /* MBEDTLS_RSA_NO_CRT */
 
     if( f_rng != NULL )
     {
         /*
          * Unblind
-         * T = T * Vf mod N
+         * T = T * Vf mod N, with Vf in Montgomery form
          */
-        MBEDTLS_MPI_CHK( mbedtls_mpi_mul_mpi( &T, &T, &ctx->Vf ) );
-        MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi( &T, &T, &ctx->N ) );
+        MBEDTLS_MPI_CHK( mbedtls_mpi_mont_mul( &T, &T, &Vf, &ctx->N, &ctx->RN ) );
     }
 
     olen = ctx->len;
@@ -441,11 +727,18 @@ int mbedtls_rsa_private( mbedtls_rsa_context *ctx,
 
 cleanup:
 #if defined(MBEDTLS_THREADING_C)
-    if( mbedtls_mutex_unlock( &ctx->mutex ) != 0 )
-        return( MBEDTLS_ERR_THREADING_MUTEX_ERROR );
+    if( locked && mbedtls_mutex_unlock( &ctx->mutex ) != 0 )
+        ret = MBEDTLS_ERR_THREADING_MUTEX_ERROR;
 #endif
 
-    mbedtls_mpi_free( &T ); mbedtls_mpi_free( &T1 ); mbedtls_mpi_free( &T2 );
+    mbedtls_mpi_free( &Vf ); mbedtls_mpi_free( &Vi );
+    mbedtls_mpi_free( &TM[2] ); mbedtls_mpi_free( &TM[1] ); mbedtls_mpi_free( &TM[0] );
+    mbedtls_mpi_free( &T );
+
+#if defined(MBEDTLS_THREADING_C)
+    if( ret == MBEDTLS_ERR_THREADING_MUTEX_ERROR )
+        return( ret );
+#endif
 
     if( ret != 0 )
         return( MBEDTLS_ERR_RSA_PRIVATE_FAILED + ret );
@@ -1460,6 +1753,59 @@ int mbedtls_rsa_pkcs1_verify( mbedtls_rsa_context *ctx,
     }
 }
 
+/*
+ * Verify item index of a mbedtls_rsa_pkcs1_verify_batch() call
+ */
+static int rsa_batch_verify( void *p_job, size_t index )
+{
+    mbedtls_rsa_verify_item *item = (mbedtls_rsa_verify_item *) p_job + index;
+
+    item->ret = mbedtls_rsa_pkcs1_verify( item->ctx, NULL, NULL,
+                                          MBEDTLS_RSA_PUBLIC, item->md_alg,
+                                          item->hashlen, item->hash,
+                                          item->sig );
+    return( 0 );
+}
+
+/*
+ * Batch of signature verifications
+ */
+int mbedtls_rsa_pkcs1_verify_batch( mbedtls_rsa_verify_item *items,
+                                    size_t count,
+                                    struct mbedtls_threading_pool *pool )
+{
+    size_t i;
+
+#if defined(MBEDTLS_THREADING_PTHREAD)
+    int ret;
+
+    /* Not verified yet: no verification returns a positive value */
+    for( i = 0; i < count; i++ )
+        items[i].ret = 1;
+
+    ret = mbedtls_threading_pool_run( pool, rsa_batch_verify, items, count );
+
+    /* Items the pool didn't get to fail with its error */
+    for( i = 0; i < count; i++ )
+        if( items[i].ret == 1 )
+            items[i].ret = ( ret != 0 ) ? ret : MBEDTLS_ERR_RSA_VERIFY_FAILED;
+
+    if( ret != 0 )
+        return( ret );
+#else
+    ((void) pool);
+
+    for( i = 0; i < count; i++ )
+        rsa_batch_verify( items, i );
+#endif
+
+    for( i = 0; i < count; i++ )
+        if( items[i].ret != 0 )
+            return( items[i].ret );
+
+    return( 0 );
+}
+
 /*
  * Copy the components of an RSA key
  */
@@ -1480,9 +1826,18 @@ int mbedtls_rsa_copy( mbedtls_rsa_context *dst, const mbedtls_rsa_context *src )
     MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &dst->DQ, &src->DQ ) );
     MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &dst->QP, &src->QP ) );
 
-    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &dst->RN, &src->RN ) );
-    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &dst->RP, &src->RP ) );
-    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &dst->RQ, &src->RQ ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &dst->R, &src->R ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &dst->DR, &src->DR ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &dst->TR, &src->TR ) );
+
+    dst->RN.mm = src->RN.mm;
+    dst->RP.mm = src->RP.mm;
+    dst->RQ.mm = src->RQ.mm;
+    dst->RR.mm = src->RR.mm;
+    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &dst->RN.RR, &src->RN.RR ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &dst->RP.RR, &src->RP.RR ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &dst->RQ.RR, &src->RQ.RR ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &dst->RR.RR, &src->RR.RR ) );
 
     MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &dst->Vi, &src->Vi ) );
     MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &dst->Vf, &src->Vf ) );
@@ -1490,6 +1845,10 @@ int mbedtls_rsa_copy( mbedtls_rsa_context *dst, const mbedtls_rsa_context *src )
     dst->padding = src->padding;
     dst->hash_id = src->hash_id;
 
+#if defined(MBEDTLS_THREADING_PTHREAD)
+    dst->crt_pool = src->crt_pool;
+#endif
+
 cleanup:
     if( ret != 0 )
         mbedtls_rsa_free( dst );
@@ -1503,7 +1862,9 @@ cleanup:
 void mbedtls_rsa_free( mbedtls_rsa_context *ctx )
 {
     mbedtls_mpi_free( &ctx->Vi ); mbedtls_mpi_free( &ctx->Vf );
-    mbedtls_mpi_free( &ctx->RQ ); mbedtls_mpi_free( &ctx->RP ); mbedtls_mpi_free( &ctx->RN );
+    mbedtls_mpi_mont_free( &ctx->RR ); mbedtls_mpi_mont_free( &ctx->RQ );
+    mbedtls_mpi_mont_free( &ctx->RP ); mbedtls_mpi_mont_free( &ctx->RN );
+    mbedtls_mpi_free( &ctx->TR ); mbedtls_mpi_free( &ctx->DR ); mbedtls_mpi_free( &ctx->R );
     mbedtls_mpi_free( &ctx->QP ); mbedtls_mpi_free( &ctx->DQ ); mbedtls_mpi_free( &ctx->DP );
     mbedtls_mpi_free( &ctx->Q  ); mbedtls_mpi_free( &ctx->P  ); mbedtls_mpi_free( &ctx->D );
     mbedtls_mpi_free( &ctx->E  ); mbedtls_mpi_free( &ctx->N  );
@@ -19,8 +19,9 @@
  *  This file is part of mbed TLS (https://tls.mbed.org)
  */
 /*
- * These session callbacks use a simple chained list
- * to store and retrieve the session information.
+ * These session callbacks use a hash table of session IDs, split into
+ * independently locked shards, to store and retrieve the session
+ * information.
  */
 
 #if !defined(MBEDTLS_CONFIG_FILE)
@@ -43,198 +44,448 @@
 
 #include "mbedtls/ssl_cache.h"
 
+#include <stdint.h>
 #include <string.h>
 
+/*
+ * Number of shards in use for a maximum: as many as possible, up to
+ * MBEDTLS_SSL_CACHE_SHARDS, with room for at least one entry in each
+ */
+static size_t ssl_cache_nshards( int max )
+{
+    size_t n = 1;
+
+    while( 2 * n <= MBEDTLS_SSL_CACHE_SHARDS && 2 * n <= (size_t) max )
+        n <<= 1;
+
+    return( n );
+}
+
+/*
+ * Share of a maximum of shard i out of nshards: the shares add up to max
+ */
+static size_t ssl_cache_quota( int max, size_t nshards, size_t i )
+{
+    return( (size_t) max / nshards + ( i < (size_t) max % nshards ) );
+}
+
 void mbedtls_ssl_cache_init( mbedtls_ssl_cache_context *cache )
 {
     memset( cache, 0, sizeof( mbedtls_ssl_cache_context ) );
 
     cache->timeout = MBEDTLS_SSL_CACHE_DEFAULT_TIMEOUT;
     cache->max_entries = MBEDTLS_SSL_CACHE_DEFAULT_MAX_ENTRIES;
+    cache->nshards = ssl_cache_nshards( cache->max_entries );
 
 #if defined(MBEDTLS_THREADING_C)
-    mbedtls_mutex_init( &cache->mutex );
+    {
+        size_t i;
+
+        for( i = 0; i < MBEDTLS_SSL_CACHE_SHARDS; i++ )
+            mbedtls_mutex_init( &cache->shards[i].mutex );
+    }
 #endif
 }
 
-int mbedtls_ssl_cache_get( void *data, mbedtls_ssl_session *session )
+/*
+ * FNV-1a hash of a session ID, with the final mix of MurmurHash3 so that
+ * all bits depend on all input bits. The low bits select the shard, the
+ * others the home slot in the shard index.
+ */
+static size_t ssl_cache_hash( const unsigned char *id, size_t id_len )
 {
-    int ret = 1;
-#if defined(MBEDTLS_HAVE_TIME)
-    mbedtls_time_t t = mbedtls_time( NULL );
+    uint32_t h = 0x811C9DC5;
+    size_t i;
+
+    for( i = 0; i < id_len; i++ )
+    {
+        h ^= id[i];
+        h *= 0x01000193;
+    }
+
+    h ^= h >> 16;
+    h *= 0x85EBCA6B;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35;
+    h ^= h >> 16;
+
+    return( (size_t) h );
+}
+
+/*
+ * Lock and return the shard of a session ID hash. Which shard that is
+ * depends on the number of shards in use, only changed with all the shards
+ * locked: check it again once locked.
+ */
+static mbedtls_ssl_cache_shard *ssl_cache_lock( mbedtls_ssl_cache_context *cache,
+                                                size_t h )
+{
+    mbedtls_ssl_cache_shard *shard;
+    size_t n;
+
+    for( ;; )
+    {
+        n = cache->nshards;
+        shard = &cache->shards[h & ( n - 1 )];
+
+#if defined(MBEDTLS_THREADING_C)
+        if( mbedtls_mutex_lock( &shard->mutex ) != 0 )
+            return( NULL );
+
+        if( cache->nshards != n )
+        {
+            mbedtls_mutex_unlock( &shard->mutex );
+            continue;
+        }
 #endif
-    mbedtls_ssl_cache_context *cache = (mbedtls_ssl_cache_context *) data;
-    mbedtls_ssl_cache_entry *cur, *entry;
 
+        return( shard );
+    }
+}
+
+static int ssl_cache_unlock( mbedtls_ssl_cache_shard *shard )
+{
 #if defined(MBEDTLS_THREADING_C)
-    if( mbedtls_mutex_lock( &cache->mutex ) != 0 )
-        return( 1 );
+    return( mbedtls_mutex_unlock( &shard->mutex ) );
+#else
+    ((void) shard);
+    return( 0 );
 #endif
+}
 
-    cur = cache->chain;
-    entry = NULL;
+/* The index has twice as many slots as the pool, rounded up to a power of 2 */
+static size_t ssl_cache_index_size( const mbedtls_ssl_cache_shard *shard )
+{
+    size_t n = 2;
 
-    while( cur != NULL )
+    while( n < 2 * shard->size )
+        n <<= 1;
+
+    return( n );
+}
+
+static size_t ssl_cache_home( const mbedtls_ssl_cache_shard *shard, size_t h )
+{
+    return( ( h / MBEDTLS_SSL_CACHE_SHARDS ) &
+            ( ssl_cache_index_size( shard ) - 1 ) );
+}
+
+/*
+ * Return the index slot holding the given session ID, or the free slot
+ * where it would be inserted
+ */
+static size_t ssl_cache_find( const mbedtls_ssl_cache_shard *shard, size_t h,
+                              const unsigned char *id, size_t id_len )
+{
+    size_t mask = ssl_cache_index_size( shard ) - 1;
+    size_t slot = ssl_cache_home( shard, h );
+    const mbedtls_ssl_cache_entry *entry;
+
+    while( shard->index[slot] != 0 )
     {
-        entry = cur;
-        cur = cur->next;
+        entry = &shard->entries[shard->index[slot] - 1];
 
-#if defined(MBEDTLS_HAVE_TIME)
-        if( cache->timeout != 0 &&
-            (int) ( t - entry->timestamp ) > cache->timeout )
-            continue;
-#endif
+        if( entry->session.id_len == id_len &&
+            memcmp( entry->session.id, id, id_len ) == 0 )
+            break;
 
-        if( session->ciphersuite != entry->session.ciphersuite ||
-            session->compression != entry->session.compression ||
-            session->id_len != entry->session.id_len )
-            continue;
+        slot = ( slot + 1 ) & mask;
+    }
 
-        if( memcmp( session->id, entry->session.id,
-                    entry->session.id_len ) != 0 )
-            continue;
+    return( slot );
+}
 
-        memcpy( session->master, entry->session.master, 48 );
+/*
+ * Free an index slot, moving back the following entries of the probe
+ * sequence so that no tombstones are needed
+ */
+static void ssl_cache_unlink( mbedtls_ssl_cache_shard *shard, size_t slot )
+{
+    size_t mask = ssl_cache_index_size( shard ) - 1;
+    size_t next = slot, home;
+    const mbedtls_ssl_cache_entry *entry;
 
-        session->verify_result = entry->session.verify_result;
+    for( ;; )
+    {
+        shard->index[slot] = 0;
 
-#if defined(MBEDTLS_X509_CRT_PARSE_C)
-        /*
-         * Restore peer certificate (without rest of the original chain)
-         */
-        if( entry->peer_cert.p != NULL )
+        for( ;; )
         {
-            if( ( session->peer_cert = mbedtls_calloc( 1,
-                                 sizeof(mbedtls_x509_crt) ) ) == NULL )
-            {
-                ret = 1;
-                goto exit;
-            }
-
-            mbedtls_x509_crt_init( session->peer_cert );
-            if( mbedtls_x509_crt_parse( session->peer_cert, entry->peer_cert.p,
-                                entry->peer_cert.len ) != 0 )
-            {
-                mbedtls_free( session->peer_cert );
-                session->peer_cert = NULL;
-                ret = 1;
-                goto exit;
-            }
+            next = ( next + 1 ) & mask;
+            if( shard->index[next] == 0 )
+                return;
+
+            entry = &shard->entries[shard->index[next] - 1];
+            home = ssl_cache_home( shard,
+                        ssl_cache_hash( entry->session.id, entry->session.id_len ) );
+
+            /* Move it unless its home lies cyclically in ]slot, next] */
+            if( slot <= next ? ( home <= slot || home > next )
+                             : ( home <= slot && home > next ) )
+                break;
         }
+
+        shard->index[slot] = shard->index[next];
+        slot = next;
+    }
+}
+
+static void ssl_cache_entry_free( mbedtls_ssl_cache_entry *entry )
+{
+    mbedtls_ssl_session_free( &entry->session );
+
+#if defined(MBEDTLS_X509_CRT_PARSE_C)
+    mbedtls_free( entry->peer_cert.p );
 #endif /* MBEDTLS_X509_CRT_PARSE_C */
 
-        ret = 0;
-        goto exit;
+    memset( entry, 0, sizeof( mbedtls_ssl_cache_entry ) );
+}
+
+static void ssl_cache_shard_free( mbedtls_ssl_cache_shard *shard )
+{
+    size_t i;
+
+    for( i = 0; i < shard->used; i++ )
+        ssl_cache_entry_free( &shard->entries[i] );
+
+    mbedtls_free( shard->entries );
+    mbedtls_free( shard->index );
+
+    shard->entries = NULL;
+    shard->index = NULL;
+    shard->size = shard->used = shard->hand = 0;
+}
+
+/*
+ * Allocate the pool and index of an empty shard for size entries. The pool
+ * never grows afterwards: a full shard drops one of its entries instead.
+ */
+static int ssl_cache_shard_alloc( mbedtls_ssl_cache_shard *shard, size_t size )
+{
+    shard->size = size;
+    shard->used = shard->hand = 0;
+
+    shard->entries = mbedtls_calloc( size, sizeof( mbedtls_ssl_cache_entry ) );
+    shard->index = mbedtls_calloc( ssl_cache_index_size( shard ), sizeof( size_t ) );
+
+    if( shard->entries == NULL || shard->index == NULL )
+    {
+        mbedtls_free( shard->entries );
+        mbedtls_free( shard->index );
+        shard->entries = NULL;
+        shard->index = NULL;
+        shard->size = 0;
+        return( 1 );
     }
 
-exit:
-#if defined(MBEDTLS_THREADING_C)
-    if( mbedtls_mutex_unlock( &cache->mutex ) != 0 )
-        ret = 1;
+    return( 0 );
+}
+
+/*
+ * Move an entry into a shard that is not full
+ */
+static void ssl_cache_insert( mbedtls_ssl_cache_shard *shard,
+                              const mbedtls_ssl_cache_entry *entry )
+{
+    size_t slot = ssl_cache_find( shard,
+            ssl_cache_hash( entry->session.id, entry->session.id_len ),
+            entry->session.id, entry->session.id_len );
+
+    memcpy( &shard->entries[shard->used++], entry,
+            sizeof( mbedtls_ssl_cache_entry ) );
+    shard->index[slot] = shard->used;
+}
+
+#if defined(MBEDTLS_HAVE_TIME)
+static int ssl_cache_expired( const mbedtls_ssl_cache_context *cache,
+                              const mbedtls_ssl_cache_entry *entry,
+                              mbedtls_time_t t )
+{
+    return( cache->timeout != 0 &&
+            (int) ( t - entry->timestamp ) > cache->timeout );
+}
 #endif
 
-    return( ret );
+/*
+ * Pick the entry of a non-empty shard to drop: the first one that is
+ * expired or has not been retrieved since the clock hand last passed it
+ */
+static size_t ssl_cache_victim( mbedtls_ssl_cache_context *cache,
+                                mbedtls_ssl_cache_shard *shard )
+{
+#if defined(MBEDTLS_HAVE_TIME)
+    mbedtls_time_t t = mbedtls_time( NULL );
+#endif
+    mbedtls_ssl_cache_entry *entry;
+    size_t i;
+
+    for( ;; )
+    {
+        if( shard->hand >= shard->used )
+            shard->hand = 0;
+
+        i = shard->hand++;
+        entry = &shard->entries[i];
+
+#if defined(MBEDTLS_HAVE_TIME)
+        if( ssl_cache_expired( cache, entry, t ) )
+            break;
+#else
+        ((void) cache);
+#endif
+
+        if( entry->referenced == 0 )
+            break;
+
+        entry->referenced = 0;
+    }
+
+    return( i );
 }
 
-int mbedtls_ssl_cache_set( void *data, const mbedtls_ssl_session *session )
+/*
+ * Drop entry i of a shard, moving the last entry of the pool in its place
+ */
+static void ssl_cache_remove( mbedtls_ssl_cache_shard *shard, size_t i )
+{
+    mbedtls_ssl_cache_entry *entry = &shard->entries[i];
+    mbedtls_ssl_cache_entry *last = &shard->entries[shard->used - 1];
+
+    ssl_cache_unlink( shard, ssl_cache_find( shard,
+                ssl_cache_hash( entry->session.id, entry->session.id_len ),
+                entry->session.id, entry->session.id_len ) );
+
+    ssl_cache_entry_free( entry );
+
+    if( entry != last )
+    {
+        shard->index[ssl_cache_find( shard,
+                ssl_cache_hash( last->session.id, last->session.id_len ),
+                last->session.id, last->session.id_len )] = i + 1;
+
+        memcpy( entry, last, sizeof( mbedtls_ssl_cache_entry ) );
+        memset( last, 0, sizeof( mbedtls_ssl_cache_entry ) );
+    }
+
+    shard->used--;
+}
+
+int mbedtls_ssl_cache_get( void *data, mbedtls_ssl_session *session )
 {
     int ret = 1;
 #if defined(MBEDTLS_HAVE_TIME)
-    mbedtls_time_t t = time( NULL ), oldest = 0;
-    mbedtls_ssl_cache_entry *old = NULL;
+    mbedtls_time_t t = mbedtls_time( NULL );
 #endif
     mbedtls_ssl_cache_context *cache = (mbedtls_ssl_cache_context *) data;
-    mbedtls_ssl_cache_entry *cur, *prv;
-    int count = 0;
+    size_t h = ssl_cache_hash( session->id, session->id_len );
+    mbedtls_ssl_cache_shard *shard;
+    mbedtls_ssl_cache_entry *entry;
+    size_t slot;
 
-#if defined(MBEDTLS_THREADING_C)
-    if( ( ret = mbedtls_mutex_lock( &cache->mutex ) ) != 0 )
-        return( ret );
+    if( ( shard = ssl_cache_lock( cache, h ) ) == NULL )
+        return( 1 );
+
+    if( shard->entries == NULL )
+        goto exit;
+
+    slot = ssl_cache_find( shard, h, session->id, session->id_len );
+    if( shard->index[slot] == 0 )
+        goto exit;
+
+    entry = &shard->entries[shard->index[slot] - 1];
+
+#if defined(MBEDTLS_HAVE_TIME)
+    if( ssl_cache_expired( cache, entry, t ) )
+        goto exit;
 #endif
 
-    cur = cache->chain;
-    prv = NULL;
+    if( session->ciphersuite != entry->session.ciphersuite ||
+        session->compression != entry->session.compression )
+        goto exit;
+
+    memcpy( session->master, entry->session.master, 48 );
+
+    session->verify_result = entry->session.verify_result;
 
-    while( cur != NULL )
+#if defined(MBEDTLS_X509_CRT_PARSE_C)
+    /*
+     * Restore peer certificate (without rest of the original chain)
+     */
+    if( entry->peer_cert.p != NULL )
     {
-        count++;
+        if( ( session->peer_cert = mbedtls_calloc( 1,
+                             sizeof(mbedtls_x509_crt) ) ) == NULL )
+        {
+            ret = 1;
+            goto exit;
+        }
 
-#if defined(MBEDTLS_HAVE_TIME)
-        if( cache->timeout != 0 &&
-            (int) ( t - cur->timestamp ) > cache->timeout )
+        mbedtls_x509_crt_init( session->peer_cert );
+        if( mbedtls_x509_crt_parse( session->peer_cert, entry->peer_cert.p,
+                            entry->peer_cert.len ) != 0 )
         {
-            cur->timestamp = t;
-            break; /* expired, reuse this slot, update timestamp */
+            mbedtls_free( session->peer_cert );
+            session->peer_cert = NULL;
+            ret = 1;
+            goto exit;
         }
-#endif
+    }
+#endif /* MBEDTLS_X509_CRT_PARSE_C */
 
-        if( memcmp( session->id, cur->session.id, cur->session.id_len ) == 0 )
-            break; /* client reconnected, keep timestamp for session id */
+    entry->referenced = 1;
+    ret = 0;
 
+exit:
+    if( ssl_cache_unlock( shard ) != 0 )
+        ret = 1;
+
+    return( ret );
+}
+
+int mbedtls_ssl_cache_set( void *data, const mbedtls_ssl_session *session )
+{
+    int ret = 1;
 #if defined(MBEDTLS_HAVE_TIME)
-        if( oldest == 0 || cur->timestamp < oldest )
-        {
-            oldest = cur->timestamp;
-            old = cur;
-        }
+    mbedtls_time_t t = mbedtls_time( NULL );
 #endif
+    mbedtls_ssl_cache_context *cache = (mbedtls_ssl_cache_context *) data;
+    size_t h = ssl_cache_hash( session->id, session->id_len );
+    mbedtls_ssl_cache_shard *shard;
+    mbedtls_ssl_cache_entry *cur;
+    size_t slot, quota;
 
-        prv = cur;
-        cur = cur->next;
+    if( ( shard = ssl_cache_lock( cache, h ) ) == NULL )
+        return( 1 );
+
+    /* First entry of the shard since mbedtls_ssl_cache_init() */
+    if( shard->entries == NULL )
+    {
+        quota = ssl_cache_quota( cache->max_entries, cache->nshards,
+                                 shard - cache->shards );
+        if( quota == 0 || ssl_cache_shard_alloc( shard, quota ) != 0 )
+            goto exit;
     }
 
-    if( cur == NULL )
+    slot = ssl_cache_find( shard, h, session->id, session->id_len );
+
+    if( shard->index[slot] != 0 )
     {
-#if defined(MBEDTLS_HAVE_TIME)
-        /*
-         * Reuse oldest entry if max_entries reached
-         */
-        if( count >= cache->max_entries )
+        /* client reconnected, keep timestamp for session id */
+        cur = &shard->entries[shard->index[slot] - 1];
+    }
+    else
+    {
+        /* Make room in a full shard, which may move IDs in the index */
+        if( shard->used == shard->size )
         {
-            if( old == NULL )
-            {
-                ret = 1;
-                goto exit;
-            }
-
-            cur = old;
+            ssl_cache_remove( shard, ssl_cache_victim( cache, shard ) );
+            slot = ssl_cache_find( shard, h, session->id, session->id_len );
         }
-#else /* MBEDTLS_HAVE_TIME */
-        /*
-         * Reuse first entry in chain if max_entries reached,
-         * but move to last place
-         */
-        if( count >= cache->max_entries )
-        {
-            if( cache->chain == NULL )
-            {
-                ret = 1;
-                goto exit;
-            }
 
-            cur = cache->chain;
-            cache->chain = cur->next;
-            cur->next = NULL;
-            prv->next = cur;
-        }
-#endif /* MBEDTLS_HAVE_TIME */
-        else
-        {
-            /*
-             * max_entries not reached, create new entry
-             */
-            cur = mbedtls_calloc( 1, sizeof(mbedtls_ssl_cache_entry) );
-            if( cur == NULL )
-            {
-                ret = 1;
-                goto exit;
-            }
+        cur = &shard->entries[shard->used++];
 
-            if( prv == NULL )
-                cache->chain = cur;
-            else
-                prv->next = cur;
-        }
+        shard->index[slot] = shard->used;
+        cur->referenced = 0;
 
 #if defined(MBEDTLS_HAVE_TIME)
         cur->timestamp = t;
@@ -276,10 +527,8 @@ int mbedtls_ssl_cache_set( void *data, const mbedtls_ssl_session *session )
     ret = 0;
 
 exit:
-#if defined(MBEDTLS_THREADING_C)
-    if( mbedtls_mutex_unlock( &cache->mutex ) != 0 )
+    if( ssl_cache_unlock( shard ) != 0 )
         ret = 1;
-#endif
 
     return( ret );
 }
@@ -295,34 +544,109 @@ void mbedtls_ssl_cache_set_timeout( mbedtls_ssl_cache_context *cache, int timeou
 
 void mbedtls_ssl_cache_set_max_entries( mbedtls_ssl_cache_context *cache, int max )
 {
+    mbedtls_ssl_cache_shard fresh[MBEDTLS_SSL_CACHE_SHARDS];
+    mbedtls_ssl_cache_shard *shard;
+    mbedtls_ssl_cache_entry *entry;
+    size_t nshards, quota, i, j, locked = 0;
+    int referenced;
+
     if( max < 0 ) max = 0;
 
-    cache->max_entries = max;
-}
+    nshards = ssl_cache_nshards( max );
 
-void mbedtls_ssl_cache_free( mbedtls_ssl_cache_context *cache )
-{
-    mbedtls_ssl_cache_entry *cur, *prv;
+    /* The only place where several shards are locked, always in order */
+#if defined(MBEDTLS_THREADING_C)
+    for( locked = 0; locked < MBEDTLS_SSL_CACHE_SHARDS; locked++ )
+        if( mbedtls_mutex_lock( &cache->shards[locked].mutex ) != 0 )
+            goto exit;
+#endif
+
+    /*
+     * Preallocate the pools for the new maximum, keeping the current ones
+     * if that fails
+     */
+    memset( fresh, 0, sizeof( fresh ) );
+
+    for( i = 0; i < nshards; i++ )
+    {
+        quota = ssl_cache_quota( max, nshards, i );
 
-    cur = cache->chain;
+        if( quota > 0 && ssl_cache_shard_alloc( &fresh[i], quota ) != 0 )
+        {
+            for( j = 0; j < i; j++ )
+            {
+                mbedtls_free( fresh[j].entries );
+                mbedtls_free( fresh[j].index );
+            }
+            goto exit;
+        }
+    }
 
-    while( cur != NULL )
+    /*
+     * Move the sessions to their new shard, those retrieved since the clock
+     * hand last passed them first, dropping those that don't fit
+     */
+    for( referenced = 1; referenced >= 0; referenced-- )
     {
-        prv = cur;
-        cur = cur->next;
+        for( i = 0; i < MBEDTLS_SSL_CACHE_SHARDS; i++ )
+        {
+            for( j = 0; j < cache->shards[i].used; j++ )
+            {
+                entry = &cache->shards[i].entries[j];
+                if( ( entry->referenced != 0 ) != referenced )
+                    continue;
+
+                shard = &fresh[ssl_cache_hash( entry->session.id,
+                                               entry->session.id_len ) &
+                               ( nshards - 1 )];
+
+                if( shard->used < shard->size )
+                    ssl_cache_insert( shard, entry );
+                else
+                    ssl_cache_entry_free( entry );
+            }
+        }
+    }
 
-        mbedtls_ssl_session_free( &prv->session );
+    for( i = 0; i < MBEDTLS_SSL_CACHE_SHARDS; i++ )
+    {
+        shard = &cache->shards[i];
 
-#if defined(MBEDTLS_X509_CRT_PARSE_C)
-        mbedtls_free( prv->peer_cert.p );
-#endif /* MBEDTLS_X509_CRT_PARSE_C */
+        mbedtls_free( shard->entries );
+        mbedtls_free( shard->index );
 
-        mbedtls_free( prv );
+        shard->entries = fresh[i].entries;
+        shard->index = fresh[i].index;
+        shard->size = fresh[i].size;
+        shard->used = fresh[i].used;
+        shard->hand = 0;
     }
 
+    cache->max_entries = max;
+    cache->nshards = nshards;
+
+exit:
 #if defined(MBEDTLS_THREADING_C)
-    mbedtls_mutex_free( &cache->mutex );
+    while( locked > 0 )
+        mbedtls_mutex_unlock( &cache->shards[--locked].mutex );
+#else
+    ((void) locked);
 #endif
 }
 
+void mbedtls_ssl_cache_free( mbedtls_ssl_cache_context *cache )
+{
+    size_t i;
+
+    for( i = 0; i < MBEDTLS_SSL_CACHE_SHARDS; i++ )
+    {
+        ssl_cache_shard_free( &cache->shards[i] );
+
+#if defined(MBEDTLS_THREADING_C)
+        mbedtls_mutex_free( &cache->shards[i].mutex );
+#endif
+    }
+
+}
+
 #endif /* MBEDTLS_SSL_CACHE_C */
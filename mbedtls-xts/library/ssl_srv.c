@@ -2188,7 +2188,7 @@ static int ssl_write_hello_verify_request( mbedtls_ssl_context *ssl )
     cookie_len_byte = p++;
 
     if( ( ret = ssl->conf->f_cookie_write( ssl->conf->p_cookie,
-                                     &p, ssl->out_buf + MBEDTLS_SSL_BUFFER_LEN,
+                                     &p, ssl->out_buf + ssl->out_buf_len,
                                      ssl->cli_id, ssl->cli_id_len ) ) != 0 )
     {
         MBEDTLS_SSL_DEBUG_RET( 1, "f_cookie_write", ret );
@@ -2665,9 +2665,76 @@ static int ssl_get_ecdh_params_from_cert( mbedtls_ssl_context *ssl )
 #endif /* MBEDTLS_KEY_EXCHANGE_ECDH_RSA_ENABLED) ||
           MBEDTLS_KEY_EXCHANGE_ECDH_ECDSA_ENABLED */
 
-static int ssl_write_server_key_exchange( mbedtls_ssl_context *ssl )
+static int ssl_send_server_key_exchange( mbedtls_ssl_context *ssl, size_t n )
+{
+    int ret;
+
+    ssl->out_msglen  = 4 + n;
+    ssl->out_msgtype = MBEDTLS_SSL_MSG_HANDSHAKE;
+    ssl->out_msg[0]  = MBEDTLS_SSL_HS_SERVER_KEY_EXCHANGE;
+
+    ssl->state++;
+
+    if( ( ret = mbedtls_ssl_write_record( ssl ) ) != 0 )
+    {
+        MBEDTLS_SSL_DEBUG_RET( 1, "mbedtls_ssl_write_record", ret );
+        return( ret );
+    }
+
+    MBEDTLS_SSL_DEBUG_MSG( 2, ( "<= write server key exchange" ) );
+
+    return( 0 );
+}
+
+#if defined(MBEDTLS_SSL_ASYNC_PRIVATE) &&                                  \
+    ( defined(MBEDTLS_KEY_EXCHANGE_DHE_RSA_ENABLED) ||                     \
+      defined(MBEDTLS_KEY_EXCHANGE_ECDHE_RSA_ENABLED) ||                   \
+      defined(MBEDTLS_KEY_EXCHANGE_ECDHE_ECDSA_ENABLED) )
+/*
+ * Collect the signature of an asynchronous operation started by
+ * ssl_write_server_key_exchange(). The parameters to sign are still in
+ * out_msg, the signature goes after its 2-byte length at async_offset.
+ */
+static int ssl_resume_server_key_exchange( mbedtls_ssl_context *ssl )
 {
     int ret;
+    size_t n = ssl->handshake->async_offset;
+    unsigned char *p = ssl->out_msg + 4 + n;
+    size_t signature_len = 0;
+
+    ret = ssl->conf->f_async_resume( ssl->conf->p_async, ssl,
+                                     p + 2, &signature_len,
+                                     MBEDTLS_SSL_MAX_CONTENT_LEN - ( 4 + n + 2 ) );
+    if( ret == MBEDTLS_ERR_SSL_WANT_ASYNC )
+    {
+        MBEDTLS_SSL_DEBUG_MSG( 2, ( "signature in progress" ) );
+        return( ret );
+    }
+
+    ssl->handshake->async_in_progress = 0;
+
+    if( ret != 0 )
+    {
+        MBEDTLS_SSL_DEBUG_RET( 1, "f_async_resume", ret );
+        return( ret );
+    }
+
+    *(p++) = (unsigned char)( signature_len >> 8 );
+    *(p++) = (unsigned char)( signature_len      );
+    n += 2;
+
+    MBEDTLS_SSL_DEBUG_BUF( 3, "my signature", p, signature_len );
+
+    n += signature_len;
+
+    return( ssl_send_server_key_exchange( ssl, n ) );
+}
+#endif /* MBEDTLS_SSL_ASYNC_PRIVATE && ( MBEDTLS_KEY_EXCHANGE_DHE_RSA_ENABLED ||
+          MBEDTLS_KEY_EXCHANGE_ECDHE_RSA_ENABLED ||
+          MBEDTLS_KEY_EXCHANGE_ECDHE_ECDSA_ENABLED ) */
+
+static int ssl_write_server_key_exchange( mbedtls_ssl_context *ssl )
+{
     size_t n = 0;
     const mbedtls_ssl_ciphersuite_t *ciphersuite_info =
                             ssl->transform_negotiate->ciphersuite_info;
@@ -2678,6 +2745,7 @@ static int ssl_write_server_key_exchange( mbedtls_ssl_context *ssl )
     defined(MBEDTLS_KEY_EXCHANGE_ECDHE_PSK_ENABLED) ||                     \
     defined(MBEDTLS_KEY_EXCHANGE_ECDHE_ECDSA_ENABLED) ||                   \
     defined(MBEDTLS_KEY_EXCHANGE_ECJPAKE_ENABLED)
+    int ret;
     unsigned char *p = ssl->out_msg + 4;
     unsigned char *dig_signed = p;
     size_t dig_signed_len = 0, len;
@@ -2688,6 +2756,15 @@ static int ssl_write_server_key_exchange( mbedtls_ssl_context *ssl )
 
     MBEDTLS_SSL_DEBUG_MSG( 2, ( "=> write server key exchange" ) );
 
+#if defined(MBEDTLS_SSL_ASYNC_PRIVATE) &&                                  \
+    ( defined(MBEDTLS_KEY_EXCHANGE_DHE_RSA_ENABLED) ||                     \
+      defined(MBEDTLS_KEY_EXCHANGE_ECDHE_RSA_ENABLED) ||                   \
+      defined(MBEDTLS_KEY_EXCHANGE_ECDHE_ECDSA_ENABLED) )
+    /* The parameters were written by a previous call */
+    if( ssl->handshake->async_in_progress != 0 )
+        return( ssl_resume_server_key_exchange( ssl ) );
+#endif
+
 #if defined(MBEDTLS_KEY_EXCHANGE_RSA_ENABLED) ||                           \
     defined(MBEDTLS_KEY_EXCHANGE_PSK_ENABLED) ||                           \
     defined(MBEDTLS_KEY_EXCHANGE_RSA_PSK_ENABLED)
@@ -2999,6 +3076,27 @@ curve_matching_done:
         }
 #endif /* MBEDTLS_SSL_PROTO_TLS1_2 */
 
+#if defined(MBEDTLS_SSL_ASYNC_PRIVATE)
+        if( ssl->conf->f_async_sign_start != NULL )
+        {
+            ret = ssl->conf->f_async_sign_start( ssl->conf->p_async, ssl,
+                        mbedtls_ssl_own_key( ssl ), md_alg, hash, hashlen != 0 ?
+                        hashlen : mbedtls_md_get_size( mbedtls_md_info_from_type( md_alg ) ) );
+            if( ret == 0 )
+            {
+                ssl->handshake->async_in_progress = 1;
+                ssl->handshake->async_offset = n;
+                return( ssl_resume_server_key_exchange( ssl ) );
+            }
+
+            if( ret != MBEDTLS_ERR_SSL_HW_ACCEL_FALLTHROUGH )
+            {
+                MBEDTLS_SSL_DEBUG_RET( 1, "f_async_sign_start", ret );
+                return( ret );
+            }
+        }
+#endif /* MBEDTLS_SSL_ASYNC_PRIVATE */
+
         if( ( ret = mbedtls_pk_sign( mbedtls_ssl_own_key( ssl ), md_alg, hash, hashlen,
                         p + 2 , &signature_len,
                         ssl->conf->f_rng, ssl->conf->p_rng ) ) != 0 )
@@ -3019,21 +3117,7 @@ curve_matching_done:
           MBEDTLS_KEY_EXCHANGE_ECDHE_RSA_ENABLED ||
           MBEDTLS_KEY_EXCHANGE_ECDHE_ECDSA_ENABLED */
 
-    ssl->out_msglen  = 4 + n;
-    ssl->out_msgtype = MBEDTLS_SSL_MSG_HANDSHAKE;
-    ssl->out_msg[0]  = MBEDTLS_SSL_HS_SERVER_KEY_EXCHANGE;
-
-    ssl->state++;
-
-    if( ( ret = mbedtls_ssl_write_record( ssl ) ) != 0 )
-    {
-        MBEDTLS_SSL_DEBUG_RET( 1, "mbedtls_ssl_write_record", ret );
-        return( ret );
-    }
-
-    MBEDTLS_SSL_DEBUG_MSG( 2, ( "<= write server key exchange" ) );
-
-    return( 0 );
+    return( ssl_send_server_key_exchange( ssl, n ) );
 }
 
 static int ssl_write_server_hello_done( mbedtls_ssl_context *ssl )
@@ -3164,6 +3248,38 @@ static int ssl_parse_encrypted_pms( mbedtls_ssl_context *ssl,
     if( ret != 0 )
         return( ret );
 
+#if defined(MBEDTLS_SSL_ASYNC_PRIVATE)
+    if( ssl->handshake->async_in_progress == 0 &&
+        ssl->conf->f_async_decrypt_start != NULL )
+    {
+        ret = ssl->conf->f_async_decrypt_start( ssl->conf->p_async, ssl,
+                                                mbedtls_ssl_own_key( ssl ),
+                                                p, len );
+        if( ret == 0 )
+            ssl->handshake->async_in_progress = 1;
+        else if( ret != MBEDTLS_ERR_SSL_HW_ACCEL_FALLTHROUGH )
+        {
+            MBEDTLS_SSL_DEBUG_RET( 1, "f_async_decrypt_start", ret );
+            return( ret );
+        }
+    }
+
+    if( ssl->handshake->async_in_progress != 0 )
+    {
+        peer_pmslen = 0;
+        ret = ssl->conf->f_async_resume( ssl->conf->p_async, ssl,
+                                         peer_pms, &peer_pmslen,
+                                         sizeof( peer_pms ) );
+        if( ret == MBEDTLS_ERR_SSL_WANT_ASYNC )
+        {
+            MBEDTLS_SSL_DEBUG_MSG( 2, ( "decryption in progress" ) );
+            return( ret );
+        }
+
+        ssl->handshake->async_in_progress = 0;
+    }
+    else
+#endif /* MBEDTLS_SSL_ASYNC_PRIVATE */
     ret = mbedtls_pk_decrypt( mbedtls_ssl_own_key( ssl ), p, len,
                       peer_pms, &peer_pmslen,
                       sizeof( peer_pms ),
@@ -3285,6 +3401,12 @@ static int ssl_parse_client_key_exchange( mbedtls_ssl_context *ssl )
 
     MBEDTLS_SSL_DEBUG_MSG( 2, ( "=> parse client key exchange" ) );
 
+#if defined(MBEDTLS_SSL_ASYNC_PRIVATE) &&                                  \
+    ( defined(MBEDTLS_KEY_EXCHANGE_RSA_ENABLED) ||                         \
+      defined(MBEDTLS_KEY_EXCHANGE_RSA_PSK_ENABLED) )
+    /* When resuming a decryption, the message is already in in_msg */
+    if( ssl->handshake->async_in_progress == 0 )
+#endif
     if( ( ret = mbedtls_ssl_read_record( ssl ) ) != 0 )
     {
         MBEDTLS_SSL_DEBUG_RET( 1, "mbedtls_ssl_read_record", ret );
@@ -3734,7 +3856,7 @@ static int ssl_write_new_session_ticket( mbedtls_ssl_context *ssl )
     if( ( ret = ssl->conf->f_ticket_write( ssl->conf->p_ticket,
                                 ssl->session_negotiate,
                                 ssl->out_msg + 10,
-                                ssl->out_msg + MBEDTLS_SSL_MAX_CONTENT_LEN,
+                                ssl->out_buf + ssl->out_buf_len,
                                 &tlen, &lifetime ) ) != 0 )
     {
         MBEDTLS_SSL_DEBUG_RET( 1, "mbedtls_ssl_ticket_write", ret );
@@ -41,6 +41,7 @@
 
 #include <string.h>
 
+
 /* Implementation that should never be optimized out by the compiler */
 static void mbedtls_zeroize( void *v, size_t n ) {
     volatile unsigned char *p = v; while( n-- ) *p++ = 0;
@@ -85,11 +86,36 @@ static int ssl_ticket_gen_key( mbedtls_ssl_ticket_context *ctx,
                                  mbedtls_cipher_get_key_bitlen( &key->ctx ),
                                  MBEDTLS_ENCRYPT );
 
+#if defined(MBEDTLS_THREADING_PTHREAD)
+    /* Kept for the copies of the threads, see ssl_ticket_thread_keys() */
+    memcpy( key->key, buf, sizeof( key->key ) );
+    ctx->generation++;
+#endif
+
     mbedtls_zeroize( buf, sizeof( buf ) );
 
     return( ret );
 }
 
+#if defined(MBEDTLS_HAVE_TIME)
+/*
+ * Check whether a key is too old to protect new tickets
+ */
+static int ssl_ticket_key_expired( const mbedtls_ssl_ticket_context *ctx,
+                                   const mbedtls_ssl_ticket_key *key )
+{
+    uint32_t current_time;
+
+    if( ctx->ticket_lifetime == 0 )
+        return( 0 );
+
+    current_time = (uint32_t) mbedtls_time( NULL );
+
+    return( current_time < key->generation_time ||
+            current_time - key->generation_time >= ctx->ticket_lifetime );
+}
+#endif /* MBEDTLS_HAVE_TIME */
+
 /*
  * Rotate/generate keys if necessary
  */
@@ -98,25 +124,322 @@ static int ssl_ticket_update_keys( mbedtls_ssl_ticket_context *ctx )
 #if !defined(MBEDTLS_HAVE_TIME)
     ((void) ctx);
 #else
-    if( ctx->ticket_lifetime != 0 )
+    if( ssl_ticket_key_expired( ctx, &ctx->keys[ctx->active] ) )
+    {
+        ctx->active = 1 - ctx->active;
+
+        return( ssl_ticket_gen_key( ctx, ctx->active ) );
+    }
+#endif /* MBEDTLS_HAVE_TIME */
+
+    return( 0 );
+}
+
+#if defined(MBEDTLS_THREADING_PTHREAD)
+/*
+ * Number of fork() calls that led to this process, so that copies notice
+ * they were inherited without a system call for every ticket
+ */
+static volatile uint32_t ssl_ticket_forks = 0;
+static pthread_once_t ssl_ticket_atfork_once = PTHREAD_ONCE_INIT;
+static int ssl_ticket_atfork_ret = 0;
+
+static void ssl_ticket_atfork_child( void )
+{
+    ssl_ticket_forks++;
+}
+
+static void ssl_ticket_atfork_register( void )
+{
+    ssl_ticket_atfork_ret = pthread_atfork( NULL, NULL,
+                                            ssl_ticket_atfork_child );
+}
+
+/*
+ * Thread exit handler: give the copy back so that short-lived threads (one
+ * per connection) do not make the list grow.
+ */
+static void ssl_ticket_thread_release( void *data )
+{
+    mbedtls_ssl_ticket_thread *thr = (mbedtls_ssl_ticket_thread *) data;
+    mbedtls_ssl_ticket_context *ctx = (mbedtls_ssl_ticket_context *) thr->owner;
+
+    if( mbedtls_mutex_lock( &ctx->mutex ) != 0 )
+        return;
+
+    thr->in_use = 0;
+
+    mbedtls_mutex_unlock( &ctx->mutex );
+}
+
+/*
+ * Bind the calling thread to a free copy, or to a new one.
+ * Must be called with the mutex held.
+ */
+static int ssl_ticket_thread_claim( mbedtls_ssl_ticket_context *ctx,
+                                    mbedtls_ssl_ticket_thread **thr )
+{
+    int ret;
+    mbedtls_ssl_ticket_thread *cur;
+
+    for( cur = ctx->threads; cur != NULL; cur = cur->next )
+        if( cur->in_use == 0 )
+            break;
+
+    if( cur == NULL )
     {
-        uint32_t current_time = (uint32_t) mbedtls_time( NULL );
-        uint32_t key_time = ctx->keys[ctx->active].generation_time;
+        cur = mbedtls_calloc( 1, sizeof( mbedtls_ssl_ticket_thread ) );
+        if( cur == NULL )
+            return( MBEDTLS_ERR_SSL_ALLOC_FAILED );
 
-        if( current_time > key_time &&
-            current_time - key_time < ctx->ticket_lifetime )
+        mbedtls_cipher_init( &cur->keys[0].ctx );
+        mbedtls_cipher_init( &cur->keys[1].ctx );
+
+        if( ( ret = mbedtls_cipher_setup( &cur->keys[0].ctx,
+                                          ctx->keys[0].ctx.cipher_info ) ) != 0 ||
+            ( ret = mbedtls_cipher_setup( &cur->keys[1].ctx,
+                                          ctx->keys[1].ctx.cipher_info ) ) != 0 )
         {
-            return( 0 );
+            mbedtls_cipher_free( &cur->keys[0].ctx );
+            mbedtls_cipher_free( &cur->keys[1].ctx );
+            mbedtls_free( cur );
+            return( ret );
         }
 
-        ctx->active = 1 - ctx->active;
+        /* Cannot match the current generation nor fork count while we
+         * hold the mutex, so the keys get copied and the copy gets an
+         * identifier */
+        cur->generation = ctx->generation - 1;
+        cur->forks = ssl_ticket_forks - 1;
+        cur->owner = ctx;
+        cur->next = ctx->threads;
+        ctx->threads = cur;
+    }
 
-        return( ssl_ticket_gen_key( ctx, ctx->active ) );
+    if( pthread_setspecific( ctx->thread_key, cur ) != 0 )
+        return( MBEDTLS_ERR_THREADING_MUTEX_ERROR );
+
+    cur->in_use = 1;
+    *thr = cur;
+
+    return( 0 );
+}
+
+#define TICKET_IV_COUNT ( (uint64_t) 1 << 32 )   /* IVs per identifier */
+
+/*
+ * Give a copy a new random identifier, different from the other copies,
+ * and restart its counter. Done on first use of the copy in a process, so
+ * that processes sharing a context after fork() don't repeat IVs, and when
+ * the counter is exhausted.
+ * Must be called with the mutex held.
+ */
+static int ssl_ticket_thread_rename( mbedtls_ssl_ticket_context *ctx,
+                                     mbedtls_ssl_ticket_thread *thr )
+{
+    int ret;
+    unsigned char buf[8], i;
+    mbedtls_ssl_ticket_thread *cur;
+
+    do
+    {
+        if( ( ret = ctx->f_rng( ctx->p_rng, buf, sizeof( buf ) ) ) != 0 )
+            return( ret );
+
+        thr->id = 0;
+        for( i = 0; i < 8; i++ )
+            thr->id = ( thr->id << 8 ) | buf[i];
+
+        for( cur = ctx->threads; cur != NULL; cur = cur->next )
+            if( cur != thr && cur->id == thr->id )
+                break;
     }
-    else
-#endif /* MBEDTLS_HAVE_TIME */
+    while( cur != NULL );
+
+    thr->invocations = 0;
+    thr->forks = ssl_ticket_forks;
+
+    return( 0 );
+}
+
+/*
+ * Get the copy of the keys of the calling thread, up to date.
+ *
+ * The mutex is only taken on first use by a thread or process, when another
+ * thread changed the keys, when the active key must be rotated, or when the
+ * IV counter is exhausted: the keys of the
+ * context are only ever written and copied under the mutex, and reading a
+ * stale generation number only delays the refresh until the next call
+ * (previous keys remain valid for parsing one more ticket lifetime).
+ */
+static int ssl_ticket_thread_keys( mbedtls_ssl_ticket_context *ctx,
+                                   mbedtls_ssl_ticket_thread **thr )
+{
+    int ret;
+    unsigned char i;
+    mbedtls_ssl_ticket_thread *cur;
+
+    cur = (mbedtls_ssl_ticket_thread *) pthread_getspecific( ctx->thread_key );
+
+    if( cur != NULL && cur->generation == ctx->generation &&
+        cur->forks == ssl_ticket_forks &&
+        cur->invocations < TICKET_IV_COUNT
+#if defined(MBEDTLS_HAVE_TIME)
+        && ! ssl_ticket_key_expired( ctx, &cur->keys[cur->active] )
+#endif
+      )
+    {
+        *thr = cur;
         return( 0 );
+    }
+
+    if( ( ret = mbedtls_mutex_lock( &ctx->mutex ) ) != 0 )
+        return( ret );
+
+    if( cur == NULL && ( ret = ssl_ticket_thread_claim( ctx, &cur ) ) != 0 )
+        goto cleanup;
+
+    if( ( cur->forks != ssl_ticket_forks ||
+          cur->invocations >= TICKET_IV_COUNT ) &&
+        ( ret = ssl_ticket_thread_rename( ctx, cur ) ) != 0 )
+        goto cleanup;
+
+    if( ( ret = ssl_ticket_update_keys( ctx ) ) != 0 )
+        goto cleanup;
+
+    if( cur->generation != ctx->generation )
+    {
+        for( i = 0; i < 2; i++ )
+        {
+            /* Rotation only replaces one of the keys */
+            if( memcmp( cur->keys[i].name, ctx->keys[i].name, 4 ) == 0 &&
+                cur->keys[i].generation_time == ctx->keys[i].generation_time )
+            {
+                continue;
+            }
+
+            if( ( ret = mbedtls_cipher_setkey( &cur->keys[i].ctx,
+                            ctx->keys[i].key,
+                            mbedtls_cipher_get_key_bitlen( &cur->keys[i].ctx ),
+                            MBEDTLS_ENCRYPT ) ) != 0 )
+            {
+                goto cleanup;
+            }
+
+            memcpy( cur->keys[i].name, ctx->keys[i].name, 4 );
+            cur->keys[i].generation_time = ctx->keys[i].generation_time;
+        }
+
+        cur->active = ctx->active;
+        cur->generation = ctx->generation;
+    }
+
+    *thr = cur;
+
+cleanup:
+    if( mbedtls_mutex_unlock( &ctx->mutex ) != 0 )
+        return( MBEDTLS_ERR_THREADING_MUTEX_ERROR );
+
+    return( ret );
+}
+#endif /* MBEDTLS_THREADING_PTHREAD */
+
+/*
+ * Generate the IV of a new ticket.
+ *
+ * With per-thread copies, use the construction of NIST SP 800-38D 8.2.1:
+ * the 64-bit identifier of the copy, unique among the copies and drawn
+ * again in each process, followed by the 32-bit number of tickets issued
+ * with this identifier, which never goes back, even when the keys change.
+ * Random identifiers only collide across processes with probability about
+ * 2^-64 per pair of copies.
+ * Otherwise, use the RNG.
+ */
+static int ssl_ticket_gen_iv( mbedtls_ssl_ticket_context *ctx,
+                              unsigned char iv[12] )
+{
+#if defined(MBEDTLS_THREADING_PTHREAD)
+    mbedtls_ssl_ticket_thread *thr;
+    uint64_t n;
+    unsigned char i;
+
+    /* Bound by ssl_ticket_acquire_keys() */
+    thr = (mbedtls_ssl_ticket_thread *) pthread_getspecific( ctx->thread_key );
+    if( thr == NULL )
+        return( MBEDTLS_ERR_SSL_INTERNAL_ERROR );
+
+    /* Checked by ssl_ticket_thread_keys() */
+    if( thr->invocations >= TICKET_IV_COUNT )
+        return( MBEDTLS_ERR_SSL_INTERNAL_ERROR );
+
+    n = thr->id;
+    for( i = 0; i < 8; i++ )
+    {
+        iv[7 - i] = (unsigned char)( n & 0xFF );
+        n >>= 8;
+    }
+
+    n = thr->invocations++;
+    for( i = 0; i < 4; i++ )
+    {
+        iv[11 - i] = (unsigned char)( n & 0xFF );
+        n >>= 8;
+    }
+
+    return( 0 );
+#else
+    return( ctx->f_rng( ctx->p_rng, iv, 12 ) );
+#endif /* MBEDTLS_THREADING_PTHREAD */
+}
+
+/*
+ * Get the current keys, to be used until ssl_ticket_release_keys()
+ */
+static int ssl_ticket_acquire_keys( mbedtls_ssl_ticket_context *ctx,
+                                    mbedtls_ssl_ticket_key **keys,
+                                    unsigned char *active )
+{
+    int ret;
+#if defined(MBEDTLS_THREADING_PTHREAD)
+    mbedtls_ssl_ticket_thread *thr;
+
+    if( ( ret = ssl_ticket_thread_keys( ctx, &thr ) ) != 0 )
+        return( ret );
+
+    *keys = thr->keys;
+    *active = thr->active;
+#else
+#if defined(MBEDTLS_THREADING_C)
+    if( ( ret = mbedtls_mutex_lock( &ctx->mutex ) ) != 0 )
+        return( ret );
+#endif
+
+    if( ( ret = ssl_ticket_update_keys( ctx ) ) != 0 )
+    {
+#if defined(MBEDTLS_THREADING_C)
+        mbedtls_mutex_unlock( &ctx->mutex );
+#endif
+        return( ret );
+    }
+
+    *keys = ctx->keys;
+    *active = ctx->active;
+#endif /* MBEDTLS_THREADING_PTHREAD */
+
+    return( 0 );
+}
+
+#if defined(MBEDTLS_THREADING_C)
+static int ssl_ticket_release_keys( mbedtls_ssl_ticket_context *ctx )
+{
+#if defined(MBEDTLS_THREADING_PTHREAD)
+    ((void) ctx);
+    return( 0 );
+#else
+    return( mbedtls_mutex_unlock( &ctx->mutex ) );
+#endif
 }
+#endif /* MBEDTLS_THREADING_C */
 
 /*
  * Setup context for actual use
@@ -159,6 +482,19 @@ int mbedtls_ssl_ticket_setup( mbedtls_ssl_ticket_context *ctx,
         return( ret );
     }
 
+#if defined(MBEDTLS_THREADING_PTHREAD)
+    if( pthread_once( &ssl_ticket_atfork_once,
+                      ssl_ticket_atfork_register ) != 0 ||
+        ssl_ticket_atfork_ret != 0 )
+    {
+        return( MBEDTLS_ERR_THREADING_MUTEX_ERROR );
+    }
+
+    if( pthread_key_create( &ctx->thread_key, ssl_ticket_thread_release ) != 0 )
+        return( MBEDTLS_ERR_THREADING_MUTEX_ERROR );
+    ctx->thread_key_valid = 1;
+#endif
+
     return( 0 );
 }
 
@@ -293,7 +629,8 @@ int mbedtls_ssl_ticket_write( void *p_ticket,
 {
     int ret;
     mbedtls_ssl_ticket_context *ctx = p_ticket;
-    mbedtls_ssl_ticket_key *key;
+    mbedtls_ssl_ticket_key *keys, *key;
+    unsigned char active;
     unsigned char *key_name = start;
     unsigned char *iv = start + 4;
     unsigned char *state_len_bytes = iv + 12;
@@ -311,21 +648,16 @@ int mbedtls_ssl_ticket_write( void *p_ticket,
     if( end - start < 4 + 12 + 2 + 16 )
         return( MBEDTLS_ERR_SSL_BUFFER_TOO_SMALL );
 
-#if defined(MBEDTLS_THREADING_C)
-    if( ( ret = mbedtls_mutex_lock( &ctx->mutex ) ) != 0 )
+    if( ( ret = ssl_ticket_acquire_keys( ctx, &keys, &active ) ) != 0 )
         return( ret );
-#endif
-
-    if( ( ret = ssl_ticket_update_keys( ctx ) ) != 0 )
-        goto cleanup;
 
-    key = &ctx->keys[ctx->active];
+    key = &keys[active];
 
     *ticket_lifetime = ctx->ticket_lifetime;
 
     memcpy( key_name, key->name, 4 );
 
-    if( ( ret = ctx->f_rng( ctx->p_rng, iv, 12 ) ) != 0 )
+    if( ( ret = ssl_ticket_gen_iv( ctx, iv ) ) != 0 )
         goto cleanup;
 
     /* Dump session state */
@@ -356,7 +688,7 @@ int mbedtls_ssl_ticket_write( void *p_ticket,
 
 cleanup:
 #if defined(MBEDTLS_THREADING_C)
-    if( mbedtls_mutex_unlock( &ctx->mutex ) != 0 )
+    if( ssl_ticket_release_keys( ctx ) != 0 )
         return( MBEDTLS_ERR_THREADING_MUTEX_ERROR );
 #endif
 
@@ -367,14 +699,14 @@ cleanup:
  * Select key based on name
  */
 static mbedtls_ssl_ticket_key *ssl_ticket_select_key(
-        mbedtls_ssl_ticket_context *ctx,
+        mbedtls_ssl_ticket_key *keys,
         const unsigned char name[4] )
 {
     unsigned char i;
 
-    for( i = 0; i < sizeof( ctx->keys ) / sizeof( *ctx->keys ); i++ )
-        if( memcmp( name, ctx->keys[i].name, 4 ) == 0 )
-            return( &ctx->keys[i] );
+    for( i = 0; i < 2; i++ )
+        if( memcmp( name, keys[i].name, 4 ) == 0 )
+            return( &keys[i] );
 
     return( NULL );
 }
@@ -389,7 +721,8 @@ int mbedtls_ssl_ticket_parse( void *p_ticket,
 {
     int ret;
     mbedtls_ssl_ticket_context *ctx = p_ticket;
-    mbedtls_ssl_ticket_key *key;
+    mbedtls_ssl_ticket_key *keys, *key;
+    unsigned char active;
     unsigned char *key_name = buf;
     unsigned char *iv = buf + 4;
     unsigned char *enc_len_p = iv + 12;
@@ -404,13 +737,8 @@ int mbedtls_ssl_ticket_parse( void *p_ticket,
     if( len < 4 + 12 + 2 + 16 )
         return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
 
-#if defined(MBEDTLS_THREADING_C)
-    if( ( ret = mbedtls_mutex_lock( &ctx->mutex ) ) != 0 )
+    if( ( ret = ssl_ticket_acquire_keys( ctx, &keys, &active ) ) != 0 )
         return( ret );
-#endif
-
-    if( ( ret = ssl_ticket_update_keys( ctx ) ) != 0 )
-        goto cleanup;
 
     enc_len = ( enc_len_p[0] << 8 ) | enc_len_p[1];
     tag = ticket + enc_len;
@@ -422,7 +750,7 @@ int mbedtls_ssl_ticket_parse( void *p_ticket,
     }
 
     /* Select key */
-    if( ( key = ssl_ticket_select_key( ctx, key_name ) ) == NULL )
+    if( ( key = ssl_ticket_select_key( keys, key_name ) ) == NULL )
     {
         /* We can't know for sure but this is a likely option unless we're
          * under attack - this is only informative anyway */
@@ -466,7 +794,7 @@ int mbedtls_ssl_ticket_parse( void *p_ticket,
 
 cleanup:
 #if defined(MBEDTLS_THREADING_C)
-    if( mbedtls_mutex_unlock( &ctx->mutex ) != 0 )
+    if( ssl_ticket_release_keys( ctx ) != 0 )
         return( MBEDTLS_ERR_THREADING_MUTEX_ERROR );
 #endif
 
@@ -478,6 +806,23 @@ cleanup:
  */
 void mbedtls_ssl_ticket_free( mbedtls_ssl_ticket_context *ctx )
 {
+#if defined(MBEDTLS_THREADING_PTHREAD)
+    mbedtls_ssl_ticket_thread *thr;
+
+    if( ctx->thread_key_valid )
+        (void) pthread_key_delete( ctx->thread_key );
+
+    while( ( thr = ctx->threads ) != NULL )
+    {
+        ctx->threads = thr->next;
+
+        mbedtls_cipher_free( &thr->keys[0].ctx );
+        mbedtls_cipher_free( &thr->keys[1].ctx );
+        mbedtls_zeroize( thr, sizeof( mbedtls_ssl_ticket_thread ) );
+        mbedtls_free( thr );
+    }
+#endif
+
     mbedtls_cipher_free( &ctx->keys[0].ctx );
     mbedtls_cipher_free( &ctx->keys[1].ctx );
 
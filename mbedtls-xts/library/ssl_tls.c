@@ -55,6 +55,10 @@
 #include "mbedtls/oid.h"
 #endif
 
+#if defined(MBEDTLS_AES_OFFLOAD) && defined(MBEDTLS_GCM_C)
+#include "mbedtls/gcm.h"
+#endif
+
 /* Implementation that should never be optimized out by the compiler */
 static void mbedtls_zeroize( void *v, size_t n ) {
     volatile unsigned char *p = v; while( n-- ) *p++ = 0;
@@ -453,6 +457,7 @@ static int tls_prf_sha384( const unsigned char *secret, size_t slen,
 #endif /* MBEDTLS_SSL_PROTO_TLS1_2 */
 
 static void ssl_update_checksum_start( mbedtls_ssl_context *, const unsigned char *, size_t );
+static void ssl_update_checksum_all( mbedtls_ssl_context *, const unsigned char *, size_t );
 
 #if defined(MBEDTLS_SSL_PROTO_SSL3) || defined(MBEDTLS_SSL_PROTO_TLS1) || \
     defined(MBEDTLS_SSL_PROTO_TLS1_1)
@@ -922,6 +927,29 @@ int mbedtls_ssl_derive_keys( mbedtls_ssl_context *ssl )
     }
 #endif /* MBEDTLS_CIPHER_MODE_CBC */
 
+#if defined(MBEDTLS_AES_OFFLOAD) && defined(MBEDTLS_GCM_C)
+    if( ssl->conf->aes_offload != NULL &&
+        ( cipher_info->type == MBEDTLS_CIPHER_AES_128_GCM ||
+          cipher_info->type == MBEDTLS_CIPHER_AES_192_GCM ||
+          cipher_info->type == MBEDTLS_CIPHER_AES_256_GCM ) )
+    {
+        MBEDTLS_SSL_DEBUG_MSG( 3, ( "offloading AES-GCM records" ) );
+
+        if( ( ret = mbedtls_gcm_set_offload(
+                        transform->cipher_ctx_enc.cipher_ctx,
+                        ssl->conf->aes_offload, key1,
+                        cipher_info->key_bitlen ) ) != 0 ||
+            ( ret = mbedtls_gcm_set_offload(
+                        transform->cipher_ctx_dec.cipher_ctx,
+                        ssl->conf->aes_offload, key2,
+                        cipher_info->key_bitlen ) ) != 0 )
+        {
+            MBEDTLS_SSL_DEBUG_RET( 1, "mbedtls_gcm_set_offload", ret );
+            return( ret );
+        }
+    }
+#endif /* MBEDTLS_AES_OFFLOAD && MBEDTLS_GCM_C */
+
     mbedtls_zeroize( keyblk, sizeof( keyblk ) );
 
 #if defined(MBEDTLS_ZLIB_SUPPORT)
@@ -2081,6 +2109,7 @@ static int ssl_compress_buf( mbedtls_ssl_context *ssl )
     unsigned char *msg_post = ssl->out_msg;
     size_t len_pre = ssl->out_msglen;
     unsigned char *msg_pre = ssl->compress_buf;
+    size_t len_max = ssl->out_buf_len - (size_t)( ssl->out_msg - ssl->out_buf );
 
     MBEDTLS_SSL_DEBUG_MSG( 2, ( "=> compress buf" ) );
 
@@ -2098,7 +2127,7 @@ static int ssl_compress_buf( mbedtls_ssl_context *ssl )
     ssl->transform_out->ctx_deflate.next_in = msg_pre;
     ssl->transform_out->ctx_deflate.avail_in = len_pre;
     ssl->transform_out->ctx_deflate.next_out = msg_post;
-    ssl->transform_out->ctx_deflate.avail_out = MBEDTLS_SSL_BUFFER_LEN;
+    ssl->transform_out->ctx_deflate.avail_out = len_max;
 
     ret = deflate( &ssl->transform_out->ctx_deflate, Z_SYNC_FLUSH );
     if( ret != Z_OK )
@@ -2107,7 +2136,7 @@ static int ssl_compress_buf( mbedtls_ssl_context *ssl )
         return( MBEDTLS_ERR_SSL_COMPRESSION_FAILED );
     }
 
-    ssl->out_msglen = MBEDTLS_SSL_BUFFER_LEN -
+    ssl->out_msglen = len_max -
                       ssl->transform_out->ctx_deflate.avail_out;
 
     MBEDTLS_SSL_DEBUG_MSG( 3, ( "after compression: msglen = %d, ",
@@ -2127,6 +2156,10 @@ static int ssl_decompress_buf( mbedtls_ssl_context *ssl )
     unsigned char *msg_post = ssl->in_msg;
     size_t len_pre = ssl->in_msglen;
     unsigned char *msg_pre = ssl->compress_buf;
+    size_t len_max = ssl->in_buf_len - (size_t)( ssl->in_msg - ssl->in_buf );
+
+    if( len_max > MBEDTLS_SSL_MAX_CONTENT_LEN )
+        len_max = MBEDTLS_SSL_MAX_CONTENT_LEN;
 
     MBEDTLS_SSL_DEBUG_MSG( 2, ( "=> decompress buf" ) );
 
@@ -2144,7 +2177,7 @@ static int ssl_decompress_buf( mbedtls_ssl_context *ssl )
     ssl->transform_in->ctx_inflate.next_in = msg_pre;
     ssl->transform_in->ctx_inflate.avail_in = len_pre;
     ssl->transform_in->ctx_inflate.next_out = msg_post;
-    ssl->transform_in->ctx_inflate.avail_out = MBEDTLS_SSL_MAX_CONTENT_LEN;
+    ssl->transform_in->ctx_inflate.avail_out = len_max;
 
     ret = inflate( &ssl->transform_in->ctx_inflate, Z_SYNC_FLUSH );
     if( ret != Z_OK )
@@ -2153,7 +2186,7 @@ static int ssl_decompress_buf( mbedtls_ssl_context *ssl )
         return( MBEDTLS_ERR_SSL_COMPRESSION_FAILED );
     }
 
-    ssl->in_msglen = MBEDTLS_SSL_MAX_CONTENT_LEN -
+    ssl->in_msglen = len_max -
                      ssl->transform_in->ctx_inflate.avail_out;
 
     MBEDTLS_SSL_DEBUG_MSG( 3, ( "after decompression: msglen = %d, ",
@@ -2228,7 +2261,7 @@ int mbedtls_ssl_fetch_input( mbedtls_ssl_context *ssl, size_t nb_want )
         return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
     }
 
-    if( nb_want > MBEDTLS_SSL_BUFFER_LEN - (size_t)( ssl->in_hdr - ssl->in_buf ) )
+    if( nb_want > ssl->in_buf_len - (size_t)( ssl->in_hdr - ssl->in_buf ) )
     {
         MBEDTLS_SSL_DEBUG_MSG( 1, ( "requesting more data than fits" ) );
         return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
@@ -2311,7 +2344,7 @@ int mbedtls_ssl_fetch_input( mbedtls_ssl_context *ssl, size_t nb_want )
             ret = MBEDTLS_ERR_SSL_TIMEOUT;
         else
         {
-            len = MBEDTLS_SSL_BUFFER_LEN - ( ssl->in_hdr - ssl->in_buf );
+            len = ssl->in_buf_len - ( ssl->in_hdr - ssl->in_buf );
 
             if( ssl->state != MBEDTLS_SSL_HANDSHAKE_OVER )
                 timeout = ssl->handshake->retransmit_timeout;
@@ -2422,10 +2455,83 @@ int mbedtls_ssl_fetch_input( mbedtls_ssl_context *ssl, size_t nb_want )
 /*
  * Flush any data not yet written
  */
+/*
+ * Increment the outgoing record counter
+ */
+static int ssl_out_ctr_increment( mbedtls_ssl_context *ssl )
+{
+    unsigned char i;
+
+    for( i = 8; i > ssl_ep_len( ssl ); i-- )
+        if( ++ssl->out_ctr[i - 1] != 0 )
+            break;
+
+    /* The loop goes to its end iff the counter is wrapping */
+    if( i == ssl_ep_len( ssl ) )
+    {
+        MBEDTLS_SSL_DEBUG_MSG( 1, ( "outgoing message counter would wrap" ) );
+        return( MBEDTLS_ERR_SSL_COUNTER_WRAPPING );
+    }
+
+    return( 0 );
+}
+
+#if defined(MBEDTLS_SSL_BATCH_WRITES)
+/*
+ * Send what is left of a batch of records with the vectored callback.
+ * Their counters were already incremented when they were encrypted.
+ */
+static int ssl_flush_batch( mbedtls_ssl_context *ssl )
+{
+    int ret;
+    mbedtls_ssl_iovec iov[MBEDTLS_SSL_BATCH_RECORDS];
+    size_t i, cnt, skip;
+
+    while( ssl->out_left > 0 )
+    {
+        /* Skip the bytes already sent */
+        skip = 0;
+        for( i = 0; i < ssl->out_batch_cnt; i++ )
+            skip += ssl->out_batch[i].len;
+        skip -= ssl->out_left;
+
+        for( i = 0, cnt = 0; i < ssl->out_batch_cnt; i++ )
+        {
+            if( skip >= ssl->out_batch[i].len )
+            {
+                skip -= ssl->out_batch[i].len;
+                continue;
+            }
+
+            iov[cnt].buf = ssl->out_batch[i].buf + skip;
+            iov[cnt].len = ssl->out_batch[i].len - skip;
+            skip = 0;
+            cnt++;
+        }
+
+        MBEDTLS_SSL_DEBUG_MSG( 2, ( "batch of %d records, out_left: %d",
+                                    ssl->out_batch_cnt, ssl->out_left ) );
+
+        ret = ssl->f_send_vec( ssl->p_bio, iov, cnt );
+
+        MBEDTLS_SSL_DEBUG_RET( 2, "ssl->f_send_vec", ret );
+
+        if( ret <= 0 )
+            return( ret );
+
+        ssl->out_left -= ret;
+    }
+
+    ssl->out_batch_cnt = 0;
+
+    return( 0 );
+}
+#endif /* MBEDTLS_SSL_BATCH_WRITES */
+
 int mbedtls_ssl_flush_output( mbedtls_ssl_context *ssl )
 {
     int ret;
-    unsigned char *buf, i;
+    unsigned char *buf;
 
     MBEDTLS_SSL_DEBUG_MSG( 2, ( "=> flush output" ) );
 
@@ -2443,6 +2549,17 @@ int mbedtls_ssl_flush_output( mbedtls_ssl_context *ssl )
         return( 0 );
     }
 
+#if defined(MBEDTLS_SSL_BATCH_WRITES)
+    if( ssl->out_batch_cnt != 0 )
+    {
+        if( ( ret = ssl_flush_batch( ssl ) ) != 0 )
+            return( ret );
+
+        MBEDTLS_SSL_DEBUG_MSG( 2, ( "<= flush output" ) );
+        return( 0 );
+    }
+#endif
+
     while( ssl->out_left > 0 )
     {
         MBEDTLS_SSL_DEBUG_MSG( 2, ( "message length: %d, out_left: %d",
@@ -2460,16 +2577,8 @@ int mbedtls_ssl_flush_output( mbedtls_ssl_context *ssl )
         ssl->out_left -= ret;
     }
 
-    for( i = 8; i > ssl_ep_len( ssl ); i-- )
-        if( ++ssl->out_ctr[i - 1] != 0 )
-            break;
-
-    /* The loop goes to its end iff the counter is wrapping */
-    if( i == ssl_ep_len( ssl ) )
-    {
-        MBEDTLS_SSL_DEBUG_MSG( 1, ( "outgoing message counter would wrap" ) );
-        return( MBEDTLS_ERR_SSL_COUNTER_WRAPPING );
-    }
+    if( ( ret = ssl_out_ctr_increment( ssl ) ) != 0 )
+        return( ret );
 
     MBEDTLS_SSL_DEBUG_MSG( 2, ( "<= flush output" ) );
 
@@ -2703,13 +2812,15 @@ void mbedtls_ssl_send_flight_completed( mbedtls_ssl_context *ssl )
  * Record layer functions
  */
 
+static int ssl_prepare_record( mbedtls_ssl_context *ssl );
+
 /*
  * Write current record.
  * Uses ssl->out_msgtype, ssl->out_msglen and bytes at ssl->out_msg.
  */
 int mbedtls_ssl_write_record( mbedtls_ssl_context *ssl )
 {
-    int ret, done = 0, out_msg_type;
+    int ret, out_msg_type;
     size_t len = ssl->out_msglen;
 
     MBEDTLS_SSL_DEBUG_MSG( 2, ( "=> write record" ) );
@@ -2792,6 +2903,29 @@ int mbedtls_ssl_write_record( mbedtls_ssl_context *ssl )
     }
 #endif
 
+    if( ( ret = ssl_prepare_record( ssl ) ) != 0 )
+        return( ret );
+
+    if( ( ret = mbedtls_ssl_flush_output( ssl ) ) != 0 )
+    {
+        MBEDTLS_SSL_DEBUG_RET( 1, "mbedtls_ssl_flush_output", ret );
+        return( ret );
+    }
+
+    MBEDTLS_SSL_DEBUG_MSG( 2, ( "<= write record" ) );
+
+    return( 0 );
+}
+
+/*
+ * Compress and encrypt the record at ssl->out_msg and write its header,
+ * leaving it ready to be sent
+ */
+static int ssl_prepare_record( mbedtls_ssl_context *ssl )
+{
+    int ret, done = 0;
+    size_t len = ssl->out_msglen;
+
 #if defined(MBEDTLS_ZLIB_SUPPORT)
     if( ssl->transform_out != NULL &&
         ssl->session_out->compression == MBEDTLS_SSL_COMPRESS_DEFLATE )
@@ -2855,14 +2989,6 @@ int mbedtls_ssl_write_record( mbedtls_ssl_context *ssl )
                        ssl->out_hdr, mbedtls_ssl_hdr_len( ssl ) + ssl->out_msglen );
     }
 
-    if( ( ret = mbedtls_ssl_flush_output( ssl ) ) != 0 )
-    {
-        MBEDTLS_SSL_DEBUG_RET( 1, "mbedtls_ssl_flush_output", ret );
-        return( ret );
-    }
-
-    MBEDTLS_SSL_DEBUG_MSG( 2, ( "<= write record" ) );
-
     return( 0 );
 }
 
@@ -3062,7 +3188,7 @@ static int ssl_reassemble_dtls_handshake( mbedtls_ssl_context *ssl )
         ssl->next_record_offset = new_remain - ssl->in_hdr;
         ssl->in_left = ssl->next_record_offset + remain_len;
 
-        if( ssl->in_left > MBEDTLS_SSL_BUFFER_LEN -
+        if( ssl->in_left > ssl->in_buf_len -
                            (size_t)( ssl->in_hdr - ssl->in_buf ) )
         {
             MBEDTLS_SSL_DEBUG_MSG( 1, ( "reassembled message too large for buffer" ) );
@@ -3432,7 +3558,7 @@ static int ssl_handle_possible_reconnect( mbedtls_ssl_context *ssl )
             ssl->conf->p_cookie,
             ssl->cli_id, ssl->cli_id_len,
             ssl->in_buf, ssl->in_left,
-            ssl->out_buf, MBEDTLS_SSL_MAX_CONTENT_LEN, &len );
+            ssl->out_buf, ssl->out_buf_len, &len );
 
     MBEDTLS_SSL_DEBUG_RET( 2, "ssl_check_dtls_clihlo_cookie", ret );
 
@@ -3529,7 +3655,7 @@ static int ssl_parse_record_header( mbedtls_ssl_context *ssl )
     }
 
     /* Check length against the size of our buffer */
-    if( ssl->in_msglen > MBEDTLS_SSL_BUFFER_LEN
+    if( ssl->in_msglen > ssl->in_buf_len
                          - (size_t)( ssl->in_msg - ssl->in_buf ) )
     {
         MBEDTLS_SSL_DEBUG_MSG( 1, ( "bad message length" ) );
@@ -3991,6 +4117,9 @@ int mbedtls_ssl_send_fatal_handshake_failure( mbedtls_ssl_context *ssl )
     return( 0 );
 }
 
+/* Forward declaration */
+static int ssl_buffers_alloc( mbedtls_ssl_context *ssl );
+
 int mbedtls_ssl_send_alert_message( mbedtls_ssl_context *ssl,
                             unsigned char level,
                             unsigned char message )
@@ -4002,6 +4131,9 @@ int mbedtls_ssl_send_alert_message( mbedtls_ssl_context *ssl,
 
     MBEDTLS_SSL_DEBUG_MSG( 2, ( "=> send alert message" ) );
 
+    if( ( ret = ssl_buffers_alloc( ssl ) ) != 0 )
+        return( ret );
+
     ssl->out_msgtype = MBEDTLS_SSL_MSG_ALERT;
     ssl->out_msglen = 2;
     ssl->out_msg[0] = level;
@@ -4597,12 +4729,27 @@ void mbedtls_ssl_optimize_checksum( mbedtls_ssl_context *ssl,
 #endif /* MBEDTLS_SSL_PROTO_TLS1_2 */
     {
         MBEDTLS_SSL_DEBUG_MSG( 1, ( "should never happen" ) );
-        return;
+        ssl->handshake->update_checksum = ssl_update_checksum_all;
+    }
+
+    /* Hash the messages kept so far, with the needed digests only */
+    if( ssl->handshake->transcript != NULL )
+    {
+        ssl->handshake->update_checksum( ssl, ssl->handshake->transcript,
+                                         ssl->handshake->transcript_len );
+
+        mbedtls_free( ssl->handshake->transcript );
+        ssl->handshake->transcript = NULL;
+        ssl->handshake->transcript_len = 0;
     }
 }
 
 void mbedtls_ssl_reset_checksum( mbedtls_ssl_context *ssl )
 {
+    mbedtls_free( ssl->handshake->transcript );
+    ssl->handshake->transcript = NULL;
+    ssl->handshake->transcript_len = 0;
+
 #if defined(MBEDTLS_SSL_PROTO_SSL3) || defined(MBEDTLS_SSL_PROTO_TLS1) || \
     defined(MBEDTLS_SSL_PROTO_TLS1_1)
      mbedtls_md5_starts( &ssl->handshake->fin_md5  );
@@ -4618,8 +4765,8 @@ void mbedtls_ssl_reset_checksum( mbedtls_ssl_context *ssl )
 #endif /* MBEDTLS_SSL_PROTO_TLS1_2 */
 }
 
-static void ssl_update_checksum_start( mbedtls_ssl_context *ssl,
-                                       const unsigned char *buf, size_t len )
+static void ssl_update_checksum_all( mbedtls_ssl_context *ssl,
+                                     const unsigned char *buf, size_t len )
 {
 #if defined(MBEDTLS_SSL_PROTO_SSL3) || defined(MBEDTLS_SSL_PROTO_TLS1) || \
     defined(MBEDTLS_SSL_PROTO_TLS1_1)
@@ -4636,6 +4783,45 @@ static void ssl_update_checksum_start( mbedtls_ssl_context *ssl,
 #endif /* MBEDTLS_SSL_PROTO_TLS1_2 */
 }
 
+/*
+ * Until the version and ciphersuite are known, keep the messages rather
+ * than running every digest over them: mbedtls_ssl_optimize_checksum()
+ * then hashes them once with the digests that are actually needed.
+ */
+static void ssl_update_checksum_start( mbedtls_ssl_context *ssl,
+                                       const unsigned char *buf, size_t len )
+{
+    mbedtls_ssl_handshake_params *handshake = ssl->handshake;
+    unsigned char *transcript;
+
+    transcript = mbedtls_calloc( 1, handshake->transcript_len + len );
+
+    if( transcript == NULL )
+    {
+        /* Not worth failing the handshake for: go back to every digest */
+        MBEDTLS_SSL_DEBUG_MSG( 3, ( "no memory for the transcript" ) );
+
+        if( handshake->transcript != NULL )
+            ssl_update_checksum_all( ssl, handshake->transcript,
+                                     handshake->transcript_len );
+        ssl_update_checksum_all( ssl, buf, len );
+
+        mbedtls_free( handshake->transcript );
+        handshake->transcript = NULL;
+        handshake->transcript_len = 0;
+        handshake->update_checksum = ssl_update_checksum_all;
+        return;
+    }
+
+    if( handshake->transcript != NULL )
+        memcpy( transcript, handshake->transcript, handshake->transcript_len );
+    memcpy( transcript + handshake->transcript_len, buf, len );
+
+    mbedtls_free( handshake->transcript );
+    handshake->transcript = transcript;
+    handshake->transcript_len += len;
+}
+
 #if defined(MBEDTLS_SSL_PROTO_SSL3) || defined(MBEDTLS_SSL_PROTO_TLS1) || \
     defined(MBEDTLS_SSL_PROTO_TLS1_1)
 static void ssl_update_checksum_md5sha1( mbedtls_ssl_context *ssl,
@@ -5252,8 +5438,28 @@ void mbedtls_ssl_session_init( mbedtls_ssl_session *session )
     memset( session, 0, sizeof(mbedtls_ssl_session) );
 }
 
+#if defined(MBEDTLS_SSL_ASYNC_PRIVATE)
+/*
+ * Abandon a pending asynchronous private key operation, if any
+ */
+static void ssl_async_cancel( mbedtls_ssl_context *ssl )
+{
+    if( ssl->handshake == NULL || ssl->handshake->async_in_progress == 0 )
+        return;
+
+    if( ssl->conf->f_async_cancel != NULL )
+        ssl->conf->f_async_cancel( ssl->conf->p_async, ssl );
+
+    ssl->handshake->async_in_progress = 0;
+}
+#endif /* MBEDTLS_SSL_ASYNC_PRIVATE */
+
 static int ssl_handshake_init( mbedtls_ssl_context *ssl )
 {
+#if defined(MBEDTLS_SSL_ASYNC_PRIVATE)
+    ssl_async_cancel( ssl );
+#endif
+
     /* Clear old handshake information if present */
     if( ssl->transform_negotiate )
         mbedtls_ssl_transform_free( ssl->transform_negotiate );
@@ -5359,30 +5565,102 @@ void mbedtls_ssl_init( mbedtls_ssl_context *ssl )
 }
 
 /*
- * Setup an SSL context
+ * Size of the record buffers to allocate
  */
-int mbedtls_ssl_setup( mbedtls_ssl_context *ssl,
-                       const mbedtls_ssl_config *conf )
+static size_t ssl_buffer_len( const mbedtls_ssl_context *ssl )
 {
-    int ret;
-    const size_t len = MBEDTLS_SSL_BUFFER_LEN;
-
-    ssl->conf = conf;
-
+#if defined(MBEDTLS_SSL_LAZY_BUFFERS) && defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
     /*
-     * Prepare base structures
+     * Out of handshakes, records are limited by the negotiated
+     * max_fragment_length. Keep full-size buffers if the peer may start a
+     * renegotiation, as its first handshake message could be larger.
      */
-    if( ( ssl-> in_buf = mbedtls_calloc( 1, len ) ) == NULL ||
-        ( ssl->out_buf = mbedtls_calloc( 1, len ) ) == NULL )
+    if( ssl->state == MBEDTLS_SSL_HANDSHAKE_OVER && ssl->session != NULL
+#if defined(MBEDTLS_SSL_RENEGOTIATION)
+        && ssl->conf->disable_renegotiation == MBEDTLS_SSL_RENEGOTIATION_DISABLED
+#endif
+        )
     {
-        MBEDTLS_SSL_DEBUG_MSG( 1, ( "alloc(%d bytes) failed", len ) );
+        return( MBEDTLS_SSL_BUFFER_LEN - MBEDTLS_SSL_MAX_CONTENT_LEN +
+                mfl_code_to_length[ssl->session->mfl_code] );
+    }
+#else
+    ((void) ssl);
+#endif
+
+    return( MBEDTLS_SSL_BUFFER_LEN );
+}
+
+static void ssl_buffers_free( mbedtls_ssl_context *ssl )
+{
+    if( ssl->out_buf != NULL )
+    {
+        mbedtls_zeroize( ssl->out_buf, ssl->out_buf_len );
+        mbedtls_free( ssl->out_buf );
+    }
+
+    if( ssl->in_buf != NULL )
+    {
+        mbedtls_zeroize( ssl->in_buf, ssl->in_buf_len );
         mbedtls_free( ssl->in_buf );
-        ssl->in_buf = NULL;
+    }
+
+#if defined(MBEDTLS_SSL_BATCH_WRITES)
+    if( ssl->batch_buf != NULL )
+    {
+        mbedtls_zeroize( ssl->batch_buf,
+                         ( MBEDTLS_SSL_BATCH_RECORDS - 1 ) * ssl->out_buf_len );
+        mbedtls_free( ssl->batch_buf );
+        ssl->batch_buf = NULL;
+    }
+#endif
+
+    ssl->in_buf = ssl->out_buf = NULL;
+    ssl->in_buf_len = ssl->out_buf_len = 0;
+}
+
+/*
+ * Allocate the record buffers, or grow them to ssl_buffer_len() keeping
+ * their contents, and set the record pointers
+ */
+static int ssl_buffers_alloc( mbedtls_ssl_context *ssl )
+{
+    const size_t len = ssl_buffer_len( ssl );
+    unsigned char *in_buf, *out_buf;
+#if defined(MBEDTLS_SSL_LAZY_BUFFERS)
+    const int fresh = ( ssl->in_buf == NULL );
+#endif
+
+    if( ssl->in_buf != NULL && ssl->in_buf_len >= len )
+        return( 0 );
+
+    if( ( in_buf  = mbedtls_calloc( 1, len ) ) == NULL ||
+        ( out_buf = mbedtls_calloc( 1, len ) ) == NULL )
+    {
+        MBEDTLS_SSL_DEBUG_MSG( 1, ( "alloc(%d bytes) failed", len ) );
+        mbedtls_free( in_buf );
         return( MBEDTLS_ERR_SSL_ALLOC_FAILED );
     }
 
+    if( ssl->in_buf != NULL )
+    {
+        /* Growing: only happens when a handshake starts */
+        memcpy( in_buf, ssl->in_buf, ssl->in_buf_len );
+        memcpy( out_buf, ssl->out_buf, ssl->out_buf_len );
+
+        if( ssl->in_offt != NULL )
+            ssl->in_offt = in_buf + ( ssl->in_offt - ssl->in_buf );
+
+        ssl_buffers_free( ssl );
+    }
+
+    ssl->in_buf = in_buf;
+    ssl->in_buf_len = len;
+    ssl->out_buf = out_buf;
+    ssl->out_buf_len = len;
+
 #if defined(MBEDTLS_SSL_PROTO_DTLS)
-    if( conf->transport == MBEDTLS_SSL_TRANSPORT_DATAGRAM )
+    if( ssl->conf->transport == MBEDTLS_SSL_TRANSPORT_DATAGRAM )
     {
         ssl->out_hdr = ssl->out_buf;
         ssl->out_ctr = ssl->out_buf +  3;
@@ -5412,6 +5690,93 @@ int mbedtls_ssl_setup( mbedtls_ssl_context *ssl,
         ssl->in_msg = ssl->in_buf + 13;
     }
 
+    /* Skip the explicit IV if a transform is already active */
+    if( ssl->transform_in != NULL &&
+        ssl->minor_ver >= MBEDTLS_SSL_MINOR_VERSION_2 )
+    {
+        ssl->in_msg = ssl->in_iv + ssl->transform_in->ivlen -
+                                   ssl->transform_in->fixed_ivlen;
+    }
+
+    if( ssl->transform_out != NULL &&
+        ssl->minor_ver >= MBEDTLS_SSL_MINOR_VERSION_2 )
+    {
+        ssl->out_msg = ssl->out_iv + ssl->transform_out->ivlen -
+                                     ssl->transform_out->fixed_ivlen;
+    }
+
+#if defined(MBEDTLS_SSL_LAZY_BUFFERS)
+    if( fresh )
+    {
+        memcpy( ssl->in_ctr, ssl->in_ctr_saved, 8 );
+        memcpy( ssl->out_ctr, ssl->out_ctr_saved, 8 );
+    }
+#endif
+
+    return( 0 );
+}
+
+#if defined(MBEDTLS_SSL_LAZY_BUFFERS)
+/*
+ * Release the record buffers if they hold no pending data, keeping only
+ * the record counters
+ */
+static void ssl_buffers_release( mbedtls_ssl_context *ssl )
+{
+    if( ssl->in_buf == NULL ||
+        ssl->state != MBEDTLS_SSL_HANDSHAKE_OVER ||
+        ssl->handshake != NULL ||
+        ssl->in_offt != NULL ||
+        ( ssl->in_hslen != 0 && ssl->in_hslen < ssl->in_msglen ) ||
+        ssl->out_left != 0 )
+    {
+        return;
+    }
+
+#if defined(MBEDTLS_SSL_PROTO_DTLS)
+    if( ssl->conf->transport == MBEDTLS_SSL_TRANSPORT_DATAGRAM )
+    {
+        /* Other records of the last datagram are still to be read */
+        if( ssl->in_left != ssl->next_record_offset )
+            return;
+
+        ssl->next_record_offset = 0;
+    }
+    else
+#endif
+    if( ssl->in_left != 0 )
+        return;
+
+    ssl->in_left = 0;
+    ssl->in_msglen = 0;
+    ssl->in_hslen = 0;
+
+    memcpy( ssl->in_ctr_saved, ssl->in_ctr, 8 );
+    memcpy( ssl->out_ctr_saved, ssl->out_ctr, 8 );
+
+    ssl_buffers_free( ssl );
+
+    ssl->in_ctr = ssl->in_hdr = ssl->in_len = ssl->in_iv = ssl->in_msg = NULL;
+    ssl->out_ctr = ssl->out_hdr = ssl->out_len = ssl->out_iv = ssl->out_msg = NULL;
+}
+#endif /* MBEDTLS_SSL_LAZY_BUFFERS */
+
+/*
+ * Setup an SSL context
+ */
+int mbedtls_ssl_setup( mbedtls_ssl_context *ssl,
+                       const mbedtls_ssl_config *conf )
+{
+    int ret;
+
+    ssl->conf = conf;
+
+    /*
+     * Prepare base structures
+     */
+    if( ( ret = ssl_buffers_alloc( ssl ) ) != 0 )
+        return( ret );
+
     if( ( ret = ssl_handshake_init( ssl ) ) != 0 )
         return( ret );
 
@@ -5446,7 +5811,16 @@ static int ssl_session_reset_int( mbedtls_ssl_context *ssl, int partial )
 
     ssl->in_offt = NULL;
 
-    ssl->in_msg = ssl->in_buf + 13;
+#if defined(MBEDTLS_SSL_LAZY_BUFFERS)
+    memset( ssl->in_ctr_saved, 0, 8 );
+    memset( ssl->out_ctr_saved, 0, 8 );
+
+    if( partial == 0 )
+        ssl_buffers_free( ssl );
+#endif
+
+    if( ssl->in_buf != NULL )
+        ssl->in_msg = ssl->in_buf + 13;
     ssl->in_msgtype = 0;
     ssl->in_msglen = 0;
     if( partial == 0 )
@@ -5463,10 +5837,14 @@ static int ssl_session_reset_int( mbedtls_ssl_context *ssl, int partial )
     ssl->nb_zero = 0;
     ssl->record_read = 0;
 
-    ssl->out_msg = ssl->out_buf + 13;
+    if( ssl->out_buf != NULL )
+        ssl->out_msg = ssl->out_buf + 13;
     ssl->out_msgtype = 0;
     ssl->out_msglen = 0;
     ssl->out_left = 0;
+#if defined(MBEDTLS_SSL_BATCH_WRITES)
+    ssl->out_batch_cnt = 0;
+#endif
 #if defined(MBEDTLS_SSL_CBC_RECORD_SPLITTING)
     if( ssl->split_done != MBEDTLS_SSL_CBC_RECORD_SPLITTING_DISABLED )
         ssl->split_done = 0;
@@ -5475,9 +5853,10 @@ static int ssl_session_reset_int( mbedtls_ssl_context *ssl, int partial )
     ssl->transform_in = NULL;
     ssl->transform_out = NULL;
 
-    memset( ssl->out_buf, 0, MBEDTLS_SSL_BUFFER_LEN );
-    if( partial == 0 )
-        memset( ssl->in_buf, 0, MBEDTLS_SSL_BUFFER_LEN );
+    if( ssl->out_buf != NULL )
+        memset( ssl->out_buf, 0, ssl->out_buf_len );
+    if( partial == 0 && ssl->in_buf != NULL )
+        memset( ssl->in_buf, 0, ssl->in_buf_len );
 
 #if defined(MBEDTLS_SSL_HW_RECORD_ACCEL)
     if( mbedtls_ssl_hw_record_reset != NULL )
@@ -5611,6 +5990,14 @@ void mbedtls_ssl_set_bio( mbedtls_ssl_context *ssl,
     ssl->f_recv_timeout = f_recv_timeout;
 }
 
+#if defined(MBEDTLS_SSL_BATCH_WRITES)
+void mbedtls_ssl_set_send_vec( mbedtls_ssl_context *ssl,
+                               mbedtls_ssl_send_vec_t *f_send_vec )
+{
+    ssl->f_send_vec = f_send_vec;
+}
+#endif
+
 void mbedtls_ssl_conf_read_timeout( mbedtls_ssl_config *conf, uint32_t timeout )
 {
     conf->read_timeout   = timeout;
@@ -6124,6 +6511,45 @@ void mbedtls_ssl_conf_export_keys_cb( mbedtls_ssl_config *conf,
 }
 #endif
 
+#if defined(MBEDTLS_SSL_ASYNC_PRIVATE)
+void mbedtls_ssl_conf_async_private_cb( mbedtls_ssl_config *conf,
+        mbedtls_ssl_async_sign_t *f_sign_start,
+        mbedtls_ssl_async_decrypt_t *f_decrypt_start,
+        mbedtls_ssl_async_resume_t *f_resume,
+        mbedtls_ssl_async_cancel_t *f_cancel,
+        void *p_async )
+{
+    conf->f_async_sign_start = f_sign_start;
+    conf->f_async_decrypt_start = f_decrypt_start;
+    conf->f_async_resume = f_resume;
+    conf->f_async_cancel = f_cancel;
+    conf->p_async = p_async;
+}
+
+void *mbedtls_ssl_get_async_operation_data( const mbedtls_ssl_context *ssl )
+{
+    if( ssl->handshake == NULL )
+        return( NULL );
+
+    return( ssl->handshake->user_async_ctx );
+}
+
+void mbedtls_ssl_set_async_operation_data( mbedtls_ssl_context *ssl,
+                                           void *ctx )
+{
+    if( ssl->handshake != NULL )
+        ssl->handshake->user_async_ctx = ctx;
+}
+#endif /* MBEDTLS_SSL_ASYNC_PRIVATE */
+
+#if defined(MBEDTLS_AES_OFFLOAD) && defined(MBEDTLS_GCM_C)
+void mbedtls_ssl_conf_aes_offload( mbedtls_ssl_config *conf,
+                                   mbedtls_aes_offload_context *offload )
+{
+    conf->aes_offload = offload;
+}
+#endif /* MBEDTLS_AES_OFFLOAD && MBEDTLS_GCM_C */
+
 /*
  * SSL get accessors
  */
@@ -6281,6 +6707,9 @@ int mbedtls_ssl_handshake_step( mbedtls_ssl_context *ssl )
     if( ssl == NULL || ssl->conf == NULL )
         return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
 
+    if( ( ret = ssl_buffers_alloc( ssl ) ) != 0 )
+        return( ret );
+
 #if defined(MBEDTLS_SSL_CLI_C)
     if( ssl->conf->endpoint == MBEDTLS_SSL_IS_CLIENT )
         ret = mbedtls_ssl_handshake_client_step( ssl );
@@ -6296,13 +6725,10 @@ int mbedtls_ssl_handshake_step( mbedtls_ssl_context *ssl )
 /*
  * Perform the SSL handshake
  */
-int mbedtls_ssl_handshake( mbedtls_ssl_context *ssl )
+static int ssl_handshake( mbedtls_ssl_context *ssl )
 {
     int ret = 0;
 
-    if( ssl == NULL || ssl->conf == NULL )
-        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
-
     MBEDTLS_SSL_DEBUG_MSG( 2, ( "=> handshake" ) );
 
     while( ssl->state != MBEDTLS_SSL_HANDSHAKE_OVER )
@@ -6318,6 +6744,25 @@ int mbedtls_ssl_handshake( mbedtls_ssl_context *ssl )
     return( ret );
 }
 
+/*
+ * Perform the SSL handshake (public-facing wrapper)
+ */
+int mbedtls_ssl_handshake( mbedtls_ssl_context *ssl )
+{
+    int ret;
+
+    if( ssl == NULL || ssl->conf == NULL )
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+
+    ret = ssl_handshake( ssl );
+
+#if defined(MBEDTLS_SSL_LAZY_BUFFERS)
+    ssl_buffers_release( ssl );
+#endif
+
+    return( ret );
+}
+
 #if defined(MBEDTLS_SSL_RENEGOTIATION)
 #if defined(MBEDTLS_SSL_SRV_C)
 /*
@@ -6379,7 +6824,7 @@ static int ssl_start_renegotiation( mbedtls_ssl_context *ssl )
     ssl->state = MBEDTLS_SSL_HELLO_REQUEST;
     ssl->renego_status = MBEDTLS_SSL_RENEGOTIATION_IN_PROGRESS;
 
-    if( ( ret = mbedtls_ssl_handshake( ssl ) ) != 0 )
+    if( ( ret = ssl_handshake( ssl ) ) != 0 )
     {
         MBEDTLS_SSL_DEBUG_RET( 1, "mbedtls_ssl_handshake", ret );
         return( ret );
@@ -6401,6 +6846,9 @@ int mbedtls_ssl_renegotiate( mbedtls_ssl_context *ssl )
     if( ssl == NULL || ssl->conf == NULL )
         return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
 
+    if( ( ret = ssl_buffers_alloc( ssl ) ) != 0 )
+        return( ret );
+
 #if defined(MBEDTLS_SSL_SRV_C)
     /* On server, just send the request */
     if( ssl->conf->endpoint == MBEDTLS_SSL_IS_SERVER )
@@ -6436,7 +6884,7 @@ int mbedtls_ssl_renegotiate( mbedtls_ssl_context *ssl )
     }
     else
     {
-        if( ( ret = mbedtls_ssl_handshake( ssl ) ) != 0 )
+        if( ( ret = ssl_handshake( ssl ) ) != 0 )
         {
             MBEDTLS_SSL_DEBUG_RET( 1, "mbedtls_ssl_handshake", ret );
             return( ret );
@@ -6471,17 +6919,13 @@ static int ssl_check_ctr_renegotiate( mbedtls_ssl_context *ssl )
 #endif /* MBEDTLS_SSL_RENEGOTIATION */
 
 /*
- * Receive application data decrypted from the SSL layer
+ * Make decrypted application data available at ssl->in_offt, reading and
+ * processing records as needed. On success, ssl->in_offt is only left NULL
+ * if the transport reported EOF.
  */
-int mbedtls_ssl_read( mbedtls_ssl_context *ssl, unsigned char *buf, size_t len )
+static int ssl_read_prepare( mbedtls_ssl_context *ssl )
 {
     int ret, record_read = 0;
-    size_t n;
-
-    if( ssl == NULL || ssl->conf == NULL )
-        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
-
-    MBEDTLS_SSL_DEBUG_MSG( 2, ( "=> read" ) );
 
 #if defined(MBEDTLS_SSL_PROTO_DTLS)
     if( ssl->conf->transport == MBEDTLS_SSL_TRANSPORT_DATAGRAM )
@@ -6508,7 +6952,7 @@ int mbedtls_ssl_read( mbedtls_ssl_context *ssl, unsigned char *buf, size_t len )
 
     if( ssl->state != MBEDTLS_SSL_HANDSHAKE_OVER )
     {
-        ret = mbedtls_ssl_handshake( ssl );
+        ret = ssl_handshake( ssl );
         if( ret == MBEDTLS_ERR_SSL_WAITING_SERVER_HELLO_RENEGO )
         {
             record_read = 1;
@@ -6708,10 +7152,14 @@ int mbedtls_ssl_read( mbedtls_ssl_context *ssl, unsigned char *buf, size_t len )
 #endif
     }
 
-    n = ( len < ssl->in_msglen )
-        ? len : ssl->in_msglen;
+    return( 0 );
+}
 
-    memcpy( buf, ssl->in_offt, n );
+/*
+ * Mark n bytes of application data at ssl->in_offt as consumed
+ */
+static void ssl_read_consume( mbedtls_ssl_context *ssl, size_t n )
+{
     ssl->in_msglen -= n;
 
     if( ssl->in_msglen == 0 )
@@ -6720,6 +7168,30 @@ int mbedtls_ssl_read( mbedtls_ssl_context *ssl, unsigned char *buf, size_t len )
     else
         /* more data available */
         ssl->in_offt += n;
+}
+
+/*
+ * Receive application data decrypted from the SSL layer
+ */
+static int ssl_read_real( mbedtls_ssl_context *ssl,
+                          unsigned char *buf, size_t len )
+{
+    int ret;
+    size_t n;
+
+    MBEDTLS_SSL_DEBUG_MSG( 2, ( "=> read" ) );
+
+    if( ( ret = ssl_read_prepare( ssl ) ) != 0 )
+        return( ret );
+
+    if( ssl->in_offt == NULL )
+        return( 0 );
+
+    n = ( len < ssl->in_msglen )
+        ? len : ssl->in_msglen;
+
+    memcpy( buf, ssl->in_offt, n );
+    ssl_read_consume( ssl, n );
 
     MBEDTLS_SSL_DEBUG_MSG( 2, ( "<= read" ) );
 
@@ -6727,31 +7199,133 @@ int mbedtls_ssl_read( mbedtls_ssl_context *ssl, unsigned char *buf, size_t len )
 }
 
 /*
- * Send application data to be encrypted by the SSL layer,
- * taking care of max fragment length and buffer size
+ * Read application data (public-facing wrapper)
  */
-static int ssl_write_real( mbedtls_ssl_context *ssl,
-                           const unsigned char *buf, size_t len )
+int mbedtls_ssl_read( mbedtls_ssl_context *ssl, unsigned char *buf, size_t len )
 {
     int ret;
+
+    if( ssl == NULL || ssl->conf == NULL )
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+
+    if( ( ret = ssl_buffers_alloc( ssl ) ) != 0 )
+        return( ret );
+
+    ret = ssl_read_real( ssl, buf, len );
+
+#if defined(MBEDTLS_SSL_LAZY_BUFFERS)
+    ssl_buffers_release( ssl );
+#endif
+
+    return( ret );
+}
+
+/*
+ * Access received application data in place (public-facing)
+ */
+int mbedtls_ssl_read_buf( mbedtls_ssl_context *ssl, const unsigned char **buf )
+{
+    int ret;
+
+    if( ssl == NULL || ssl->conf == NULL || buf == NULL )
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+
+    if( ( ret = ssl_buffers_alloc( ssl ) ) != 0 )
+        return( ret );
+
+    MBEDTLS_SSL_DEBUG_MSG( 2, ( "=> read buf" ) );
+
+    *buf = NULL;
+
+    if( ( ret = ssl_read_prepare( ssl ) ) == 0 && ssl->in_offt != NULL )
+    {
+        *buf = ssl->in_offt;
+        ret = (int) ssl->in_msglen;
+
+        /* Nothing to consume in empty records */
+        if( ret == 0 )
+            ssl_read_consume( ssl, 0 );
+    }
+
+#if defined(MBEDTLS_SSL_LAZY_BUFFERS)
+    ssl_buffers_release( ssl );
+#endif
+
+    MBEDTLS_SSL_DEBUG_MSG( 2, ( "<= read buf" ) );
+
+    return( ret );
+}
+
+/*
+ * Consume application data accessed with mbedtls_ssl_read_buf()
+ */
+int mbedtls_ssl_read_consume( mbedtls_ssl_context *ssl, size_t len )
+{
+    if( ssl == NULL || ssl->conf == NULL ||
+        ssl->in_offt == NULL || len > ssl->in_msglen )
+    {
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+    }
+
+    ssl_read_consume( ssl, len );
+
+#if defined(MBEDTLS_SSL_LAZY_BUFFERS)
+    ssl_buffers_release( ssl );
+#endif
+
+    return( 0 );
+}
+
+/*
+ * Maximum length of application data in one record
+ */
+static size_t ssl_max_app_data_len( const mbedtls_ssl_context *ssl )
+{
 #if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
-    size_t max_len = mbedtls_ssl_get_max_frag_len( ssl );
+    return( mbedtls_ssl_get_max_frag_len( ssl ) );
+#else
+    ((void) ssl);
+    return( MBEDTLS_SSL_MAX_CONTENT_LEN );
+#endif
+}
 
-    if( len > max_len )
+/*
+ * Cap the length of application data to write to the maximum fragment
+ * length, or reject it with DTLS
+ */
+static int ssl_write_check_len( const mbedtls_ssl_context *ssl, size_t *len )
+{
+    size_t max_len = ssl_max_app_data_len( ssl );
+
+    if( *len > max_len )
     {
 #if defined(MBEDTLS_SSL_PROTO_DTLS)
         if( ssl->conf->transport == MBEDTLS_SSL_TRANSPORT_DATAGRAM )
         {
             MBEDTLS_SSL_DEBUG_MSG( 1, ( "fragment larger than the (negotiated) "
                                 "maximum fragment length: %d > %d",
-                                len, max_len ) );
+                                *len, max_len ) );
             return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
         }
         else
 #endif
-            len = max_len;
+            *len = max_len;
     }
-#endif /* MBEDTLS_SSL_MAX_FRAGMENT_LENGTH */
+
+    return( 0 );
+}
+
+/*
+ * Send application data to be encrypted by the SSL layer,
+ * taking care of max fragment length and buffer size
+ */
+static int ssl_write_real( mbedtls_ssl_context *ssl,
+                           const unsigned char *buf, size_t len )
+{
+    int ret;
+
+    if( ( ret = ssl_write_check_len( ssl, &len ) ) != 0 )
+        return( ret );
 
     if( ssl->out_left != 0 )
     {
@@ -6785,20 +7359,22 @@ static int ssl_write_real( mbedtls_ssl_context *ssl,
  * remember wether we already did the split or not.
  */
 #if defined(MBEDTLS_SSL_CBC_RECORD_SPLITTING)
+static int ssl_record_splitting( const mbedtls_ssl_context *ssl )
+{
+    return( ssl->conf->cbc_record_splitting !=
+                MBEDTLS_SSL_CBC_RECORD_SPLITTING_DISABLED &&
+            ssl->minor_ver <= MBEDTLS_SSL_MINOR_VERSION_1 &&
+            mbedtls_cipher_get_cipher_mode( &ssl->transform_out->cipher_ctx_enc )
+                                == MBEDTLS_MODE_CBC );
+}
+
 static int ssl_write_split( mbedtls_ssl_context *ssl,
                             const unsigned char *buf, size_t len )
 {
     int ret;
 
-    if( ssl->conf->cbc_record_splitting ==
-            MBEDTLS_SSL_CBC_RECORD_SPLITTING_DISABLED ||
-        len <= 1 ||
-        ssl->minor_ver > MBEDTLS_SSL_MINOR_VERSION_1 ||
-        mbedtls_cipher_get_cipher_mode( &ssl->transform_out->cipher_ctx_enc )
-                                != MBEDTLS_MODE_CBC )
-    {
+    if( len <= 1 || ! ssl_record_splitting( ssl ) )
         return( ssl_write_real( ssl, buf, len ) );
-    }
 
     if( ssl->split_done == 0 )
     {
@@ -6818,14 +7394,157 @@ static int ssl_write_split( mbedtls_ssl_context *ssl,
 /*
  * Write application data (public-facing wrapper)
  */
-int mbedtls_ssl_write( mbedtls_ssl_context *ssl, const unsigned char *buf, size_t len )
+#if defined(MBEDTLS_SSL_BATCH_WRITES)
+/*
+ * Whether a write of len bytes should be sent as a batch of records
+ */
+static int ssl_batch_applies( const mbedtls_ssl_context *ssl, size_t len )
 {
-    int ret;
+    if( ssl->f_send_vec == NULL ||
+        ssl->conf->transport != MBEDTLS_SSL_TRANSPORT_STREAM ||
+        len <= ssl_max_app_data_len( ssl ) )
+    {
+        return( 0 );
+    }
 
-    MBEDTLS_SSL_DEBUG_MSG( 2, ( "=> write" ) );
+#if defined(MBEDTLS_SSL_HW_RECORD_ACCEL)
+    if( mbedtls_ssl_hw_record_write != NULL )
+        return( 0 );
+#endif
 
-    if( ssl == NULL || ssl->conf == NULL )
-        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+#if defined(MBEDTLS_SSL_CBC_RECORD_SPLITTING)
+    if( ssl_record_splitting( ssl ) )
+        return( 0 );
+#endif
+
+#if defined(MBEDTLS_ZLIB_SUPPORT)
+    /* ssl_compress_buf() works in out_buf only */
+    if( ssl->session_out->compression == MBEDTLS_SSL_COMPRESS_DEFLATE )
+        return( 0 );
+#endif
+
+    return( 1 );
+}
+
+/*
+ * Point the output record pointers to a record slot (TLS layout),
+ * keeping the offset of out_msg from out_iv
+ */
+static void ssl_set_out_slot( mbedtls_ssl_context *ssl, unsigned char *slot )
+{
+    size_t msg_offset = ssl->out_msg - ssl->out_iv;
+
+    ssl->out_ctr = slot;
+    ssl->out_hdr = slot +  8;
+    ssl->out_len = slot + 11;
+    ssl->out_iv  = slot + 13;
+    ssl->out_msg = ssl->out_iv + msg_offset;
+}
+
+/*
+ * Encrypt up to MBEDTLS_SSL_BATCH_RECORDS records of application data,
+ * the first one in out_buf and the next ones in batch_buf, and send them
+ * together with the vectored callback
+ */
+static int ssl_write_batch( mbedtls_ssl_context *ssl,
+                            const unsigned char *buf, size_t len )
+{
+    int ret = 0;
+    size_t i, n, written = 0, total = 0;
+    size_t max_len = ssl_max_app_data_len( ssl );
+
+    if( ssl->out_left != 0 )
+    {
+        /* Called again after WANT_WRITE: finish sending the last batch */
+        n = ssl->out_batch_cnt != 0 ? ssl->out_batch_len : max_len;
+
+        if( ( ret = mbedtls_ssl_flush_output( ssl ) ) != 0 )
+        {
+            MBEDTLS_SSL_DEBUG_RET( 1, "mbedtls_ssl_flush_output", ret );
+            return( ret );
+        }
+
+        return( (int) n );
+    }
+
+    if( ssl->batch_buf == NULL )
+    {
+        ssl->batch_buf = mbedtls_calloc( MBEDTLS_SSL_BATCH_RECORDS - 1,
+                                         ssl->out_buf_len );
+        if( ssl->batch_buf == NULL )
+        {
+            MBEDTLS_SSL_DEBUG_MSG( 1, ( "alloc(%d bytes) failed",
+                ( MBEDTLS_SSL_BATCH_RECORDS - 1 ) * ssl->out_buf_len ) );
+            return( MBEDTLS_ERR_SSL_ALLOC_FAILED );
+        }
+    }
+
+    for( i = 0; i < MBEDTLS_SSL_BATCH_RECORDS && written < len; i++ )
+    {
+        if( i > 0 )
+        {
+            unsigned char *slot = ssl->batch_buf + ( i - 1 ) * ssl->out_buf_len;
+
+            memcpy( slot, ssl->out_ctr, 8 );
+            ssl_set_out_slot( ssl, slot );
+        }
+
+        n = ( len - written < max_len ) ? len - written : max_len;
+
+        ssl->out_msglen  = n;
+        ssl->out_msgtype = MBEDTLS_SSL_MSG_APPLICATION_DATA;
+        memcpy( ssl->out_msg, buf + written, n );
+
+        if( ( ret = ssl_prepare_record( ssl ) ) != 0 ||
+            ( ret = ssl_out_ctr_increment( ssl ) ) != 0 )
+        {
+            break;
+        }
+
+        ssl->out_batch[i].buf = ssl->out_hdr;
+        ssl->out_batch[i].len = mbedtls_ssl_hdr_len( ssl ) + ssl->out_msglen;
+        total += ssl->out_batch[i].len;
+        written += n;
+    }
+
+    /* Back to the record in out_buf, with the up-to-date counter */
+    if( i > 0 && ssl->out_ctr != ssl->out_buf )
+    {
+        memcpy( ssl->out_buf, ssl->out_ctr, 8 );
+        ssl_set_out_slot( ssl, ssl->out_buf );
+    }
+
+    if( ret != 0 )
+    {
+        MBEDTLS_SSL_DEBUG_RET( 1, "ssl_prepare_record", ret );
+        ssl->out_left = 0;
+        return( ret );
+    }
+
+    ssl->out_left = total;
+    ssl->out_batch_cnt = i;
+    ssl->out_batch_len = written;
+
+    if( ( ret = mbedtls_ssl_flush_output( ssl ) ) != 0 )
+    {
+        MBEDTLS_SSL_DEBUG_RET( 1, "mbedtls_ssl_flush_output", ret );
+        return( ret );
+    }
+
+    return( (int) written );
+}
+#endif /* MBEDTLS_SSL_BATCH_WRITES */
+
+/*
+ * Get ready to write application data: allocate buffers, renegotiate if
+ * needed and complete the handshake
+ */
+static int ssl_write_prepare( mbedtls_ssl_context *ssl )
+{
+    int ret;
+
+    if( ( ret = ssl_buffers_alloc( ssl ) ) != 0 )
+        return( ret );
 
 #if defined(MBEDTLS_SSL_RENEGOTIATION)
     if( ( ret = ssl_check_ctr_renegotiate( ssl ) ) != 0 )
@@ -6837,24 +7556,219 @@ int mbedtls_ssl_write( mbedtls_ssl_context *ssl, const unsigned char *buf, size_
 
     if( ssl->state != MBEDTLS_SSL_HANDSHAKE_OVER )
     {
-        if( ( ret = mbedtls_ssl_handshake( ssl ) ) != 0 )
+        if( ( ret = ssl_handshake( ssl ) ) != 0 )
         {
             MBEDTLS_SSL_DEBUG_RET( 1, "mbedtls_ssl_handshake", ret );
             return( ret );
         }
+
     }
 
+    return( 0 );
+}
+
+/*
+ * Write application data (public-facing wrapper)
+ */
+int mbedtls_ssl_write( mbedtls_ssl_context *ssl, const unsigned char *buf, size_t len )
+{
+    int ret;
+
+    MBEDTLS_SSL_DEBUG_MSG( 2, ( "=> write" ) );
+
+    if( ssl == NULL || ssl->conf == NULL )
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+
+    if( ( ret = ssl_write_prepare( ssl ) ) != 0 )
+        return( ret );
+
+#if defined(MBEDTLS_SSL_BATCH_WRITES)
+    if( ssl_batch_applies( ssl, len ) )
+        ret = ssl_write_batch( ssl, buf, len );
+    else
+#endif
 #if defined(MBEDTLS_SSL_CBC_RECORD_SPLITTING)
     ret = ssl_write_split( ssl, buf, len );
 #else
     ret = ssl_write_real( ssl, buf, len );
 #endif
 
+#if defined(MBEDTLS_SSL_LAZY_BUFFERS)
+    ssl_buffers_release( ssl );
+#endif
+
     MBEDTLS_SSL_DEBUG_MSG( 2, ( "<= write" ) );
 
     return( ret );
 }
 
+/*
+ * Write application data gathered from several buffers
+ */
+static int ssl_writev_real( mbedtls_ssl_context *ssl,
+                            const mbedtls_ssl_iovec *iov, size_t iovcnt )
+{
+    int ret;
+    size_t i, n, len = 0;
+    unsigned char *p;
+
+#if defined(MBEDTLS_SSL_CBC_RECORD_SPLITTING)
+    if( ssl_record_splitting( ssl ) )
+    {
+        /* Keep the 1/n-1 split of each buffer */
+        for( i = 0; i < iovcnt; i++ )
+            if( iov[i].len != 0 )
+                return( ssl_write_split( ssl, iov[i].buf, iov[i].len ) );
+    }
+#endif
+
+    for( i = 0; i < iovcnt; i++ )
+        len += iov[i].len;
+
+    if( ( ret = ssl_write_check_len( ssl, &len ) ) != 0 )
+        return( ret );
+
+    if( ssl->out_left != 0 )
+    {
+        if( ( ret = mbedtls_ssl_flush_output( ssl ) ) != 0 )
+        {
+            MBEDTLS_SSL_DEBUG_RET( 1, "mbedtls_ssl_flush_output", ret );
+            return( ret );
+        }
+    }
+    else
+    {
+        p = ssl->out_msg;
+
+        for( i = 0; i < iovcnt && p < ssl->out_msg + len; i++ )
+        {
+            n = iov[i].len;
+            if( n > (size_t)( ssl->out_msg + len - p ) )
+                n = ssl->out_msg + len - p;
+            if( n == 0 )
+                continue;
+
+            memcpy( p, iov[i].buf, n );
+            p += n;
+        }
+
+        ssl->out_msglen  = len;
+        ssl->out_msgtype = MBEDTLS_SSL_MSG_APPLICATION_DATA;
+
+        if( ( ret = mbedtls_ssl_write_record( ssl ) ) != 0 )
+        {
+            MBEDTLS_SSL_DEBUG_RET( 1, "mbedtls_ssl_write_record", ret );
+            return( ret );
+        }
+    }
+
+    return( (int) len );
+}
+
+/*
+ * Write application data from several buffers (public-facing wrapper)
+ */
+int mbedtls_ssl_writev( mbedtls_ssl_context *ssl,
+                        const mbedtls_ssl_iovec *iov, size_t iovcnt )
+{
+    int ret;
+
+    MBEDTLS_SSL_DEBUG_MSG( 2, ( "=> writev" ) );
+
+    if( ssl == NULL || ssl->conf == NULL || ( iov == NULL && iovcnt != 0 ) )
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+
+    if( ( ret = ssl_write_prepare( ssl ) ) != 0 )
+        return( ret );
+
+    ret = ssl_writev_real( ssl, iov, iovcnt );
+
+#if defined(MBEDTLS_SSL_LAZY_BUFFERS)
+    ssl_buffers_release( ssl );
+#endif
+
+    MBEDTLS_SSL_DEBUG_MSG( 2, ( "<= writev" ) );
+
+    return( ret );
+}
+
+/*
+ * Let the caller write application data directly into the output record
+ */
+int mbedtls_ssl_write_buf( mbedtls_ssl_context *ssl, unsigned char **buf )
+{
+    int ret;
+
+    if( ssl == NULL || ssl->conf == NULL || buf == NULL )
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+
+    if( ( ret = ssl_write_prepare( ssl ) ) != 0 )
+        return( ret );
+
+#if defined(MBEDTLS_SSL_CBC_RECORD_SPLITTING)
+    if( ssl_record_splitting( ssl ) )
+        return( MBEDTLS_ERR_SSL_FEATURE_UNAVAILABLE );
+#endif
+
+    if( ssl->out_left != 0 )
+    {
+        if( ( ret = mbedtls_ssl_flush_output( ssl ) ) != 0 )
+        {
+            MBEDTLS_SSL_DEBUG_RET( 1, "mbedtls_ssl_flush_output", ret );
+            return( ret );
+        }
+    }
+
+    *buf = ssl->out_msg;
+
+    return( (int) ssl_max_app_data_len( ssl ) );
+}
+
+/*
+ * Send application data written with mbedtls_ssl_write_buf()
+ */
+int mbedtls_ssl_write_commit( mbedtls_ssl_context *ssl, size_t len )
+{
+    int ret;
+
+    if( ssl == NULL || ssl->conf == NULL || ssl->out_buf == NULL ||
+        ssl->state != MBEDTLS_SSL_HANDSHAKE_OVER ||
+        len > ssl_max_app_data_len( ssl ) )
+    {
+        return( MBEDTLS_ERR_SSL_BAD_INPUT_DATA );
+    }
+
+    MBEDTLS_SSL_DEBUG_MSG( 2, ( "=> write commit" ) );
+
+    if( ssl->out_left != 0 )
+    {
+        if( ( ret = mbedtls_ssl_flush_output( ssl ) ) != 0 )
+        {
+            MBEDTLS_SSL_DEBUG_RET( 1, "mbedtls_ssl_flush_output", ret );
+            return( ret );
+        }
+    }
+    else
+    {
+        ssl->out_msglen  = len;
+        ssl->out_msgtype = MBEDTLS_SSL_MSG_APPLICATION_DATA;
+
+        if( ( ret = mbedtls_ssl_write_record( ssl ) ) != 0 )
+        {
+            MBEDTLS_SSL_DEBUG_RET( 1, "mbedtls_ssl_write_record", ret );
+            return( ret );
+        }
+    }
+
+#if defined(MBEDTLS_SSL_LAZY_BUFFERS)
+    ssl_buffers_release( ssl );
+#endif
+
+    MBEDTLS_SSL_DEBUG_MSG( 2, ( "<= write commit" ) );
+
+    return( (int) len );
+}
+
 /*
  * Notify the peer that the connection is being closed
  */
@@ -6924,6 +7838,8 @@ void mbedtls_ssl_handshake_free( mbedtls_ssl_handshake_params *handshake )
     if( handshake == NULL )
         return;
 
+    mbedtls_free( handshake->transcript );
+
 #if defined(MBEDTLS_SSL_PROTO_SSL3) || defined(MBEDTLS_SSL_PROTO_TLS1) || \
     defined(MBEDTLS_SSL_PROTO_TLS1_1)
     mbedtls_md5_free(    &handshake->fin_md5  );
@@ -7025,17 +7941,7 @@ void mbedtls_ssl_free( mbedtls_ssl_context *ssl )
 
     MBEDTLS_SSL_DEBUG_MSG( 2, ( "=> free" ) );
 
-    if( ssl->out_buf != NULL )
-    {
-        mbedtls_zeroize( ssl->out_buf, MBEDTLS_SSL_BUFFER_LEN );
-        mbedtls_free( ssl->out_buf );
-    }
-
-    if( ssl->in_buf != NULL )
-    {
-        mbedtls_zeroize( ssl->in_buf, MBEDTLS_SSL_BUFFER_LEN );
-        mbedtls_free( ssl->in_buf );
-    }
+    ssl_buffers_free( ssl );
 
 #if defined(MBEDTLS_ZLIB_SUPPORT)
     if( ssl->compress_buf != NULL )
@@ -7053,6 +7959,9 @@ void mbedtls_ssl_free( mbedtls_ssl_context *ssl )
 
     if( ssl->handshake )
     {
+#if defined(MBEDTLS_SSL_ASYNC_PRIVATE)
+        ssl_async_cancel( ssl );
+#endif
         mbedtls_ssl_handshake_free( ssl->handshake );
         mbedtls_ssl_transform_free( ssl->transform_negotiate );
         mbedtls_ssl_session_free( ssl->session_negotiate );
@@ -30,6 +30,15 @@
 #include "mbedtls/threading.h"
 
 #if defined(MBEDTLS_THREADING_PTHREAD)
+#if defined(MBEDTLS_PLATFORM_C)
+#include "mbedtls/platform.h"
+#else
+#include <stdlib.h>
+#define mbedtls_calloc    calloc
+#define mbedtls_free       free
+#endif
+
+#include <string.h>
 static void threading_mutex_init_pthread( mbedtls_threading_mutex_t *mutex )
 {
     if( mutex == NULL )
@@ -78,6 +87,241 @@ int (*mbedtls_mutex_unlock)( mbedtls_threading_mutex_t * ) = threading_mutex_unl
  */
 #define MUTEX_INIT  = { PTHREAD_MUTEX_INITIALIZER, 1 }
 
+/*
+ * Work items in progress in a thread, innermost first: the pool of each
+ * one, then the work items its job was submitted from, possibly in other
+ * threads, which wait for it
+ */
+typedef struct threading_pool_frame
+{
+    const mbedtls_threading_pool *pool;
+    const struct threading_pool_frame *prev;
+}
+threading_pool_frame;
+
+static pthread_key_t threading_pool_key;
+static pthread_once_t threading_pool_once = PTHREAD_ONCE_INIT;
+static int threading_pool_key_valid = 0;
+
+static void threading_pool_key_create( void )
+{
+    threading_pool_key_valid =
+        ( pthread_key_create( &threading_pool_key, NULL ) == 0 );
+}
+
+static const threading_pool_frame *threading_pool_frames( void )
+{
+    if( ! threading_pool_key_valid )
+        return( NULL );
+
+    return( (const threading_pool_frame *)
+            pthread_getspecific( threading_pool_key ) );
+}
+
+void mbedtls_threading_pool_init( mbedtls_threading_pool *pool )
+{
+    (void) pthread_once( &threading_pool_once, threading_pool_key_create );
+
+    memset( pool, 0, sizeof( mbedtls_threading_pool ) );
+
+    pthread_mutex_init( &pool->mutex, NULL );
+    pthread_cond_init( &pool->work_cond, NULL );
+    pthread_cond_init( &pool->done_cond, NULL );
+}
+
+/*
+ * Claim and process work items of the current job until none is left.
+ * Called with pool->mutex held.
+ */
+static void threading_pool_work( mbedtls_threading_pool *pool )
+{
+    mbedtls_threading_job_f f_job = pool->f_job;
+    void *p_job = pool->p_job;
+    const threading_pool_frame *saved = threading_pool_frames();
+    threading_pool_frame frame;
+    size_t index;
+    int ret;
+
+    frame.pool = pool;
+    frame.prev = (const threading_pool_frame *) pool->caller;
+
+    while( pool->next < pool->count )
+    {
+        index = pool->next++;
+        pool->active++;
+
+        pthread_mutex_unlock( &pool->mutex );
+
+        if( threading_pool_key_valid )
+            (void) pthread_setspecific( threading_pool_key, &frame );
+        ret = f_job( p_job, index );
+        if( threading_pool_key_valid )
+            (void) pthread_setspecific( threading_pool_key, saved );
+
+        pthread_mutex_lock( &pool->mutex );
+
+        pool->active--;
+
+        if( ret != 0 )
+        {
+            if( pool->ret == 0 )
+                pool->ret = ret;
+
+            /* Skip the remaining work items */
+            pool->next = pool->count;
+        }
+    }
+
+    if( pool->active == 0 )
+        pthread_cond_broadcast( &pool->done_cond );
+}
+
+static void *threading_pool_worker( void *data )
+{
+    mbedtls_threading_pool *pool = (mbedtls_threading_pool *) data;
+
+    pthread_mutex_lock( &pool->mutex );
+
+    for( ;; )
+    {
+        while( ! pool->stop &&
+               ( pool->f_job == NULL || pool->next >= pool->count ) )
+        {
+            pthread_cond_wait( &pool->work_cond, &pool->mutex );
+        }
+
+        if( pool->stop )
+            break;
+
+        threading_pool_work( pool );
+    }
+
+    pthread_mutex_unlock( &pool->mutex );
+
+    return( NULL );
+}
+
+/*
+ * Stop and join the worker threads
+ */
+static void threading_pool_stop( mbedtls_threading_pool *pool )
+{
+    size_t i;
+
+    pthread_mutex_lock( &pool->mutex );
+    pool->stop = 1;
+    pthread_cond_broadcast( &pool->work_cond );
+    pthread_mutex_unlock( &pool->mutex );
+
+    for( i = 0; i < pool->thread_count; i++ )
+        pthread_join( pool->threads[i], NULL );
+
+    mbedtls_free( pool->threads );
+    pool->threads = NULL;
+    pool->thread_count = 0;
+    pool->stop = 0;
+}
+
+int mbedtls_threading_pool_setup( mbedtls_threading_pool *pool, size_t threads )
+{
+    size_t i;
+
+    if( threads == 0 )
+        return( 0 );
+
+    pool->threads = mbedtls_calloc( threads, sizeof( pthread_t ) );
+    if( pool->threads == NULL )
+        return( MBEDTLS_ERR_THREADING_ALLOC_FAILED );
+
+    for( i = 0; i < threads; i++ )
+    {
+        if( pthread_create( &pool->threads[i], NULL,
+                            threading_pool_worker, pool ) != 0 )
+        {
+            threading_pool_stop( pool );
+            return( MBEDTLS_ERR_THREADING_FEATURE_UNAVAILABLE );
+        }
+
+        pool->thread_count++;
+    }
+
+    return( 0 );
+}
+
+int mbedtls_threading_pool_run( mbedtls_threading_pool *pool,
+                                mbedtls_threading_job_f f_job, void *p_job,
+                                size_t count )
+{
+    int ret = 0;
+    size_t i;
+    const threading_pool_frame *caller = threading_pool_frames(), *frame;
+
+    /* Called from a work item of this pool: it can't be waited for */
+    for( frame = caller; frame != NULL; frame = frame->prev )
+        if( frame->pool == pool )
+            break;
+
+    if( pool == NULL || pool->thread_count == 0 || count <= 1 ||
+        frame != NULL )
+    {
+        for( i = 0; i < count; i++ )
+            if( ( ret = f_job( p_job, i ) ) != 0 )
+                return( ret );
+
+        return( 0 );
+    }
+
+    if( pthread_mutex_lock( &pool->mutex ) != 0 )
+        return( MBEDTLS_ERR_THREADING_MUTEX_ERROR );
+
+    /* Wait for the job of another submitter to finish */
+    while( pool->f_job != NULL )
+        pthread_cond_wait( &pool->done_cond, &pool->mutex );
+
+    pool->f_job = f_job;
+    pool->p_job = p_job;
+    pool->caller = caller;
+    pool->next = 0;
+    pool->count = count;
+    pool->ret = 0;
+
+    pthread_cond_broadcast( &pool->work_cond );
+
+    /* Take part in the job, then wait for items still in progress */
+    threading_pool_work( pool );
+
+    while( pool->active > 0 )
+        pthread_cond_wait( &pool->done_cond, &pool->mutex );
+
+    ret = pool->ret;
+    pool->f_job = NULL;
+    pool->p_job = NULL;
+    pool->caller = NULL;
+    pool->count = 0;
+
+    /* Let the next submitter in */
+    pthread_cond_broadcast( &pool->done_cond );
+
+    if( pthread_mutex_unlock( &pool->mutex ) != 0 )
+        return( MBEDTLS_ERR_THREADING_MUTEX_ERROR );
+
+    return( ret );
+}
+
+void mbedtls_threading_pool_free( mbedtls_threading_pool *pool )
+{
+    if( pool == NULL )
+        return;
+
+    threading_pool_stop( pool );
+
+    pthread_cond_destroy( &pool->done_cond );
+    pthread_cond_destroy( &pool->work_cond );
+    pthread_mutex_destroy( &pool->mutex );
+
+    memset( pool, 0, sizeof( mbedtls_threading_pool ) );
+}
+
 #endif /* MBEDTLS_THREADING_PTHREAD */
 
 #if defined(MBEDTLS_THREADING_ALT)
@@ -112,6 +356,8 @@ void mbedtls_threading_set_alt( void (*mutex_init)( mbedtls_threading_mutex_t *
 
     mbedtls_mutex_init( &mbedtls_threading_readdir_mutex );
     mbedtls_mutex_init( &mbedtls_threading_gmtime_mutex );
+    mbedtls_mutex_init( &mbedtls_threading_ecp_mutex );
+    mbedtls_mutex_init( &mbedtls_threading_dhm_mutex );
 }
 
 /*
@@ -121,6 +367,8 @@ void mbedtls_threading_free_alt( void )
 {
     mbedtls_mutex_free( &mbedtls_threading_readdir_mutex );
     mbedtls_mutex_free( &mbedtls_threading_gmtime_mutex );
+    mbedtls_mutex_free( &mbedtls_threading_ecp_mutex );
+    mbedtls_mutex_free( &mbedtls_threading_dhm_mutex );
 }
 #endif /* MBEDTLS_THREADING_ALT */
 
@@ -132,5 +380,7 @@ void mbedtls_threading_free_alt( void )
 #endif
 mbedtls_threading_mutex_t mbedtls_threading_readdir_mutex MUTEX_INIT;
 mbedtls_threading_mutex_t mbedtls_threading_gmtime_mutex MUTEX_INIT;
+mbedtls_threading_mutex_t mbedtls_threading_ecp_mutex MUTEX_INIT;
+mbedtls_threading_mutex_t mbedtls_threading_dhm_mutex MUTEX_INIT;
 
 #endif /* MBEDTLS_THREADING_C */
@@ -183,6 +183,9 @@ static const char *features[] = {
 #if defined(MBEDTLS_CIPHER_MODE_CTR)
     "MBEDTLS_CIPHER_MODE_CTR",
 #endif /* MBEDTLS_CIPHER_MODE_CTR */
+#if defined(MBEDTLS_AES_OFFLOAD)
+    "MBEDTLS_AES_OFFLOAD",
+#endif /* MBEDTLS_AES_OFFLOAD */
 #if defined(MBEDTLS_CIPHER_NULL_CIPHER)
     "MBEDTLS_CIPHER_NULL_CIPHER",
 #endif /* MBEDTLS_CIPHER_NULL_CIPHER */
@@ -243,6 +246,18 @@ static const char *features[] = {
 #if defined(MBEDTLS_ECP_NIST_OPTIM)
     "MBEDTLS_ECP_NIST_OPTIM",
 #endif /* MBEDTLS_ECP_NIST_OPTIM */
+#if defined(MBEDTLS_ECP_P256_OPTIM)
+    "MBEDTLS_ECP_P256_OPTIM",
+#endif /* MBEDTLS_ECP_P256_OPTIM */
+#if defined(MBEDTLS_ECP_X25519_OPTIM)
+    "MBEDTLS_ECP_X25519_OPTIM",
+#endif /* MBEDTLS_ECP_X25519_OPTIM */
+#if defined(MBEDTLS_ECP_COMB_CACHE)
+    "MBEDTLS_ECP_COMB_CACHE",
+#endif /* MBEDTLS_ECP_COMB_CACHE */
+#if defined(MBEDTLS_DHM_COMB_CACHE)
+    "MBEDTLS_DHM_COMB_CACHE",
+#endif /* MBEDTLS_DHM_COMB_CACHE */
 #if defined(MBEDTLS_ECDSA_DETERMINISTIC)
     "MBEDTLS_ECDSA_DETERMINISTIC",
 #endif /* MBEDTLS_ECDSA_DETERMINISTIC */
@@ -288,6 +303,12 @@ static const char *features[] = {
 #if defined(MBEDTLS_GENPRIME)
     "MBEDTLS_GENPRIME",
 #endif /* MBEDTLS_GENPRIME */
+#if defined(MBEDTLS_MPI_ARENA)
+    "MBEDTLS_MPI_ARENA",
+#endif /* MBEDTLS_MPI_ARENA */
+#if defined(MBEDTLS_MPI_MULX)
+    "MBEDTLS_MPI_MULX",
+#endif /* MBEDTLS_MPI_MULX */
 #if defined(MBEDTLS_FS_IO)
     "MBEDTLS_FS_IO",
 #endif /* MBEDTLS_FS_IO */
@@ -303,6 +324,9 @@ static const char *features[] = {
 #if defined(MBEDTLS_ENTROPY_NV_SEED)
     "MBEDTLS_ENTROPY_NV_SEED",
 #endif /* MBEDTLS_ENTROPY_NV_SEED */
+#if defined(MBEDTLS_ENTROPY_BACKGROUND)
+    "MBEDTLS_ENTROPY_BACKGROUND",
+#endif /* MBEDTLS_ENTROPY_BACKGROUND */
 #if defined(MBEDTLS_MEMORY_DEBUG)
     "MBEDTLS_MEMORY_DEBUG",
 #endif /* MBEDTLS_MEMORY_DEBUG */
@@ -360,6 +384,15 @@ static const char *features[] = {
 #if defined(MBEDTLS_SSL_SRV_RESPECT_CLIENT_PREFERENCE)
     "MBEDTLS_SSL_SRV_RESPECT_CLIENT_PREFERENCE",
 #endif /* MBEDTLS_SSL_SRV_RESPECT_CLIENT_PREFERENCE */
+#if defined(MBEDTLS_SSL_LAZY_BUFFERS)
+    "MBEDTLS_SSL_LAZY_BUFFERS",
+#endif /* MBEDTLS_SSL_LAZY_BUFFERS */
+#if defined(MBEDTLS_SSL_BATCH_WRITES)
+    "MBEDTLS_SSL_BATCH_WRITES",
+#endif /* MBEDTLS_SSL_BATCH_WRITES */
+#if defined(MBEDTLS_SSL_ASYNC_PRIVATE)
+    "MBEDTLS_SSL_ASYNC_PRIVATE",
+#endif /* MBEDTLS_SSL_ASYNC_PRIVATE */
 #if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
     "MBEDTLS_SSL_MAX_FRAGMENT_LENGTH",
 #endif /* MBEDTLS_SSL_MAX_FRAGMENT_LENGTH */
@@ -411,6 +444,9 @@ static const char *features[] = {
 #if defined(MBEDTLS_THREADING_PTHREAD)
     "MBEDTLS_THREADING_PTHREAD",
 #endif /* MBEDTLS_THREADING_PTHREAD */
+#if defined(MBEDTLS_NET_POLLER)
+    "MBEDTLS_NET_POLLER",
+#endif /* MBEDTLS_NET_POLLER */
 #if defined(MBEDTLS_VERSION_FEATURES)
     "MBEDTLS_VERSION_FEATURES",
 #endif /* MBEDTLS_VERSION_FEATURES */
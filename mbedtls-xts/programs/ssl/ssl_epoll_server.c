@@ -0,0 +1,737 @@
+/*
+ *  SSL server demonstration program using an event loop per thread to
+ *  serve many non-blocking connections at once.
+ *
+ *  Copyright (C) 2006-2015, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  This file is part of mbed TLS (https://tls.mbed.org)
+ */
+
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+
+#if defined(MBEDTLS_PLATFORM_C)
+#include "mbedtls/platform.h"
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#define mbedtls_free       free
+#define mbedtls_fprintf    fprintf
+#define mbedtls_printf     printf
+#define mbedtls_calloc     calloc
+#define mbedtls_snprintf   snprintf
+#endif
+
+#if !defined(MBEDTLS_BIGNUM_C) || !defined(MBEDTLS_CERTS_C) ||            \
+    !defined(MBEDTLS_ENTROPY_C) || !defined(MBEDTLS_SSL_TLS_C) ||         \
+    !defined(MBEDTLS_SSL_SRV_C) || !defined(MBEDTLS_NET_C) ||             \
+    !defined(MBEDTLS_RSA_C) || !defined(MBEDTLS_CTR_DRBG_C) ||            \
+    !defined(MBEDTLS_X509_CRT_PARSE_C) || !defined(MBEDTLS_TIMING_C) ||   \
+    !defined(MBEDTLS_THREADING_C) || !defined(MBEDTLS_THREADING_PTHREAD) || \
+    !defined(MBEDTLS_NET_POLLER) || !defined(MBEDTLS_PEM_PARSE_C)
+int main( void )
+{
+    mbedtls_printf("MBEDTLS_BIGNUM_C and/or MBEDTLS_CERTS_C and/or MBEDTLS_ENTROPY_C "
+           "and/or MBEDTLS_SSL_TLS_C and/or MBEDTLS_SSL_SRV_C and/or "
+           "MBEDTLS_NET_C and/or MBEDTLS_RSA_C and/or "
+           "MBEDTLS_CTR_DRBG_C and/or MBEDTLS_X509_CRT_PARSE_C and/or "
+           "MBEDTLS_TIMING_C and/or "
+           "MBEDTLS_THREADING_C and/or MBEDTLS_THREADING_PTHREAD and/or "
+           "MBEDTLS_NET_POLLER and/or MBEDTLS_PEM_PARSE_C not defined.\n");
+    return( 0 );
+}
+#else
+
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/certs.h"
+#include "mbedtls/x509.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/net.h"
+#include "mbedtls/timing.h"
+#include "mbedtls/error.h"
+
+#if defined(MBEDTLS_SSL_CACHE_C)
+#include "mbedtls/ssl_cache.h"
+#endif
+
+#define DFL_SERVER_ADDR         NULL
+#define DFL_SERVER_PORT         "4433"
+#define DFL_THREADS             4
+#define DFL_RESPONSE_SIZE       -1
+#define DFL_STATS_INTERVAL      0
+
+#define HTTP_RESPONSE \
+    "HTTP/1.0 200 OK\r\nContent-Type: text/html\r\n\r\n" \
+    "<h2>mbed TLS Test Server</h2>\r\n" \
+    "<p>Successful connection</p>\r\n"
+
+#define MAX_NUM_THREADS 64
+#define MAX_EVENTS      64
+
+/* Milliseconds between two checks of the termination flag */
+#define POLL_TIMEOUT    100
+
+#define USAGE \
+    "\n usage: ssl_epoll_server param=<>...\n"                  \
+    "\n acceptable parameters:\n"                               \
+    "    server_addr=%%s      default: (all interfaces)\n"      \
+    "    server_port=%%d      default: 4433\n"                  \
+    "    threads=%%d          default: 4 (max 64)\n"            \
+    "                        one listening socket and one event loop each\n" \
+    "    response_size=%%d    default: about 100 bytes\n"        \
+    "                        size of the answer to each request\n" \
+    "    stats_interval=%%d   default: 0 (only at exit)\n"      \
+    "                        seconds between two statistics reports\n" \
+    "\n"
+
+/*
+ * global options
+ */
+struct options
+{
+    const char *server_addr;    /* address on which the ssl service runs    */
+    const char *server_port;    /* port on which the ssl service runs       */
+    int threads;                /* number of event loop threads             */
+    int response_size;          /* size of the response to each request     */
+    int stats_interval;         /* seconds between two statistics reports   */
+} opt;
+
+/*
+ * Connection states: the TLS handshake, then any number of
+ * request/response exchanges until the client closes the connection.
+ */
+#define CONN_HANDSHAKE  0
+#define CONN_READ       1
+#define CONN_WRITE      2
+
+typedef struct conn
+{
+    mbedtls_net_context fd;
+    mbedtls_ssl_context ssl;
+    int state;
+    size_t written;             /* bytes of the response already sent       */
+    struct conn *prev;          /* list of the connections of a worker      */
+    struct conn *next;
+} conn_t;
+
+/*
+ * Counters, kept per thread and added to the global ones after each batch
+ * of events so that the threads do not contend for them
+ */
+typedef struct
+{
+    unsigned long accepted;
+    unsigned long handshakes;
+    unsigned long failed;
+    unsigned long bytes_read;
+    unsigned long bytes_written;
+} stats_t;
+
+typedef struct
+{
+    pthread_t thread;
+    int id;
+    mbedtls_net_context listen_fd;
+    mbedtls_net_poller poller;
+    const mbedtls_ssl_config *config;
+    conn_t *conns;
+    unsigned long active;       /* number of connections in conns           */
+    unsigned long reported;     /* last value of active seen by main()      */
+    stats_t stats;
+} worker_t;
+
+static worker_t workers[MAX_NUM_THREADS];
+
+static mbedtls_threading_mutex_t stats_mutex;
+static stats_t total;
+
+static unsigned char *response;
+static size_t response_len;
+
+static volatile int received_sigterm = 0;
+
+static void term_handler( int sig )
+{
+    ((void) sig);
+    received_sigterm = 1;
+}
+
+static void stats_flush( worker_t *w )
+{
+    mbedtls_mutex_lock( &stats_mutex );
+
+    total.accepted      += w->stats.accepted;
+    total.handshakes    += w->stats.handshakes;
+    total.failed        += w->stats.failed;
+    total.bytes_read    += w->stats.bytes_read;
+    total.bytes_written += w->stats.bytes_written;
+    w->reported = w->active;
+
+    mbedtls_mutex_unlock( &stats_mutex );
+
+    memset( &w->stats, 0, sizeof( stats_t ) );
+}
+
+static void conn_close( worker_t *w, conn_t *c, int ret )
+{
+    if( ret == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY )
+    {
+        /* Best effort: the socket is non-blocking */
+        (void) mbedtls_ssl_close_notify( &c->ssl );
+    }
+    else if( c->state == CONN_HANDSHAKE )
+    {
+        w->stats.failed++;
+    }
+
+    if( c->prev != NULL )
+        c->prev->next = c->next;
+    else
+        w->conns = c->next;
+    if( c->next != NULL )
+        c->next->prev = c->prev;
+
+    w->active--;
+
+    mbedtls_net_free( &c->fd );
+    mbedtls_ssl_free( &c->ssl );
+    mbedtls_free( c );
+}
+
+/*
+ * Make as much progress as possible on a connection: with edge-triggered
+ * events, the next notification only comes once the socket has been
+ * drained, ie after MBEDTLS_ERR_SSL_WANT_READ or MBEDTLS_ERR_SSL_WANT_WRITE.
+ *
+ * Returns 0 if the connection is waiting for the socket, or the error
+ * that ended it.
+ */
+static int conn_process( worker_t *w, conn_t *c )
+{
+    int ret;
+    unsigned char buf[1024];
+
+    while( 1 )
+    {
+        switch( c->state )
+        {
+            case CONN_HANDSHAKE:
+                if( ( ret = mbedtls_ssl_handshake( &c->ssl ) ) != 0 )
+                    break;
+
+                w->stats.handshakes++;
+                c->state = CONN_READ;
+                continue;
+
+            case CONN_READ:
+                ret = mbedtls_ssl_read( &c->ssl, buf, sizeof( buf ) );
+                if( ret == 0 )
+                    ret = MBEDTLS_ERR_NET_CONN_RESET;
+                if( ret < 0 )
+                    break;
+
+                w->stats.bytes_read += ret;
+
+                /* End of request should be detected according to the
+                 * syntax of the application protocol (eg HTTP), just use
+                 * a dummy test here, as ssl_client2 does for responses */
+                if( buf[ret - 1] == '\n' )
+                {
+                    c->written = 0;
+                    c->state = CONN_WRITE;
+                }
+                continue;
+
+            case CONN_WRITE:
+                ret = mbedtls_ssl_write( &c->ssl, response + c->written,
+                                         response_len - c->written );
+                if( ret < 0 )
+                    break;
+
+                w->stats.bytes_written += ret;
+                c->written += ret;
+
+                if( c->written == response_len )
+                    c->state = CONN_READ;
+                continue;
+        }
+
+        if( ret == MBEDTLS_ERR_SSL_WANT_READ ||
+            ret == MBEDTLS_ERR_SSL_WANT_WRITE )
+            return( 0 );
+
+        return( ret );
+    }
+}
+
+/*
+ * Accept every pending connection on the (non-blocking) listening socket
+ */
+static int accept_all( worker_t *w )
+{
+    int ret;
+    conn_t *c;
+
+    while( 1 )
+    {
+        if( ( c = mbedtls_calloc( 1, sizeof( conn_t ) ) ) == NULL )
+            return( MBEDTLS_ERR_SSL_ALLOC_FAILED );
+
+        mbedtls_net_init( &c->fd );
+        mbedtls_ssl_init( &c->ssl );
+
+        if( ( ret = mbedtls_net_accept( &w->listen_fd, &c->fd,
+                                        NULL, 0, NULL ) ) != 0 )
+        {
+            mbedtls_free( c );
+            return( ret == MBEDTLS_ERR_SSL_WANT_READ ? 0 : ret );
+        }
+
+        w->stats.accepted++;
+
+        if( ( ret = mbedtls_net_set_nonblock( &c->fd ) ) != 0 ||
+            ( ret = mbedtls_ssl_setup( &c->ssl, w->config ) ) != 0 )
+        {
+            mbedtls_printf( "  [ #%d ]  failed to set up connection: -0x%04x\n",
+                            w->id, -ret );
+            w->stats.failed++;
+            mbedtls_net_free( &c->fd );
+            mbedtls_ssl_free( &c->ssl );
+            mbedtls_free( c );
+            continue;
+        }
+
+        mbedtls_ssl_set_bio( &c->ssl, &c->fd,
+                             mbedtls_net_send, mbedtls_net_recv, NULL );
+
+        c->state = CONN_HANDSHAKE;
+        c->next = w->conns;
+        if( w->conns != NULL )
+            w->conns->prev = c;
+        w->conns = c;
+        w->active++;
+
+        /* Readiness at the time of the call is reported too, so a
+         * ClientHello that arrived already is not missed */
+        if( ( ret = mbedtls_net_poller_add( &w->poller, &c->fd, c ) ) != 0 )
+            conn_close( w, c, ret );
+    }
+}
+
+static void *worker_loop( void *data )
+{
+    int ret, i, n;
+    worker_t *w = (worker_t *) data;
+    mbedtls_net_poll_event events[MAX_EVENTS];
+
+    while( ! received_sigterm )
+    {
+        n = mbedtls_net_poller_wait( &w->poller, events, MAX_EVENTS,
+                                     POLL_TIMEOUT );
+        if( n < 0 )
+        {
+            mbedtls_printf( "  [ #%d ]  failed: mbedtls_net_poller_wait returned -0x%04x\n",
+                            w->id, -n );
+            break;
+        }
+
+        for( i = 0; i < n; i++ )
+        {
+            conn_t *c = (conn_t *) events[i].data;
+
+            /* The listening socket is registered with NULL */
+            if( c == NULL )
+            {
+                if( ( ret = accept_all( w ) ) != 0 )
+                    mbedtls_printf( "  [ #%d ]  failed: mbedtls_net_accept returned -0x%04x\n",
+                                    w->id, -ret );
+                continue;
+            }
+
+            /* A hang-up still leaves data to read, eg a close_notify */
+            if( ( ret = conn_process( w, c ) ) != 0 )
+                conn_close( w, c, ret );
+        }
+
+        stats_flush( w );
+    }
+
+    while( w->conns != NULL )
+        conn_close( w, w->conns, 0 );
+
+    stats_flush( w );
+
+    return( NULL );
+}
+
+static void print_stats( const char *what, const stats_t *s,
+                         unsigned long ms, unsigned long active )
+{
+    if( ms == 0 )
+        ms = 1;
+
+    mbedtls_printf( "  [ main ]  %s: %lu connections, %lu handshakes "
+                    "(%lu/s), %lu failed, %lu active, "
+                    "%lu bytes read, %lu bytes written (%lu bytes/s)\n",
+                    what, s->accepted, s->handshakes,
+                    (unsigned long) ( s->handshakes * 1000.0 / ms ),
+                    s->failed, active, s->bytes_read, s->bytes_written,
+                    (unsigned long) ( ( s->bytes_read + s->bytes_written )
+                                      * 1000.0 / ms ) );
+    fflush( stdout );
+}
+
+int main( int argc, char *argv[] )
+{
+    int ret = 0, i, started = 0;
+    char *p, *q;
+    const char pers[] = "ssl_epoll_server";
+    unsigned long elapsed, last = 0, active;
+    stats_t snap, prev;
+    struct mbedtls_timing_hr_time timer;
+
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_pool ctr_drbg;
+    mbedtls_ssl_config conf;
+    mbedtls_x509_crt srvcert;
+    mbedtls_pk_context pkey;
+#if defined(MBEDTLS_SSL_CACHE_C)
+    mbedtls_ssl_cache_context cache;
+#endif
+
+#if defined(MBEDTLS_SSL_CACHE_C)
+    mbedtls_ssl_cache_init( &cache );
+#endif
+    mbedtls_x509_crt_init( &srvcert );
+    mbedtls_pk_init( &pkey );
+    mbedtls_ssl_config_init( &conf );
+    mbedtls_ctr_drbg_pool_init( &ctr_drbg );
+    mbedtls_entropy_init( &entropy );
+    mbedtls_mutex_init( &stats_mutex );
+
+    memset( workers, 0, sizeof( workers ) );
+    for( i = 0; i < MAX_NUM_THREADS; i++ )
+    {
+        mbedtls_net_init( &workers[i].listen_fd );
+        mbedtls_net_poller_init( &workers[i].poller );
+    }
+    memset( &total, 0, sizeof( total ) );
+    memset( &prev, 0, sizeof( prev ) );
+
+    opt.server_addr         = DFL_SERVER_ADDR;
+    opt.server_port         = DFL_SERVER_PORT;
+    opt.threads             = DFL_THREADS;
+    opt.response_size       = DFL_RESPONSE_SIZE;
+    opt.stats_interval      = DFL_STATS_INTERVAL;
+
+    for( i = 1; i < argc; i++ )
+    {
+        p = argv[i];
+        if( ( q = strchr( p, '=' ) ) == NULL )
+            goto usage;
+        *q++ = '\0';
+
+        if( strcmp( p, "server_port" ) == 0 )
+            opt.server_port = q;
+        else if( strcmp( p, "server_addr" ) == 0 )
+            opt.server_addr = q;
+        else if( strcmp( p, "threads" ) == 0 )
+        {
+            opt.threads = atoi( q );
+            if( opt.threads < 1 || opt.threads > MAX_NUM_THREADS )
+                goto usage;
+        }
+        else if( strcmp( p, "response_size" ) == 0 )
+        {
+            opt.response_size = atoi( q );
+            if( opt.response_size < 1 || opt.response_size > 1000000 )
+                goto usage;
+        }
+        else if( strcmp( p, "stats_interval" ) == 0 )
+        {
+            opt.stats_interval = atoi( q );
+            if( opt.stats_interval < 0 )
+                goto usage;
+        }
+        else
+        {
+        usage:
+            mbedtls_printf( USAGE );
+            ret = 1;
+            goto exit;
+        }
+    }
+
+    /*
+     * 0. Prepare the response, shared by all connections.
+     * Like ssl_server2, pad it with letters and end it with a newline.
+     */
+    if( opt.response_size == DFL_RESPONSE_SIZE )
+        response_len = strlen( HTTP_RESPONSE );
+    else
+        response_len = opt.response_size;
+
+    if( ( response = mbedtls_calloc( 1, response_len + 1 ) ) == NULL )
+    {
+        mbedtls_printf( "  ! Could not allocate the response\n" );
+        ret = 1;
+        goto exit;
+    }
+
+    if( opt.response_size == DFL_RESPONSE_SIZE )
+        memcpy( response, HTTP_RESPONSE, response_len );
+    else
+    {
+        for( i = 0; i < (int) response_len; i++ )
+            response[i] = 'A' + i % 26;
+        response[response_len - 1] = '\n';
+    }
+
+    /*
+     * 1. Load the certificates and private RSA key
+     */
+    mbedtls_printf( "\n  . Loading the server cert. and key..." );
+    fflush( stdout );
+
+    /*
+     * This demonstration program uses embedded test certificates.
+     * Instead, you may want to use mbedtls_x509_crt_parse_file() to read the
+     * server and CA certificates, as well as mbedtls_pk_parse_keyfile().
+     */
+    ret = mbedtls_x509_crt_parse( &srvcert, (const unsigned char *) mbedtls_test_srv_crt,
+                          mbedtls_test_srv_crt_len );
+    if( ret != 0 )
+    {
+        mbedtls_printf( " failed\n  !  mbedtls_x509_crt_parse returned %d\n\n", ret );
+        goto exit;
+    }
+
+    ret = mbedtls_x509_crt_parse( &srvcert, (const unsigned char *) mbedtls_test_cas_pem,
+                          mbedtls_test_cas_pem_len );
+    if( ret != 0 )
+    {
+        mbedtls_printf( " failed\n  !  mbedtls_x509_crt_parse returned %d\n\n", ret );
+        goto exit;
+    }
+
+    ret =  mbedtls_pk_parse_key( &pkey, (const unsigned char *) mbedtls_test_srv_key,
+                         mbedtls_test_srv_key_len, NULL, 0 );
+    if( ret != 0 )
+    {
+        mbedtls_printf( " failed\n  !  mbedtls_pk_parse_key returned %d\n\n", ret );
+        goto exit;
+    }
+
+    mbedtls_printf( " ok\n" );
+
+    /*
+     * 1b. Seed the random number generators, one instance per thread
+     */
+    mbedtls_printf( "  . Seeding the random number generators..." );
+    fflush( stdout );
+
+    if( ( ret = mbedtls_ctr_drbg_pool_seed( &ctr_drbg, opt.threads,
+                               mbedtls_entropy_func, &entropy,
+                               (const unsigned char *) pers,
+                               strlen( pers ) ) ) != 0 )
+    {
+        mbedtls_printf( " failed: mbedtls_ctr_drbg_pool_seed returned -0x%04x\n",
+                -ret );
+        goto exit;
+    }
+
+    mbedtls_printf( " ok\n" );
+
+    /*
+     * 1c. Prepare SSL configuration
+     */
+    mbedtls_printf( "  . Setting up the SSL data...." );
+    fflush( stdout );
+
+    if( ( ret = mbedtls_ssl_config_defaults( &conf,
+                    MBEDTLS_SSL_IS_SERVER,
+                    MBEDTLS_SSL_TRANSPORT_STREAM,
+                    MBEDTLS_SSL_PRESET_DEFAULT ) ) != 0 )
+    {
+        mbedtls_printf( " failed: mbedtls_ssl_config_defaults returned -0x%04x\n",
+                -ret );
+        goto exit;
+    }
+
+    mbedtls_ssl_conf_rng( &conf, mbedtls_ctr_drbg_pool_random, &ctr_drbg );
+
+#if defined(MBEDTLS_SSL_CACHE_C)
+    mbedtls_ssl_conf_session_cache( &conf, &cache,
+                                   mbedtls_ssl_cache_get,
+                                   mbedtls_ssl_cache_set );
+#endif
+
+    mbedtls_ssl_conf_ca_chain( &conf, srvcert.next, NULL );
+    if( ( ret = mbedtls_ssl_conf_own_cert( &conf, &srvcert, &pkey ) ) != 0 )
+    {
+        mbedtls_printf( " failed\n  ! mbedtls_ssl_conf_own_cert returned %d\n\n", ret );
+        goto exit;
+    }
+
+    mbedtls_printf( " ok\n" );
+
+    /*
+     * 2. Setup one listening TCP socket and event loop per thread. The
+     * kernel spreads the incoming connections among the sockets.
+     */
+    mbedtls_printf( "  . Bind on tcp://%s:%s/ (%d sockets) ...",
+            opt.server_addr ? opt.server_addr : "*",
+            opt.server_port, opt.threads );
+    fflush( stdout );
+
+    for( i = 0; i < opt.threads; i++ )
+    {
+        worker_t *w = &workers[i];
+
+        w->id = i;
+        w->config = &conf;
+
+        if( ( ret = mbedtls_net_bind_reuseport( &w->listen_fd, opt.server_addr,
+                                                opt.server_port,
+                                                MBEDTLS_NET_PROTO_TCP ) ) != 0 )
+        {
+            mbedtls_printf( " failed\n  ! mbedtls_net_bind_reuseport returned -0x%04x\n\n",
+                            -ret );
+            goto exit;
+        }
+
+        if( ( ret = mbedtls_net_set_nonblock( &w->listen_fd ) ) != 0 ||
+            ( ret = mbedtls_net_poller_setup( &w->poller ) ) != 0 ||
+            ( ret = mbedtls_net_poller_add( &w->poller, &w->listen_fd,
+                                            NULL ) ) != 0 )
+        {
+            mbedtls_printf( " failed\n  ! setting up the event loop returned -0x%04x\n\n",
+                            -ret );
+            goto exit;
+        }
+    }
+
+    mbedtls_printf( " ok\n" );
+
+    /*
+     * 3. Start the event loops
+     */
+    signal( SIGTERM, term_handler );
+    signal( SIGINT, term_handler );
+
+    mbedtls_printf( "  . Performing the SSL/TLS handshakes in %d threads\n",
+                    opt.threads );
+    fflush( stdout );
+
+    (void) mbedtls_timing_get_timer( &timer, 1 );
+
+    for( started = 0; started < opt.threads; started++ )
+    {
+        if( ( ret = pthread_create( &workers[started].thread, NULL,
+                                    worker_loop, &workers[started] ) ) != 0 )
+        {
+            mbedtls_printf( "  [ main ]  failed: pthread_create returned %d\n", ret );
+            received_sigterm = 1;
+            break;
+        }
+    }
+
+    /*
+     * 4. Report statistics until interrupted
+     */
+    while( ! received_sigterm )
+    {
+        mbedtls_net_usleep( POLL_TIMEOUT * 1000 );
+
+        if( opt.stats_interval == 0 )
+            continue;
+
+        elapsed = mbedtls_timing_get_timer( &timer, 0 );
+        if( elapsed - last < (unsigned long) opt.stats_interval * 1000 )
+            continue;
+
+        mbedtls_mutex_lock( &stats_mutex );
+        snap = total;
+        for( active = 0, i = 0; i < started; i++ )
+            active += workers[i].reported;
+        mbedtls_mutex_unlock( &stats_mutex );
+
+        prev.accepted      = snap.accepted - prev.accepted;
+        prev.handshakes    = snap.handshakes - prev.handshakes;
+        prev.failed        = snap.failed - prev.failed;
+        prev.bytes_read    = snap.bytes_read - prev.bytes_read;
+        prev.bytes_written = snap.bytes_written - prev.bytes_written;
+
+        print_stats( "Last interval", &prev, elapsed - last, active );
+
+        prev = snap;
+        last = elapsed;
+    }
+
+    mbedtls_printf( "  [ main ]  interrupted by signal, stopping the threads\n" );
+
+    for( i = 0; i < started; i++ )
+        pthread_join( workers[i].thread, NULL );
+
+    print_stats( "Total", &total, mbedtls_timing_get_timer( &timer, 0 ), 0 );
+
+    ret = 0;
+
+exit:
+
+#ifdef MBEDTLS_ERROR_C
+    if( ret != 0 && ret != 1 )
+    {
+        char error_buf[100];
+        mbedtls_strerror( ret, error_buf, 100 );
+        mbedtls_printf( "  Last error was: -0x%04x - %s\n\n", -ret, error_buf );
+    }
+#endif
+
+    for( i = 0; i < MAX_NUM_THREADS; i++ )
+    {
+        mbedtls_net_poller_free( &workers[i].poller );
+        mbedtls_net_free( &workers[i].listen_fd );
+    }
+
+    mbedtls_free( response );
+    mbedtls_x509_crt_free( &srvcert );
+    mbedtls_pk_free( &pkey );
+#if defined(MBEDTLS_SSL_CACHE_C)
+    mbedtls_ssl_cache_free( &cache );
+#endif
+    mbedtls_ctr_drbg_pool_free( &ctr_drbg );
+    mbedtls_entropy_free( &entropy );
+    mbedtls_ssl_config_free( &conf );
+    mbedtls_mutex_free( &stats_mutex );
+
+    return( ret );
+}
+
+#endif /* MBEDTLS_BIGNUM_C && MBEDTLS_CERTS_C && MBEDTLS_ENTROPY_C &&
+          MBEDTLS_SSL_TLS_C && MBEDTLS_SSL_SRV_C && MBEDTLS_NET_C &&
+          MBEDTLS_RSA_C && MBEDTLS_CTR_DRBG_C && MBEDTLS_X509_CRT_PARSE_C &&
+          MBEDTLS_TIMING_C && MBEDTLS_THREADING_C &&
+          MBEDTLS_THREADING_PTHREAD && MBEDTLS_NET_POLLER &&
+          MBEDTLS_PEM_PARSE_C */
@@ -73,6 +73,14 @@ int main( void )
 #include "mbedtls/ssl_cache.h"
 #endif
 
+#if defined(MBEDTLS_ECP_COMB_CACHE)
+#include "mbedtls/ecp.h"
+#endif
+
+#if defined(MBEDTLS_DHM_COMB_CACHE)
+#include "mbedtls/dhm.h"
+#endif
+
 #if defined(MBEDTLS_MEMORY_BUFFER_ALLOC_C)
 #include "mbedtls/memory_buffer_alloc.h"
 #endif
@@ -319,7 +327,7 @@ int main( void )
     const char pers[] = "ssl_pthread_server";
 
     mbedtls_entropy_context entropy;
-    mbedtls_ctr_drbg_context ctr_drbg;
+    mbedtls_ctr_drbg_pool ctr_drbg;
     mbedtls_ssl_config conf;
     mbedtls_x509_crt srvcert;
     mbedtls_x509_crt cachain;
@@ -343,7 +351,7 @@ int main( void )
     mbedtls_x509_crt_init( &cachain );
 
     mbedtls_ssl_config_init( &conf );
-    mbedtls_ctr_drbg_init( &ctr_drbg );
+    mbedtls_ctr_drbg_pool_init( &ctr_drbg );
     memset( threads, 0, sizeof(threads) );
     mbedtls_net_init( &listen_fd );
     mbedtls_net_init( &client_fd );
@@ -396,21 +404,38 @@ int main( void )
     mbedtls_printf( " ok\n" );
 
     /*
-     * 1b. Seed the random number generator
+     * 1b. Seed the random number generators
+     *
+     * Each worker thread gets its own DRBG instance, so that handshakes
+     * running in parallel do not serialize on a single RNG mutex.
      */
-    mbedtls_printf( "  . Seeding the random number generator..." );
+    mbedtls_printf( "  . Seeding the random number generators..." );
 
-    if( ( ret = mbedtls_ctr_drbg_seed( &ctr_drbg, mbedtls_entropy_func, &entropy,
+    if( ( ret = mbedtls_ctr_drbg_pool_seed( &ctr_drbg, MAX_NUM_THREADS,
+                               mbedtls_entropy_func, &entropy,
                                (const unsigned char *) pers,
                                strlen( pers ) ) ) != 0 )
     {
-        mbedtls_printf( " failed: mbedtls_ctr_drbg_seed returned -0x%04x\n",
+        mbedtls_printf( " failed: mbedtls_ctr_drbg_pool_seed returned -0x%04x\n",
                 -ret );
         goto exit;
     }
 
     mbedtls_printf( " ok\n" );
 
+#if defined(MBEDTLS_ENTROPY_BACKGROUND)
+    /*
+     * Gather entropy ahead of time so that reseeding in the worker threads
+     * does not wait on the entropy sources
+     */
+    if( ( ret = mbedtls_entropy_background_start( &entropy ) ) != 0 )
+    {
+        mbedtls_printf( "  ! mbedtls_entropy_background_start returned -0x%04x\n",
+                -ret );
+        goto exit;
+    }
+#endif
+
     /*
      * 1c. Prepare SSL configuration
      */
@@ -426,7 +451,7 @@ int main( void )
         goto exit;
     }
 
-    mbedtls_ssl_conf_rng( &conf, mbedtls_ctr_drbg_random, &ctr_drbg );
+    mbedtls_ssl_conf_rng( &conf, mbedtls_ctr_drbg_pool_random, &ctr_drbg );
     mbedtls_ssl_conf_dbg( &conf, my_mutexed_debug, stdout );
 
     /* mbedtls_ssl_cache_get() and mbedtls_ssl_cache_set() are thread-safe if
@@ -503,7 +528,7 @@ exit:
 #if defined(MBEDTLS_SSL_CACHE_C)
     mbedtls_ssl_cache_free( &cache );
 #endif
-    mbedtls_ctr_drbg_free( &ctr_drbg );
+    mbedtls_ctr_drbg_pool_free( &ctr_drbg );
     mbedtls_entropy_free( &entropy );
     mbedtls_ssl_config_free( &conf );
 
@@ -511,6 +536,14 @@ exit:
 
     mbedtls_mutex_free( &debug_mutex );
 
+#if defined(MBEDTLS_ECP_COMB_CACHE)
+    mbedtls_ecp_comb_cache_free();
+#endif
+
+#if defined(MBEDTLS_DHM_COMB_CACHE)
+    mbedtls_dhm_comb_cache_free();
+#endif
+
 #if defined(MBEDTLS_MEMORY_BUFFER_ALLOC_C)
     mbedtls_memory_buffer_alloc_free();
 #endif
@@ -136,6 +136,7 @@ int main( void )
 #define DFL_BADMAC_LIMIT        -1
 #define DFL_EXTENDED_MS         -1
 #define DFL_ETM                 -1
+#define DFL_ASYNC_PRIVATE       -1
 
 #define LONG_RESPONSE "<p>01-blah-blah-blah-blah-blah-blah-blah-blah-blah\r\n" \
     "02-blah-blah-blah-blah-blah-blah-blah-blah-blah-blah-blah-blah-blah\r\n"  \
@@ -287,6 +288,15 @@ int main( void )
 #define USAGE_ETM ""
 #endif
 
+#if defined(MBEDTLS_SSL_ASYNC_PRIVATE) && defined(MBEDTLS_X509_CRT_PARSE_C)
+#define USAGE_ASYNC \
+    "    async_private=%%d    default: -1 (synchronous private key operations)\n" \
+    "                        number of WANT_ASYNC returns before an asynchronous\n" \
+    "                        sign or decrypt completes\n"
+#else
+#define USAGE_ASYNC ""
+#endif
+
 #if defined(MBEDTLS_SSL_RENEGOTIATION)
 #define USAGE_RENEGO \
     "    renegotiation=%%d    default: 0 (disabled)\n"      \
@@ -323,6 +333,7 @@ int main( void )
     "                        options: none, optional, required\n" \
     USAGE_IO                                                \
     USAGE_SNI                                               \
+    USAGE_ASYNC                                             \
     "\n"                                                    \
     USAGE_PSK                                               \
     USAGE_ECJPAKE                                           \
@@ -394,6 +405,7 @@ struct options
     const char *dhm_file;       /* the file with the DH parameters          */
     int extended_ms;            /* allow negotiation of extended MS?        */
     int etm;                    /* allow negotiation of encrypt-then-MAC?   */
+    int async_private;          /* WANT_ASYNC returns per private key op.   */
     int transport;              /* TLS or DTLS?                             */
     int cookies;                /* Use cookies for DTLS? -1 to break them   */
     int anti_replay;            /* Use anti-replay for DTLS? -1 for default */
@@ -455,6 +467,94 @@ static int my_send( void *ctx, const unsigned char *buf, size_t len )
     return( ret );
 }
 
+#if defined(MBEDTLS_SSL_ASYNC_PRIVATE) && defined(MBEDTLS_X509_CRT_PARSE_C)
+/*
+ * Asynchronous private key operations, completed after opt.async_private
+ * calls to the resume callback, as if done by another thread
+ */
+typedef struct
+{
+    int sign;                   /* signature rather than decryption */
+    int remaining;              /* WANT_ASYNC returns left */
+    mbedtls_pk_context *pk;
+    mbedtls_md_type_t md_alg;
+    unsigned char input[MBEDTLS_MPI_MAX_SIZE];
+    size_t input_len;
+    int (*f_rng)(void *, unsigned char *, size_t);
+    void *p_rng;
+} async_context;
+
+static int async_start( async_context *ctx, mbedtls_ssl_context *ssl,
+                        mbedtls_pk_context *pk,
+                        const unsigned char *input, size_t input_len )
+{
+    if( input_len > sizeof( ctx->input ) )
+        return( MBEDTLS_ERR_SSL_HW_ACCEL_FALLTHROUGH );
+
+    mbedtls_printf( "  . Async %s started\n", ctx->sign ? "sign" : "decrypt" );
+
+    ctx->remaining = opt.async_private;
+    ctx->pk = pk;
+    memcpy( ctx->input, input, input_len );
+    ctx->input_len = input_len;
+    mbedtls_ssl_set_async_operation_data( ssl, ctx );
+
+    return( 0 );
+}
+
+static int async_sign( void *p_async, mbedtls_ssl_context *ssl,
+                       mbedtls_pk_context *pk, mbedtls_md_type_t md_alg,
+                       const unsigned char *hash, size_t hash_len )
+{
+    async_context *ctx = (async_context *) p_async;
+
+    ctx->sign = 1;
+    ctx->md_alg = md_alg;
+
+    return( async_start( ctx, ssl, pk, hash, hash_len ) );
+}
+
+static int async_decrypt( void *p_async, mbedtls_ssl_context *ssl,
+                          mbedtls_pk_context *pk,
+                          const unsigned char *input, size_t input_len )
+{
+    async_context *ctx = (async_context *) p_async;
+
+    ctx->sign = 0;
+
+    return( async_start( ctx, ssl, pk, input, input_len ) );
+}
+
+static int async_resume( void *p_async, mbedtls_ssl_context *ssl,
+                         unsigned char *output, size_t *output_len,
+                         size_t output_size )
+{
+    async_context *ctx = mbedtls_ssl_get_async_operation_data( ssl );
+    int ret;
+
+    ((void) p_async);
+
+    if( ctx->remaining > 0 )
+    {
+        ctx->remaining--;
+        return( MBEDTLS_ERR_SSL_WANT_ASYNC );
+    }
+
+    if( ctx->sign )
+        ret = mbedtls_pk_sign( ctx->pk, ctx->md_alg,
+                               ctx->input, ctx->input_len,
+                               output, output_len, ctx->f_rng, ctx->p_rng );
+    else
+        ret = mbedtls_pk_decrypt( ctx->pk, ctx->input, ctx->input_len,
+                                  output, output_len, output_size,
+                                  ctx->f_rng, ctx->p_rng );
+
+    mbedtls_printf( "  . Async %s completed\n", ctx->sign ? "sign" : "decrypt" );
+
+    return( ret );
+}
+#endif /* MBEDTLS_SSL_ASYNC_PRIVATE && MBEDTLS_X509_CRT_PARSE_C */
+
 /*
  * Return authmode from string, or -1 on error
  */
@@ -828,6 +928,9 @@ int main( int argc, char *argv[] )
 #if defined(MBEDTLS_SSL_ALPN)
     const char *alpn_list[10];
 #endif
+#if defined(MBEDTLS_SSL_ASYNC_PRIVATE) && defined(MBEDTLS_X509_CRT_PARSE_C)
+    async_context async_ctx;
+#endif
 #if defined(MBEDTLS_MEMORY_BUFFER_ALLOC_C)
     unsigned char alloc_buf[100000];
 #endif
@@ -943,6 +1046,7 @@ int main( int argc, char *argv[] )
     opt.badmac_limit        = DFL_BADMAC_LIMIT;
     opt.extended_ms         = DFL_EXTENDED_MS;
     opt.etm                 = DFL_ETM;
+    opt.async_private       = DFL_ASYNC_PRIVATE;
 
     for( i = 1; i < argc; i++ )
     {
@@ -1167,6 +1271,12 @@ int main( int argc, char *argv[] )
                 default: goto usage;
             }
         }
+        else if( strcmp( p, "async_private" ) == 0 )
+        {
+            opt.async_private = atoi( q );
+            if( opt.async_private < -1 )
+                goto usage;
+        }
         else if( strcmp( p, "etm" ) == 0 )
         {
             switch( atoi( q ) )
@@ -1782,6 +1892,16 @@ int main( int argc, char *argv[] )
         }
 #endif
 
+#if defined(MBEDTLS_SSL_ASYNC_PRIVATE) && defined(MBEDTLS_X509_CRT_PARSE_C)
+    if( opt.async_private >= 0 )
+    {
+        async_ctx.f_rng = mbedtls_ctr_drbg_random;
+        async_ctx.p_rng = &ctr_drbg;
+        mbedtls_ssl_conf_async_private_cb( &conf, async_sign, async_decrypt,
+                                           async_resume, NULL, &async_ctx );
+    }
+#endif
+
 #if defined(SNI_OPTION)
     if( opt.sni != NULL )
         mbedtls_ssl_conf_sni( &conf, sni_callback, sni_info );
@@ -1944,7 +2064,8 @@ handshake:
 
     do ret = mbedtls_ssl_handshake( &ssl );
     while( ret == MBEDTLS_ERR_SSL_WANT_READ ||
-           ret == MBEDTLS_ERR_SSL_WANT_WRITE );
+           ret == MBEDTLS_ERR_SSL_WANT_WRITE ||
+           ret == MBEDTLS_ERR_SSL_WANT_ASYNC );
 
     if( ret == MBEDTLS_ERR_SSL_HELLO_VERIFY_REQUIRED )
     {
@@ -2049,7 +2170,8 @@ data_exchange:
             ret = mbedtls_ssl_read( &ssl, buf, len );
 
             if( ret == MBEDTLS_ERR_SSL_WANT_READ ||
-                ret == MBEDTLS_ERR_SSL_WANT_WRITE )
+                ret == MBEDTLS_ERR_SSL_WANT_WRITE ||
+                ret == MBEDTLS_ERR_SSL_WANT_ASYNC )
                 continue;
 
             if( ret <= 0 )
@@ -2140,7 +2262,8 @@ data_exchange:
 
         do ret = mbedtls_ssl_read( &ssl, buf, len );
         while( ret == MBEDTLS_ERR_SSL_WANT_READ ||
-               ret == MBEDTLS_ERR_SSL_WANT_WRITE );
+               ret == MBEDTLS_ERR_SSL_WANT_WRITE ||
+               ret == MBEDTLS_ERR_SSL_WANT_ASYNC );
 
         if( ret <= 0 )
         {
@@ -2176,7 +2299,8 @@ data_exchange:
         while( ( ret = mbedtls_ssl_renegotiate( &ssl ) ) != 0 )
         {
             if( ret != MBEDTLS_ERR_SSL_WANT_READ &&
-                ret != MBEDTLS_ERR_SSL_WANT_WRITE )
+                ret != MBEDTLS_ERR_SSL_WANT_WRITE &&
+                ret != MBEDTLS_ERR_SSL_WANT_ASYNC )
             {
                 mbedtls_printf( " failed\n  ! mbedtls_ssl_renegotiate returned %d\n\n", ret );
                 goto reset;
@@ -2210,7 +2334,8 @@ data_exchange:
                 }
 
                 if( ret != MBEDTLS_ERR_SSL_WANT_READ &&
-                    ret != MBEDTLS_ERR_SSL_WANT_WRITE )
+                    ret != MBEDTLS_ERR_SSL_WANT_WRITE &&
+                    ret != MBEDTLS_ERR_SSL_WANT_ASYNC )
                 {
                     mbedtls_printf( " failed\n  ! mbedtls_ssl_write returned %d\n\n", ret );
                     goto reset;
@@ -2222,7 +2347,8 @@ data_exchange:
     {
         do ret = mbedtls_ssl_write( &ssl, buf, len );
         while( ret == MBEDTLS_ERR_SSL_WANT_READ ||
-               ret == MBEDTLS_ERR_SSL_WANT_WRITE );
+               ret == MBEDTLS_ERR_SSL_WANT_WRITE ||
+               ret == MBEDTLS_ERR_SSL_WANT_ASYNC );
 
         if( ret < 0 )
         {
@@ -74,6 +74,11 @@ int main( void )
 #include "mbedtls/memory_buffer_alloc.h"
 #endif
 
+#if defined(MBEDTLS_THREADING_PTHREAD)
+#include <pthread.h>
+#include "mbedtls/threading.h"
+#endif
+
 /*
  * For heap usage estimates, we need an estimate of the overhead per allocated
  * block. ptmalloc2/3 (used in gnu libc for instance) uses 2 size_t per block,
@@ -216,7 +221,8 @@ static int myrand( void *rng_state, unsigned char *output, size_t len )
 #if defined(MBEDTLS_ECP_C)
 void ecp_clear_precomputed( mbedtls_ecp_group *grp )
 {
-    if( grp->T != NULL )
+    /* Tables from the comb cache are only detached, never freed here */
+    if( grp->T != NULL && ! grp->T_shared )
     {
         size_t i;
         for( i = 0; i < grp->T_size; i++ )
@@ -225,6 +231,7 @@ void ecp_clear_precomputed( mbedtls_ecp_group *grp )
     }
     grp->T = NULL;
     grp->T_size = 0;
+    grp->T_shared = 0;
 }
 #else
 #define ecp_clear_precomputed( g )
@@ -232,6 +239,116 @@ void ecp_clear_precomputed( mbedtls_ecp_group *grp )
 
 unsigned char buf[BUFSIZE];
 
+#if defined(MBEDTLS_CIPHER_MODE_XTS) && defined(MBEDTLS_THREADING_PTHREAD)
+#define XTS_BENCH_SIZE      ( 256 * 1024 )
+#define XTS_BENCH_SECTOR    4096
+
+unsigned char xts_buf[XTS_BENCH_SIZE];
+
+/*
+ * Aggregate multi-sector XTS throughput on a pool of 1, 2, 4, ... threads
+ * (counting the submitting thread)
+ */
+static void xts_pool_scaling( mbedtls_aes_context *crypt_ctx,
+                              mbedtls_aes_context *tweak_ctx )
+{
+    mbedtls_threading_pool pool;
+    char title[TITLE_LEN];
+    unsigned long count;
+    unsigned char n;
+
+    for( n = 1; n <= 8; n *= 2 )
+    {
+        mbedtls_threading_pool_init( &pool );
+        if( mbedtls_threading_pool_setup( &pool, n - 1 ) != 0 )
+            mbedtls_exit( 1 );
+
+        mbedtls_snprintf( title, sizeof( title ), "AES-XTS 4K pool x%d", n );
+        mbedtls_printf( HEADER_FORMAT, title );
+        fflush( stdout );
+
+        mbedtls_set_alarm( 1 );
+        for( count = 0; ! mbedtls_timing_alarmed; count++ )
+        {
+            if( mbedtls_aes_crypt_xts_sectors( crypt_ctx, tweak_ctx,
+                        MBEDTLS_AES_ENCRYPT, XTS_BENCH_SECTOR, 0,
+                        XTS_BENCH_SIZE, xts_buf, xts_buf, &pool ) != 0 )
+                mbedtls_exit( 1 );
+        }
+
+        mbedtls_printf( "%9lu Kb/s\n", count * ( XTS_BENCH_SIZE / 1024 ) );
+
+        mbedtls_threading_pool_free( &pool );
+    }
+}
+#endif /* MBEDTLS_CIPHER_MODE_XTS && MBEDTLS_THREADING_PTHREAD */
+
+#if defined(MBEDTLS_CTR_DRBG_C) && defined(MBEDTLS_THREADING_PTHREAD)
+#define MAX_BENCH_THREADS   8
+
+typedef struct {
+    int (*f_rng)( void *, unsigned char *, size_t );
+    void *p_rng;
+    unsigned long count;
+    pthread_t thread;
+} rng_thread_info;
+
+static void *rng_thread( void *data )
+{
+    rng_thread_info *info = (rng_thread_info *) data;
+    unsigned char out[BUFSIZE];
+
+    while( ! mbedtls_timing_alarmed )
+    {
+        if( info->f_rng( info->p_rng, out, sizeof( out ) ) != 0 )
+            break;
+        info->count++;
+    }
+
+    return( NULL );
+}
+
+/*
+ * Aggregate throughput of 1, 2, 4, ... threads drawing from the same RNG
+ */
+static void rng_thread_scaling( const char *name,
+                                int (*f_rng)( void *, unsigned char *, size_t ),
+                                void *p_rng )
+{
+    rng_thread_info info[MAX_BENCH_THREADS];
+    char title[TITLE_LEN];
+    unsigned long total;
+    int n, i;
+
+    for( n = 1; n <= MAX_BENCH_THREADS; n *= 2 )
+    {
+        mbedtls_snprintf( title, sizeof( title ), "%s x%d", name, n );
+        mbedtls_printf( HEADER_FORMAT, title );
+        fflush( stdout );
+
+        memset( info, 0, sizeof( info ) );
+        mbedtls_set_alarm( 1 );
+
+        for( i = 0; i < n; i++ )
+        {
+            info[i].f_rng = f_rng;
+            info[i].p_rng = p_rng;
+            if( pthread_create( &info[i].thread, NULL, rng_thread, &info[i] ) != 0 )
+                mbedtls_exit( 1 );
+        }
+
+        total = 0;
+        for( i = 0; i < n; i++ )
+        {
+            pthread_join( info[i].thread, NULL );
+            total += info[i].count;
+        }
+
+        mbedtls_printf( "%9lu Kb/s\n", total * BUFSIZE / 1024 );
+    }
+}
+#endif /* MBEDTLS_CTR_DRBG_C && MBEDTLS_THREADING_PTHREAD */
+
 typedef struct {
     char md4, md5, ripemd160, sha1, sha256, sha512,
          arc4, des3, des, aes_cbc, aes_xex, aes_xts, aes_gcm, aes_ccm,
@@ -447,6 +564,9 @@ int main( int argc, char *argv[] )
             TIME_AND_TSC( title,
                 mbedtls_aes_crypt_xts( &crypt_ctx, &tweak_ctx, MBEDTLS_AES_ENCRYPT, BUFSIZE * 8, tmp, buf, buf ) );
         }
+#if defined(MBEDTLS_THREADING_PTHREAD)
+        xts_pool_scaling( &crypt_ctx, &tweak_ctx );
+#endif
         mbedtls_aes_free( &crypt_ctx );
         mbedtls_aes_free( &tweak_ctx );
     }
@@ -559,6 +679,7 @@ int main( int argc, char *argv[] )
     if( todo.ctr_drbg )
     {
         mbedtls_ctr_drbg_context ctr_drbg;
+        size_t off;
 
         mbedtls_ctr_drbg_init( &ctr_drbg );
 
@@ -568,6 +689,16 @@ int main( int argc, char *argv[] )
                 if( mbedtls_ctr_drbg_random( &ctr_drbg, buf, BUFSIZE ) != 0 )
                 mbedtls_exit(1) );
 
+        TIME_AND_TSC( "CTR_DRBG (16B calls)",
+                for( off = 0; off < BUFSIZE; off += 16 )
+                    if( mbedtls_ctr_drbg_random( &ctr_drbg, buf + off, 16 ) != 0 )
+                        mbedtls_exit(1) );
+
+        TIME_AND_TSC( "CTR_DRBG (16B buffered)",
+                for( off = 0; off < BUFSIZE; off += 16 )
+                    if( mbedtls_ctr_drbg_random_buffered( &ctr_drbg, buf + off, 16 ) != 0 )
+                        mbedtls_exit(1) );
+
         if( mbedtls_ctr_drbg_seed( &ctr_drbg, myrand, NULL, NULL, 0 ) != 0 )
             mbedtls_exit(1);
         mbedtls_ctr_drbg_set_prediction_resistance( &ctr_drbg, MBEDTLS_CTR_DRBG_PR_ON );
@@ -575,6 +706,25 @@ int main( int argc, char *argv[] )
                 if( mbedtls_ctr_drbg_random( &ctr_drbg, buf, BUFSIZE ) != 0 )
                 mbedtls_exit(1) );
         mbedtls_ctr_drbg_free( &ctr_drbg );
+
+#if defined(MBEDTLS_THREADING_PTHREAD)
+        {
+            mbedtls_ctr_drbg_pool pool;
+
+            mbedtls_ctr_drbg_init( &ctr_drbg );
+            if( mbedtls_ctr_drbg_seed( &ctr_drbg, myrand, NULL, NULL, 0 ) != 0 )
+                mbedtls_exit(1);
+            rng_thread_scaling( "CTR_DRBG shared", mbedtls_ctr_drbg_random, &ctr_drbg );
+            mbedtls_ctr_drbg_free( &ctr_drbg );
+
+            mbedtls_ctr_drbg_pool_init( &pool );
+            if( mbedtls_ctr_drbg_pool_seed( &pool, MAX_BENCH_THREADS, myrand, NULL,
+                                            NULL, 0 ) != 0 )
+                mbedtls_exit(1);
+            rng_thread_scaling( "CTR_DRBG pool", mbedtls_ctr_drbg_pool_random, &pool );
+            mbedtls_ctr_drbg_pool_free( &pool );
+        }
+#endif /* MBEDTLS_THREADING_PTHREAD */
     }
 #endif
 
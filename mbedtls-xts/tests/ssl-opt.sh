@@ -25,6 +25,7 @@ set -u
 : ${P_SRV:=../programs/ssl/ssl_server2}
 : ${P_CLI:=../programs/ssl/ssl_client2}
 : ${P_PXY:=../programs/test/udp_proxy}
+: ${P_EPOLL:=../programs/ssl/ssl_epoll_server}
 : ${OPENSSL_CMD:=openssl} # OPENSSL would conflict with the build system
 : ${GNUTLS_CLI:=gnutls-cli}
 : ${GNUTLS_SERV:=gnutls-serv}
@@ -587,6 +588,7 @@ unset PORT_BASE
 P_SRV="$P_SRV server_addr=127.0.0.1 server_port=$SRV_PORT"
 P_CLI="$P_CLI server_addr=127.0.0.1 server_port=+SRV_PORT"
 P_PXY="$P_PXY server_addr=127.0.0.1 server_port=$SRV_PORT listen_addr=127.0.0.1 listen_port=$PXY_PORT"
+P_EPOLL="$P_EPOLL server_addr=127.0.0.1 server_port=$SRV_PORT"
 O_SRV="$O_SRV -accept $SRV_PORT -dhparam data_files/dhparams.pem"
 O_CLI="$O_CLI -connect localhost:+SRV_PORT"
 G_SRV="$G_SRV -p $SRV_PORT"
@@ -2066,6 +2068,87 @@ run_test    "Non-blocking I/O: session-id resume" \
             -C "mbedtls_ssl_handshake returned" \
             -c "Read from server: .* bytes read"
 
+# Tests for asynchronous private key operations
+
+requires_config_enabled MBEDTLS_SSL_ASYNC_PRIVATE
+run_test    "Async private key: sign, immediate" \
+            "$P_SRV async_private=0" \
+            "$P_CLI force_ciphersuite=TLS-ECDHE-ECDSA-WITH-AES-128-GCM-SHA256" \
+            0 \
+            -s "Async sign started" \
+            -s "Async sign completed" \
+            -S "mbedtls_ssl_handshake returned"
+
+requires_config_enabled MBEDTLS_SSL_ASYNC_PRIVATE
+run_test    "Async private key: sign, delayed" \
+            "$P_SRV async_private=3 debug_level=2" \
+            "$P_CLI force_ciphersuite=TLS-ECDHE-RSA-WITH-AES-128-GCM-SHA256" \
+            0 \
+            -s "Async sign started" \
+            -s "signature in progress" \
+            -s "Async sign completed" \
+            -S "mbedtls_ssl_handshake returned"
+
+requires_config_enabled MBEDTLS_SSL_ASYNC_PRIVATE
+run_test    "Async private key: decrypt, delayed" \
+            "$P_SRV async_private=3 debug_level=2" \
+            "$P_CLI force_ciphersuite=TLS-RSA-WITH-AES-128-GCM-SHA256" \
+            0 \
+            -s "Async decrypt started" \
+            -s "decryption in progress" \
+            -s "Async decrypt completed" \
+            -S "mbedtls_ssl_handshake returned"
+
+requires_config_enabled MBEDTLS_SSL_ASYNC_PRIVATE
+run_test    "Async private key: sign, delayed, non-blocking I/O" \
+            "$P_SRV async_private=2 nbio=2 tickets=0" \
+            "$P_CLI nbio=2 tickets=0 force_ciphersuite=TLS-ECDHE-ECDSA-WITH-AES-128-GCM-SHA256" \
+            0 \
+            -s "Async sign completed" \
+            -S "mbedtls_ssl_handshake returned" \
+            -c "Read from server: .* bytes read"
+
+requires_config_enabled MBEDTLS_SSL_ASYNC_PRIVATE
+run_test    "Async private key: renegotiation, delayed" \
+            "$P_SRV async_private=1 debug_level=2 exchanges=2 renegotiation=1 renegotiate=1" \
+            "$P_CLI exchanges=2 renegotiation=1 force_ciphersuite=TLS-ECDHE-ECDSA-WITH-AES-128-GCM-SHA256" \
+            0 \
+            -s "Async sign completed" \
+            -s "=> renegotiate" \
+            -S "mbedtls_ssl_renegotiate returned" \
+            -S "mbedtls_ssl_handshake returned"
+
+# Tests for the event-driven server
+
+requires_config_enabled MBEDTLS_NET_POLLER
+requires_config_enabled MBEDTLS_THREADING_PTHREAD
+run_test    "Epoll server: default" \
+            "$P_EPOLL" \
+            "$P_CLI" \
+            0 \
+            -s "Total: 1 connections, 1 handshakes .* 0 failed" \
+            -c "Read from server: .* bytes read"
+
+requires_config_enabled MBEDTLS_NET_POLLER
+requires_config_enabled MBEDTLS_THREADING_PTHREAD
+run_test    "Epoll server: keep-alive, large response" \
+            "$P_EPOLL threads=2 response_size=40000" \
+            "$P_CLI exchanges=3" \
+            0 \
+            -s "Total: 1 connections, 1 handshakes .* 0 failed" \
+            -s "120000 bytes written" \
+            -c "Read from server: 16384 bytes read"
+
+requires_config_enabled MBEDTLS_NET_POLLER
+requires_config_enabled MBEDTLS_THREADING_PTHREAD
+run_test    "Epoll server: reconnect, non-blocking client" \
+            "$P_EPOLL threads=4" \
+            "$P_CLI nbio=2 reconnect=2" \
+            0 \
+            -s "Total: 3 connections, 3 handshakes .* 0 failed" \
+            -c "Reconnecting with saved session" \
+            -C "mbedtls_ssl_handshake returned"
+
 # Tests for version negotiation
 
 run_test    "Version check: all -> 1.2" \